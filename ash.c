@@ -0,0 +1,554 @@
+/*-------------------------------------------------------------------------
+ *
+ * ash.c
+ *		Active session history of pg_linux_proc
+ *
+ * A background worker looks at every backend each pg_linux_proc.ash_interval
+ * and, for those that are active, records the wait event and query id
+ * together with the scheduler state of the process: its state and
+ * processor in /proc/<pid>/stat, the kernel function it sleeps in from
+ * /proc/<pid>/wchan, and the time spent on a cpu and on a runqueue since
+ * the previous sample from /proc/<pid>/schedstat.  This tells a backend
+ * waiting on a lock from one that is runnable but starved of cpu.
+ *
+ * The samples are kept in a ring buffer in shared memory, which is read by
+ * pg_proc_ash().  wchan names are stored once in a small dictionary and
+ * referenced by index, to keep each sample at a fixed, small size.
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "catalog/pg_authid.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/interrupt.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/lwlock.h"
+#include "storage/proc.h"
+#include "storage/procarray.h"
+#include "storage/shmem.h"
+#include "tcop/tcopprot.h"
+#include "utils/acl.h"
+#include "utils/backend_status.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+
+#include "ash.h"
+#include "pg_linux_proc.h"
+#include "pid.h"
+
+#define ASH_TRANCHE_NAME	"pg_linux_proc ash"
+
+/* cpu_time and run_delay of a sample whose previous sample is unknown */
+#define ASH_DELTA_UNKNOWN	PG_UINT32_MAX
+
+/*
+ * Shared state of the ring buffer.
+ *
+ * next is the number of samples written since server start.  Samples and
+ * wchan names are written by the worker under the exclusive lock and read
+ * by backends under the shared lock.  wchans[0] is "", i.e. no wchan.
+ */
+typedef struct AshShared
+{
+	LWLock	   *lock;
+	int			size;			/* number of samples */
+	uint64		next;
+	int			nwchans;
+	char		wchans[ASH_MAX_WCHANS][ASH_WCHAN_LEN];
+	AshSample	samples[FLEXIBLE_ARRAY_MEMBER];
+}			AshShared;
+
+/* schedstat of a backend at its previous sample, in the worker */
+typedef struct AshPrev
+{
+	int			pid;			/* hash key */
+	uint64		round;			/* round of the previous sample */
+	int64		cpu_time;
+	int64		run_delay;
+}			AshPrev;
+
+/* wchan name to its index in AshShared.wchans, in the worker */
+typedef struct AshWchan
+{
+	char		name[ASH_WCHAN_LEN];	/* hash key */
+	uint16		id;
+}			AshWchan;
+
+/* GUC variables */
+int			ash_interval = 500;	/* ms */
+int			ash_size = 65536;
+
+static AshShared * ash = NULL;
+
+static HTAB *ash_prev = NULL;
+static HTAB *ash_wchans = NULL;
+
+void
+ash_define_gucs(void)
+{
+	DefineCustomIntVariable("pg_linux_proc.ash_interval",
+							"Sets the interval between samples of the active session history.",
+							NULL,
+							&ash_interval,
+							500,
+							10,
+							INT_MAX,
+							PGC_SIGHUP,
+							GUC_UNIT_MS,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("pg_linux_proc.ash_size",
+							"Sets the number of samples kept in the active session history.",
+							"Zero disables the active session history.",
+							&ash_size,
+							65536,
+							0,
+							INT_MAX / 2,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+}
+
+void
+ash_register_worker(void)
+{
+	BackgroundWorker worker;
+
+	if (ash_size <= 0)
+		return;
+
+	memset(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	worker.bgw_start_time = BgWorkerStart_PostmasterStart;
+	worker.bgw_restart_time = 10;
+	sprintf(worker.bgw_library_name, "pg_linux_proc");
+	sprintf(worker.bgw_function_name, "pg_linux_proc_ash_main");
+	snprintf(worker.bgw_name, BGW_MAXLEN, "pg_linux_proc ash sampler");
+	snprintf(worker.bgw_type, BGW_MAXLEN, "pg_linux_proc ash sampler");
+	worker.bgw_main_arg = (Datum) 0;
+	worker.bgw_notify_pid = 0;
+
+	RegisterBackgroundWorker(&worker);
+}
+
+Size
+ash_shmem_size(void)
+{
+	if (ash_size <= 0)
+		return 0;
+
+	return add_size(offsetof(AshShared, samples),
+					mul_size(sizeof(AshSample), ash_size));
+}
+
+void
+ash_shmem_request(void)
+{
+	if (ash_size <= 0)
+		return;
+
+	RequestAddinShmemSpace(ash_shmem_size());
+	RequestNamedLWLockTranche(ASH_TRANCHE_NAME, 1);
+}
+
+void
+ash_shmem_startup(void)
+{
+	bool		found;
+
+	if (ash_size <= 0)
+		return;
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	ash = ShmemInitStruct("pg_linux_proc ash",
+						  ash_shmem_size(),
+						  &found);
+	if (!found)
+	{
+		ash->lock = &(GetNamedLWLockTranche(ASH_TRANCHE_NAME))->lock;
+		ash->size = ash_size;
+		ash->next = 0;
+		ash->nwchans = 1;
+		ash->wchans[0][0] = '\0';
+	}
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+/*
+ * Set up the hash tables of the worker.  The wchan names may be left in
+ * shared memory by a previous incarnation of the worker.
+ */
+static void
+ash_init_worker(void)
+{
+	HASHCTL		ctl;
+	int			i;
+
+	ctl.keysize = sizeof(int);
+	ctl.entrysize = sizeof(AshPrev);
+	ash_prev = hash_create("pg_linux_proc ash backends", 256, &ctl,
+						   HASH_ELEM | HASH_BLOBS);
+
+	ctl.keysize = ASH_WCHAN_LEN;
+	ctl.entrysize = sizeof(AshWchan);
+	ash_wchans = hash_create("pg_linux_proc ash wchans", 64, &ctl,
+							 HASH_ELEM | HASH_STRINGS);
+
+	LWLockAcquire(ash->lock, LW_SHARED);
+	for (i = 1; i < ash->nwchans; i++)
+	{
+		AshWchan   *w = hash_search(ash_wchans, ash->wchans[i], HASH_ENTER, NULL);
+
+		w->id = (uint16) i;
+	}
+	LWLockRelease(ash->lock);
+}
+
+/*
+ * Return the index of the wchan name, adding it to the dictionary if it is
+ * new.  0 is returned for no wchan and once the dictionary is full.
+ */
+static uint16
+ash_wchan_id(const char *wchan)
+{
+	char		name[ASH_WCHAN_LEN];
+	AshWchan   *w;
+	bool		found;
+
+	if (wchan[0] == '\0')
+		return 0;
+
+	strlcpy(name, wchan, sizeof(name));
+	w = hash_search(ash_wchans, name, HASH_FIND, &found);
+	if (found)
+		return w->id;
+
+	if (ash->nwchans >= ASH_MAX_WCHANS)
+		return 0;
+
+	w = hash_search(ash_wchans, name, HASH_ENTER, NULL);
+
+	LWLockAcquire(ash->lock, LW_EXCLUSIVE);
+	w->id = (uint16) ash->nwchans;
+	strlcpy(ash->wchans[w->id], name, ASH_WCHAN_LEN);
+	ash->nwchans++;
+	LWLockRelease(ash->lock);
+
+	return w->id;
+}
+
+/*
+ * Return the delta of a schedstat counter in us, or ASH_DELTA_UNKNOWN if
+ * the previous value is not usable.  Unlike counter_delta(), a decrease
+ * is not taken as zero, as it means the pid was reused.
+ */
+static uint32
+ash_delta(int64 prev, int64 cur)
+{
+	int64		delta;
+
+	if (cur < prev)
+		return ASH_DELTA_UNKNOWN;
+	delta = counter_delta(prev, cur) / 1000;
+	if (delta >= ASH_DELTA_UNKNOWN)
+		return ASH_DELTA_UNKNOWN;
+	return (uint32) delta;
+}
+
+/*
+ * Sample the active backends and store them into the ring buffer.
+ *
+ * A backend with a session state is active while it runs a query.  The
+ * other processes, such as the checkpointer, are taken as idle while they
+ * wait in their main loop, i.e. on an event of the Activity class.
+ */
+static void
+ash_take_sample(uint64 round)
+{
+	AshSample  *samples;
+	int			nsamples = 0;
+	int			num_backends;
+	int			curr_backend;
+	TimestampTz ts;
+	HASH_SEQ_STATUS hash_seq;
+	AshPrev    *prev;
+	int			i;
+
+	pgstat_clear_backend_activity_snapshot();
+	num_backends = pgstat_fetch_stat_numbackends();
+	samples = (AshSample *) palloc(sizeof(AshSample) * Max(num_backends, 1));
+
+	ts = GetCurrentTimestamp();
+
+	for (curr_backend = 1; curr_backend <= num_backends; curr_backend++)
+	{
+		LocalPgBackendStatus *local_beentry;
+		PgBackendStatus *beentry;
+		PGPROC	   *proc;
+		uint32		wait_event_info = 0;
+		PidSched	ps;
+		AshSample  *s;
+		bool		found;
+
+		local_beentry = pl_local_beentry_by_index(curr_backend);
+		beentry = &local_beentry->backendStatus;
+
+		if (beentry->st_procpid <= 0 || beentry->st_procpid == MyProcPid)
+			continue;
+
+		if (beentry->st_state != STATE_UNDEFINED &&
+			beentry->st_state != STATE_RUNNING &&
+			beentry->st_state != STATE_FASTPATH)
+			continue;
+
+		/* Same lookup as pg_stat_activity */
+		proc = BackendPidGetProc(beentry->st_procpid);
+		if (proc == NULL && beentry->st_backendType != B_BACKEND)
+			proc = AuxiliaryPidGetProc(beentry->st_procpid);
+		if (proc != NULL)
+			wait_event_info = UINT32_ACCESS_ONCE(proc->wait_event_info);
+
+		if (beentry->st_state == STATE_UNDEFINED &&
+			(wait_event_info & 0xFF000000) == PG_WAIT_ACTIVITY)
+			continue;
+
+		if (!get_pid_sched(beentry->st_procpid, &ps))
+			continue;
+
+		s = &samples[nsamples++];
+		s->ts = ts;
+		s->query_id = beentry->st_query_id;
+		s->pid = beentry->st_procpid;
+		s->userid = beentry->st_userid;
+		s->wait_event_info = wait_event_info;
+		s->processor = (int16) ps.processor;
+		s->wchan = ash_wchan_id(ps.wchan);
+		s->state = ps.state;
+		s->backend_type = (uint8) beentry->st_backendType;
+
+		/* The deltas are known only if it was sampled in the last round. */
+		prev = hash_search(ash_prev, &s->pid, HASH_ENTER, &found);
+		if (found && prev->round == round - 1)
+		{
+			s->cpu_time = ash_delta(prev->cpu_time, ps.cpu_time);
+			s->run_delay = ash_delta(prev->run_delay, ps.run_delay);
+		}
+		else
+		{
+			s->cpu_time = ASH_DELTA_UNKNOWN;
+			s->run_delay = ASH_DELTA_UNKNOWN;
+		}
+		prev->round = round;
+		prev->cpu_time = ps.cpu_time;
+		prev->run_delay = ps.run_delay;
+	}
+
+	/* Forget the backends that have become idle or exited. */
+	hash_seq_init(&hash_seq, ash_prev);
+	while ((prev = hash_seq_search(&hash_seq)) != NULL)
+	{
+		if (prev->round != round)
+			hash_search(ash_prev, &prev->pid, HASH_REMOVE, NULL);
+	}
+
+	if (nsamples == 0)
+		return;
+
+	LWLockAcquire(ash->lock, LW_EXCLUSIVE);
+	for (i = 0; i < nsamples; i++)
+	{
+		ash->samples[ash->next % ash->size] = samples[i];
+		ash->next++;
+	}
+	LWLockRelease(ash->lock);
+}
+
+void
+pg_linux_proc_ash_main(Datum main_arg)
+{
+	MemoryContext sample_context;
+	uint64		round;
+
+	pqsignal(SIGHUP, SignalHandlerForConfigReload);
+	pqsignal(SIGTERM, die);
+	BackgroundWorkerUnblockSignals();
+
+	ash_init_worker();
+
+	sample_context = AllocSetContextCreate(TopMemoryContext,
+										   "pg_linux_proc ash sampler",
+										   ALLOCSET_DEFAULT_SIZES);
+
+	for (round = 1;; round++)
+	{
+		MemoryContext oldcontext;
+		TimestampTz start;
+		long		elapsed;
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (ConfigReloadPending)
+		{
+			ConfigReloadPending = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		start = GetCurrentTimestamp();
+
+		oldcontext = MemoryContextSwitchTo(sample_context);
+		ash_take_sample(round);
+		MemoryContextSwitchTo(oldcontext);
+		MemoryContextReset(sample_context);
+
+		/* Sleep until the next sampling time, not for a whole interval. */
+		elapsed = (long) ((GetCurrentTimestamp() - start) / 1000);
+
+		(void) WaitLatch(MyLatch,
+						 WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+						 Max(ash_interval - elapsed, 0),
+						 PG_WAIT_EXTENSION);
+		ResetLatch(MyLatch);
+	}
+}
+
+/*
+ * Active session history
+ */
+
+PG_FUNCTION_INFO_V1(pg_proc_ash);
+
+#define NUM_ASH_COLS 11
+
+Datum
+pg_proc_ash(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TimestampTz since = PG_GETARG_TIMESTAMPTZ(0);
+	Datum		values[NUM_ASH_COLS];
+	bool		nulls[NUM_ASH_COLS];
+	AshSample  *samples;
+	int			nsamples = 0;
+	char	  (*wchans)[ASH_WCHAN_LEN];
+	int			nwchans;
+	uint64		first;
+	uint64		n;
+	bool		read_all_stats;
+	int			j;
+
+	if (ash == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("pg_linux_proc active session history is not available"),
+				 errhint("pg_linux_proc must be loaded via shared_preload_libraries, and pg_linux_proc.ash_size must be greater than zero.")));
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	read_all_stats = has_privs_of_role(GetUserId(), ROLE_PG_READ_ALL_STATS);
+
+	/*
+	 * Copy the samples and names, and build the tuples without the lock.
+	 * A large ash_size makes the copy exceed MaxAllocSize.
+	 */
+	samples = (AshSample *) palloc_extended(mul_size(sizeof(AshSample), ash->size),
+											MCXT_ALLOC_HUGE);
+	wchans = palloc(ASH_WCHAN_LEN * ASH_MAX_WCHANS);
+
+	LWLockAcquire(ash->lock, LW_SHARED);
+
+	first = (ash->next > (uint64) ash->size) ? ash->next - ash->size : 0;
+	for (n = first; n < ash->next; n++)
+	{
+		AshSample  *s = &ash->samples[n % ash->size];
+
+		if (s->ts > since)
+			samples[nsamples++] = *s;
+	}
+	nwchans = ash->nwchans;
+	memcpy(wchans, ash->wchans, ASH_WCHAN_LEN * nwchans);
+
+	LWLockRelease(ash->lock);
+
+	for (j = 0; j < nsamples; j++)
+	{
+		AshSample  *s = &samples[j];
+		const char *backend_type = NULL;
+		const char *wait_event_type;
+		const char *wait_event;
+		char		state[2];
+		int			i;
+
+		memset(values, 0, sizeof(values));
+		memset(nulls, false, sizeof(nulls));
+
+		if (s->backend_type == B_BG_WORKER)
+			backend_type = GetBackgroundWorkerTypeByPid(s->pid);
+		if (backend_type == NULL)
+			backend_type = GetBackendTypeDesc((BackendType) s->backend_type);
+
+		wait_event_type = pgstat_get_wait_event_type(s->wait_event_info);
+		wait_event = pgstat_get_wait_event(s->wait_event_info);
+
+		state[0] = s->state;
+		state[1] = '\0';
+
+		i = 0;
+		values[i++] = TimestampTzGetDatum(s->ts);
+		values[i++] = Int32GetDatum(s->pid);
+		values[i++] = CStringGetTextDatum(backend_type);
+		values[i++] = CStringGetTextDatum(state);
+		values[i++] = Int32GetDatum((int32) s->processor);
+		if (wait_event_type)
+			values[i++] = CStringGetTextDatum(wait_event_type);
+		else
+			nulls[i++] = true;
+		if (wait_event)
+			values[i++] = CStringGetTextDatum(wait_event);
+		else
+			nulls[i++] = true;
+
+		/* Same visibility rule as pg_stat_activity.query_id */
+		if (s->query_id != 0 &&
+			(read_all_stats || has_privs_of_role(GetUserId(), s->userid)))
+			values[i++] = Int64GetDatum((int64) s->query_id);
+		else
+			nulls[i++] = true;
+
+		if (s->wchan > 0 && s->wchan < nwchans)
+			values[i++] = CStringGetTextDatum(wchans[s->wchan]);
+		else
+			nulls[i++] = true;
+
+		if (s->run_delay != ASH_DELTA_UNKNOWN)
+			values[i++] = Float8GetDatum((double) s->run_delay / 1000.0);
+		else
+			nulls[i++] = true;
+		if (s->cpu_time != ASH_DELTA_UNKNOWN)
+			values[i++] = Float8GetDatum((double) s->cpu_time / 1000.0);
+		else
+			nulls[i++] = true;
+
+		Assert(i == NUM_ASH_COLS);
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
@@ -0,0 +1,53 @@
+/*-------------------------------------------------------------------------
+ *
+ * ash.h
+ *		Active session history of pg_linux_proc
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#ifndef __ASH_H__
+#define __ASH_H__
+
+#include "datatype/timestamp.h"
+
+/* Max number of distinct wchan names kept in shared memory */
+#define ASH_MAX_WCHANS		1024
+#define ASH_WCHAN_LEN		32
+
+/*
+ * One sample of an active backend.  This is kept small, as a sample is
+ * taken per active backend at every pg_linux_proc.ash_interval.
+ */
+typedef struct AshSample
+{
+	TimestampTz ts;				/* sampling time */
+	uint64		query_id;
+	int32		pid;
+	Oid			userid;
+	uint32		wait_event_info;
+	uint32		run_delay;		/* us on a runqueue since the last sample */
+	uint32		cpu_time;		/* us on a cpu since the last sample */
+	int16		processor;
+	uint16		wchan;			/* index into the wchan names; 0 if none */
+	char		state;			/* R, S, D, ... of /proc/<pid>/stat */
+	uint8		backend_type;	/* BackendType */
+}			AshSample;
+
+/* GUC variables */
+extern int	ash_interval;
+extern int	ash_size;
+
+extern void ash_define_gucs(void);
+extern void ash_register_worker(void);
+extern Size ash_shmem_size(void);
+extern void ash_shmem_request(void);
+extern void ash_shmem_startup(void);
+
+extern PGDLLEXPORT void pg_linux_proc_ash_main(Datum main_arg);
+
+#endif
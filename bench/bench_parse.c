@@ -0,0 +1,564 @@
+/*-------------------------------------------------------------------------
+ *
+ * bench_parse.c
+ *		Benchmark of the /proc parsers
+ *
+ * This runs the parsing loops of the collectors over /proc fixtures, once
+ * with the sscanf() formats the collectors used to have and once with the
+ * in-place tokenizer of parse.h, and reports the cost per line.
+ *
+ * By default the fixtures are generated to model a large host (384 cpus
+ * and 4096 block devices).  Recorded files can be given instead:
+ *
+ *	bench_parse [-i iterations] [-c cpus] [-d devices]
+ *				[stat=FILE] [diskstats=FILE] [meminfo=FILE] [loadavg=FILE]
+ *
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres_fe.h"
+
+#include <time.h>
+
+#include "parse.h"
+
+typedef struct Fixture
+{
+	const char *name;
+	char	   *data;
+	size_t		len;
+	int			lines;
+}			Fixture;
+
+typedef int (*parse_fn) (char *buf);
+
+static volatile int64 sink;
+
+static double
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void
+fixture_set(Fixture * f, char *data, size_t len)
+{
+	size_t		i;
+
+	f->data = data;
+	f->len = len;
+	f->lines = 0;
+	for (i = 0; i < len; i++)
+		if (data[i] == '\n')
+			f->lines++;
+}
+
+static void
+fixture_load(Fixture * f, const char *path)
+{
+	FILE	   *fp;
+	char	   *data;
+	size_t		len = 0;
+	size_t		size = 65536;
+	size_t		n;
+
+	if ((fp = fopen(path, "r")) == NULL)
+	{
+		perror(path);
+		exit(1);
+	}
+	data = malloc(size);
+	while ((n = fread(data + len, 1, size - len - 1, fp)) > 0)
+	{
+		len += n;
+		if (len == size - 1)
+			data = realloc(data, size *= 2);
+	}
+	fclose(fp);
+	data[len] = '\0';
+
+	fixture_set(f, data, len);
+}
+
+/*
+ * Synthetic fixtures
+ */
+
+static char *
+append(char *buf, size_t *len, size_t *size, const char *line)
+{
+	size_t		n = strlen(line);
+
+	while (*len + n + 1 > *size)
+		buf = realloc(buf, *size *= 2);
+	memcpy(buf + *len, line, n + 1);
+	*len += n;
+
+	return buf;
+}
+
+static void
+make_stat(Fixture * f, int ncpus)
+{
+	size_t		len = 0;
+	size_t		size = 4096;
+	char	   *buf = malloc(size);
+	char		line[8192];
+	int			i;
+
+	buf[0] = '\0';
+	buf = append(buf, &len, &size,
+				 "cpu  92286512 3175321 63578512 6172382812 3509412 0 10736412 0 0 0\n");
+	for (i = 0; i < ncpus; i++)
+	{
+		snprintf(line, sizeof(line),
+				 "cpu%d 502595%d 13988 351453%d 313147621%d 20962 0 28700 0 0 0\n",
+				 i, i % 10, i % 7, i % 3);
+		buf = append(buf, &len, &size, line);
+	}
+
+	/* The intr line has one column per interrupt; it is not parsed. */
+	strcpy(line, "intr 1234567890");
+	for (i = 0; i < 1000; i++)
+		strcat(line, " 0");
+	strcat(line, "\n");
+	buf = append(buf, &len, &size, line);
+	buf = append(buf, &len, &size,
+				 "ctxt 9876543210\nbtime 1700000000\nprocesses 1234567\n"
+				 "procs_running 3\nprocs_blocked 0\n");
+
+	fixture_set(f, buf, len);
+}
+
+static void
+make_diskstats(Fixture * f, int ndevices)
+{
+	size_t		len = 0;
+	size_t		size = 4096;
+	char	   *buf = malloc(size);
+	char		line[512];
+	int			i;
+
+	buf[0] = '\0';
+	for (i = 0; i < ndevices; i++)
+	{
+		snprintf(line, sizeof(line),
+				 " 259 %7d nvme%dn1p%d 8912334%d 1289 2849217364 1736472 "
+				 "293847562 8172634 98172634123 8273645 0 9182736 10010117 "
+				 "0 0 0 0 1827364 82736\n",
+				 i, i / 16, i % 16, i % 10);
+		buf = append(buf, &len, &size, line);
+	}
+
+	fixture_set(f, buf, len);
+}
+
+static const char *meminfo_keys[] = {
+	"MemTotal:", "MemFree:", "MemAvailable:", "Buffers:", "Cached:",
+	"SwapCached:", "Active:", "Inactive:", "Active(anon):", "Inactive(anon):",
+	"Active(file):", "Inactive(file):", "Unevictable:", "Mlocked:",
+	"SwapTotal:", "SwapFree:", "Zswap:", "Zswapped:", "Dirty:", "Writeback:",
+	"AnonPages:", "Mapped:", "Shmem:", "KReclaimable:", "Slab:",
+	"SReclaimable:", "SUnreclaim:", "KernelStack:", "PageTables:",
+	"SecPageTables:", "NFS_Unstable:", "Bounce:", "WritebackTmp:",
+	"CommitLimit:", "Committed_AS:", "VmallocTotal:", "VmallocUsed:",
+	"VmallocChunk:", "Percpu:", "HardwareCorrupted:", "AnonHugePages:",
+	"ShmemHugePages:", "ShmemPmdMapped:", "FileHugePages:", "FilePmdMapped:",
+	"CmaTotal:", "CmaFree:", "Unaccepted:", "HugePages_Total:",
+	"HugePages_Free:", "HugePages_Rsvd:", "HugePages_Surp:", "Hugepagesize:",
+	"Hugetlb:", "DirectMap4k:", "DirectMap2M:", "DirectMap1G:",
+};
+
+#define NUM_MEMINFO_KEYS	(sizeof(meminfo_keys) / sizeof(meminfo_keys[0]))
+
+static void
+make_meminfo(Fixture * f)
+{
+	size_t		len = 0;
+	size_t		size = 4096;
+	char	   *buf = malloc(size);
+	char		line[128];
+	size_t		i;
+
+	buf[0] = '\0';
+	for (i = 0; i < NUM_MEMINFO_KEYS; i++)
+	{
+		snprintf(line, sizeof(line), "%-16s%10zu kB\n",
+				 meminfo_keys[i], 16318032 - i * 1234);
+		buf = append(buf, &len, &size, line);
+	}
+
+	fixture_set(f, buf, len);
+}
+
+static void
+make_loadavg(Fixture * f)
+{
+	fixture_set(f, strdup("0.35 0.28 0.21 3/1402 123456\n"), 29);
+}
+
+/*
+ * The former sscanf()-based loops, line by line as with fgets()
+ */
+
+static char *
+sscanf_next_line(char **pp)
+{
+	char	   *line = *pp;
+	char	   *nl;
+
+	if (*line == '\0')
+		return NULL;
+	if ((nl = strchr(line, '\n')) != NULL)
+		*pp = nl + 1;
+	else
+		*pp = line + strlen(line);
+	return line;
+}
+
+static int
+sscanf_stat(char *buf)
+{
+	char	   *p = buf;
+	char	   *line;
+	int			n = 0;
+
+	while ((line = sscanf_next_line(&p)) != NULL)
+	{
+		char		cpu[8];
+		int64		v[10];
+
+		if (strncmp(line, "cpu", 3) == 0 &&
+			(line[3] == ' ' || (line[3] >= '0' && line[3] <= '9')))
+		{
+			if (sscanf(line, "%7s %ld %ld %ld %ld %ld %ld %ld %ld %ld %ld",
+					   cpu, &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6],
+					   &v[7], &v[8], &v[9]) < 9)
+				return -1;
+			sink += v[3];
+		}
+		n++;
+	}
+	return n;
+}
+
+static int
+sscanf_diskstats(char *buf)
+{
+	char	   *p = buf;
+	char	   *line;
+	int			n = 0;
+
+	while ((line = sscanf_next_line(&p)) != NULL)
+	{
+		int			major,
+					minor;
+		char		name[32];
+		int64		v[17];
+
+		if (sscanf(line, "%d %d %31s %ld %ld  %ld %ld %ld %ld %ld  %ld %ld %ld %ld %ld %ld %ld %ld %ld %ld",
+				   &major, &minor, name, &v[0], &v[1], &v[2], &v[3], &v[4],
+				   &v[5], &v[6], &v[7], &v[8], &v[9], &v[10], &v[11], &v[12],
+				   &v[13], &v[14], &v[15], &v[16]) < 14)
+			return -1;
+		sink += v[2];
+		n++;
+	}
+	return n;
+}
+
+static int
+sscanf_meminfo(char *buf)
+{
+	char	   *p = buf;
+	char	   *line;
+	int			n = 0;
+
+	while ((line = sscanf_next_line(&p)) != NULL)
+	{
+		size_t		i;
+
+		/* 50 keys are looked up linearly, as get_proc_meminfo() did */
+		for (i = 0; i < 50 && i < NUM_MEMINFO_KEYS; i++)
+		{
+			size_t		len = strlen(meminfo_keys[i]);
+
+			if (strncmp(meminfo_keys[i], line, len) == 0)
+			{
+				int64		v;
+
+				if (sscanf(line, "%*s %ld %*s", &v) < 1)
+					return -1;
+				sink += v;
+				break;
+			}
+		}
+		n++;
+	}
+	return n;
+}
+
+static int
+sscanf_loadavg(char *buf)
+{
+	float		l1,
+				l5,
+				l15;
+	int			cur,
+				total,
+				last;
+
+	if (sscanf(buf, "%f %f %f %d/%d %d", &l1, &l5, &l15, &cur, &total, &last) < 6)
+		return -1;
+	sink += total;
+	return 1;
+}
+
+/*
+ * The parse.h loops, with the field handling of the collectors: the same
+ * calls, the same minimum numbers of fields and the same key checks.  Only
+ * the storing of the values into palloc'd structs and Lists is left out,
+ * since the collectors cannot be linked into a frontend program.
+ */
+
+/* As NUM_STAT_FIELDS_MIN/MAX of stat.h, and NUM_DISKSTATS_FIELDS_MIN/MAX */
+#define STAT_FIELDS_MIN			9
+#define STAT_FIELDS_MAX			11
+#define DISKSTATS_FIELDS_MIN	14
+#define DISKSTATS_FIELDS_MAX	20
+
+static int
+pl_stat(char *buf)
+{
+	char	   *p = buf;
+	char	   *line;
+	int			n = 0;
+
+	while ((line = pl_next_line(&p)) != NULL)
+	{
+		char	   *name;
+		int64		v[STAT_FIELDS_MAX - 1];
+
+		/* The rest, including the long intr line, is not parsed. */
+		if (strncmp(line, "cpu", 3) != 0)
+			break;
+		name = pl_next_token(&line);
+		memset(v, 0, sizeof(v));
+		if (pl_parse_int64_array(&line, v, lengthof(v)) < STAT_FIELDS_MIN - 1)
+			return -1;
+		sink += v[3] + name[0];
+		n++;
+	}
+	return n;
+}
+
+static int
+pl_diskstats(char *buf)
+{
+	char	   *p = buf;
+	char	   *line;
+	int			n = 0;
+
+	while ((line = pl_next_line(&p)) != NULL)
+	{
+		int32		major,
+					minor;
+		char	   *name;
+		int64		v[DISKSTATS_FIELDS_MAX - 3];
+
+		if (!pl_parse_int32(&line, &major) ||
+			!pl_parse_int32(&line, &minor) ||
+			(name = pl_next_token(&line)) == NULL)
+			return -1;
+		memset(v, 0, sizeof(v));
+		if (pl_parse_int64_array(&line, v, lengthof(v)) < DISKSTATS_FIELDS_MIN - 3)
+			return -1;
+		sink += v[2] + name[0];
+		n++;
+	}
+	return n;
+}
+
+static int
+pl_meminfo(char *buf)
+{
+	char	   *p = buf;
+	char	   *line;
+	int			n = 0;
+
+	while ((line = pl_next_line(&p)) != NULL)
+	{
+		char	   *key = pl_next_token(&line);
+		char	   *unit;
+		size_t		keylen;
+		int64		v;
+
+		if (key == NULL)
+			continue;
+
+		keylen = strlen(key);
+		if (keylen < 2 || key[keylen - 1] != ':' ||
+			!pl_parse_int64(&line, &v))
+			return -1;
+		key[keylen - 1] = '\0';
+		unit = pl_next_token(&line);
+
+		sink += v + key[0] + (unit ? unit[0] : 0);
+		n++;
+	}
+	return n;
+}
+
+static int
+pl_loadavg(char *buf)
+{
+	char	   *p = buf;
+	float4		l1,
+				l5,
+				l15;
+	int32		cur,
+				total,
+				last;
+
+	if (!pl_parse_float4(&p, &l1) || !pl_parse_float4(&p, &l5) ||
+		!pl_parse_float4(&p, &l15) || !pl_parse_int32(&p, &cur) ||
+		!pl_expect_char(&p, '/') || !pl_parse_int32(&p, &total) ||
+		!pl_parse_int32(&p, &last))
+		return -1;
+	sink += total;
+	return 1;
+}
+
+/*
+ * Run fn over a fresh copy of the fixture for each iteration, since the
+ * tokenizer modifies the buffer.  The copy is timed separately and
+ * subtracted.
+ */
+static double
+run(Fixture * f, parse_fn fn, long iterations)
+{
+	char	   *work = malloc(f->len + 1);
+	double		start;
+	double		copy_ns;
+	double		total_ns;
+	long		i;
+
+	start = now_ns();
+	for (i = 0; i < iterations; i++)
+	{
+		memcpy(work, f->data, f->len + 1);
+		sink += work[i % (f->len + 1)];
+	}
+	copy_ns = now_ns() - start;
+
+	start = now_ns();
+	for (i = 0; i < iterations; i++)
+	{
+		memcpy(work, f->data, f->len + 1);
+		if (fn(work) < 0)
+		{
+			fprintf(stderr, "could not parse %s\n", f->name);
+			exit(1);
+		}
+	}
+	total_ns = now_ns() - start;
+
+	free(work);
+
+	return (total_ns - copy_ns) / iterations / f->lines;
+}
+
+int
+main(int argc, char **argv)
+{
+	long		iterations = 1000;
+	int			ncpus = 384;
+	int			ndevices = 4096;
+	Fixture		stat = {"stat"},
+				diskstats = {"diskstats"},
+				meminfo = {"meminfo"},
+				loadavg = {"loadavg"};
+	const char *stat_path = NULL,
+			   *diskstats_path = NULL,
+			   *meminfo_path = NULL,
+			   *loadavg_path = NULL;
+	int			i;
+	struct
+	{
+		Fixture    *f;
+		parse_fn	old_fn;
+		parse_fn	new_fn;
+	}			cases[4];
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+			iterations = atol(argv[++i]);
+		else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+			ncpus = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+			ndevices = atoi(argv[++i]);
+		else if (strncmp(argv[i], "stat=", 5) == 0)
+			stat_path = argv[i] + 5;
+		else if (strncmp(argv[i], "diskstats=", 10) == 0)
+			diskstats_path = argv[i] + 10;
+		else if (strncmp(argv[i], "meminfo=", 8) == 0)
+			meminfo_path = argv[i] + 8;
+		else if (strncmp(argv[i], "loadavg=", 8) == 0)
+			loadavg_path = argv[i] + 8;
+		else
+		{
+			fprintf(stderr, "usage: %s [-i iterations] [-c cpus] [-d devices] "
+					"[stat=FILE] [diskstats=FILE] [meminfo=FILE] [loadavg=FILE]\n",
+					argv[0]);
+			return 1;
+		}
+	}
+
+	if (stat_path)
+		fixture_load(&stat, stat_path);
+	else
+		make_stat(&stat, ncpus);
+	if (diskstats_path)
+		fixture_load(&diskstats, diskstats_path);
+	else
+		make_diskstats(&diskstats, ndevices);
+	if (meminfo_path)
+		fixture_load(&meminfo, meminfo_path);
+	else
+		make_meminfo(&meminfo);
+	if (loadavg_path)
+		fixture_load(&loadavg, loadavg_path);
+	else
+		make_loadavg(&loadavg);
+
+	cases[0].f = &stat;
+	cases[0].old_fn = sscanf_stat;
+	cases[0].new_fn = pl_stat;
+	cases[1].f = &diskstats;
+	cases[1].old_fn = sscanf_diskstats;
+	cases[1].new_fn = pl_diskstats;
+	cases[2].f = &meminfo;
+	cases[2].old_fn = sscanf_meminfo;
+	cases[2].new_fn = pl_meminfo;
+	cases[3].f = &loadavg;
+	cases[3].old_fn = sscanf_loadavg;
+	cases[3].new_fn = pl_loadavg;
+
+	printf("ns per line, %ld iterations\n", iterations);
+	printf("%-10s %7s %10s %10s\n", "file", "lines", "sscanf", "parse.h");
+	for (i = 0; i < 4; i++)
+	{
+		Fixture    *f = cases[i].f;
+
+		printf("%-10s %7d %10.1f %10.1f\n", f->name, f->lines,
+			   run(f, cases[i].old_fn, iterations),
+			   run(f, cases[i].new_fn, iterations));
+	}
+
+	return 0;
+}
@@ -0,0 +1,314 @@
+/*-------------------------------------------------------------------------
+ *
+ * bench_proc_read.c
+ *		Memory high-water mark of the ways pg_proc() can read a file
+ *
+ * This replays the allocations of each strategy over a file with a
+ * counting allocator and reports the peak number of bytes allocated:
+ *
+ *	list	fgets() into 1024 bytes, a palloc0'd 1024-byte copy of each line
+ *			in a List, a buffer for the concatenation, and the text copy
+ *			made by cstring_to_text(); the former pg_proc()
+ *	strinfo	read() into one StringInfo that doubles as needed, returned
+ *			as the text value; pg_proc()
+ *	lines	read() into a reused 8kB buffer, one text value per line that
+ *			is freed before the next one; pg_proc_lines()
+ *
+ * Usage: bench_proc_read [iterations] [file]
+ *
+ * The default file is /proc/self/smaps, which is large in a backend with
+ * big shared_buffers; the smaps of a running backend can be given to see
+ * that case.
+ *
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define VARHDRSZ	4
+#define BLCKSZ		8192
+#define LINES_BUFSIZE	8192
+
+/*
+ * Counting allocator.  Each chunk carries its size so that frees can be
+ * accounted.
+ */
+static size_t cur_bytes;
+static size_t peak_bytes;
+
+static void *
+xalloc(size_t size)
+{
+	size_t	   *p = malloc(sizeof(size_t) + size);
+
+	if (p == NULL)
+	{
+		perror("malloc");
+		exit(1);
+	}
+	*p = size;
+	cur_bytes += size;
+	if (cur_bytes > peak_bytes)
+		peak_bytes = cur_bytes;
+	return p + 1;
+}
+
+static void
+xfree(void *ptr)
+{
+	size_t	   *p = (size_t *) ptr - 1;
+
+	cur_bytes -= *p;
+	free(p);
+}
+
+/* Like repalloc(): the old and the new chunk coexist while copying. */
+static void *
+xrealloc(void *ptr, size_t size)
+{
+	size_t		old = ((size_t *) ptr)[-1];
+	void	   *n = xalloc(size);
+
+	memcpy(n, ptr, old < size ? old : size);
+	xfree(ptr);
+	return n;
+}
+
+static double
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int
+open_file(const char *path)
+{
+	int			fd = open(path, O_RDONLY);
+
+	if (fd < 0)
+	{
+		perror(path);
+		exit(1);
+	}
+	return fd;
+}
+
+/* A List of pointers grows by doubling, as pg_list.h does. */
+typedef struct PtrList
+{
+	int			length;
+	int			max_length;
+	char	  **elements;
+}			PtrList;
+
+static size_t
+read_list(const char *path)
+{
+	FILE	   *fp = fopen(path, "r");
+	char		buffer[1024];
+	PtrList		list = {0, 0, NULL};
+	size_t		length = 0;
+	char	   *ret;
+	char	   *text;
+	int			i;
+
+	if (fp == NULL)
+	{
+		perror(path);
+		exit(1);
+	}
+
+	while (fgets(buffer, sizeof(buffer) - 1, fp) != NULL)
+	{
+		char	   *l = xalloc(sizeof(buffer));
+
+		memset(l, 0, sizeof(buffer));
+		memcpy(l, buffer, sizeof(buffer));
+		if (list.length == list.max_length)
+		{
+			list.max_length = list.max_length ? list.max_length * 2 : 8;
+			list.elements = list.elements ?
+				xrealloc(list.elements, list.max_length * sizeof(char *)) :
+				xalloc(list.max_length * sizeof(char *));
+		}
+		list.elements[list.length++] = l;
+	}
+	fclose(fp);
+
+	for (i = 0; i < list.length; i++)
+		length += strlen(list.elements[i]);
+
+	ret = xalloc(length + 1);
+	length = 0;
+	for (i = 0; i < list.length; i++)
+	{
+		size_t		len = strlen(list.elements[i]);
+
+		memcpy(ret + length, list.elements[i], len);
+		length += len;
+	}
+	ret[length] = '\0';
+
+	/* cstring_to_text() */
+	text = xalloc(length + VARHDRSZ);
+	memcpy(text + VARHDRSZ, ret, length);
+
+	for (i = 0; i < list.length; i++)
+		xfree(list.elements[i]);
+	if (list.elements)
+		xfree(list.elements);
+	xfree(ret);
+	xfree(text);
+
+	return length;
+}
+
+static size_t
+read_strinfo(const char *path)
+{
+	int			fd = open_file(path);
+	size_t		maxlen = 1024;	/* initStringInfo() */
+	size_t		len = VARHDRSZ;
+	char	   *data = xalloc(maxlen);
+
+	for (;;)
+	{
+		ssize_t		n;
+
+		/* enlargeStringInfo() doubles */
+		if (maxlen - len - 1 < BLCKSZ)
+		{
+			while (maxlen - len - 1 < BLCKSZ)
+				maxlen *= 2;
+			data = xrealloc(data, maxlen);
+		}
+
+		n = read(fd, data + len, maxlen - len - 1);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			perror(path);
+			exit(1);
+		}
+		if (n == 0)
+			break;
+		len += n;
+	}
+	close(fd);
+
+	xfree(data);
+
+	return len - VARHDRSZ;
+}
+
+static size_t
+read_lines(const char *path)
+{
+	int			fd = open_file(path);
+	size_t		bufsize = LINES_BUFSIZE;
+	char	   *buf = xalloc(bufsize);
+	size_t		start = 0;
+	size_t		end = 0;
+	size_t		total = 0;
+	int			eof = 0;
+
+	for (;;)
+	{
+		char	   *line = buf + start;
+		size_t		avail = end - start;
+		char	   *nl = memchr(line, '\n', avail);
+		size_t		len;
+		char	   *text;
+		ssize_t		n;
+
+		if (nl != NULL || (eof && avail > 0))
+		{
+			len = nl ? (size_t) (nl - line) : avail;
+			start += nl ? len + 1 : len;
+
+			/* cstring_to_text_with_len(); freed by the per-tuple reset */
+			text = xalloc(len + VARHDRSZ);
+			memcpy(text + VARHDRSZ, line, len);
+			xfree(text);
+
+			total += len + 1;
+			continue;
+		}
+		if (eof)
+			break;
+
+		if (start > 0)
+		{
+			memmove(buf, line, avail);
+			start = 0;
+			end = avail;
+		}
+		if (end == bufsize)
+			buf = xrealloc(buf, bufsize *= 2);
+
+		n = read(fd, buf + end, bufsize - end);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			perror(path);
+			exit(1);
+		}
+		if (n == 0)
+			eof = 1;
+		end += n;
+	}
+	close(fd);
+
+	xfree(buf);
+
+	return total;
+}
+
+int
+main(int argc, char **argv)
+{
+	int			iterations = (argc > 1) ? atoi(argv[1]) : 100;
+	const char *path = (argc > 2) ? argv[2] : "/proc/self/smaps";
+	struct
+	{
+		const char *name;
+		size_t		(*fn) (const char *path);
+	}			cases[] = {
+		{"list", read_list},
+		{"strinfo", read_strinfo},
+		{"lines", read_lines},
+	};
+	size_t		c;
+
+	printf("%s, %d iterations\n", path, iterations);
+	printf("%-10s %12s %12s %12s\n", "strategy", "file bytes", "peak bytes", "us per call");
+
+	for (c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+	{
+		size_t		bytes = 0;
+		double		start;
+		int			i;
+
+		peak_bytes = 0;
+		start = now_ns();
+		for (i = 0; i < iterations; i++)
+			bytes = cases[c].fn(path);
+
+		printf("%-10s %12zu %12zu %12.1f\n", cases[c].name, bytes, peak_bytes,
+			   (now_ns() - start) / iterations / 1000);
+	}
+
+	return 0;
+}
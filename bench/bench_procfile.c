@@ -0,0 +1,156 @@
+/*-------------------------------------------------------------------------
+ *
+ * bench_procfile.c
+ *		Microbenchmark of the ways to re-read a /proc file
+ *
+ * This compares the per-call cost of the access patterns used by
+ * pg_linux_proc over the files read by the collectors:
+ *
+ *	fopen	fopen() + fgets() per line + fclose(), the former collectors
+ *	open	open() + read() + close()
+ *	pread	pread() from offset zero on a descriptor kept open (procfile.c)
+ *
+ * Only the access is measured; the parsing is the same in all cases.
+ *
+ * Usage: bench_procfile [iterations]
+ *
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char *files[] = {
+	"/proc/loadavg",
+	"/proc/meminfo",
+	"/proc/stat",
+	"/proc/diskstats",
+	"/proc/sys/kernel/osrelease",
+};
+
+static char buf[1024 * 1024];
+
+/*
+ * Read in chunks of the initial buffer size of procfile.c.  Note that the
+ * kernel allocates a buffer of the requested size for sysctl files, so a
+ * huge read size makes them slow.
+ */
+#define CHUNK	4096
+
+static double
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static size_t
+read_fopen(const char *path)
+{
+	FILE	   *fp;
+	char		line[256];
+	size_t		total = 0;
+
+	if ((fp = fopen(path, "r")) == NULL)
+	{
+		perror(path);
+		exit(1);
+	}
+	while (fgets(line, sizeof(line), fp) != NULL)
+		total += strlen(line);
+	fclose(fp);
+
+	return total;
+}
+
+static size_t
+read_open(const char *path)
+{
+	int			fd;
+	ssize_t		nbytes;
+	size_t		total = 0;
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+	{
+		perror(path);
+		exit(1);
+	}
+	while ((nbytes = read(fd, buf + total, CHUNK)) > 0 &&
+		   total + nbytes + CHUNK <= sizeof(buf))
+		total += nbytes;
+	close(fd);
+
+	return total;
+}
+
+static size_t
+read_pread(int fd)
+{
+	ssize_t		nbytes;
+	size_t		total = 0;
+
+	while ((nbytes = pread(fd, buf + total, CHUNK, total)) > 0 &&
+		   total + nbytes + CHUNK <= sizeof(buf))
+		total += nbytes;
+
+	return total;
+}
+
+int
+main(int argc, char **argv)
+{
+	long		iterations = (argc > 1) ? atol(argv[1]) : 10000;
+	size_t		i;
+
+	printf("ns per call, %ld iterations\n", iterations);
+	printf("%-28s %10s %10s %10s\n", "file", "fopen", "open", "pread");
+
+	for (i = 0; i < sizeof(files) / sizeof(files[0]); i++)
+	{
+		const char *path = files[i];
+		double		start;
+		double		t_fopen,
+					t_open,
+					t_pread;
+		volatile size_t sink = 0;
+		long		n;
+		int			fd;
+
+		if (access(path, R_OK) != 0)
+			continue;
+
+		start = now_ns();
+		for (n = 0; n < iterations; n++)
+			sink += read_fopen(path);
+		t_fopen = (now_ns() - start) / iterations;
+
+		start = now_ns();
+		for (n = 0; n < iterations; n++)
+			sink += read_open(path);
+		t_open = (now_ns() - start) / iterations;
+
+		if ((fd = open(path, O_RDONLY)) < 0)
+		{
+			perror(path);
+			exit(1);
+		}
+		start = now_ns();
+		for (n = 0; n < iterations; n++)
+			sink += read_pread(fd);
+		t_pread = (now_ns() - start) / iterations;
+		close(fd);
+
+		printf("%-28s %10.0f %10.0f %10.0f\n", path, t_fopen, t_open, t_pread);
+		(void) sink;
+	}
+
+	return 0;
+}
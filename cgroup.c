@@ -0,0 +1,586 @@
+/*-------------------------------------------------------------------------
+ *
+ * cgroup.c
+ *		Show cgroup v2 resource statistics of the server on Linux
+ *
+ * In a container, /proc/meminfo and /proc/stat describe the host, not the
+ * memory and cpu limits the server actually runs under.  This module reads
+ * the interface files of the cgroup the backend belongs to, which is the
+ * cgroup of the postmaster unless someone moved the process.
+ *
+ * The cgroup directory is resolved once per backend from /proc/self/cgroup
+ * and the cgroup2 mount point in /proc/self/mountinfo.  Each interface file
+ * is then read through a cached descriptor like the /proc files (see
+ * procfile.h).  A file of a controller that is not enabled for the cgroup
+ * does not exist; it is reported as missing rather than as an error.
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "storage/fd.h"
+#include "utils/memutils.h"
+
+#include "cgroup.h"
+#include "parse.h"
+#include "pg_linux_proc.h"
+#include "pressure.h"
+#include "procfile.h"
+
+typedef enum CgroupFile
+{
+	CG_CPU_STAT,
+	CG_CPU_MAX,
+	CG_MEMORY_CURRENT,
+	CG_MEMORY_MAX,
+	CG_MEMORY_STAT,
+	CG_MEMORY_EVENTS,
+	CG_IO_STAT,
+	CG_CPU_PRESSURE,
+	CG_MEMORY_PRESSURE,
+	CG_IO_PRESSURE
+}			CgroupFile;
+
+#define NUM_CGROUP_FILES	(CG_IO_PRESSURE + 1)
+
+static const char *cgroup_file_names[NUM_CGROUP_FILES] = {
+	"cpu.stat",
+	"cpu.max",
+	"memory.current",
+	"memory.max",
+	"memory.stat",
+	"memory.events",
+	"io.stat",
+	"cpu.pressure",
+	"memory.pressure",
+	"io.pressure",
+};
+
+/* Resolved on first use; allocated in TopMemoryContext */
+static char *cgroup_dir = NULL;
+static ProcFile cgroup_files[NUM_CGROUP_FILES];
+
+/*
+ * Return the cgroup v2 path of this process from /proc/self/cgroup, e.g.
+ * "/system.slice/postgresql.service" from "0::/system.slice/...".
+ */
+static char *
+read_self_cgroup(void)
+{
+	FILE	   *fp;
+	char		line[MAXPGPATH];
+	char	   *result = NULL;
+
+	if ((fp = AllocateFile(FILE_SELF_CGROUP, "r")) == NULL)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m", FILE_SELF_CGROUP)));
+
+	while (fgets(line, sizeof(line), fp) != NULL)
+	{
+		if (strncmp(line, "0::", 3) == 0)
+		{
+			line[strcspn(line, "\n")] = '\0';
+			result = pstrdup(line + 3);
+			break;
+		}
+	}
+
+	FreeFile(fp);
+
+	if (result == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("cgroup v2 is not available"),
+				 errdetail("\"%s\" has no entry of the unified hierarchy.",
+						   FILE_SELF_CGROUP)));
+
+	return result;
+}
+
+/*
+ * Find the cgroup2 mount point in /proc/self/mountinfo, and set *root to
+ * the cgroup mounted there ("/" unless only a subtree is mounted).
+ *
+ * "36 25 0:30 / /sys/fs/cgroup rw,nosuid shared:9 - cgroup2 cgroup2 rw"
+ */
+static char *
+find_cgroup2_mount(char **root)
+{
+	FILE	   *fp;
+	char		line[MAXPGPATH * 2];
+	char	   *result = NULL;
+
+	if ((fp = AllocateFile(FILE_SELF_MOUNTINFO, "r")) == NULL)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m", FILE_SELF_MOUNTINFO)));
+
+	while (fgets(line, sizeof(line), fp) != NULL)
+	{
+		char	   *p = line;
+		char	   *mroot = NULL;
+		char	   *mpoint = NULL;
+		char	   *tok;
+		int			field;
+
+		for (field = 0; (tok = pl_next_token(&p)) != NULL; field++)
+		{
+			if (field == 3)
+				mroot = tok;
+			else if (field == 4)
+				mpoint = tok;
+			else if (strcmp(tok, "-") == 0)
+				break;
+		}
+
+		if (tok == NULL || mpoint == NULL)
+			continue;
+
+		tok = pl_next_token(&p);
+		if (tok != NULL && strcmp(tok, "cgroup2") == 0)
+		{
+			result = pstrdup(mpoint);
+			*root = pstrdup(mroot);
+			break;
+		}
+	}
+
+	FreeFile(fp);
+
+	if (result == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("cgroup v2 is not available"),
+				 errdetail("No cgroup2 file system is mounted.")));
+
+	return result;
+}
+
+static void
+cgroup_resolve(void)
+{
+	char	   *path;
+	char	   *mount;
+	char	   *root;
+	size_t		rootlen;
+	MemoryContext oldcontext;
+	int			i;
+
+	if (cgroup_dir != NULL)
+		return;
+
+	path = read_self_cgroup();
+	mount = find_cgroup2_mount(&root);
+
+	/* Inside a bind-mounted subtree, the path is relative to its root. */
+	rootlen = strlen(root);
+	if (strcmp(root, "/") != 0 && strncmp(path, root, rootlen) == 0)
+		path += rootlen;
+
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+
+	for (i = 0; i < NUM_CGROUP_FILES; i++)
+	{
+		cgroup_files[i].path = psprintf("%s%s/%s", mount,
+										strcmp(path, "/") == 0 ? "" : path,
+										cgroup_file_names[i]);
+		cgroup_files[i].fd = -1;
+		cgroup_files[i].buf = NULL;
+		cgroup_files[i].bufsize = 0;
+	}
+	cgroup_dir = psprintf("%s%s", mount, strcmp(path, "/") == 0 ? "" : path);
+
+	MemoryContextSwitchTo(oldcontext);
+}
+
+/*
+ * Return the directory of the cgroup of this process.
+ */
+const char *
+get_cgroup_path(void)
+{
+	cgroup_resolve();
+	return cgroup_dir;
+}
+
+/*
+ * Read the interface file f, or return NULL if it does not exist.
+ */
+static char *
+cgroup_read(CgroupFile f)
+{
+	size_t		len;
+
+	cgroup_resolve();
+	return procfile_read_extended(&cgroup_files[f], &len, true);
+}
+
+static void
+cgroup_format_error(CgroupFile f)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_DATA_EXCEPTION),
+			 errmsg("unexpected file format: \"%s\"", cgroup_files[f].path),
+			 errdetail("number of fields is not corresponding")));
+}
+
+/*
+ * Parse a single value, or "max" as -1.
+ */
+static int64
+parse_max_value(char **pp, CgroupFile f)
+{
+	char	   *p = pl_skip_blanks(*pp);
+	int64		value;
+
+	if (strncmp(p, "max", 3) == 0)
+	{
+		*pp = p + 3;
+		return -1;
+	}
+	if (!pl_parse_int64(&p, &value))
+		cgroup_format_error(f);
+	*pp = p;
+	return value;
+}
+
+/*
+ * Fields of a flat keyed file ("key value" per line) stored into a struct.
+ */
+typedef struct CgroupKey
+{
+	const char *key;
+	size_t		offset;
+}			CgroupKey;
+
+static void
+parse_flat_keyed(char *buf, const CgroupKey * keys, int nkeys, void *dst,
+				 CgroupFile f)
+{
+	char	   *line;
+
+	while ((line = pl_next_line(&buf)) != NULL)
+	{
+		char	   *key = pl_next_token(&line);
+		int			i;
+
+		if (key == NULL)
+			continue;
+
+		for (i = 0; i < nkeys; i++)
+		{
+			if (strcmp(keys[i].key, key) == 0)
+			{
+				if (!pl_parse_int64(&line, (int64 *) ((char *) dst + keys[i].offset)))
+					cgroup_format_error(f);
+				break;
+			}
+		}
+	}
+}
+
+static const CgroupKey cpu_stat_keys[] = {
+	{"usage_usec", offsetof(CgroupCpu, usage_usec)},
+	{"user_usec", offsetof(CgroupCpu, user_usec)},
+	{"system_usec", offsetof(CgroupCpu, system_usec)},
+	{"nr_periods", offsetof(CgroupCpu, nr_periods)},
+	{"nr_throttled", offsetof(CgroupCpu, nr_throttled)},
+	{"throttled_usec", offsetof(CgroupCpu, throttled_usec)},
+};
+
+/*
+ * Read cpu.stat and cpu.max.  Without the cpu controller, only the usage
+ * is reported and the quota and period are -1.
+ */
+void
+get_cgroup_cpu(CgroupCpu * cpu)
+{
+	char	   *buf;
+
+	memset(cpu, 0, sizeof(CgroupCpu));
+	cpu->quota_usec = -1;
+	cpu->period_usec = -1;
+
+	if ((buf = cgroup_read(CG_CPU_STAT)) != NULL)
+		parse_flat_keyed(buf, cpu_stat_keys, lengthof(cpu_stat_keys), cpu,
+						 CG_CPU_STAT);
+
+	/* "max 100000" or "200000 100000" */
+	if ((buf = cgroup_read(CG_CPU_MAX)) != NULL)
+	{
+		cpu->quota_usec = parse_max_value(&buf, CG_CPU_MAX);
+		if (!pl_parse_int64(&buf, &cpu->period_usec))
+			cgroup_format_error(CG_CPU_MAX);
+	}
+}
+
+/*
+ * Compute the cpu usage between two results of get_cgroup_cpu() taken
+ * elapsed seconds apart.
+ */
+void
+get_cgroup_cpu_usage(CgroupCpu * prev, CgroupCpu * cur, double elapsed,
+					 CgroupCpuUsage * usage)
+{
+	double		elapsed_us = elapsed * 1000000.0;
+	int64		periods;
+
+	memset(usage, 0, sizeof(CgroupCpuUsage));
+	usage->limit_cpus = -1;
+	usage->limit_pct = -1;
+	usage->throttled_pct = -1;
+
+	if (elapsed <= 0)
+		return;
+
+	usage->cpus = counter_delta(prev->usage_usec, cur->usage_usec) / elapsed_us;
+	usage->user_cpus = counter_delta(prev->user_usec, cur->user_usec) / elapsed_us;
+	usage->system_cpus = counter_delta(prev->system_usec, cur->system_usec) / elapsed_us;
+	usage->throttled_ms_s =
+		counter_delta(prev->throttled_usec, cur->throttled_usec) / 1000.0 / elapsed;
+
+	if (cur->quota_usec > 0 && cur->period_usec > 0)
+	{
+		usage->limit_cpus = (double) cur->quota_usec / cur->period_usec;
+		usage->limit_pct = usage->cpus / usage->limit_cpus * 100.0;
+	}
+
+	periods = counter_delta(prev->nr_periods, cur->nr_periods);
+	if (periods > 0)
+		usage->throttled_pct =
+			counter_delta(prev->nr_throttled, cur->nr_throttled) * 100.0 / periods;
+}
+
+static const CgroupKey memory_stat_keys[] = {
+	{"anon", offsetof(CgroupMemory, anon)},
+	{"file", offsetof(CgroupMemory, file)},
+	{"inactive_file", offsetof(CgroupMemory, inactive_file)},
+};
+
+static const CgroupKey memory_events_keys[] = {
+	{"low", offsetof(CgroupMemory, events_low)},
+	{"high", offsetof(CgroupMemory, events_high)},
+	{"max", offsetof(CgroupMemory, events_max)},
+	{"oom", offsetof(CgroupMemory, events_oom)},
+	{"oom_kill", offsetof(CgroupMemory, events_oom_kill)},
+};
+
+/*
+ * Read memory.current, memory.max, memory.stat and memory.events.
+ * Return false if the memory controller is not enabled for the cgroup.
+ *
+ * available is what the cgroup can still use before reclaim has nothing
+ * cheap left: the headroom under memory.max plus the inactive page cache.
+ */
+bool
+get_cgroup_memory(CgroupMemory * mem)
+{
+	char	   *buf;
+
+	memset(mem, 0, sizeof(CgroupMemory));
+
+	if ((buf = cgroup_read(CG_MEMORY_CURRENT)) == NULL)
+		return false;
+	if (!pl_parse_int64(&buf, &mem->current))
+		cgroup_format_error(CG_MEMORY_CURRENT);
+
+	mem->max = -1;
+	if ((buf = cgroup_read(CG_MEMORY_MAX)) != NULL)
+		mem->max = parse_max_value(&buf, CG_MEMORY_MAX);
+
+	if ((buf = cgroup_read(CG_MEMORY_STAT)) != NULL)
+		parse_flat_keyed(buf, memory_stat_keys, lengthof(memory_stat_keys),
+						 mem, CG_MEMORY_STAT);
+
+	if ((buf = cgroup_read(CG_MEMORY_EVENTS)) != NULL)
+		parse_flat_keyed(buf, memory_events_keys, lengthof(memory_events_keys),
+						 mem, CG_MEMORY_EVENTS);
+
+	if (mem->max >= 0)
+		mem->available = Max(mem->max - mem->current, 0) + mem->inactive_file;
+	else
+		mem->available = -1;
+
+	return true;
+}
+
+/*
+ * Append a CgroupStatItem per line of memory.stat.  Return NIL if the
+ * memory controller is not enabled.
+ */
+List *
+get_cgroup_memory_stat(List *stat)
+{
+	char	   *buf;
+	char	   *line;
+
+	if ((buf = cgroup_read(CG_MEMORY_STAT)) == NULL)
+		return stat;
+
+	while ((line = pl_next_line(&buf)) != NULL)
+	{
+		char	   *key = pl_next_token(&line);
+		CgroupStatItem *item;
+
+		if (key == NULL)
+			continue;
+
+		item = (CgroupStatItem *) palloc(sizeof(CgroupStatItem));
+		item->key = pstrdup(key);
+		if (!pl_parse_int64(&line, &item->value))
+			cgroup_format_error(CG_MEMORY_STAT);
+		stat = lappend(stat, item);
+	}
+
+	return stat;
+}
+
+static const CgroupKey io_stat_keys[] = {
+	{"rbytes", offsetof(CgroupIoStat, rbytes)},
+	{"wbytes", offsetof(CgroupIoStat, wbytes)},
+	{"rios", offsetof(CgroupIoStat, rios)},
+	{"wios", offsetof(CgroupIoStat, wios)},
+	{"dbytes", offsetof(CgroupIoStat, dbytes)},
+	{"dios", offsetof(CgroupIoStat, dios)},
+};
+
+/*
+ * Append a CgroupIoStat per device of io.stat.
+ *
+ * "8:0 rbytes=1459200 wbytes=314773504 rios=192 wios=353 dbytes=0 dios=0"
+ */
+List *
+get_cgroup_io_stat(List *iostat)
+{
+	char	   *buf;
+	char	   *line;
+
+	if ((buf = cgroup_read(CG_IO_STAT)) == NULL)
+		return iostat;
+
+	while ((line = pl_next_line(&buf)) != NULL)
+	{
+		CgroupIoStat *io = (CgroupIoStat *) palloc0(sizeof(CgroupIoStat));
+		int32		major,
+					minor;
+		char	   *tok;
+
+		if (!pl_parse_int32(&line, &major) ||
+			!pl_expect_char(&line, ':') ||
+			!pl_parse_int32(&line, &minor))
+			cgroup_format_error(CG_IO_STAT);
+		io->major = major;
+		io->minor = minor;
+
+		while ((tok = pl_next_token(&line)) != NULL)
+		{
+			char	   *eq = strchr(tok, '=');
+			int			i;
+
+			if (eq == NULL)
+				continue;
+			*eq++ = '\0';
+
+			for (i = 0; i < lengthof(io_stat_keys); i++)
+			{
+				if (strcmp(io_stat_keys[i].key, tok) == 0)
+				{
+					if (!pl_parse_int64(&eq,
+										(int64 *) ((char *) io + io_stat_keys[i].offset)))
+						cgroup_format_error(CG_IO_STAT);
+					break;
+				}
+			}
+		}
+
+		iostat = lappend(iostat, io);
+	}
+
+	return iostat;
+}
+
+static bool
+match_io_device(const void *a, const void *b)
+{
+	const CgroupIoStat *da = (const CgroupIoStat *) a;
+	const CgroupIoStat *db = (const CgroupIoStat *) b;
+
+	return da->major == db->major && da->minor == db->minor;
+}
+
+/*
+ * Compute per-device rates between two results of get_cgroup_io_stat()
+ * taken elapsed seconds apart.  Devices are matched by major:minor, and
+ * a device missing from prev is skipped.
+ */
+List *
+get_cgroup_io_rate(List *prev, List *cur, double elapsed)
+{
+	List	   *rates = NIL;
+	ListCell   *lc;
+
+	if (elapsed <= 0)
+		return NIL;
+
+	foreach(lc, cur)
+	{
+		CgroupIoStat *c = (CgroupIoStat *) lfirst(lc);
+		CgroupIoStat *p;
+		CgroupIoRate *r;
+
+		p = (CgroupIoStat *) find_prev_entry(prev, foreach_current_index(lc), c,
+											 match_io_device);
+		if (p == NULL)
+			continue;
+
+		r = (CgroupIoRate *) palloc0(sizeof(CgroupIoRate));
+		r->major = c->major;
+		r->minor = c->minor;
+		r->r_s = counter_delta(p->rios, c->rios) / elapsed;
+		r->w_s = counter_delta(p->wios, c->wios) / elapsed;
+		r->rkb_s = counter_delta(p->rbytes, c->rbytes) / 1024.0 / elapsed;
+		r->wkb_s = counter_delta(p->wbytes, c->wbytes) / 1024.0 / elapsed;
+		r->d_s = counter_delta(p->dios, c->dios) / elapsed;
+		r->dkb_s = counter_delta(p->dbytes, c->dbytes) / 1024.0 / elapsed;
+
+		rates = lappend(rates, r);
+	}
+
+	return rates;
+}
+
+/*
+ * Append a PressureStat per line of {cpu,memory,io}.pressure of the
+ * cgroup.  The files are missing if PSI is disabled.
+ */
+List *
+get_cgroup_pressure(List *pressure)
+{
+	static const struct
+	{
+		CgroupFile	file;
+		const char *resource;
+	}			files[] = {
+		{CG_CPU_PRESSURE, "cpu"},
+		{CG_MEMORY_PRESSURE, "memory"},
+		{CG_IO_PRESSURE, "io"},
+	};
+	int			i;
+
+	for (i = 0; i < lengthof(files); i++)
+	{
+		char	   *buf;
+
+		if ((buf = cgroup_read(files[i].file)) == NULL)
+			continue;
+		pressure = parse_pressure(buf, files[i].resource,
+								  cgroup_files[files[i].file].path, pressure);
+	}
+
+	return pressure;
+}
@@ -0,0 +1,106 @@
+/*-------------------------------------------------------------------------
+ *
+ * cgroup.h
+ *		Show cgroup v2 resource statistics of the server on Linux
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#ifndef __CGROUP_H__
+#define __CGROUP_H__
+
+#include "nodes/pg_list.h"
+
+#define FILE_SELF_CGROUP		"/proc/self/cgroup"
+#define FILE_SELF_MOUNTINFO		"/proc/self/mountinfo"
+
+/* cpu.stat and cpu.max */
+typedef struct CgroupCpu
+{
+	int64		usage_usec;
+	int64		user_usec;
+	int64		system_usec;
+	int64		nr_periods;
+	int64		nr_throttled;
+	int64		throttled_usec;
+	int64		quota_usec;		/* -1 if "max" or no cpu controller */
+	int64		period_usec;	/* -1 if no cpu controller */
+}			CgroupCpu;
+
+/* Rates between two CgroupCpu; -1 means not applicable */
+typedef struct CgroupCpuUsage
+{
+	double		cpus;			/* cpus used on average */
+	double		user_cpus;
+	double		system_cpus;
+	double		limit_cpus;		/* quota / period, or -1 */
+	double		limit_pct;		/* cpus / limit_cpus in percent, or -1 */
+	double		throttled_pct;	/* throttled periods in percent, or -1 */
+	double		throttled_ms_s; /* throttled time per second in ms */
+}			CgroupCpuUsage;
+
+/* memory.current, memory.max, memory.stat and memory.events, in bytes */
+typedef struct CgroupMemory
+{
+	int64		current;
+	int64		max;			/* -1 if "max" */
+	int64		available;		/* max - current + inactive_file, or -1 */
+	int64		anon;
+	int64		file;
+	int64		inactive_file;
+	int64		events_low;
+	int64		events_high;
+	int64		events_max;
+	int64		events_oom;
+	int64		events_oom_kill;
+}			CgroupMemory;
+
+/* One line of a flat keyed file such as memory.stat */
+typedef struct CgroupStatItem
+{
+	char	   *key;
+	int64		value;
+}			CgroupStatItem;
+
+/* One line of io.stat */
+typedef struct CgroupIoStat
+{
+	int			major;
+	int			minor;
+	int64		rbytes;
+	int64		wbytes;
+	int64		rios;
+	int64		wios;
+	int64		dbytes;
+	int64		dios;
+}			CgroupIoStat;
+
+/* Rates between two CgroupIoStat of a device */
+typedef struct CgroupIoRate
+{
+	int			major;
+	int			minor;
+	double		r_s;
+	double		w_s;
+	double		rkb_s;
+	double		wkb_s;
+	double		d_s;
+	double		dkb_s;
+}			CgroupIoRate;
+
+
+extern const char *get_cgroup_path(void);
+extern void get_cgroup_cpu(CgroupCpu * cpu);
+extern void get_cgroup_cpu_usage(CgroupCpu * prev, CgroupCpu * cur,
+								 double elapsed, CgroupCpuUsage * usage);
+extern bool get_cgroup_memory(CgroupMemory * mem);
+extern List *get_cgroup_memory_stat(List *stat);
+extern List *get_cgroup_io_stat(List *iostat);
+extern List *get_cgroup_io_rate(List *prev, List *cur, double elapsed);
+extern List *get_cgroup_pressure(List *pressure);
+
+#endif
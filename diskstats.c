@@ -13,6 +13,11 @@
 #include "nodes/pg_list.h"
 
 #include "diskstats.h"
+#include "parse.h"
+#include "pg_linux_proc.h"
+#include "procfile.h"
+
+static ProcFile diskstats_file = PROCFILE_INIT(FILE_DISKSTATS);
 
 /*
 Date:		February 2008
@@ -61,43 +66,134 @@ Description:
 List *
 get_proc_diskstats(List *diskstats)
 {
-	FILE	   *fp;
-	char		line[256];
+	char	   *buf;
+	char	   *p;
+	char	   *line;
+	size_t		len;
 
-	if ((fp = fopen(FILE_DISKSTATS, "r")) == NULL)
-		ereport(ERROR,
-				(errcode_for_file_access(),
-				 errmsg("could not open file \"%s\": ", FILE_DISKSTATS)));
+	buf = procfile_read(&diskstats_file, &len);
 
-	while (fgets(line, sizeof(line), fp) != NULL)
+	p = buf;
+	while ((line = pl_next_line(&p)) != NULL)
 	{
 		DiskStat   *ds;
+		char	   *name;
+		int64		v[NUM_DISKSTATS_FIELDS_MAX - 3];
 
-		ds = palloc0(sizeof(DiskStat));
+		ds = palloc(sizeof(DiskStat));
 
-		if (sscanf(line, "%d %d %s %ld %ld  %ld %ld %ld %ld %ld  %ld %ld %ld %ld %ld %ld %ld %ld %ld %ld",
-				   &(ds->major), &(ds->minor), ds->name, &(ds->rd), &(ds->rd_merged), &(ds->rd_sec), &(ds->rd_tm),
-				   &(ds->wr), &(ds->wr_merged), &(ds->wr_sec), &(ds->wr_tm), &(ds->io), &(ds->tm), &(ds->wtm),
-				   &(ds->dis), &(ds->dis_merged), &(ds->dis_sec), &(ds->dis_tm), &(ds->fl), &(ds->tm_fl)) < 20)
+		if (!pl_parse_int32(&line, &ds->major) ||
+			!pl_parse_int32(&line, &ds->minor) ||
+			(name = pl_next_token(&line)) == NULL)
 			ereport(ERROR,
 					(errcode(ERRCODE_DATA_EXCEPTION),
 					 errmsg("unexpected file format: \"%s\"", FILE_DISKSTATS),
 					 errdetail("number of fields is not corresponding")));
 
-		diskstats = lappend(diskstats, ds);
+		strlcpy(ds->name, name, sizeof(ds->name));
+
+		/* The discard and flush fields are missing on old kernels. */
+		memset(v, 0, sizeof(v));
+		if (pl_parse_int64_array(&line, v, lengthof(v)) < NUM_DISKSTATS_FIELDS_MIN - 3)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_EXCEPTION),
+					 errmsg("unexpected file format: \"%s\"", FILE_DISKSTATS),
+					 errdetail("number of fields is not corresponding")));
+
+		ds->rd = v[0];
+		ds->rd_merged = v[1];
+		ds->rd_sec = v[2];
+		ds->rd_tm = v[3];
+		ds->wr = v[4];
+		ds->wr_merged = v[5];
+		ds->wr_sec = v[6];
+		ds->wr_tm = v[7];
+		ds->io = v[8];
+		ds->tm = v[9];
+		ds->wtm = v[10];
+		ds->dis = v[11];
+		ds->dis_merged = v[12];
+		ds->dis_sec = v[13];
+		ds->dis_tm = v[14];
+		ds->fl = v[15];
+		ds->tm_fl = v[16];
 
+		diskstats = lappend(diskstats, ds);
 	}
 
+	return diskstats;
+}
+
+static bool
+match_device(const void *a, const void *b)
+{
+	const DiskStat *da = (const DiskStat *) a;
+	const DiskStat *db = (const DiskStat *) b;
+
+	return da->major == db->major && da->minor == db->minor;
+}
+
+/*
+ * Compute iostat-style metrics between two results of get_proc_diskstats()
+ * taken elapsed seconds apart.
+ *
+ * The devices are matched by major and minor numbers; a device that
+ * appears only in cur is skipped.  The formulas are the ones of iostat
+ * in sysstat, and a sector is 512 bytes regardless of the device.
+ */
+List *
+get_iostat(List *prev, List *cur, double elapsed)
+{
+	List	   *iostats = NIL;
+	ListCell   *lc;
+	double		elapsed_ms = elapsed * 1000.0;
 
-	if (ferror(fp) && errno != EINTR)
+	if (elapsed <= 0)
+		return NIL;
+
+	foreach(lc, cur)
 	{
-		fclose(fp);
-		ereport(ERROR,
-				(errcode_for_file_access(),
-				 errmsg("could not read file \"%s\": ", FILE_DISKSTATS)));
+		DiskStat   *c = (DiskStat *) lfirst(lc);
+		DiskStat   *p;
+		IoStat	   *io;
+		int64		rd,
+					wr,
+					dis,
+					fl;
+
+		p = (DiskStat *) find_prev_entry(prev, foreach_current_index(lc), c,
+										 match_device);
+		if (p == NULL)
+			continue;
+
+		rd = counter_delta(p->rd, c->rd);
+		wr = counter_delta(p->wr, c->wr);
+		dis = counter_delta(p->dis, c->dis);
+		fl = counter_delta(p->fl, c->fl);
+
+		io = palloc0(sizeof(IoStat));
+		io->major = c->major;
+		io->minor = c->minor;
+		strlcpy(io->name, c->name, sizeof(io->name));
+
+		io->r_s = rd / elapsed;
+		io->w_s = wr / elapsed;
+		io->rkb_s = counter_delta(p->rd_sec, c->rd_sec) / 2.0 / elapsed;
+		io->wkb_s = counter_delta(p->wr_sec, c->wr_sec) / 2.0 / elapsed;
+		io->rrqm_s = counter_delta(p->rd_merged, c->rd_merged) / elapsed;
+		io->wrqm_s = counter_delta(p->wr_merged, c->wr_merged) / elapsed;
+		io->r_await = rd > 0 ? (double) counter_delta(p->rd_tm, c->rd_tm) / rd : 0.0;
+		io->w_await = wr > 0 ? (double) counter_delta(p->wr_tm, c->wr_tm) / wr : 0.0;
+		io->aqu_sz = counter_delta(p->wtm, c->wtm) / elapsed_ms;
+		io->util = Min(100.0, counter_delta(p->tm, c->tm) * 100.0 / elapsed_ms);
+		io->d_s = dis / elapsed;
+		io->dkb_s = counter_delta(p->dis_sec, c->dis_sec) / 2.0 / elapsed;
+		io->d_await = dis > 0 ? (double) counter_delta(p->dis_tm, c->dis_tm) / dis : 0.0;
+		io->f_s = fl / elapsed;
+		io->f_await = fl > 0 ? (double) counter_delta(p->tm_fl, c->tm_fl) / fl : 0.0;
+
+		iostats = lappend(iostats, io);
 	}
 
-	fclose(fp);
-
-	return diskstats;
+	return iostats;
 }
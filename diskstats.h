@@ -16,6 +16,8 @@
 #define __DISKSTATS_H__
 
 #define FILE_DISKSTATS		"/proc/diskstats"
+#define NUM_DISKSTATS_FIELDS_MIN	14
+#define NUM_DISKSTATS_FIELDS_MAX	20
 
 typedef struct DiskStat
 {
@@ -50,6 +52,33 @@ typedef struct DiskStat
 
 }			DiskStat;
 
+/*
+ * iostat-style metrics of a device between two DiskStat samples.
+ * The rates are per second and the times are in milliseconds.
+ */
+typedef struct IoStat
+{
+	int			major;
+	int			minor;
+	char		name[32];
+	double		r_s;			/* reads per second */
+	double		w_s;			/* writes per second */
+	double		rkb_s;			/* kilobytes read per second */
+	double		wkb_s;			/* kilobytes written per second */
+	double		rrqm_s;			/* reads merged per second */
+	double		wrqm_s;			/* writes merged per second */
+	double		r_await;		/* average time per read */
+	double		w_await;		/* average time per write */
+	double		aqu_sz;			/* average queue length */
+	double		util;			/* percentage of time the device was busy */
+	double		d_s;			/* discards per second */
+	double		dkb_s;			/* kilobytes discarded per second */
+	double		d_await;		/* average time per discard */
+	double		f_s;			/* flushes per second */
+	double		f_await;		/* average time per flush */
+}			IoStat;
+
 extern List *get_proc_diskstats(List *diskstats);
+extern List *get_iostat(List *prev, List *cur, double elapsed);
 
 #endif
@@ -0,0 +1,648 @@
+/*-------------------------------------------------------------------------
+ *
+ * exporter.c
+ *		OpenMetrics endpoint of pg_linux_proc
+ *
+ * When pg_linux_proc.exporter_address is set, a background worker listens
+ * on it, a loopback address or a UNIX socket, and answers "GET /metrics"
+ * with /proc/loadavg, meminfo, stat and diskstats in the OpenMetrics text
+ * format, named as in pg_proc_history().  A scrape reads the files
+ * through the same collectors as the SQL functions and renders the parsed
+ * structs into a buffer reused across scrapes, so it costs no backend, no
+ * connection slot and no query.
+ *
+ * The worker serves one scrape at a time, and gives up on a client that
+ * has not sent its request and read the response EXPORTER_TIMEOUT_MS after
+ * it was accepted, so a stuck client delays the others by that much at
+ * most.
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "common/shortest_dec.h"
+#include "lib/stringinfo.h"
+#include "libpq/libpq.h"
+#include "miscadmin.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/interrupt.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "tcop/tcopprot.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+
+#include "diskstats.h"
+#include "exporter.h"
+#include "loadavg.h"
+#include "meminfo.h"
+#include "stat.h"
+#include "store.h"
+
+#define EXPORTER_TIMEOUT_MS		1000
+#define EXPORTER_ACCEPT_RETRY_MS	1000
+#define EXPORTER_REQUEST_LEN	4096
+#define EXPORTER_CONTENT_TYPE	"application/openmetrics-text; version=1.0.0; charset=utf-8"
+
+#define SECTOR_SIZE				512
+
+/* GUC variables */
+char	   *exporter_address = NULL;
+
+static pgsocket exporter_sock = PGINVALID_SOCKET;
+static char exporter_sock_path[MAXPGPATH];
+
+/* The response body, reused across scrapes */
+static StringInfoData exporter_buf;
+
+static bool check_exporter_address(char **newval, void **extra, GucSource source);
+static void exporter_close(int code, Datum arg);
+
+void
+exporter_define_gucs(void)
+{
+	DefineCustomStringVariable("pg_linux_proc.exporter_address",
+							   "Sets the address of the OpenMetrics endpoint.",
+							   "A loopback address and port such as \"127.0.0.1:9187\" or \"[::1]:9187\", "
+							   "or the absolute path of a UNIX socket.  Empty disables the endpoint.",
+							   &exporter_address,
+							   "",
+							   PGC_POSTMASTER,
+							   0,
+							   check_exporter_address,
+							   NULL,
+							   NULL);
+}
+
+void
+exporter_register_worker(void)
+{
+	BackgroundWorker worker;
+
+	if (exporter_address == NULL || exporter_address[0] == '\0')
+		return;
+
+	memset(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	worker.bgw_start_time = BgWorkerStart_PostmasterStart;
+	worker.bgw_restart_time = 10;
+	sprintf(worker.bgw_library_name, "pg_linux_proc");
+	sprintf(worker.bgw_function_name, "pg_linux_proc_exporter_main");
+	snprintf(worker.bgw_name, BGW_MAXLEN, "pg_linux_proc exporter");
+	snprintf(worker.bgw_type, BGW_MAXLEN, "pg_linux_proc exporter");
+	worker.bgw_main_arg = (Datum) 0;
+	worker.bgw_notify_pid = 0;
+
+	RegisterBackgroundWorker(&worker);
+}
+
+/*
+ * Rendering
+ *
+ * The metrics are those of pg_proc_history(), from the same table: a
+ * metric of a source is the family pg_linux_proc_<source>_<metric>, and
+ * the item, a cpu or a device, is its label "item".  The values are in the
+ * units of node_exporter, so the family of a time or a size ends with
+ * _seconds or _bytes.
+ */
+
+static const char *
+unit_suffix(StoreUnit unit)
+{
+	switch (unit)
+	{
+		case STORE_UNIT_TICKS:
+		case STORE_UNIT_MS:
+			return "_seconds";
+		case STORE_UNIT_KB:
+		case STORE_UNIT_SECTORS:
+			return "_bytes";
+		case STORE_UNIT_NONE:
+			break;
+	}
+	return "";
+}
+
+static void
+append_value(StringInfo buf, const char *record, const StoreMetric * metric)
+{
+	double		value = store_metric_value(record, metric);
+	char		num[DOUBLE_SHORTEST_DECIMAL_LEN];
+
+	switch (metric->unit)
+	{
+		case STORE_UNIT_TICKS:
+			value /= sysconf(_SC_CLK_TCK);
+			break;
+		case STORE_UNIT_MS:
+			value /= 1000;
+			break;
+		case STORE_UNIT_KB:
+			appendStringInfo(buf, INT64_FORMAT, (int64) value * 1024);
+			return;
+		case STORE_UNIT_SECTORS:
+			appendStringInfo(buf, INT64_FORMAT, (int64) value * SECTOR_SIZE);
+			return;
+		case STORE_UNIT_NONE:
+			if (metric->type != STORE_FLOAT4)
+			{
+				appendStringInfo(buf, INT64_FORMAT, (int64) value);
+				return;
+			}
+			break;
+	}
+
+	double_to_shortest_decimal_buf(value, num);
+	appendStringInfoString(buf, num);
+}
+
+/*
+ * Append the families of the metrics of a source.  records are the nitems
+ * structs of the source, named by items, or a single one if items is NULL.
+ */
+static void
+render_source(StringInfo buf, StoreSource source, const char **records,
+			  const char **items, int nitems)
+{
+	const StoreSourceDef *def = &store_sources[source];
+	char		family[NAMEDATALEN];
+	int			m;
+	int			i;
+
+	for (m = 0; m < def->nmetrics; m++)
+	{
+		const StoreMetric *metric = &def->metrics[m];
+
+		snprintf(family, sizeof(family), "%s_%s%s",
+				 def->name, metric->name, unit_suffix(metric->unit));
+		appendStringInfo(buf, "# TYPE pg_linux_proc_%s %s\n# HELP pg_linux_proc_%s %s\n",
+						 family, metric->counter ? "counter" : "gauge",
+						 family, metric->help);
+
+		for (i = 0; i < nitems; i++)
+		{
+			appendStringInfo(buf, "pg_linux_proc_%s%s", family,
+							 metric->counter ? "_total" : "");
+			if (items)
+				appendStringInfo(buf, "{item=\"%s\"}", items[i]);
+			appendStringInfoChar(buf, ' ');
+			append_value(buf, records[i], metric);
+			appendStringInfoChar(buf, '\n');
+		}
+	}
+}
+
+static void
+exporter_render(StringInfo buf)
+{
+	LoadAvg		loadavg;
+	MemInfo		meminfo;
+	List	   *stats;
+	List	   *disks;
+	const char **records;
+	const char **items;
+	const char *record;
+	ListCell   *lc;
+	int			n;
+
+	get_proc_loadavg(&loadavg);
+	get_proc_meminfo(&meminfo, NULL);
+	stats = get_proc_stat(NIL);
+	disks = get_proc_diskstats(NIL);
+
+	resetStringInfo(buf);
+
+	record = (const char *) &loadavg;
+	render_source(buf, STORE_LOADAVG, &record, NULL, 1);
+
+	record = (const char *) &meminfo;
+	render_source(buf, STORE_MEMINFO, &record, NULL, 1);
+
+	records = palloc(sizeof(char *) * Max(list_length(stats), 1));
+	items = palloc(sizeof(char *) * Max(list_length(stats), 1));
+	n = 0;
+	foreach(lc, stats)
+	{
+		ProcStat   *st = (ProcStat *) lfirst(lc);
+
+		items[n] = st->cpu;
+		records[n++] = (const char *) st;
+	}
+	render_source(buf, STORE_STAT, records, items, n);
+
+	records = palloc(sizeof(char *) * Max(list_length(disks), 1));
+	items = palloc(sizeof(char *) * Max(list_length(disks), 1));
+	n = 0;
+	foreach(lc, disks)
+	{
+		DiskStat   *ds = (DiskStat *) lfirst(lc);
+
+		items[n] = ds->name;
+		records[n++] = (const char *) ds;
+	}
+	render_source(buf, STORE_DISKSTATS, records, items, n);
+
+	appendStringInfoString(buf, "# EOF\n");
+}
+
+/*
+ * Serving
+ */
+
+/*
+ * Parse an exporter address into addr.  A TCP address must be a loopback
+ * one: the endpoint has no authentication.  Return NULL, or why the
+ * address is invalid.
+ */
+static char *
+parse_address(const char *address, struct sockaddr_storage *addr,
+			  socklen_t *addrlen)
+{
+	memset(addr, 0, sizeof(*addr));
+
+	if (address[0] == '/')
+	{
+		struct sockaddr_un *un = (struct sockaddr_un *) addr;
+
+		if (strlen(address) >= sizeof(un->sun_path))
+			return psprintf("UNIX socket path \"%s\" is too long (maximum %d bytes).",
+							address, (int) sizeof(un->sun_path) - 1);
+
+		un->sun_family = AF_UNIX;
+		strlcpy(un->sun_path, address, sizeof(un->sun_path));
+		*addrlen = sizeof(struct sockaddr_un);
+	}
+	else
+	{
+		char	   *host = pstrdup(address);
+		char	   *port = strrchr(host, ':');
+		struct addrinfo hints;
+		struct addrinfo *res;
+		bool		loopback;
+		int			rc;
+
+		if (port == NULL)
+			return pstrdup("The address must be \"host:port\" or the absolute path of a UNIX socket.");
+		*port++ = '\0';
+		if (host[0] == '[' && host[strlen(host) - 1] == ']')
+		{
+			host[strlen(host) - 1] = '\0';
+			host++;
+		}
+
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_flags = AI_NUMERICSERV;
+		if ((rc = getaddrinfo(host, port, &hints, &res)) != 0)
+			return psprintf("Could not resolve \"%s\": %s.", address, gai_strerror(rc));
+
+		memcpy(addr, res->ai_addr, res->ai_addrlen);
+		*addrlen = res->ai_addrlen;
+		freeaddrinfo(res);
+
+		if (addr->ss_family == AF_INET)
+			loopback = (ntohl(((struct sockaddr_in *) addr)->sin_addr.s_addr) >> 24) == 127;
+		else
+			loopback = addr->ss_family == AF_INET6 &&
+				IN6_IS_ADDR_LOOPBACK(&((struct sockaddr_in6 *) addr)->sin6_addr);
+		if (!loopback)
+			return psprintf("\"%s\" is not a loopback address.", address);
+	}
+
+	return NULL;
+}
+
+/*
+ * Reject an invalid exporter_address when the configuration is loaded,
+ * rather than in the worker, which would fail at each restart.
+ */
+static bool
+check_exporter_address(char **newval, void **extra, GucSource source)
+{
+	struct sockaddr_storage addr;
+	socklen_t	addrlen;
+	char	   *reason;
+
+	if (*newval == NULL || (*newval)[0] == '\0')
+		return true;
+
+	if ((reason = parse_address(*newval, &addr, &addrlen)) != NULL)
+	{
+		GUC_check_errdetail("%s", reason);
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Listen on exporter_address, which check_exporter_address() has accepted.
+ */
+static void
+exporter_listen(void)
+{
+	struct sockaddr_storage addr;
+	socklen_t	addrlen;
+	char	   *reason;
+	int			one = 1;
+
+	if ((reason = parse_address(exporter_address, &addr, &addrlen)) != NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("invalid exporter address: \"%s\"", exporter_address),
+				 errdetail_internal("%s", reason)));
+
+	/* Remove the socket left by a previous incarnation of the worker. */
+	if (addr.ss_family == AF_UNIX)
+	{
+		struct stat st;
+
+		if (lstat(exporter_address, &st) == 0 && S_ISSOCK(st.st_mode))
+			(void) unlink(exporter_address);
+	}
+
+	exporter_sock = socket(addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (exporter_sock == PGINVALID_SOCKET)
+		ereport(ERROR,
+				(errcode_for_socket_access(),
+				 errmsg("could not create socket for \"%s\": %m", exporter_address)));
+
+	/* Close the socket, and remove the UNIX one, when the worker exits. */
+	on_proc_exit(exporter_close, (Datum) 0);
+
+	if (addr.ss_family != AF_UNIX)
+		(void) setsockopt(exporter_sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	if (bind(exporter_sock, (struct sockaddr *) &addr, addrlen) < 0)
+		ereport(ERROR,
+				(errcode_for_socket_access(),
+				 errmsg("could not bind to \"%s\": %m", exporter_address)));
+
+	if (addr.ss_family == AF_UNIX)
+	{
+		strlcpy(exporter_sock_path, exporter_address, sizeof(exporter_sock_path));
+		if (chmod(exporter_address, Unix_socket_permissions) < 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not set permissions of file \"%s\": %m", exporter_address)));
+	}
+
+	if (listen(exporter_sock, 16) < 0)
+		ereport(ERROR,
+				(errcode_for_socket_access(),
+				 errmsg("could not listen on \"%s\": %m", exporter_address)));
+
+	ereport(LOG,
+			(errmsg("pg_linux_proc exporter listening on \"%s\"", exporter_address)));
+}
+
+static void
+exporter_close(int code, Datum arg)
+{
+	if (exporter_sock != PGINVALID_SOCKET)
+		closesocket(exporter_sock);
+	exporter_sock = PGINVALID_SOCKET;
+
+	if (exporter_sock_path[0] != '\0')
+		(void) unlink(exporter_sock_path);
+	exporter_sock_path[0] = '\0';
+}
+
+/*
+ * Wait until fd is ready for events, or deadline.  Return false at the
+ * deadline or on an error.
+ */
+static bool
+wait_socket(pgsocket fd, short events, TimestampTz deadline)
+{
+	for (;;)
+	{
+		long		timeout = TimestampDifferenceMilliseconds(GetCurrentTimestamp(),
+															  deadline);
+		struct pollfd pfd;
+		int			rc;
+
+		if (timeout <= 0)
+			return false;
+
+		pfd.fd = fd;
+		pfd.events = events;
+		pfd.revents = 0;
+		rc = poll(&pfd, 1, (int) timeout);
+		if (rc < 0 && errno == EINTR)
+			continue;
+		return rc > 0;
+	}
+}
+
+static bool
+send_all(pgsocket fd, const char *data, size_t len, TimestampTz deadline)
+{
+	while (len > 0)
+	{
+		ssize_t		n = send(fd, data, len, MSG_NOSIGNAL);
+
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			if ((errno == EAGAIN || errno == EWOULDBLOCK) &&
+				wait_socket(fd, POLLOUT, deadline))
+				continue;
+			return false;
+		}
+		data += n;
+		len -= n;
+	}
+	return true;
+}
+
+static void
+send_response(pgsocket fd, const char *status, const char *content_type,
+			  const char *body, size_t len, TimestampTz deadline)
+{
+	char		header[256];
+	int			n;
+
+	n = snprintf(header, sizeof(header),
+				 "HTTP/1.1 %s\r\n"
+				 "Content-Type: %s\r\n"
+				 "Content-Length: %zu\r\n"
+				 "Connection: close\r\n"
+				 "\r\n",
+				 status, content_type, len);
+
+	if (send_all(fd, header, n, deadline))
+		(void) send_all(fd, body, len, deadline);
+}
+
+/*
+ * Read the request of a client and answer it.  Only the request line is
+ * looked at.  fd is non-blocking, and each recv() and send() waits for at
+ * most the time left until a deadline set when the client was accepted.
+ */
+static void
+exporter_serve(pgsocket fd, MemoryContext scrape_context)
+{
+	char		req[EXPORTER_REQUEST_LEN];
+	size_t		len = 0;
+	TimestampTz deadline;
+	volatile bool rendered = false;
+
+	deadline = TimestampTzPlusMilliseconds(GetCurrentTimestamp(),
+										   EXPORTER_TIMEOUT_MS);
+
+	/* Read up to the end of the header, which ends with an empty line. */
+	while (len < sizeof(req) - 1)
+	{
+		ssize_t		n = recv(fd, req + len, sizeof(req) - 1 - len, 0);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) &&
+			wait_socket(fd, POLLIN, deadline))
+			continue;
+		if (n <= 0)
+			return;
+		len += n;
+		req[len] = '\0';
+		if (strstr(req, "\r\n\r\n") != NULL || strstr(req, "\n\n") != NULL)
+			break;
+	}
+	req[len] = '\0';
+
+	if (strncmp(req, "GET /metrics", 12) != 0 ||
+		(req[12] != ' ' && req[12] != '?'))
+	{
+		static const char not_found[] = "Not Found\n";
+
+		send_response(fd, "404 Not Found", "text/plain; charset=utf-8",
+					  not_found, sizeof(not_found) - 1, deadline);
+		return;
+	}
+
+	/*
+	 * A file in an unexpected format makes the collectors throw an error;
+	 * report it to the client and in the log, and keep serving.
+	 */
+	PG_TRY();
+	{
+		MemoryContext oldcontext = MemoryContextSwitchTo(scrape_context);
+
+		exporter_render(&exporter_buf);
+		MemoryContextSwitchTo(oldcontext);
+		rendered = true;
+	}
+	PG_CATCH();
+	{
+		MemoryContextSwitchTo(TopMemoryContext);
+		EmitErrorReport();
+		FlushErrorState();
+	}
+	PG_END_TRY();
+	MemoryContextReset(scrape_context);
+
+	if (rendered)
+		send_response(fd, "200 OK", EXPORTER_CONTENT_TYPE,
+					  exporter_buf.data, exporter_buf.len, deadline);
+	else
+	{
+		static const char error[] = "Internal Server Error\n";
+
+		send_response(fd, "500 Internal Server Error", "text/plain; charset=utf-8",
+					  error, sizeof(error) - 1, deadline);
+	}
+}
+
+void
+pg_linux_proc_exporter_main(Datum main_arg)
+{
+	MemoryContext scrape_context;
+	MemoryContext oldcontext;
+
+	pqsignal(SIGHUP, SignalHandlerForConfigReload);
+	pqsignal(SIGTERM, die);
+	BackgroundWorkerUnblockSignals();
+
+	exporter_listen();
+
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+	initStringInfo(&exporter_buf);
+	MemoryContextSwitchTo(oldcontext);
+
+	scrape_context = AllocSetContextCreate(TopMemoryContext,
+										   "pg_linux_proc exporter",
+										   ALLOCSET_DEFAULT_SIZES);
+
+	for (;;)
+	{
+		int			rc;
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (ConfigReloadPending)
+		{
+			ConfigReloadPending = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		rc = WaitLatchOrSocket(MyLatch,
+							   WL_LATCH_SET | WL_SOCKET_READABLE | WL_EXIT_ON_PM_DEATH,
+							   exporter_sock, -1L,
+							   PG_WAIT_EXTENSION);
+		if (rc & WL_LATCH_SET)
+			ResetLatch(MyLatch);
+
+		if (rc & WL_SOCKET_READABLE)
+		{
+			pgsocket	fd;
+
+			/* Serve the pending clients one by one. */
+			for (;;)
+			{
+				fd = accept4(exporter_sock, NULL, NULL,
+							 SOCK_NONBLOCK | SOCK_CLOEXEC);
+				if (fd == PGINVALID_SOCKET)
+				{
+					if (errno == EINTR || errno == ECONNABORTED)
+						continue;
+					if (errno == EAGAIN || errno == EWOULDBLOCK)
+						break;
+
+					/*
+					 * Out of descriptors or memory.  The listening socket
+					 * stays readable, so wait a while instead of spinning.
+					 */
+					ereport(LOG,
+							(errcode_for_socket_access(),
+							 errmsg("could not accept new connection: %m")));
+					(void) WaitLatch(MyLatch,
+									 WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+									 EXPORTER_ACCEPT_RETRY_MS,
+									 PG_WAIT_EXTENSION);
+					ResetLatch(MyLatch);
+					break;
+				}
+
+				exporter_serve(fd, scrape_context);
+				closesocket(fd);
+				CHECK_FOR_INTERRUPTS();
+			}
+		}
+	}
+}
@@ -0,0 +1,24 @@
+/*-------------------------------------------------------------------------
+ *
+ * exporter.h
+ *		OpenMetrics endpoint of pg_linux_proc
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#ifndef __EXPORTER_H__
+#define __EXPORTER_H__
+
+/* GUC variables */
+extern char *exporter_address;
+
+extern void exporter_define_gucs(void);
+extern void exporter_register_worker(void);
+
+extern PGDLLEXPORT void pg_linux_proc_exporter_main(Datum main_arg);
+
+#endif
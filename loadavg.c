@@ -10,47 +10,36 @@
  */
 
 #include "postgres.h"
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
-#include <unistd.h>
 
 #include "loadavg.h"
+#include "parse.h"
+#include "procfile.h"
+
+static ProcFile loadavg_file = PROCFILE_INIT(FILE_LOADAVG);
 
 bool
 get_proc_loadavg(struct LoadAvg *loadavg)
 {
-	int			fd;
-	char		buffer[64];
-	int			nbytes;
+	char	   *buffer;
+	char	   *p;
+	size_t		nbytes;
 
 	/* extract loadavg information */
-	if ((fd = open(FILE_LOADAVG, O_RDONLY)) < 0)
-		ereport(ERROR,
-				(errcode_for_file_access(),
-				 errmsg("could not open file \"%s\": ", FILE_LOADAVG)));
-
-	if ((nbytes = read(fd, buffer, sizeof(buffer) - 1)) < 0)
-	{
-		close(fd);
-		ereport(ERROR,
-				(errcode_for_file_access(),
-				 errmsg("could not read file \"%s\": ", FILE_LOADAVG)));
-	}
-
-	close(fd);
-	buffer[nbytes] = '\0';
-
-	if (sscanf(buffer, "%f %f %f %d/%d %d",
-			   &(loadavg->loadavg1), &(loadavg->loadavg5), &(loadavg->loadavg15),
-			   &(loadavg->current_processes), &(loadavg->total_processes),
-			   &(loadavg->last_pid)) < NUM_LOADAVG_FIELDS_MIN)
+	buffer = procfile_read(&loadavg_file, &nbytes);
+
+	/* "0.00 0.01 0.05 1/140 12345" */
+	p = buffer;
+	if (!pl_parse_float4(&p, &(loadavg->loadavg1)) ||
+		!pl_parse_float4(&p, &(loadavg->loadavg5)) ||
+		!pl_parse_float4(&p, &(loadavg->loadavg15)) ||
+		!pl_parse_int32(&p, &(loadavg->current_processes)) ||
+		!pl_expect_char(&p, '/') ||
+		!pl_parse_int32(&p, &(loadavg->total_processes)) ||
+		!pl_parse_int32(&p, &(loadavg->last_pid)))
 		ereport(ERROR,
 				(errcode(ERRCODE_DATA_EXCEPTION),
 				 errmsg("unexpected file format: \"%s\"", FILE_LOADAVG),
 				 errdetail("number of fields is not corresponding")));
 
-
-
 	return true;
 }
@@ -11,109 +11,135 @@
 
 #include "postgres.h"
 #include "meminfo.h"
+#include "parse.h"
+#include "procfile.h"
 
+static ProcFile meminfo_file = PROCFILE_INIT(FILE_MEMINFO);
 
-bool
-get_proc_meminfo(MemInfo * meminfo)
+typedef struct MemInfoKey
 {
-	FILE	   *fp;
-	char		line[64];
+	const char *key;
+	size_t		offset;			/* of the field in MemInfo */
+}			MemInfoKey;
 
-	meminfo_store meminfo_stores[] =
-	{
-		{"MemTotal:", &(meminfo->MemTotal)},
-		{"MemFree:", &(meminfo->MemFree)},
-		{"MemAvailable:", &(meminfo->MemAvailable)},
-		{"Buffers:", &(meminfo->Buffers)},
-		{"Cached:", &(meminfo->Cached)},
-		{"SwapCached:", &(meminfo->SwapCached)},
-		{"Active:", &(meminfo->Active)},
-		{"Inactive:", &(meminfo->Inactive)},
-		{"Active(anon):", &(meminfo->Active_anon)},
-		{"Inactive(anon):", &(meminfo->Inactive_anon)},
-		{"Active(file):", &(meminfo->Active_file)},
-		{"Inactive(file):", &(meminfo->Inactive_file)},
-		{"Unevictable:", &(meminfo->Unevictable)},
-		{"Mlocked:", &(meminfo->Mlocked)},
-		{"SwapTotal:", &(meminfo->SwapTotal)},
-		{"SwapFree:", &(meminfo->SwapFree)},
-		{"Dirty:", &(meminfo->Dirty)},
-		{"Writeback:", &(meminfo->Writeback)},
-		{"AnonPages:", &(meminfo->AnonPages)},
-		{"Mapped:", &(meminfo->Mapped)},
-		{"Shmem:", &(meminfo->Shmem)},
-		{"KReclaimable:", &(meminfo->KReclaimable)},
-		{"Slab:", &(meminfo->Slab)},
-		{"SReclaimable:", &(meminfo->SReclaimable)},
-		{"SUnreclaim:", &(meminfo->SUnreclaim)},
-		{"KernelStack:", &(meminfo->KernelStack)},
-		{"PageTables:", &(meminfo->PageTables)},
-		{"NFS_Unstable:", &(meminfo->NFS_Unstable)},
-		{"Bounce:", &(meminfo->Bounce)},
-		{"WritebackTmp:", &(meminfo->WritebackTmp)},
-		{"CommitLimit:", &(meminfo->CommitLimit)},
-		{"Committed_AS:", &(meminfo->Committed_AS)},
-		{"VmallocTotal:", &(meminfo->VmallocTotal)},
-		{"VmallocUsed:", &(meminfo->VmallocUsed)},
-		{"VmallocChunk:", &(meminfo->VmallocChunk)},
-		{"Percpu:", &(meminfo->Percpu)},
-		{"HardwareCorrupted:", &(meminfo->HardwareCorrupted)},
-		{"AnonHugePages:", &(meminfo->AnonHugePages)},
-		{"ShmemHugePages:", &(meminfo->ShmemHugePages)},
-		{"ShmemPmdMapped:", &(meminfo->ShmemPmdMapped)},
-		{"FileHugePages:", &(meminfo->FileHugePages)},
-		{"FilePmdMapped:", &(meminfo->FilePmdMapped)},
-		{"CmaTotal:", &(meminfo->CmaTotal)},
-		{"CmaFree:", &(meminfo->CmaFree)},
-		{"HugePages_Total:", &(meminfo->HugePages_Total)},
-		{"HugePages_Free:", &(meminfo->HugePages_Free)},
-		{"HugePages_Rsvd:", &(meminfo->HugePages_Rsvd)},
-		{"HugePages_Surp:", &(meminfo->HugePages_Surp)},
-		{"Hugepagesize:", &(meminfo->Hugepagesize)},
-		{"Hugetlb:", &(meminfo->Hugetlb)}
-	};
-
-	if ((fp = fopen(FILE_MEMINFO, "r")) == NULL)
-		ereport(ERROR,
-				(errcode_for_file_access(),
-				 errmsg("could not open file \"%s\": ", FILE_MEMINFO)));
-
-	while (fgets(line, sizeof(line), fp) != NULL)
-	{
-		int			i;
-		int			store_size;
+#define MEMINFO_KEY(key, field, unit)	{key, offsetof(MemInfo, field)},
 
-		store_size = sizeof(meminfo_stores) / sizeof(meminfo_store);
+static const MemInfoKey meminfo_keys[] = {
+	MEMINFO_KEYS(MEMINFO_KEY)
+};
 
-		for (i = 0; i < store_size; i++)
-		{
-			meminfo_store *m = &(meminfo_stores[i]);
-			int			len = strlen(m->key);
-
-			if (strncmp(m->key, line, len) == 0)
-			{
-				if (sscanf(line, "%*s %ld %*s", m->value) < 1)
-					ereport(ERROR,
-							(errcode(ERRCODE_DATA_EXCEPTION),
-							 errmsg("unexpected file format: \"%s\"", FILE_MEMINFO),
-							 errdetail("number of fields is not corresponding")));
-
-				break;
-			}
-		}
+/*
+ * Open-addressing hash table of meminfo_keys, built on the first call.
+ * Each bucket holds an index into meminfo_keys plus one, or 0 if empty.
+ * The size is a power of two more than twice the number of keys, so
+ * probes are short.
+ */
+#define MEMINFO_HASH_SIZE	128
+
+StaticAssertDecl(lengthof(meminfo_keys) * 2 < MEMINFO_HASH_SIZE,
+				 "MEMINFO_HASH_SIZE is too small");
+
+static uint8 meminfo_hash[MEMINFO_HASH_SIZE];
+static bool meminfo_hash_built = false;
+
+/* FNV-1a */
+static inline uint32
+meminfo_key_hash(const char *key)
+{
+	uint32		h = 2166136261;
+
+	for (; *key != '\0'; key++)
+		h = (h ^ (unsigned char) *key) * 16777619;
+
+	return h;
+}
+
+static void
+meminfo_build_hash(void)
+{
+	int			i;
+
+	for (i = 0; i < lengthof(meminfo_keys); i++)
+	{
+		uint32		h = meminfo_key_hash(meminfo_keys[i].key);
+
+		while (meminfo_hash[h & (MEMINFO_HASH_SIZE - 1)] != 0)
+			h++;
+		meminfo_hash[h & (MEMINFO_HASH_SIZE - 1)] = i + 1;
 	}
 
+	meminfo_hash_built = true;
+}
 
-	if (ferror(fp) && errno != EINTR)
+static const MemInfoKey *
+meminfo_lookup(const char *key)
+{
+	uint32		h = meminfo_key_hash(key);
+	uint8		idx;
+
+	while ((idx = meminfo_hash[h & (MEMINFO_HASH_SIZE - 1)]) != 0)
 	{
-		fclose(fp);
-		ereport(ERROR,
-				(errcode_for_file_access(),
-				 errmsg("could not read file \"%s\": ", FILE_MEMINFO)));
+		if (strcmp(meminfo_keys[idx - 1].key, key) == 0)
+			return &meminfo_keys[idx - 1];
+		h++;
 	}
 
-	fclose(fp);
+	return NULL;
+}
+
+/*
+ * Read /proc/meminfo into meminfo.  If extra is not NULL, the lines whose
+ * key has no field in MemInfo are appended to *extra as MemInfoExtra.
+ */
+bool
+get_proc_meminfo(MemInfo * meminfo, List **extra)
+{
+	char	   *buf;
+	char	   *p;
+	char	   *line;
+	size_t		len;
+
+	if (!meminfo_hash_built)
+		meminfo_build_hash();
+
+	memset(meminfo, 0, sizeof(MemInfo));
 
+	buf = procfile_read(&meminfo_file, &len);
+
+	/* "MemTotal:       16318032 kB" */
+	p = buf;
+	while ((line = pl_next_line(&p)) != NULL)
+	{
+		char	   *key = pl_next_token(&line);
+		size_t		keylen;
+		const MemInfoKey *k;
+		int64		value;
+
+		if (key == NULL)
+			continue;
+
+		keylen = strlen(key);
+		if (keylen < 2 || key[keylen - 1] != ':' ||
+			!pl_parse_int64(&line, &value))
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_EXCEPTION),
+					 errmsg("unexpected file format: \"%s\"", FILE_MEMINFO),
+					 errdetail("number of fields is not corresponding")));
+		key[keylen - 1] = '\0';
+
+		if ((k = meminfo_lookup(key)) != NULL)
+			*(int64 *) ((char *) meminfo + k->offset) = value;
+		else if (extra != NULL)
+		{
+			MemInfoExtra *e = (MemInfoExtra *) palloc(sizeof(MemInfoExtra));
+			char	   *unit = pl_next_token(&line);
+
+			e->key = pstrdup(key);
+			e->value = value;
+			e->unit = unit ? pstrdup(unit) : NULL;
+			*extra = lappend(*extra, e);
+		}
+	}
 
 	return true;
 }
@@ -14,6 +14,8 @@
 #ifndef __MEMINFO_H__
 #define __MEMINFO_H__
 
+#include "nodes/pg_list.h"
+
 #define FILE_MEMINFO		"/proc/meminfo"
 
 /*
@@ -21,72 +23,88 @@ https://access.redhat.com/documentation/en-us/red_hat_enterprise_linux/6/html/de
 
 */
 
-typedef struct MemInfo
-{
-	int64		MemTotal;
-	int64		MemFree;
-	int64		MemAvailable;
-	int64		Buffers;
-	int64		Cached;
-	int64		SwapCached;
-	int64		Active;
-	int64		Inactive;
-	int64		Active_anon;
-	int64		Inactive_anon;
-
-	int64		Active_file;
-	int64		Inactive_file;
-	int64		Unevictable;
-	int64		Mlocked;
-	int64		SwapTotal;
-	int64		SwapFree;
-	int64		Dirty;
-	int64		Writeback;
-	int64		AnonPages;
-	int64		Mapped;
-
-	int64		Shmem;
-	int64		KReclaimable;
-	int64		Slab;
-	int64		SReclaimable;
-	int64		SUnreclaim;
-	int64		KernelStack;
-	int64		PageTables;
-	int64		NFS_Unstable;
-	int64		Bounce;
-	int64		WritebackTmp;
+/*
+ * The keys of /proc/meminfo that have their own column in pg_proc_meminfo(),
+ * in column order, with the unit of their value: KB, or NONE for the
+ * hugepage counts.  This is the single table from which MemInfo, the key
+ * lookup of get_proc_meminfo(), meminfo_values() and the metrics of the
+ * store are generated.
+ */
+#define MEMINFO_KEYS(X) \
+	X("MemTotal", MemTotal, KB) \
+	X("MemFree", MemFree, KB) \
+	X("MemAvailable", MemAvailable, KB) \
+	X("Buffers", Buffers, KB) \
+	X("Cached", Cached, KB) \
+	X("SwapCached", SwapCached, KB) \
+	X("Active", Active, KB) \
+	X("Inactive", Inactive, KB) \
+	X("Active(anon)", Active_anon, KB) \
+	X("Inactive(anon)", Inactive_anon, KB) \
+	\
+	X("Active(file)", Active_file, KB) \
+	X("Inactive(file)", Inactive_file, KB) \
+	X("Unevictable", Unevictable, KB) \
+	X("Mlocked", Mlocked, KB) \
+	X("SwapTotal", SwapTotal, KB) \
+	X("SwapFree", SwapFree, KB) \
+	X("Dirty", Dirty, KB) \
+	X("Writeback", Writeback, KB) \
+	X("AnonPages", AnonPages, KB) \
+	X("Mapped", Mapped, KB) \
+	\
+	X("Shmem", Shmem, KB) \
+	X("KReclaimable", KReclaimable, KB) \
+	X("Slab", Slab, KB) \
+	X("SReclaimable", SReclaimable, KB) \
+	X("SUnreclaim", SUnreclaim, KB) \
+	X("KernelStack", KernelStack, KB) \
+	X("PageTables", PageTables, KB) \
+	X("NFS_Unstable", NFS_Unstable, KB) \
+	X("Bounce", Bounce, KB) \
+	X("WritebackTmp", WritebackTmp, KB) \
+	\
+	X("CommitLimit", CommitLimit, KB) \
+	X("Committed_AS", Committed_AS, KB) \
+	X("VmallocTotal", VmallocTotal, KB) \
+	X("VmallocUsed", VmallocUsed, KB) \
+	X("VmallocChunk", VmallocChunk, KB) \
+	X("Percpu", Percpu, KB) \
+	X("HardwareCorrupted", HardwareCorrupted, KB) \
+	X("AnonHugePages", AnonHugePages, KB) \
+	X("ShmemHugePages", ShmemHugePages, KB) \
+	X("ShmemPmdMapped", ShmemPmdMapped, KB) \
+	\
+	X("FileHugePages", FileHugePages, KB) \
+	X("FilePmdMapped", FilePmdMapped, KB) \
+	X("CmaTotal", CmaTotal, KB) \
+	X("CmaFree", CmaFree, KB) \
+	X("HugePages_Total", HugePages_Total, NONE) \
+	X("HugePages_Free", HugePages_Free, NONE) \
+	X("HugePages_Rsvd", HugePages_Rsvd, NONE) \
+	X("HugePages_Surp", HugePages_Surp, NONE) \
+	X("Hugepagesize", Hugepagesize, KB) \
+	X("Hugetlb", Hugetlb, KB)
 
-	int64		CommitLimit;
-	int64		Committed_AS;
-	int64		VmallocTotal;
-	int64		VmallocUsed;
-	int64		VmallocChunk;
-	int64		Percpu;
-	int64		HardwareCorrupted;
-	int64		AnonHugePages;
-	int64		ShmemHugePages;
-	int64		ShmemPmdMapped;
+#define MEMINFO_FIELD(key, field, unit)	int64 field;
 
-	int64		FileHugePages;
-	int64		FilePmdMapped;
-	int64		CmaTotal;
-	int64		CmaFree;
-	int64		HugePages_Total;
-	int64		HugePages_Free;
-	int64		HugePages_Rsvd;
-	int64		HugePages_Surp;
-	int64		Hugepagesize;
-	int64		Hugetlb;
+typedef struct MemInfo
+{
+	MEMINFO_KEYS(MEMINFO_FIELD)
 }			MemInfo;
 
-
-typedef struct meminfo_store
+/*
+ * A line of /proc/meminfo whose key is not in MEMINFO_KEYS, such as
+ * "Zswap" or "Unaccepted" of newer kernels.
+ */
+typedef struct MemInfoExtra
 {
-	const char *key;
-	int64	   *value;
-}			meminfo_store;
+	char	   *key;			/* without the trailing ':' */
+	int64		value;
+	char	   *unit;			/* "kB", or NULL if the value is a count */
+}			MemInfoExtra;
 
 
-extern bool get_proc_meminfo(MemInfo * meminfo);
+extern bool get_proc_meminfo(MemInfo * meminfo, List **extra);
 
 #endif
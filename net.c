@@ -0,0 +1,275 @@
+/*-------------------------------------------------------------------------
+ *
+ * net.c
+ *		Get /proc/net/dev and /proc/net/snmp on Linux
+ *
+ * Both files are read through /proc/self/net, so inside a container the
+ * counters are those of the network namespace of the server.
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "nodes/pg_list.h"
+
+#include "net.h"
+#include "parse.h"
+#include "pg_linux_proc.h"
+#include "procfile.h"
+
+static ProcFile netdev_file = PROCFILE_INIT(FILE_NETDEV);
+static ProcFile netsnmp_file = PROCFILE_INIT(FILE_NETSNMP);
+
+/* Max number of counters of a protocol in /proc/net/snmp */
+#define MAX_NETSNMP_FIELDS	64
+
+/*
+Inter-|   Receive                                                |  Transmit
+ face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed
+    lo: 32442669    4898    0    0    0     0          0         0 32442669    4898    0    0    0     0       0          0
+
+The name is printed as "%6s:" followed by the counters without a separator,
+so a large counter can be glued to the ':'.
+ */
+
+List *
+get_proc_netdev(List *netdev)
+{
+	char	   *buf;
+	char	   *p;
+	char	   *line;
+	size_t		len;
+	int			lineno = 0;
+
+	buf = procfile_read(&netdev_file, &len);
+
+	p = buf;
+	while ((line = pl_next_line(&p)) != NULL)
+	{
+		NetDev	   *nd;
+		char	   *colon;
+		char	   *name;
+		int64		v[NUM_NETDEV_FIELDS];
+
+		/* two header lines */
+		if (lineno++ < 2)
+			continue;
+
+		if ((colon = strchr(line, ':')) == NULL)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_EXCEPTION),
+					 errmsg("unexpected file format: \"%s\"", FILE_NETDEV),
+					 errdetail("number of fields is not corresponding")));
+		*colon = '\0';
+		name = pl_skip_blanks(line);
+		line = colon + 1;
+
+		if (pl_parse_int64_array(&line, v, lengthof(v)) < NUM_NETDEV_FIELDS)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_EXCEPTION),
+					 errmsg("unexpected file format: \"%s\"", FILE_NETDEV),
+					 errdetail("number of fields is not corresponding")));
+
+		nd = palloc(sizeof(NetDev));
+		strlcpy(nd->name, name, sizeof(nd->name));
+		nd->rx_bytes = v[0];
+		nd->rx_packets = v[1];
+		nd->rx_errs = v[2];
+		nd->rx_drop = v[3];
+		nd->rx_fifo = v[4];
+		nd->rx_frame = v[5];
+		nd->rx_compressed = v[6];
+		nd->rx_multicast = v[7];
+		nd->tx_bytes = v[8];
+		nd->tx_packets = v[9];
+		nd->tx_errs = v[10];
+		nd->tx_drop = v[11];
+		nd->tx_fifo = v[12];
+		nd->tx_colls = v[13];
+		nd->tx_carrier = v[14];
+		nd->tx_compressed = v[15];
+
+		netdev = lappend(netdev, nd);
+	}
+
+	return netdev;
+}
+
+static bool
+match_interface(const void *a, const void *b)
+{
+	return strcmp(((const NetDev *) a)->name, ((const NetDev *) b)->name) == 0;
+}
+
+/*
+ * Compute per-second rates between two results of get_proc_netdev()
+ * taken elapsed seconds apart.  Interfaces are matched by name, and an
+ * interface missing from prev is skipped.
+ */
+List *
+get_netdev_rate(List *prev, List *cur, double elapsed)
+{
+	List	   *rates = NIL;
+	ListCell   *lc;
+
+	if (elapsed <= 0)
+		return NIL;
+
+	foreach(lc, cur)
+	{
+		NetDev	   *c = (NetDev *) lfirst(lc);
+		NetDev	   *p;
+		NetDevRate *r;
+
+		p = (NetDev *) find_prev_entry(prev, foreach_current_index(lc), c,
+									   match_interface);
+		if (p == NULL)
+			continue;
+
+		r = palloc0(sizeof(NetDevRate));
+		strlcpy(r->name, c->name, sizeof(r->name));
+		r->rx_kb_s = counter_delta(p->rx_bytes, c->rx_bytes) / 1024.0 / elapsed;
+		r->tx_kb_s = counter_delta(p->tx_bytes, c->tx_bytes) / 1024.0 / elapsed;
+		r->rx_packets_s = counter_delta(p->rx_packets, c->rx_packets) / elapsed;
+		r->tx_packets_s = counter_delta(p->tx_packets, c->tx_packets) / elapsed;
+		r->rx_errs_s = counter_delta(p->rx_errs, c->rx_errs) / elapsed;
+		r->tx_errs_s = counter_delta(p->tx_errs, c->tx_errs) / elapsed;
+		r->rx_drop_s = counter_delta(p->rx_drop, c->rx_drop) / elapsed;
+		r->tx_drop_s = counter_delta(p->tx_drop, c->tx_drop) / elapsed;
+
+		rates = lappend(rates, r);
+	}
+
+	return rates;
+}
+
+/*
+ * /proc/net/snmp has a pair of lines per protocol, the counter names and
+ * their values:
+
+Tcp: RtoAlgorithm RtoMin RtoMax MaxConn ActiveOpens PassiveOpens ...
+Tcp: 1 200 120000 -1 7 7 ...
+
+ */
+
+List *
+get_proc_netsnmp(List *netsnmp)
+{
+	char	   *buf;
+	char	   *p;
+	char	   *names_line;
+	size_t		len;
+
+	buf = procfile_read(&netsnmp_file, &len);
+
+	p = buf;
+	while ((names_line = pl_next_line(&p)) != NULL)
+	{
+		char	   *values_line = pl_next_line(&p);
+		char	   *names[MAX_NETSNMP_FIELDS];
+		char	   *protocol;
+		char	   *vproto;
+		int			nnames = 0;
+		int			i;
+
+		protocol = pl_next_token(&names_line);
+		vproto = values_line ? pl_next_token(&values_line) : NULL;
+		if (protocol == NULL || vproto == NULL || strcmp(protocol, vproto) != 0)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_EXCEPTION),
+					 errmsg("unexpected file format: \"%s\"", FILE_NETSNMP),
+					 errdetail("number of fields is not corresponding")));
+
+		/* "Tcp:" */
+		protocol[strcspn(protocol, ":")] = '\0';
+
+		while (nnames < MAX_NETSNMP_FIELDS &&
+			   (names[nnames] = pl_next_token(&names_line)) != NULL)
+			nnames++;
+
+		for (i = 0; i < nnames; i++)
+		{
+			NetSnmp    *ns = palloc(sizeof(NetSnmp));
+
+			if (!pl_parse_int64(&values_line, &ns->value))
+				ereport(ERROR,
+						(errcode(ERRCODE_DATA_EXCEPTION),
+						 errmsg("unexpected file format: \"%s\"", FILE_NETSNMP),
+						 errdetail("number of fields is not corresponding")));
+
+			strlcpy(ns->protocol, protocol, sizeof(ns->protocol));
+			strlcpy(ns->name, names[i], sizeof(ns->name));
+			netsnmp = lappend(netsnmp, ns);
+		}
+	}
+
+	return netsnmp;
+}
+
+static int64
+netsnmp_value(List *netsnmp, const char *protocol, const char *name)
+{
+	ListCell   *lc;
+
+	foreach(lc, netsnmp)
+	{
+		NetSnmp    *ns = (NetSnmp *) lfirst(lc);
+
+		if (strcmp(ns->name, name) == 0 && strcmp(ns->protocol, protocol) == 0)
+			return ns->value;
+	}
+
+	return 0;
+}
+
+static double
+netsnmp_rate(List *prev, List *cur, const char *protocol, const char *name,
+			 double elapsed)
+{
+	return counter_delta(netsnmp_value(prev, protocol, name),
+						 netsnmp_value(cur, protocol, name)) / elapsed;
+}
+
+/*
+ * Compute per-second rates of the main counters between two results of
+ * get_proc_netsnmp() taken elapsed seconds apart.
+ */
+void
+get_netsnmp_rate(List *prev, List *cur, double elapsed, NetSnmpRate * rate)
+{
+	memset(rate, 0, sizeof(NetSnmpRate));
+
+	rate->tcp_curr_estab = netsnmp_value(cur, "Tcp", "CurrEstab");
+
+	if (elapsed <= 0)
+		return;
+
+	rate->ip_in_receives_s = netsnmp_rate(prev, cur, "Ip", "InReceives", elapsed);
+	rate->ip_out_requests_s = netsnmp_rate(prev, cur, "Ip", "OutRequests", elapsed);
+	rate->ip_in_discards_s = netsnmp_rate(prev, cur, "Ip", "InDiscards", elapsed);
+	rate->ip_out_discards_s = netsnmp_rate(prev, cur, "Ip", "OutDiscards", elapsed);
+
+	rate->tcp_active_opens_s = netsnmp_rate(prev, cur, "Tcp", "ActiveOpens", elapsed);
+	rate->tcp_passive_opens_s = netsnmp_rate(prev, cur, "Tcp", "PassiveOpens", elapsed);
+	rate->tcp_attempt_fails_s = netsnmp_rate(prev, cur, "Tcp", "AttemptFails", elapsed);
+	rate->tcp_estab_resets_s = netsnmp_rate(prev, cur, "Tcp", "EstabResets", elapsed);
+	rate->tcp_in_segs_s = netsnmp_rate(prev, cur, "Tcp", "InSegs", elapsed);
+	rate->tcp_out_segs_s = netsnmp_rate(prev, cur, "Tcp", "OutSegs", elapsed);
+	rate->tcp_retrans_segs_s = netsnmp_rate(prev, cur, "Tcp", "RetransSegs", elapsed);
+	rate->tcp_in_errs_s = netsnmp_rate(prev, cur, "Tcp", "InErrs", elapsed);
+	rate->tcp_out_rsts_s = netsnmp_rate(prev, cur, "Tcp", "OutRsts", elapsed);
+
+	/* As sar -n ETCP, relative to the segments sent */
+	if (rate->tcp_out_segs_s > 0)
+		rate->tcp_retrans_pct =
+			rate->tcp_retrans_segs_s / rate->tcp_out_segs_s * 100.0;
+
+	rate->udp_in_datagrams_s = netsnmp_rate(prev, cur, "Udp", "InDatagrams", elapsed);
+	rate->udp_out_datagrams_s = netsnmp_rate(prev, cur, "Udp", "OutDatagrams", elapsed);
+	rate->udp_in_errors_s = netsnmp_rate(prev, cur, "Udp", "InErrors", elapsed);
+	rate->udp_rcvbuf_errors_s = netsnmp_rate(prev, cur, "Udp", "RcvbufErrors", elapsed);
+	rate->udp_sndbuf_errors_s = netsnmp_rate(prev, cur, "Udp", "SndbufErrors", elapsed);
+}
@@ -0,0 +1,101 @@
+/*-------------------------------------------------------------------------
+ *
+ * net.h
+ *		Get /proc/net/dev and /proc/net/snmp on Linux
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#ifndef __NET_H__
+#define __NET_H__
+
+#include "nodes/pg_list.h"
+
+/*
+ * /proc/net is a link to /proc/self/net, which shows the network namespace
+ * of the reading process; the self path makes that explicit.
+ */
+#define FILE_NETDEV			"/proc/self/net/dev"
+#define FILE_NETSNMP		"/proc/self/net/snmp"
+#define NUM_NETDEV_FIELDS	16
+
+typedef struct NetDev
+{
+	char		name[32];		/* interface name */
+	int64		rx_bytes;
+	int64		rx_packets;
+	int64		rx_errs;
+	int64		rx_drop;
+	int64		rx_fifo;
+	int64		rx_frame;
+	int64		rx_compressed;
+	int64		rx_multicast;
+	int64		tx_bytes;
+	int64		tx_packets;
+	int64		tx_errs;
+	int64		tx_drop;
+	int64		tx_fifo;
+	int64		tx_colls;
+	int64		tx_carrier;
+	int64		tx_compressed;
+}			NetDev;
+
+/* Per-second rates of an interface between two NetDev samples */
+typedef struct NetDevRate
+{
+	char		name[32];
+	double		rx_kb_s;
+	double		tx_kb_s;
+	double		rx_packets_s;
+	double		tx_packets_s;
+	double		rx_errs_s;
+	double		tx_errs_s;
+	double		rx_drop_s;
+	double		tx_drop_s;
+}			NetDevRate;
+
+/* A counter of /proc/net/snmp, e.g. protocol "Tcp", name "RetransSegs" */
+typedef struct NetSnmp
+{
+	char		protocol[16];
+	char		name[32];
+	int64		value;
+}			NetSnmp;
+
+/* Per-second rates of the main IP, TCP and UDP counters */
+typedef struct NetSnmpRate
+{
+	double		ip_in_receives_s;
+	double		ip_out_requests_s;
+	double		ip_in_discards_s;
+	double		ip_out_discards_s;
+	double		tcp_active_opens_s;
+	double		tcp_passive_opens_s;
+	double		tcp_attempt_fails_s;
+	double		tcp_estab_resets_s;
+	int64		tcp_curr_estab;	/* gauge, at the end of the interval */
+	double		tcp_in_segs_s;
+	double		tcp_out_segs_s;
+	double		tcp_retrans_segs_s;
+	double		tcp_retrans_pct;	/* RetransSegs / OutSegs in percent */
+	double		tcp_in_errs_s;
+	double		tcp_out_rsts_s;
+	double		udp_in_datagrams_s;
+	double		udp_out_datagrams_s;
+	double		udp_in_errors_s;
+	double		udp_rcvbuf_errors_s;
+	double		udp_sndbuf_errors_s;
+}			NetSnmpRate;
+
+
+extern List *get_proc_netdev(List *netdev);
+extern List *get_netdev_rate(List *prev, List *cur, double elapsed);
+extern List *get_proc_netsnmp(List *netsnmp);
+extern void get_netsnmp_rate(List *prev, List *cur, double elapsed,
+							 NetSnmpRate * rate);
+
+#endif
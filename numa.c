@@ -0,0 +1,374 @@
+/*-------------------------------------------------------------------------
+ *
+ * numa.c
+ *		Show NUMA nodes and shared memory placement on Linux
+ *
+ * The nodes are looked up in /sys/devices/system/node once per backend;
+ * their meminfo and numastat files are then read through cached
+ * descriptors as the /proc files are.  On a kernel without NUMA support
+ * the directory does not exist and there are no nodes.
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "storage/fd.h"
+#include "utils/memutils.h"
+
+#include "numa.h"
+#include "parse.h"
+#include "pid.h"
+#include "procfile.h"
+
+typedef struct NodeFiles
+{
+	int			node;
+	char	   *cpulist;
+	ProcFile	meminfo;
+	ProcFile	numastat;
+}			NodeFiles;
+
+/* Set up by numa_init(); num_nodes is -1 until then */
+static NodeFiles *node_files = NULL;
+static int	num_nodes = -1;
+
+/* Node of each cpu, -1 if offline */
+static int *cpu_node = NULL;
+static int	num_cpus = 0;
+
+typedef struct NumaKey
+{
+	const char *key;
+	size_t		offset;			/* of the field in NumaNode */
+}			NumaKey;
+
+static const NumaKey node_meminfo_keys[] = {
+	{"MemTotal:", offsetof(NumaNode, mem_total)},
+	{"MemFree:", offsetof(NumaNode, mem_free)},
+	{"MemUsed:", offsetof(NumaNode, mem_used)},
+	{"FilePages:", offsetof(NumaNode, file_pages)},
+	{"AnonPages:", offsetof(NumaNode, anon_pages)},
+	{"Shmem:", offsetof(NumaNode, shmem)},
+	{"HugePages_Total:", offsetof(NumaNode, hugepages_total)},
+	{"HugePages_Free:", offsetof(NumaNode, hugepages_free)},
+};
+
+static const NumaKey node_numastat_keys[] = {
+	{"numa_hit", offsetof(NumaNode, numa_hit)},
+	{"numa_miss", offsetof(NumaNode, numa_miss)},
+	{"numa_foreign", offsetof(NumaNode, numa_foreign)},
+	{"interleave_hit", offsetof(NumaNode, interleave_hit)},
+	{"local_node", offsetof(NumaNode, local_node)},
+	{"other_node", offsetof(NumaNode, other_node)},
+};
+
+static int
+node_cmp(const void *a, const void *b)
+{
+	int			na = *(const int *) a;
+	int			nb = *(const int *) b;
+
+	return (na < nb) ? -1 : (na > nb);
+}
+
+/*
+ * Set up pf for DIR_NODE/node<node>/<name>.  The path is kept in
+ * TopMemoryContext, as the descriptor is.
+ */
+static void
+node_file_init(ProcFile * pf, int node, const char *name)
+{
+	char		path[MAXPGPATH];
+
+	snprintf(path, sizeof(path), DIR_NODE "/node%d/%s", node, name);
+
+	pf->path = MemoryContextStrdup(TopMemoryContext, path);
+	pf->fd = -1;
+	pf->buf = NULL;
+	pf->bufsize = 0;
+}
+
+/*
+ * Call fn for each cpu of a list such as "0-15,32-47".
+ */
+static void
+for_each_cpu_in_list(const char *list, void (*fn) (int cpu, int node), int node)
+{
+	const char *p = list;
+
+	while (*p >= '0' && *p <= '9')
+	{
+		char	   *end;
+		long		first = strtol(p, &end, 10);
+		long		last = first;
+		long		cpu;
+
+		if (*end == '-')
+			last = strtol(end + 1, &end, 10);
+
+		for (cpu = first; cpu <= last; cpu++)
+			fn((int) cpu, node);
+
+		p = (*end == ',') ? end + 1 : end;
+	}
+}
+
+static void
+count_cpu(int cpu, int node)
+{
+	if (cpu >= num_cpus)
+		num_cpus = cpu + 1;
+}
+
+static void
+set_cpu_node(int cpu, int node)
+{
+	cpu_node[cpu] = node;
+}
+
+/*
+ * The cpus of a node do not change while the server runs, so cpulist is
+ * read once and its descriptor is not kept.
+ */
+static char *
+read_node_cpulist(int node)
+{
+	ProcFile	pf;
+	char	   *buf;
+	size_t		len;
+	char	   *cpulist;
+
+	node_file_init(&pf, node, "cpulist");
+
+	buf = procfile_read(&pf, &len);
+	buf[strcspn(buf, "\n")] = '\0';
+	cpulist = MemoryContextStrdup(TopMemoryContext, buf);
+	procfile_close(&pf);
+	pfree(pf.buf);
+	pfree((char *) pf.path);
+
+	return cpulist;
+}
+
+/*
+ * Find the nodes and the cpus of each node.
+ */
+static void
+numa_init(void)
+{
+	DIR		   *dir;
+	struct dirent *dp;
+	int		   *nodes;
+	int			nnodes = 0;
+	int			maxnodes = 16;
+	int			i;
+
+	if (num_nodes >= 0)
+		return;
+
+	if ((dir = AllocateDir(DIR_NODE)) == NULL)
+	{
+		num_nodes = 0;
+		return;
+	}
+
+	nodes = palloc(sizeof(int) * maxnodes);
+	while ((dp = ReadDir(dir, DIR_NODE)) != NULL)
+	{
+		char	   *end;
+		long		node;
+
+		if (strncmp(dp->d_name, "node", 4) != 0 ||
+			dp->d_name[4] < '0' || dp->d_name[4] > '9')
+			continue;
+
+		node = strtol(dp->d_name + 4, &end, 10);
+		if (*end != '\0')
+			continue;
+
+		if (nnodes == maxnodes)
+		{
+			maxnodes *= 2;
+			nodes = repalloc(nodes, sizeof(int) * maxnodes);
+		}
+		nodes[nnodes++] = (int) node;
+	}
+	FreeDir(dir);
+
+	qsort(nodes, nnodes, sizeof(int), node_cmp);
+
+	node_files = MemoryContextAllocZero(TopMemoryContext,
+										sizeof(NodeFiles) * Max(nnodes, 1));
+	for (i = 0; i < nnodes; i++)
+	{
+		NodeFiles  *nf = &node_files[i];
+
+		nf->node = nodes[i];
+		nf->cpulist = read_node_cpulist(nodes[i]);
+		node_file_init(&nf->meminfo, nodes[i], "meminfo");
+		node_file_init(&nf->numastat, nodes[i], "numastat");
+		for_each_cpu_in_list(nf->cpulist, count_cpu, nf->node);
+	}
+
+	cpu_node = MemoryContextAlloc(TopMemoryContext, sizeof(int) * Max(num_cpus, 1));
+	memset(cpu_node, -1, sizeof(int) * Max(num_cpus, 1));
+	for (i = 0; i < nnodes; i++)
+		for_each_cpu_in_list(node_files[i].cpulist, set_cpu_node, node_files[i].node);
+
+	pfree(nodes);
+	num_nodes = nnodes;
+}
+
+/*
+ * Parse "key value" lines into the fields of node.  The lines of meminfo
+ * are prefixed with "Node <N> ".
+ */
+static void
+parse_node_file(ProcFile * pf, const NumaKey * keys, int nkeys, bool prefixed,
+				NumaNode * node)
+{
+	char	   *buf;
+	char	   *line;
+	size_t		len;
+
+	buf = procfile_read(pf, &len);
+
+	while ((line = pl_next_line(&buf)) != NULL)
+	{
+		char	   *key;
+		int			i;
+
+		if (prefixed)
+		{
+			pl_next_token(&line);	/* "Node" */
+			pl_next_token(&line);	/* "<N>" */
+		}
+		if ((key = pl_next_token(&line)) == NULL)
+			continue;
+
+		for (i = 0; i < nkeys; i++)
+		{
+			if (strcmp(keys[i].key, key) == 0)
+			{
+				if (!pl_parse_int64(&line, (int64 *) ((char *) node + keys[i].offset)))
+					ereport(ERROR,
+							(errcode(ERRCODE_DATA_EXCEPTION),
+							 errmsg("unexpected file format: \"%s\"", pf->path),
+							 errdetail("number of fields is not corresponding")));
+				break;
+			}
+		}
+	}
+}
+
+/*
+ * Append a NumaNode per node.
+ */
+List *
+get_numa_nodes(List *nodes)
+{
+	int			i;
+
+	numa_init();
+
+	for (i = 0; i < num_nodes; i++)
+	{
+		NodeFiles  *nf = &node_files[i];
+		NumaNode   *node = (NumaNode *) palloc0(sizeof(NumaNode));
+
+		node->node = nf->node;
+		node->cpulist = nf->cpulist;
+		parse_node_file(&nf->meminfo, node_meminfo_keys,
+						lengthof(node_meminfo_keys), true, node);
+		parse_node_file(&nf->numastat, node_numastat_keys,
+						lengthof(node_numastat_keys), false, node);
+
+		nodes = lappend(nodes, node);
+	}
+
+	return nodes;
+}
+
+/*
+ * Return the node of the cpu, or -1 if unknown.
+ */
+int
+numa_node_of_cpu(int cpu)
+{
+	numa_init();
+
+	if (cpu < 0 || cpu >= num_cpus)
+		return -1;
+	return cpu_node[cpu];
+}
+
+/*
+ * Find the mapping of the process that contains addr in
+ * /proc/<pid>/numa_maps, i.e. the one with the highest start address not
+ * above addr, and return its pages per node.
+ *
+ * numa_maps counts only the pages mapped by that process.  Return false
+ * if the process has exited or no mapping was found.
+ *
+ * The main shared memory segment is an anonymous shared mapping, shown as
+ * /dev/zero, or as /anon_hugepage when it uses huge pages:
+ *
+ *	7f5a8c000000 default file=/dev/zero\040(deleted) dirty=1234 mapmax=8 N0=1000 N1=234 kernelpagesize_kB=4
+ */
+bool
+get_numa_mapping(int pid, uint64 addr, NumaMapping * mapping)
+{
+	char	   *buf;
+	char	   *line;
+	char	   *found = NULL;
+	uint64		found_start = 0;
+	ssize_t		len;
+	char	   *tok;
+
+	memset(mapping, 0, sizeof(NumaMapping));
+
+	if ((buf = read_pid_file(pid, "numa_maps", &len)) == NULL)
+		return false;
+
+	/* The mappings are sorted by address. */
+	while ((line = pl_next_line(&buf)) != NULL)
+	{
+		uint64		start = strtou64(line, NULL, 16);
+
+		if (start > addr)
+			break;
+		found = line;
+		found_start = start;
+	}
+
+	if (found == NULL)
+		return false;
+
+	mapping->start = found_start;
+	pl_next_token(&found);		/* start address */
+	if ((tok = pl_next_token(&found)) != NULL)
+		strlcpy(mapping->policy, tok, sizeof(mapping->policy));
+
+	while ((tok = pl_next_token(&found)) != NULL)
+	{
+		if (tok[0] == 'N' && tok[1] >= '0' && tok[1] <= '9')
+		{
+			NumaPages  *np = (NumaPages *) palloc(sizeof(NumaPages));
+			char	   *eq;
+
+			np->node = (int) strtol(tok + 1, &eq, 10);
+			if (*eq != '=')
+				continue;
+			np->pages = strtoll(eq + 1, NULL, 10);
+			mapping->pages = lappend(mapping->pages, np);
+		}
+		else if (strncmp(tok, "kernelpagesize_kB=", 18) == 0)
+			mapping->pagesize = strtoll(tok + 18, NULL, 10);
+	}
+
+	return true;
+}
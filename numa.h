@@ -0,0 +1,66 @@
+/*-------------------------------------------------------------------------
+ *
+ * numa.h
+ *		Show NUMA nodes and shared memory placement on Linux
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#ifndef __NUMA_H__
+#define __NUMA_H__
+
+#include "nodes/pg_list.h"
+
+#define DIR_NODE			"/sys/devices/system/node"
+
+/*
+ * A node from /sys/devices/system/node/node<N>/{meminfo,numastat,cpulist}.
+ * The memory is in kB, and the HugePages_* and numastat counters are in
+ * pages.
+ */
+typedef struct NumaNode
+{
+	int			node;
+	const char *cpulist;		/* e.g. "0-15,32-47" */
+	int64		mem_total;
+	int64		mem_free;
+	int64		mem_used;
+	int64		file_pages;
+	int64		anon_pages;
+	int64		shmem;
+	int64		hugepages_total;
+	int64		hugepages_free;
+	int64		numa_hit;
+	int64		numa_miss;
+	int64		numa_foreign;
+	int64		interleave_hit;
+	int64		local_node;
+	int64		other_node;
+}			NumaNode;
+
+/* Pages of a mapping on a node, from an "N<node>=<pages>" of numa_maps */
+typedef struct NumaPages
+{
+	int			node;
+	int64		pages;
+}			NumaPages;
+
+/* A line of /proc/<pid>/numa_maps */
+typedef struct NumaMapping
+{
+	uint64		start;
+	char		policy[64];		/* "default", "interleave:0-1", ... */
+	int64		pagesize;		/* kB */
+	List	   *pages;			/* of NumaPages */
+}			NumaMapping;
+
+
+extern List *get_numa_nodes(List *nodes);
+extern int	numa_node_of_cpu(int cpu);
+extern bool get_numa_mapping(int pid, uint64 addr, NumaMapping * mapping);
+
+#endif
@@ -0,0 +1,181 @@
+/*-------------------------------------------------------------------------
+ *
+ * parse.h
+ *		In-place tokenizer for /proc files
+ *
+ * The collectors read a whole file into a buffer (see procfile.h) and
+ * parse it in a single pass with these functions instead of sscanf().
+ * The buffer is modified in place: the end of each line and token is
+ * overwritten with '\0', so no data is copied.
+ *
+ * This header depends only on c.h, so that the standalone benchmark in
+ * bench/ can use the same code.
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef __PARSE_H__
+#define __PARSE_H__
+
+/*
+ * Return the next line of *pp, terminated with '\0', and advance *pp to
+ * the following line.  Return NULL at the end of the buffer.
+ */
+static inline char *
+pl_next_line(char **pp)
+{
+	char	   *line = *pp;
+	char	   *p = line;
+
+	if (*line == '\0')
+		return NULL;
+
+	while (*p != '\n' && *p != '\0')
+		p++;
+
+	if (*p == '\n')
+		*p++ = '\0';
+	*pp = p;
+
+	return line;
+}
+
+static inline char *
+pl_skip_blanks(char *p)
+{
+	while (*p == ' ' || *p == '\t')
+		p++;
+	return p;
+}
+
+/*
+ * Return the next token of *pp delimited by blanks, terminated with '\0',
+ * and advance *pp past it.  Return NULL at the end of the line.
+ */
+static inline char *
+pl_next_token(char **pp)
+{
+	char	   *tok = pl_skip_blanks(*pp);
+	char	   *p = tok;
+
+	if (*tok == '\0' || *tok == '\n')
+		return NULL;
+
+	while (*p != ' ' && *p != '\t' && *p != '\n' && *p != '\0')
+		p++;
+
+	if (*p != '\0')
+		*p++ = '\0';
+	*pp = p;
+
+	return tok;
+}
+
+/*
+ * Parse a decimal integer after optional blanks, and advance *pp past it.
+ * Return false if there is no number.
+ */
+static inline bool
+pl_parse_int64(char **pp, int64 *value)
+{
+	char	   *p = pl_skip_blanks(*pp);
+	bool		neg = false;
+	uint64		v = 0;
+
+	if (*p == '-')
+	{
+		neg = true;
+		p++;
+	}
+
+	if (*p < '0' || *p > '9')
+		return false;
+
+	do
+	{
+		v = v * 10 + (uint64) (*p - '0');
+		p++;
+	} while (*p >= '0' && *p <= '9');
+
+	*value = neg ? -(int64) v : (int64) v;
+	*pp = p;
+
+	return true;
+}
+
+static inline bool
+pl_parse_int32(char **pp, int32 *value)
+{
+	int64		v;
+
+	if (!pl_parse_int64(pp, &v))
+		return false;
+
+	*value = (int32) v;
+	return true;
+}
+
+/*
+ * Parse a non-negative decimal fraction such as "0.35".
+ */
+static inline bool
+pl_parse_float4(char **pp, float4 *value)
+{
+	char	   *p = pl_skip_blanks(*pp);
+	int64		ipart;
+	double		frac = 0;
+	double		scale = 0.1;
+
+	if (!pl_parse_int64(&p, &ipart))
+		return false;
+
+	if (*p == '.')
+	{
+		for (p++; *p >= '0' && *p <= '9'; p++)
+		{
+			frac += (*p - '0') * scale;
+			scale *= 0.1;
+		}
+	}
+
+	*value = (float4) (ipart + frac);
+	*pp = p;
+
+	return true;
+}
+
+/*
+ * Skip the character c after optional blanks, such as the '/' of
+ * /proc/loadavg.
+ */
+static inline bool
+pl_expect_char(char **pp, char c)
+{
+	char	   *p = pl_skip_blanks(*pp);
+
+	if (*p != c)
+		return false;
+
+	*pp = p + 1;
+	return true;
+}
+
+/*
+ * Parse up to n integers into values[].  Return the number parsed.
+ */
+static inline int
+pl_parse_int64_array(char **pp, int64 *values, int n)
+{
+	int			i;
+
+	for (i = 0; i < n; i++)
+		if (!pl_parse_int64(pp, &values[i]))
+			break;
+
+	return i;
+}
+
+#endif
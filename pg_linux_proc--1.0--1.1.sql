@@ -0,0 +1,842 @@
+/* pg_linux_proc--1.0--1.1.sql */
+
+-- complain if script is sourced in psql, rather than via ALTER EXTENSION
+\echo Use "ALTER EXTENSION pg_linux_proc UPDATE TO '1.1'" to load this file. \quit
+
+--
+-- History functions, which read the ring buffer filled by the background
+-- sampler.  They return the samples taken after "since".
+--
+
+CREATE FUNCTION pg_proc_loadavg_history(
+       IN  since timestamptz DEFAULT '-infinity',
+       OUT ts timestamptz,
+       OUT loadavg1 real,
+       OUT loadavg5 real,
+       OUT loadavg15 real,
+       OUT current_processes int,
+       OUT total_processes int
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+CREATE FUNCTION pg_proc_diskstats_history(
+       IN  since timestamptz DEFAULT '-infinity',
+       OUT ts timestamptz,
+       OUT major int,
+       OUT minor int,
+       OUT dev_name varchar,
+       OUT rd bigint,
+       OUT rd_merged bigint,
+       OUT rd_sec bigint,
+       OUT rd_tm bigint,
+       OUT wr bigint,
+       OUT wr_merged bigint,
+       OUT wr_sec bigint,
+       OUT wr_tm bigint,
+       OUT io bigint,
+       OUT tm bigint,
+       OUT wtm bigint,
+       OUT dis bigint,
+       OUT dis_merged bigint,
+       OUT dis_sec bigint,
+       OUT dis_tm bigint,
+       OUT fl bigint,
+       OUT tm_fl bigint
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+CREATE FUNCTION pg_proc_meminfo_history(
+	IN  since timestamptz DEFAULT '-infinity',
+	OUT ts timestamptz,
+	OUT MemTotal bigint,
+	OUT MemFree bigint,
+	OUT MemAvailable bigint,
+	OUT Buffers bigint,
+	OUT Cached bigint,
+	OUT SwapCached bigint,
+	OUT Active bigint,
+	OUT Inactive bigint,
+	OUT Active_anon bigint,
+	OUT Inactive_anon bigint,
+
+	OUT Active_file bigint,
+	OUT Inactive_file bigint,
+	OUT Unevictable bigint,
+	OUT Mlocked bigint,
+	OUT SwapTotal bigint,
+	OUT SwapFree bigint,
+	OUT Dirty bigint,
+	OUT Writeback bigint,
+	OUT AnonPages bigint,
+	OUT Mapped bigint,
+
+	OUT Shmem bigint,
+	OUT KReclaimable bigint,
+	OUT Slab bigint,
+	OUT SReclaimable bigint,
+	OUT SUnreclaim bigint,
+	OUT KernelStack bigint,
+	OUT PageTables bigint,
+	OUT NFS_Unstable bigint,
+	OUT Bounce bigint,
+	OUT WritebackTmp bigint,
+
+	OUT CommitLimit bigint,
+	OUT Committed_AS bigint,
+	OUT VmallocTotal bigint,
+	OUT VmallocUsed bigint,
+	OUT VmallocChunk bigint,
+	OUT Percpu bigint,
+	OUT HardwareCorrupted bigint,
+	OUT AnonHugePages bigint,
+	OUT ShmemHugePages bigint,
+	OUT ShmemPmdMapped bigint,
+
+	OUT FileHugePages bigint,
+	OUT FilePmdMapped bigint,
+	OUT CmaTotal bigint,
+	OUT CmaFree bigint,
+	OUT HugePages_Total bigint,
+	OUT HugePages_Free bigint,
+	OUT HugePages_Rsvd bigint,
+	OUT HugePages_Surp bigint,
+	OUT Hugepagesize bigint,
+	OUT Hugetlb bigint
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+CREATE FUNCTION pg_proc_stat_history(
+       IN  since timestamptz DEFAULT '-infinity',
+       OUT ts timestamptz,
+       OUT cpu text,
+       OUT usr bigint,
+       OUT nice bigint,
+       OUT system bigint,
+       OUT idle bigint,
+       OUT iowait bigint,
+       OUT irq bigint,
+       OUT softirq bigint,
+       OUT steal bigint,
+       OUT guest bigint,
+       OUT guest_nice bigint
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+--
+-- pg_proc_stat() returns the aggregate "cpu" line and the guest fields,
+-- and its counters are bigint.
+--
+
+DROP FUNCTION pg_proc_stat();
+
+CREATE FUNCTION pg_proc_stat(
+       OUT cpu text,
+       OUT usr bigint,
+       OUT nice bigint,
+       OUT system bigint,
+       OUT idle bigint,
+       OUT iowait bigint,
+       OUT irq bigint,
+       OUT softirq bigint,
+       OUT steal bigint,
+       OUT guest bigint,
+       OUT guest_nice bigint
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+CREATE FUNCTION pg_proc_cpu_usage(
+       OUT cpu text,
+       OUT usr float8,
+       OUT nice float8,
+       OUT system float8,
+       OUT idle float8,
+       OUT iowait float8,
+       OUT irq float8,
+       OUT softirq float8,
+       OUT steal float8,
+       OUT guest float8,
+       OUT guest_nice float8,
+       OUT elapsed float8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pg_proc_cpu_usage'
+LANGUAGE C VOLATILE STRICT;
+
+
+CREATE FUNCTION pg_proc_cpu_usage(
+       IN  sample interval,
+       OUT cpu text,
+       OUT usr float8,
+       OUT nice float8,
+       OUT system float8,
+       OUT idle float8,
+       OUT iowait float8,
+       OUT irq float8,
+       OUT softirq float8,
+       OUT steal float8,
+       OUT guest float8,
+       OUT guest_nice float8,
+       OUT elapsed float8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pg_proc_cpu_usage_interval'
+LANGUAGE C VOLATILE STRICT;
+
+
+--
+-- The counters of pg_proc_diskstats() are bigint, since sectors wrap
+-- int on busy devices.
+--
+
+DROP FUNCTION pg_proc_diskstats();
+
+CREATE FUNCTION pg_proc_diskstats(
+       OUT major int,
+       OUT minor int,
+       OUT dev_name varchar,
+       OUT rd bigint,
+       OUT rd_merged bigint,
+       OUT rd_sec bigint,
+       OUT rd_tm bigint,
+       OUT wr bigint,
+       OUT wr_merged bigint,
+       OUT wr_sec bigint,
+       OUT wr_tm bigint,
+       OUT io bigint,
+       OUT tm bigint,
+       OUT wtm bigint,
+       OUT dis bigint,
+       OUT dis_merged bigint,
+       OUT dis_sec bigint,
+       OUT dis_tm bigint,
+       OUT fl bigint,
+       OUT tm_fl bigint
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+CREATE FUNCTION pg_proc_iostat(
+       IN  sample interval,
+       OUT major int,
+       OUT minor int,
+       OUT dev_name varchar,
+       OUT r_s float8,
+       OUT w_s float8,
+       OUT rkb_s float8,
+       OUT wkb_s float8,
+       OUT rrqm_s float8,
+       OUT wrqm_s float8,
+       OUT r_await float8,
+       OUT w_await float8,
+       OUT aqu_sz float8,
+       OUT util float8,
+       OUT d_s float8,
+       OUT dkb_s float8,
+       OUT d_await float8,
+       OUT f_s float8,
+       OUT f_await float8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+CREATE FUNCTION pg_proc_backends(
+       OUT pid int,
+       OUT backend_type text,
+       OUT query_id bigint,
+       OUT state text,
+       OUT processor int,
+       OUT utime float8,
+       OUT stime float8,
+       OUT rss bigint,
+       OUT rss_anon bigint,
+       OUT rss_file bigint,
+       OUT rss_shmem bigint,
+       OUT voluntary_ctxt_switches bigint,
+       OUT nonvoluntary_ctxt_switches bigint,
+       OUT read_bytes bigint,
+       OUT write_bytes bigint
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+--
+-- pg_proc_pid() can be limited to the postmaster and its descendants.
+--
+
+DROP FUNCTION pg_proc_pid();
+
+CREATE FUNCTION pg_proc_pid(
+       IN  postgres_only boolean DEFAULT false,
+       OUT pid int,
+       OUT cmdline text
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+--
+-- /proc/meminfo lines that pg_proc_meminfo() has no column for.
+--
+
+CREATE FUNCTION pg_proc_meminfo_extra(
+       OUT key text,
+       OUT value bigint,
+       OUT unit text
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+--
+-- Stream a file under /proc line by line.
+--
+
+CREATE FUNCTION pg_proc_lines(
+       IN  t text
+)
+RETURNS SETOF text
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+--
+-- Memory usage from /proc/<pid>/smaps_rollup.
+--
+
+CREATE FUNCTION pg_proc_backend_memory(
+       OUT pid int,
+       OUT backend_type text,
+       OUT rss bigint,
+       OUT pss bigint,
+       OUT pss_anon bigint,
+       OUT pss_file bigint,
+       OUT pss_shmem bigint,
+       OUT shared_clean bigint,
+       OUT shared_dirty bigint,
+       OUT private_clean bigint,
+       OUT private_dirty bigint,
+       OUT swap bigint,
+       OUT swap_pss bigint,
+       OUT anon_huge_pages bigint
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+CREATE FUNCTION pg_proc_cluster_memory(
+       OUT processes int,
+       OUT pss bigint,
+       OUT pss_anon bigint,
+       OUT pss_file bigint,
+       OUT pss_shmem bigint,
+       OUT private_clean bigint,
+       OUT private_dirty bigint,
+       OUT swap_pss bigint,
+       OUT anon_huge_pages bigint
+)
+RETURNS record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+--
+-- Pressure Stall Information.
+--
+
+CREATE FUNCTION pg_proc_pressure(
+       OUT resource text,
+       OUT kind text,
+       OUT avg10 real,
+       OUT avg60 real,
+       OUT avg300 real,
+       OUT total bigint
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+CREATE FUNCTION pg_proc_pressure_wait(
+       IN  resource text,
+       IN  threshold_us bigint,
+       IN  window_us bigint,
+       IN  timeout interval,
+       IN  kind text DEFAULT 'some'
+)
+RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+--
+-- cgroup v2 statistics of the cgroup the server runs in.
+--
+
+CREATE FUNCTION pg_proc_cgroup_path()
+RETURNS text
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+CREATE FUNCTION pg_proc_cgroup_cpu(
+       OUT usage_usec bigint,
+       OUT user_usec bigint,
+       OUT system_usec bigint,
+       OUT nr_periods bigint,
+       OUT nr_throttled bigint,
+       OUT throttled_usec bigint,
+       OUT quota_usec bigint,
+       OUT period_usec bigint,
+       OUT cpu_limit float8
+)
+RETURNS record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+CREATE FUNCTION pg_proc_cgroup_cpu_usage(
+       IN  sample interval,
+       OUT cpus float8,
+       OUT user_cpus float8,
+       OUT system_cpus float8,
+       OUT cpu_limit float8,
+       OUT limit_pct float8,
+       OUT throttled_pct float8,
+       OUT throttled_ms_per_sec float8,
+       OUT elapsed float8
+)
+RETURNS record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+CREATE FUNCTION pg_proc_cgroup_memory(
+       OUT current bigint,
+       OUT max bigint,
+       OUT available bigint,
+       OUT anon bigint,
+       OUT file bigint,
+       OUT inactive_file bigint,
+       OUT events_low bigint,
+       OUT events_high bigint,
+       OUT events_max bigint,
+       OUT events_oom bigint,
+       OUT events_oom_kill bigint
+)
+RETURNS record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+CREATE FUNCTION pg_proc_cgroup_memory_stat(
+       OUT key text,
+       OUT value bigint
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+CREATE FUNCTION pg_proc_cgroup_io_stat(
+       OUT major int,
+       OUT minor int,
+       OUT rbytes bigint,
+       OUT wbytes bigint,
+       OUT rios bigint,
+       OUT wios bigint,
+       OUT dbytes bigint,
+       OUT dios bigint
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+CREATE FUNCTION pg_proc_cgroup_iostat(
+       IN  sample interval,
+       OUT major int,
+       OUT minor int,
+       OUT r_s float8,
+       OUT w_s float8,
+       OUT rkb_s float8,
+       OUT wkb_s float8,
+       OUT d_s float8,
+       OUT dkb_s float8,
+       OUT elapsed float8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+CREATE FUNCTION pg_proc_cgroup_pressure(
+       OUT resource text,
+       OUT kind text,
+       OUT avg10 real,
+       OUT avg60 real,
+       OUT avg300 real,
+       OUT total bigint
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+--
+-- Network interface and protocol counters of the server's network namespace.
+--
+
+CREATE FUNCTION pg_proc_netdev(
+       OUT name text,
+       OUT rx_bytes bigint,
+       OUT rx_packets bigint,
+       OUT rx_errs bigint,
+       OUT rx_drop bigint,
+       OUT rx_fifo bigint,
+       OUT rx_frame bigint,
+       OUT rx_compressed bigint,
+       OUT rx_multicast bigint,
+       OUT tx_bytes bigint,
+       OUT tx_packets bigint,
+       OUT tx_errs bigint,
+       OUT tx_drop bigint,
+       OUT tx_fifo bigint,
+       OUT tx_colls bigint,
+       OUT tx_carrier bigint,
+       OUT tx_compressed bigint
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+CREATE FUNCTION pg_proc_netdev_rate(
+       IN  sample interval,
+       OUT name text,
+       OUT rx_kb_s float8,
+       OUT tx_kb_s float8,
+       OUT rx_packets_s float8,
+       OUT tx_packets_s float8,
+       OUT rx_errs_s float8,
+       OUT tx_errs_s float8,
+       OUT rx_drop_s float8,
+       OUT tx_drop_s float8,
+       OUT elapsed float8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+CREATE FUNCTION pg_proc_netsnmp(
+       OUT protocol text,
+       OUT name text,
+       OUT value bigint
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+CREATE FUNCTION pg_proc_netsnmp_rate(
+       IN  sample interval,
+       OUT ip_in_receives_s float8,
+       OUT ip_out_requests_s float8,
+       OUT ip_in_discards_s float8,
+       OUT ip_out_discards_s float8,
+       OUT tcp_active_opens_s float8,
+       OUT tcp_passive_opens_s float8,
+       OUT tcp_attempt_fails_s float8,
+       OUT tcp_estab_resets_s float8,
+       OUT tcp_curr_estab bigint,
+       OUT tcp_in_segs_s float8,
+       OUT tcp_out_segs_s float8,
+       OUT tcp_retrans_segs_s float8,
+       OUT tcp_retrans_pct float8,
+       OUT tcp_in_errs_s float8,
+       OUT tcp_out_rsts_s float8,
+       OUT udp_in_datagrams_s float8,
+       OUT udp_out_datagrams_s float8,
+       OUT udp_in_errors_s float8,
+       OUT udp_rcvbuf_errors_s float8,
+       OUT udp_sndbuf_errors_s float8,
+       OUT elapsed float8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+--
+-- TCP sockets of the backends.
+--
+
+CREATE FUNCTION pg_proc_backend_sockets(
+       OUT pid int,
+       OUT fd int,
+       OUT local_addr inet,
+       OUT local_port int,
+       OUT remote_addr inet,
+       OUT remote_port int,
+       OUT state text,
+       OUT send_queue bigint,
+       OUT recv_queue bigint,
+       OUT retransmits int,
+       OUT total_retrans bigint,
+       OUT unacked bigint,
+       OUT snd_cwnd bigint,
+       OUT rtt_ms float8,
+       OUT rttvar_ms float8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+--
+-- Virtual memory counters.
+--
+
+CREATE FUNCTION pg_proc_vmstat(
+       OUT name text,
+       OUT value bigint
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+CREATE FUNCTION pg_proc_vmstat_rate(
+       IN  sample interval,
+       OUT name text,
+       OUT delta bigint,
+       OUT rate float8,
+       OUT elapsed float8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+--
+-- NUMA nodes, shared memory placement and process affinity.
+--
+
+CREATE FUNCTION pg_proc_numa_nodes(
+       OUT node int,
+       OUT cpulist text,
+       OUT mem_total bigint,
+       OUT mem_free bigint,
+       OUT mem_used bigint,
+       OUT file_pages bigint,
+       OUT anon_pages bigint,
+       OUT shmem bigint,
+       OUT hugepages_total bigint,
+       OUT hugepages_free bigint,
+       OUT numa_hit bigint,
+       OUT numa_miss bigint,
+       OUT numa_foreign bigint,
+       OUT interleave_hit bigint,
+       OUT local_node bigint,
+       OUT other_node bigint
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+CREATE FUNCTION pg_proc_shmem_numa(
+       IN  pid int DEFAULT 0,
+       OUT node int,
+       OUT pages bigint,
+       OUT size bigint,
+       OUT percent float8,
+       OUT policy text
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+CREATE FUNCTION pg_proc_backend_affinity(
+       OUT pid int,
+       OUT backend_type text,
+       OUT processor int,
+       OUT node int,
+       OUT cpus_allowed_list text,
+       OUT mems_allowed_list text
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+--
+-- OS resource usage per query.
+--
+
+CREATE FUNCTION pg_proc_statements(
+       OUT userid oid,
+       OUT dbid oid,
+       OUT queryid bigint,
+       OUT calls bigint,
+       OUT user_time float8,
+       OUT system_time float8,
+       OUT minflt bigint,
+       OUT majflt bigint,
+       OUT nvcsw bigint,
+       OUT nivcsw bigint,
+       OUT rchar bigint,
+       OUT wchar bigint,
+       OUT read_bytes bigint,
+       OUT write_bytes bigint
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+CREATE FUNCTION pg_proc_statements_info(
+       OUT entries bigint,
+       OUT dropped bigint,
+       OUT stats_reset timestamptz
+)
+RETURNS record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+CREATE FUNCTION pg_proc_statements_reset()
+RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+REVOKE ALL ON FUNCTION pg_proc_statements_reset() FROM PUBLIC;
+
+
+--
+-- Active session history, filled by the ash sampler.  run_delay_ms and
+-- cpu_ms cover the time since the previous sample of the backend.
+--
+
+CREATE FUNCTION pg_proc_ash(
+       IN  since timestamptz DEFAULT '-infinity',
+       OUT ts timestamptz,
+       OUT pid int,
+       OUT backend_type text,
+       OUT state text,
+       OUT processor int,
+       OUT wait_event_type text,
+       OUT wait_event text,
+       OUT query_id bigint,
+       OUT wchan text,
+       OUT run_delay_ms float8,
+       OUT cpu_ms float8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+--
+-- Top processes over an interval, ordered by 'cpu', 'io' or 'rss' growth.
+--
+
+CREATE FUNCTION pg_proc_top(
+       IN  sample interval DEFAULT '1 second',
+       IN  n int DEFAULT 10,
+       IN  order_by text DEFAULT 'cpu',
+       OUT pid int,
+       OUT ppid int,
+       OUT postgres boolean,
+       OUT state text,
+       OUT comm text,
+       OUT cmdline text,
+       OUT cpu float8,
+       OUT read_bytes_per_sec float8,
+       OUT write_bytes_per_sec float8,
+       OUT rss bigint,
+       OUT rss_delta bigint,
+       OUT elapsed float8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+--
+-- Samples of the on-disk store taken in (since, until].  source is one of
+-- 'loadavg', 'meminfo', 'stat' and 'diskstats'.
+--
+
+CREATE FUNCTION pg_proc_history(
+       IN  source text,
+       IN  since timestamptz DEFAULT '-infinity',
+       IN  until timestamptz DEFAULT 'infinity',
+       OUT ts timestamptz,
+       OUT item text,
+       OUT metric text,
+       OUT value float8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+--
+-- Rollups of the on-disk store in (since, until] at the coarsest tier not
+-- coarser than resolution: min, max, avg and last of the rate per second of
+-- each counter, or of the value of each gauge, per bucket.
+--
+
+CREATE FUNCTION pg_proc_history_rollup(
+       IN  source text,
+       IN  resolution interval,
+       IN  since timestamptz DEFAULT '-infinity',
+       IN  until timestamptz DEFAULT 'infinity',
+       OUT ts timestamptz,
+       OUT item text,
+       OUT metric text,
+       OUT min float8,
+       OUT max float8,
+       OUT avg float8,
+       OUT last float8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+
+--
+-- Quantiles of a metric of the on-disk store, named "source.metric", over
+-- the rollup buckets overlapping (since, until], from their sketches.
+--
+
+CREATE FUNCTION pg_proc_percentiles(
+       IN  metric text,
+       IN  since timestamptz,
+       IN  until timestamptz,
+       IN  quantiles float8[] DEFAULT '{0.5,0.9,0.99,0.999}',
+       OUT item text,
+       OUT quantile float8,
+       OUT value float8,
+       OUT samples int8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
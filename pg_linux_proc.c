@@ -10,41 +10,144 @@
  */
 #include "postgres.h"
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include "nodes/pg_list.h"
+#include "lib/stringinfo.h"
 #include "utils/builtins.h"
 #include "funcapi.h"
 #include "tcop/utility.h"
 #include "pgstat.h"
-
+#include "miscadmin.h"
+#include "portability/instr_time.h"
+#include "postmaster/bgworker.h"
+#include "catalog/pg_authid.h"
+#include "storage/bufmgr.h"
+#include "storage/fd.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/proc.h"
+#include "storage/procarray.h"
+#include "utils/acl.h"
+#include "utils/backend_status.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+
+#include "pg_linux_proc.h"
 #include "loadavg.h"
 #include "diskstats.h"
 #include "meminfo.h"
 #include "stat.h"
 #include "pid.h"
+#include "sampler.h"
+#include "parse.h"
+#include "procfile.h"
+#include "snapcache.h"
+#include "statements.h"
+#include "vmstat.h"
+#include "net.h"
+#include "sockets.h"
+#include "numa.h"
+#include "pressure.h"
+#include "cgroup.h"
+#include "ash.h"
+#include "store.h"
+#include "exporter.h"
+#include "sink.h"
 
 
 
 PG_MODULE_MAGIC;
 
+/* GUC variables */
+int			proc_max_devices = 64;
+
+/* Saved hook values in case of unload */
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
 /* Function declarations */
 void		_PG_init(void);
 void		_PG_fini(void);
 
+static void pg_linux_proc_shmem_request(void);
+static void pg_linux_proc_shmem_startup(void);
+
 Datum		pg_proc(PG_FUNCTION_ARGS);
+Datum		pg_proc_lines(PG_FUNCTION_ARGS);
 Datum		pg_proc_pid(PG_FUNCTION_ARGS);
+Datum		pg_proc_top(PG_FUNCTION_ARGS);
+Datum		pg_proc_backends(PG_FUNCTION_ARGS);
+Datum		pg_proc_backend_memory(PG_FUNCTION_ARGS);
+Datum		pg_proc_cluster_memory(PG_FUNCTION_ARGS);
+Datum		pg_proc_backend_sockets(PG_FUNCTION_ARGS);
+Datum		pg_proc_numa_nodes(PG_FUNCTION_ARGS);
+Datum		pg_proc_shmem_numa(PG_FUNCTION_ARGS);
+Datum		pg_proc_backend_affinity(PG_FUNCTION_ARGS);
 Datum		pg_os_version(PG_FUNCTION_ARGS);
 Datum		pg_proc_loadavg(PG_FUNCTION_ARGS);
 Datum		pg_proc_diskstats(PG_FUNCTION_ARGS);
+Datum		pg_proc_iostat(PG_FUNCTION_ARGS);
 Datum		pg_proc_meminfo(PG_FUNCTION_ARGS);
+Datum		pg_proc_meminfo_extra(PG_FUNCTION_ARGS);
 Datum		pg_proc_stat(PG_FUNCTION_ARGS);
+Datum		pg_proc_cpu_usage(PG_FUNCTION_ARGS);
+Datum		pg_proc_cpu_usage_interval(PG_FUNCTION_ARGS);
+Datum		pg_proc_vmstat(PG_FUNCTION_ARGS);
+Datum		pg_proc_vmstat_rate(PG_FUNCTION_ARGS);
+Datum		pg_proc_netdev(PG_FUNCTION_ARGS);
+Datum		pg_proc_netdev_rate(PG_FUNCTION_ARGS);
+Datum		pg_proc_netsnmp(PG_FUNCTION_ARGS);
+Datum		pg_proc_netsnmp_rate(PG_FUNCTION_ARGS);
+Datum		pg_proc_pressure(PG_FUNCTION_ARGS);
+Datum		pg_proc_pressure_wait(PG_FUNCTION_ARGS);
+Datum		pg_proc_cgroup_path(PG_FUNCTION_ARGS);
+Datum		pg_proc_cgroup_cpu(PG_FUNCTION_ARGS);
+Datum		pg_proc_cgroup_cpu_usage(PG_FUNCTION_ARGS);
+Datum		pg_proc_cgroup_memory(PG_FUNCTION_ARGS);
+Datum		pg_proc_cgroup_memory_stat(PG_FUNCTION_ARGS);
+Datum		pg_proc_cgroup_io_stat(PG_FUNCTION_ARGS);
+Datum		pg_proc_cgroup_iostat(PG_FUNCTION_ARGS);
+Datum		pg_proc_cgroup_pressure(PG_FUNCTION_ARGS);
 
 PG_FUNCTION_INFO_V1(pg_proc);
+PG_FUNCTION_INFO_V1(pg_proc_lines);
 PG_FUNCTION_INFO_V1(pg_proc_pid);
+PG_FUNCTION_INFO_V1(pg_proc_top);
+PG_FUNCTION_INFO_V1(pg_proc_backends);
+PG_FUNCTION_INFO_V1(pg_proc_backend_memory);
+PG_FUNCTION_INFO_V1(pg_proc_cluster_memory);
+PG_FUNCTION_INFO_V1(pg_proc_backend_sockets);
+PG_FUNCTION_INFO_V1(pg_proc_numa_nodes);
+PG_FUNCTION_INFO_V1(pg_proc_shmem_numa);
+PG_FUNCTION_INFO_V1(pg_proc_backend_affinity);
 PG_FUNCTION_INFO_V1(pg_os_version);
 PG_FUNCTION_INFO_V1(pg_proc_loadavg);
 PG_FUNCTION_INFO_V1(pg_proc_diskstats);
+PG_FUNCTION_INFO_V1(pg_proc_iostat);
 PG_FUNCTION_INFO_V1(pg_proc_meminfo);
+PG_FUNCTION_INFO_V1(pg_proc_meminfo_extra);
 PG_FUNCTION_INFO_V1(pg_proc_stat);
+PG_FUNCTION_INFO_V1(pg_proc_cpu_usage);
+PG_FUNCTION_INFO_V1(pg_proc_cpu_usage_interval);
+PG_FUNCTION_INFO_V1(pg_proc_vmstat);
+PG_FUNCTION_INFO_V1(pg_proc_vmstat_rate);
+PG_FUNCTION_INFO_V1(pg_proc_netdev);
+PG_FUNCTION_INFO_V1(pg_proc_netdev_rate);
+PG_FUNCTION_INFO_V1(pg_proc_netsnmp);
+PG_FUNCTION_INFO_V1(pg_proc_netsnmp_rate);
+PG_FUNCTION_INFO_V1(pg_proc_pressure);
+PG_FUNCTION_INFO_V1(pg_proc_pressure_wait);
+PG_FUNCTION_INFO_V1(pg_proc_cgroup_path);
+PG_FUNCTION_INFO_V1(pg_proc_cgroup_cpu);
+PG_FUNCTION_INFO_V1(pg_proc_cgroup_cpu_usage);
+PG_FUNCTION_INFO_V1(pg_proc_cgroup_memory);
+PG_FUNCTION_INFO_V1(pg_proc_cgroup_memory_stat);
+PG_FUNCTION_INFO_V1(pg_proc_cgroup_io_stat);
+PG_FUNCTION_INFO_V1(pg_proc_cgroup_iostat);
+PG_FUNCTION_INFO_V1(pg_proc_cgroup_pressure);
 
 
 /* Module callback */
@@ -54,7 +157,40 @@ _PG_init(void)
 	if (!process_shared_preload_libraries_in_progress)
 		return;
 
+	DefineCustomIntVariable("pg_linux_proc.max_devices",
+							"Sets the maximum number of block devices kept in shared memory.",
+							NULL,
+							&proc_max_devices,
+							64,
+							0,
+							65536,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	sampler_define_gucs();
+	snapcache_define_gucs();
+	statements_define_gucs();
+	ash_define_gucs();
+	store_define_gucs();
+	exporter_define_gucs();
+	sink_define_gucs();
+
 	EmitWarningsOnPlaceholders("pg_linux_proc");
+
+	sampler_register_worker();
+	ash_register_worker();
+	exporter_register_worker();
+	sink_register_worker();
+	statements_install_hooks();
+
+	/* Install hooks. */
+	prev_shmem_request_hook = shmem_request_hook;
+	shmem_request_hook = pg_linux_proc_shmem_request;
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = pg_linux_proc_shmem_startup;
 }
 
 void
@@ -64,22 +200,116 @@ _PG_fini(void)
 }
 
 /*
- * Display information for specified file under /proc.
+ * Return the number of cpu lines of /proc/stat to be kept in shared
+ * memory: the aggregate "cpu" line and one line per configured CPU.
  */
+int
+proc_max_cpus(void)
+{
+	long		ncpus = sysconf(_SC_NPROCESSORS_CONF);
 
-Datum
-pg_proc(PG_FUNCTION_ARGS)
+	return (ncpus > 0) ? (int) ncpus + 1 : 2;
+}
+
+/*
+ * Request additional shared resources.
+ */
+static void
+pg_linux_proc_shmem_request(void)
+{
+	if (prev_shmem_request_hook)
+		prev_shmem_request_hook();
+
+	sampler_shmem_request();
+	snapcache_shmem_request();
+	statements_shmem_request();
+	ash_shmem_request();
+	sink_shmem_request();
+}
+
+/*
+ * Allocate or attach to shared memory.
+ */
+static void
+pg_linux_proc_shmem_startup(void)
+{
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	sampler_shmem_startup();
+	snapcache_shmem_startup();
+	statements_shmem_startup();
+	ash_shmem_startup();
+	sink_shmem_startup();
+}
+
+/*
+ * Convert a wait interval to milliseconds, checking that it is between
+ * 1 millisecond and MAX_WAIT_INTERVAL_MS.
+ */
+int64
+interval_to_wait_ms(Interval *span)
+{
+	int64		total_ms;
+
+	total_ms = (span->time / 1000) +
+		((int64) span->day * SECS_PER_DAY * 1000) +
+		((int64) span->month * DAYS_PER_MONTH * SECS_PER_DAY * 1000);
+
+	if (total_ms <= 0 || total_ms > MAX_WAIT_INTERVAL_MS)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("interval must be between 1 millisecond and %d seconds",
+						MAX_WAIT_INTERVAL_MS / 1000)));
+
+	return total_ms;
+}
+
+/*
+ * Sleep for the specified interval, which is typically the sampling window
+ * of the rate functions.  The sleep can be canceled.
+ */
+void
+wait_for_interval(Interval *span)
 {
-	text	   *t = PG_GETARG_TEXT_PP(0);
+	instr_time	start;
+	int64		total_ms = interval_to_wait_ms(span);
+
+	INSTR_TIME_SET_CURRENT(start);
+
+	for (;;)
+	{
+		instr_time	now;
+		int64		elapsed_ms;
+
+		CHECK_FOR_INTERRUPTS();
+
+		INSTR_TIME_SET_CURRENT(now);
+		INSTR_TIME_SUBTRACT(now, start);
+		elapsed_ms = (int64) INSTR_TIME_GET_MILLISEC(now);
+
+		if (elapsed_ms >= total_ms)
+			break;
+
+		(void) WaitLatch(MyLatch,
+						 WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+						 (long) (total_ms - elapsed_ms),
+						 PG_WAIT_EXTENSION);
+		ResetLatch(MyLatch);
+	}
+}
+
+/*
+ * Build the path of the file under /proc specified by t into file, which
+ * must have room for PROC_PATH_MAX bytes.
+ */
+
+#define PROC_PATH_MAX	(64 + 7)
 
+static void
+proc_file_path(text *t, char *file)
+{
 	int			i;
-	char		file[64 + 7];
-	FILE	   *fp = NULL;
-	char		buffer[1024];
-	List	   *procinfo = NIL;
-	ListCell   *lc;
-	int			length = 0;
-	char	   *ret;
 	char	   *input = VARDATA_ANY(t);
 	int			input_len = VARSIZE_ANY_EXHDR(t);
 
@@ -89,50 +319,215 @@ pg_proc(PG_FUNCTION_ARGS)
 			elog(ERROR, "Input has \'.\', but relative path cannot be set.");
 
 	if (input_len > 64)
-		elog(ERROR, "Input sentence \'%s\' is too long. Less than 64.", input);
+		elog(ERROR, "Input sentence \'%s\' is too long. Less than 64.",
+			 text_to_cstring(t));
 
-	sprintf(file, "/proc/%s", input);
+	memcpy(file, "/proc/", 6);
+	memcpy(file + 6, input, input_len);
 	file[input_len + 6] = '\0';
+}
+
+/*
+ * Display information for specified file under /proc.
+ *
+ * The file is read with read() into one StringInfo that grows as needed.
+ * Room for the varlena header is reserved at its head, so the buffer is
+ * returned as the text value without copying.
+ */
+
+Datum
+pg_proc(PG_FUNCTION_ARGS)
+{
+	char		file[PROC_PATH_MAX];
+	StringInfoData buf;
+	int			fd;
+
+	proc_file_path(PG_GETARG_TEXT_PP(0), file);
+
+	if ((fd = OpenTransientFile(file, O_RDONLY)) < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m", file)));
 
-	/* Check file open */
-	if ((fp = fopen(file, "r")) == NULL)
-		elog(ERROR, "Can't open %s", file);
+	initStringInfo(&buf);
+	buf.len = VARHDRSZ;
 
-	/* Copy all outputs to the List procinfo. */
-	while (fgets(buffer, sizeof(buffer) - 1, fp) != NULL)
+	for (;;)
 	{
-		char	   *l = palloc0(sizeof(buffer));
+		ssize_t		n;
+
+		/* Files under /proc report size 0, so read until EOF. */
+		if (buf.maxlen - buf.len - 1 < BLCKSZ)
+			enlargeStringInfo(&buf, BLCKSZ);
+
+		n = read(fd, buf.data + buf.len, buf.maxlen - buf.len - 1);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not read file \"%s\": %m", file)));
+		}
+		if (n == 0)
+			break;
+		buf.len += n;
+	}
+
+	CloseTransientFile(fd);
+
+	SET_VARSIZE(buf.data, buf.len);
+	PG_RETURN_TEXT_P((text *) buf.data);
+}
+
+/*
+ * Show the file under /proc specified by t line by line.
+ *
+ * Unlike pg_proc(), the file is never held in memory as a whole: each
+ * call reads into a single buffer, which grows only for a line longer
+ * than it, and returns the next line without its newline.  This suits
+ * large files such as /proc/<pid>/smaps.
+ */
+
+#define PROC_LINES_BUFSIZE	8192
+
+typedef struct ProcLinesState
+{
+	int			fd;				/* -1 once closed */
+	char	   *buf;
+	size_t		bufsize;
+	size_t		start;			/* of the next line in buf */
+	size_t		end;			/* of the data in buf */
+	bool		eof;
+	char		file[PROC_PATH_MAX];
+}			ProcLinesState;
+
+static void
+proc_lines_close(Datum arg)
+{
+	ProcLinesState *state = (ProcLinesState *) DatumGetPointer(arg);
 
-		memcpy(l, buffer, sizeof(buffer));
-		procinfo = lappend(procinfo, l);
+	if (state->fd >= 0)
+	{
+		CloseTransientFile(state->fd);
+		state->fd = -1;
 	}
+}
 
-	fclose(fp);
+/*
+ * Return the next line and its length, or NULL at the end of the file.
+ */
+static char *
+proc_lines_next(ProcLinesState * state, size_t *len)
+{
+	for (;;)
+	{
+		char	   *line = state->buf + state->start;
+		size_t		avail = state->end - state->start;
+		char	   *nl = memchr(line, '\n', avail);
+		ssize_t		n;
+
+		if (nl != NULL)
+		{
+			*len = nl - line;
+			state->start += *len + 1;
+			return line;
+		}
+
+		if (state->eof)
+		{
+			/* last line without a newline */
+			if (avail == 0)
+				return NULL;
+			*len = avail;
+			state->start = state->end;
+			return line;
+		}
+
+		/* Move the partial line to the head, and grow if it fills up. */
+		if (state->start > 0)
+		{
+			memmove(state->buf, line, avail);
+			state->start = 0;
+			state->end = avail;
+		}
+		if (state->end == state->bufsize)
+		{
+			state->bufsize *= 2;
+			state->buf = repalloc(state->buf, state->bufsize);
+		}
+
+		n = read(state->fd, state->buf + state->end,
+				 state->bufsize - state->end);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not read file \"%s\": %m", state->file)));
+		}
+		if (n == 0)
+			state->eof = true;
+		state->end += n;
+	}
+}
 
-	/* Count output length. */
-	foreach(lc, procinfo)
-		length += strlen((char *) lfirst(lc));
+Datum
+pg_proc_lines(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	FuncCallContext *funcctx;
+	ProcLinesState *state;
+	char	   *line;
+	size_t		len;
 
-	/* Copy from each element of the list to the ret data area sequentially. */
-	ret = (char *) palloc0(length);
-	length = 0;
-	foreach(lc, procinfo)
+	if (SRF_IS_FIRSTCALL())
 	{
-		char	   *l = (char *) lfirst(lc);
-		int			len = strlen(l);
+		MemoryContext oldcontext;
 
-		memcpy(ret + length, l, len);
-		length += len;
+		funcctx = SRF_FIRSTCALL_INIT();
+		oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
 
+		state = (ProcLinesState *) palloc0(sizeof(ProcLinesState));
+		proc_file_path(PG_GETARG_TEXT_PP(0), state->file);
+
+		if ((state->fd = OpenTransientFile(state->file, O_RDONLY)) < 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not open file \"%s\": %m", state->file)));
+
+		state->bufsize = PROC_LINES_BUFSIZE;
+		state->buf = palloc(state->bufsize);
+
+		/* Close the file even if the scan is stopped early, e.g. by LIMIT. */
+		if (rsinfo && IsA(rsinfo, ReturnSetInfo) && rsinfo->econtext)
+			RegisterExprContextCallback(rsinfo->econtext, proc_lines_close,
+										PointerGetDatum(state));
+
+		funcctx->user_fctx = state;
+		MemoryContextSwitchTo(oldcontext);
 	}
-	ret[length] = '\0';
 
-	PG_RETURN_TEXT_P(cstring_to_text(ret));
+	funcctx = SRF_PERCALL_SETUP();
+	state = (ProcLinesState *) funcctx->user_fctx;
 
+	if ((line = proc_lines_next(state, &len)) != NULL)
+		SRF_RETURN_NEXT(funcctx, PointerGetDatum(cstring_to_text_with_len(line, len)));
+
+	/* state goes away with multi_call_memory_ctx; forget the callback. */
+	proc_lines_close(PointerGetDatum(state));
+	if (rsinfo && IsA(rsinfo, ReturnSetInfo) && rsinfo->econtext)
+		UnregisterExprContextCallback(rsinfo->econtext, proc_lines_close,
+									  PointerGetDatum(state));
+	SRF_RETURN_DONE(funcctx);
 }
 
 /*
  * Show running process IDs (PIDs) and their names.
+ *
+ * If postgres_only is true, only the postmaster and its descendants are
+ * shown.  The argument is missing in the 1.0 definition.
  */
 
 #define NUM_PID_COLS 2
@@ -149,6 +544,7 @@ pg_proc_pid(PG_FUNCTION_ARGS)
 	bool		nulls[NUM_PID_COLS];
 	List	   *pids = NIL;
 	ListCell   *lc;
+	bool		postgres_only = (PG_NARGS() > 0) ? PG_GETARG_BOOL(0) : false;
 
 	/* check to see if caller supports us returning a tuplestore */
 	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
@@ -177,7 +573,7 @@ pg_proc_pid(PG_FUNCTION_ARGS)
 
 	MemoryContextSwitchTo(oldcontext);
 
-	pids = get_proc_pid(pids);
+	pids = get_proc_pid(pids, postgres_only);
 
 	foreach(lc, pids)
 	{
@@ -188,10 +584,11 @@ pg_proc_pid(PG_FUNCTION_ARGS)
 		memset(nulls, false, sizeof(nulls));
 
 		i = 0;
-		values[i++] = Int64GetDatum(ps->pid);
+		values[i++] = Int32GetDatum(ps->pid);
 		values[i++] = CStringGetTextDatum(ps->cmdline);
 		Assert(i == NUM_PID_COLS);
 		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+		pfree(ps->cmdline);
 		pfree(ps);
 	}
 
@@ -200,328 +597,838 @@ pg_proc_pid(PG_FUNCTION_ARGS)
 
 
 /*
- * Display OS type and verion.
+ * Show the top n processes by cpu, I/O or RSS growth, like top(1).
+ *
+ * /proc/<pid>/stat and io of every process are read twice, separated by
+ * the specified interval.  read and write are the bytes per second that
+ * went to the storage, NULL if /proc/<pid>/io is not readable.
  */
-#define FILE_OS_TYPE		"/proc/sys/kernel/ostype"
-#define FILE_OS_VERSION		"/proc/sys/kernel/osrelease"
+
+#define NUM_TOP_COLS 12
 
 Datum
-pg_os_version(PG_FUNCTION_ARGS)
+pg_proc_top(PG_FUNCTION_ARGS)
 {
-	TupleDesc	tupdesc;
-	HeapTuple	tuple;
-	int			fd;
-	char		buffer[64];
-	int			nbytes;
-	Datum		values[2];
-	bool		nulls[2];
-
-	/* Build a tuple descriptor for our result type */
-	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
-		elog(ERROR, "return type must be a row type");
-
-	memset(nulls, 0, sizeof(nulls));
-	memset(values, 0, sizeof(values));
-
-	/*
-	 * Get os type
-	 */
-	if ((fd = open(FILE_OS_TYPE, O_RDONLY)) < 0)
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Interval   *span = PG_GETARG_INTERVAL_P(0);
+	int			n = PG_GETARG_INT32(1);
+	char	   *order_by = text_to_cstring(PG_GETARG_TEXT_PP(2));
+	PidTopOrder order;
+	HTAB	   *prev;
+	List	   *tops;
+	ListCell   *lc;
+	instr_time	start;
+	instr_time	elapsed;
+
+	if (strcmp(order_by, "cpu") == 0)
+		order = PID_TOP_CPU;
+	else if (strcmp(order_by, "io") == 0)
+		order = PID_TOP_IO;
+	else if (strcmp(order_by, "rss") == 0)
+		order = PID_TOP_RSS;
+	else
 		ereport(ERROR,
-				(errcode_for_file_access(),
-				 errmsg("could not open file \"%s\": ", FILE_OS_TYPE)));
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("invalid order: \"%s\"", order_by),
+				 errhint("Valid orders are \"cpu\", \"io\" and \"rss\".")));
 
-	if ((nbytes = read(fd, buffer, sizeof(buffer) - 1)) < 0)
-	{
-		close(fd);
+	if (n <= 0)
 		ereport(ERROR,
-				(errcode_for_file_access(),
-				 errmsg("could not read file \"%s\": ", FILE_OS_TYPE)));
-	}
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("number of processes must be greater than zero")));
 
-	close(fd);
-	buffer[nbytes] = '\0';
+	InitMaterializedSRF(fcinfo, 0);
 
-	if (sscanf(buffer, "%s", buffer) < 1)
-		ereport(ERROR,
-				(errcode(ERRCODE_DATA_EXCEPTION),
-				 errmsg("unexpected file format: \"%s\"", FILE_OS_TYPE),
-				 errdetail("number of fields is not corresponding")));
+	INSTR_TIME_SET_CURRENT(start);
+	prev = get_pid_top_snapshot();
 
-	values[0] = CStringGetTextDatum(buffer);
+	wait_for_interval(span);
 
-	/*
-	 * Get os version
-	 */
-	if ((fd = open(FILE_OS_VERSION, O_RDONLY)) < 0)
-		ereport(ERROR,
-				(errcode_for_file_access(),
-				 errmsg("could not open file \"%s\": ", FILE_OS_VERSION)));
+	INSTR_TIME_SET_CURRENT(elapsed);
+	INSTR_TIME_SUBTRACT(elapsed, start);
+	tops = get_pid_top(prev, INSTR_TIME_GET_DOUBLE(elapsed), order, n);
+	hash_destroy(prev);
 
-	if ((nbytes = read(fd, buffer, sizeof(buffer) - 1)) < 0)
+	foreach(lc, tops)
 	{
-		close(fd);
-		ereport(ERROR,
-				(errcode_for_file_access(),
-				 errmsg("could not read file \"%s\": ", FILE_OS_VERSION)));
-	}
-
-	close(fd);
-	buffer[nbytes] = '\0';
-
-	if (sscanf(buffer, "%s", buffer) < 1)
-		ereport(ERROR,
-				(errcode(ERRCODE_DATA_EXCEPTION),
-				 errmsg("unexpected file format: \"%s\"", FILE_OS_VERSION),
-				 errdetail("number of fields is not corresponding")));
-
+		PidTop	   *t = (PidTop *) lfirst(lc);
+		Datum		values[NUM_TOP_COLS];
+		bool		nulls[NUM_TOP_COLS];
+		char		state[2];
+		int			i;
 
-	values[1] = CStringGetTextDatum(buffer);
+		memset(values, 0, sizeof(values));
+		memset(nulls, false, sizeof(nulls));
 
+		state[0] = t->state;
+		state[1] = '\0';
 
-	tuple = heap_form_tuple(tupdesc, values, nulls);
+		i = 0;
+		values[i++] = Int32GetDatum(t->pid);
+		values[i++] = Int32GetDatum(t->ppid);
+		values[i++] = BoolGetDatum(t->postgres);
+		values[i++] = CStringGetTextDatum(state);
+		values[i++] = CStringGetTextDatum(t->comm);
+		values[i++] = CStringGetTextDatum(t->cmdline);
+		values[i++] = Float8GetDatum(t->cpu);
+		if (t->io_valid)
+		{
+			values[i++] = Float8GetDatum(t->read_bytes);
+			values[i++] = Float8GetDatum(t->write_bytes);
+		}
+		else
+		{
+			nulls[i++] = true;
+			nulls[i++] = true;
+		}
+		values[i++] = Int64GetDatum(t->rss);
+		values[i++] = Int64GetDatum(t->rss_delta);
+		values[i++] = Float8GetDatum(INSTR_TIME_GET_DOUBLE(elapsed));
+		Assert(i == NUM_TOP_COLS);
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
 
-	return HeapTupleGetDatum(tuple);
+	return (Datum) 0;
 }
 
 /*
- * Display /proc/loadavg
+ * Show OS resource usage of each PostgreSQL process.
+ *
+ * The processes are taken from the backend status array, which has one
+ * entry per PGPROC, instead of scanning /proc.  A process that exits
+ * while we are reading its files is skipped.
  */
 
-#define NUM_LOADAVG_COLS		6
+#define NUM_BACKENDS_COLS 15
 
 Datum
-pg_proc_loadavg(PG_FUNCTION_ARGS)
+pg_proc_backends(PG_FUNCTION_ARGS)
 {
-	TupleDesc	tupdesc;
-	HeapTuple	tuple;
-	Datum		values[NUM_LOADAVG_COLS];
-	bool		nulls[NUM_LOADAVG_COLS];
-	LoadAvg		loadavg;
-	int			i = 0;
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Datum		values[NUM_BACKENDS_COLS];
+	bool		nulls[NUM_BACKENDS_COLS];
+	int			num_backends;
+	int			curr_backend;
+	double		ticks = (double) sysconf(_SC_CLK_TCK);
+	bool		read_all_stats;
 
-	/* Build a tuple descriptor for our result type */
-	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
-		elog(ERROR, "return type must be a row type");
+	InitMaterializedSRF(fcinfo, 0);
 
-	Assert(tupdesc->natts == lengthof(values));
+	read_all_stats = has_privs_of_role(GetUserId(), ROLE_PG_READ_ALL_STATS);
+
+	num_backends = pgstat_fetch_stat_numbackends();
+	for (curr_backend = 1; curr_backend <= num_backends; curr_backend++)
+	{
+		LocalPgBackendStatus *local_beentry;
+		PgBackendStatus *beentry;
+		PidStat		ps;
+		const char *backend_type;
+		char		state[2];
+		int			i;
 
-	get_proc_loadavg(&loadavg);
+		local_beentry = pl_local_beentry_by_index(curr_backend);
+		beentry = &local_beentry->backendStatus;
 
-	memset(nulls, 0, sizeof(nulls));
-	memset(values, 0, sizeof(values));
+		if (beentry->st_procpid <= 0)
+			continue;
 
-	values[i++] = Float4GetDatum(loadavg.loadavg1);
-	values[i++] = Float4GetDatum(loadavg.loadavg5);
-	values[i++] = Float4GetDatum(loadavg.loadavg15);
-	values[i++] = Int32GetDatum(loadavg.current_processes);
-	values[i++] = Int32GetDatum(loadavg.total_processes);
+		if (!get_pid_stat(beentry->st_procpid, &ps))
+			continue;
 
-	tuple = heap_form_tuple(tupdesc, values, nulls);
+		if (beentry->st_backendType == B_BG_WORKER)
+			backend_type = GetBackgroundWorkerTypeByPid(beentry->st_procpid);
+		else
+			backend_type = GetBackendTypeDesc(beentry->st_backendType);
 
-	return HeapTupleGetDatum(tuple);
+		memset(values, 0, sizeof(values));
+		memset(nulls, false, sizeof(nulls));
+
+		state[0] = ps.state;
+		state[1] = '\0';
+
+		i = 0;
+		values[i++] = Int32GetDatum(ps.pid);
+		if (backend_type)
+			values[i++] = CStringGetTextDatum(backend_type);
+		else
+			nulls[i++] = true;
+
+		/* Same visibility rule as pg_stat_activity.query_id */
+		if (beentry->st_query_id != 0 &&
+			(read_all_stats || has_privs_of_role(GetUserId(), beentry->st_userid)))
+			values[i++] = Int64GetDatum((int64) beentry->st_query_id);
+		else
+			nulls[i++] = true;
+
+		values[i++] = CStringGetTextDatum(state);
+		values[i++] = Int32GetDatum(ps.processor);
+		values[i++] = Float8GetDatum(ps.utime / ticks);
+		values[i++] = Float8GetDatum(ps.stime / ticks);
+		values[i++] = Int64GetDatum(ps.vm_rss);
+		values[i++] = Int64GetDatum(ps.rss_anon);
+		values[i++] = Int64GetDatum(ps.rss_file);
+		values[i++] = Int64GetDatum(ps.rss_shmem);
+		values[i++] = Int64GetDatum(ps.voluntary_ctxt_switches);
+		values[i++] = Int64GetDatum(ps.nonvoluntary_ctxt_switches);
+
+		if (ps.io_valid)
+		{
+			values[i++] = Int64GetDatum(ps.read_bytes);
+			values[i++] = Int64GetDatum(ps.write_bytes);
+		}
+		else
+		{
+			nulls[i++] = true;
+			nulls[i++] = true;
+		}
+
+		Assert(i == NUM_BACKENDS_COLS);
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
 }
 
+
 /*
- * Display /proc/diskstats
+ * Show memory usage of the postmaster and each PostgreSQL process from
+ * /proc/<pid>/smaps_rollup.
+ *
+ * Unlike the RSS of pg_proc_backends(), which counts every page of
+ * shared_buffers a backend has touched, Pss_Shmem charges each backend
+ * only its share of them, and Private_* is memory of its own.
  */
 
-#define NUM_DISKSTATS_COLS 20
+typedef struct BackendMemory
+{
+	PidMemory	mem;
+	const char *backend_type;
+}			BackendMemory;
 
-Datum
-pg_proc_diskstats(PG_FUNCTION_ARGS)
+static List *
+get_backend_memory(void)
 {
-	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
-	TupleDesc	tupdesc;
-	Tuplestorestate *tupstore;
-	MemoryContext per_query_ctx;
-	MemoryContext oldcontext;
-	Datum		values[NUM_DISKSTATS_COLS];
-	bool		nulls[NUM_DISKSTATS_COLS];
-	List	   *diskstats = NIL;
-	ListCell   *lc;
+	List	   *result = NIL;
+	BackendMemory *bm;
+	int			num_backends;
+	int			curr_backend;
 
-	/* check to see if caller supports us returning a tuplestore */
-	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
-		ereport(ERROR,
-				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
-				 errmsg("set-valued function called in context that cannot accept a set")));
-	if (!(rsinfo->allowedModes & SFRM_Materialize))
-		ereport(ERROR,
-				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
-				 errmsg("materialize mode required, but it is not " \
-						"allowed in this context")));
+	bm = (BackendMemory *) palloc(sizeof(BackendMemory));
+	if (get_pid_memory(PostmasterPid, &bm->mem))
+	{
+		bm->backend_type = "postmaster";
+		result = lappend(result, bm);
+	}
 
+	num_backends = pgstat_fetch_stat_numbackends();
+	for (curr_backend = 1; curr_backend <= num_backends; curr_backend++)
+	{
+		LocalPgBackendStatus *local_beentry;
+		PgBackendStatus *beentry;
 
-	/* Build a tuple descriptor for our result type */
-	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
-		elog(ERROR, "return type must be a row type");
-	Assert(tupdesc->natts == NUM_DISKSTATS_COLS);
+		local_beentry = pl_local_beentry_by_index(curr_backend);
+		beentry = &local_beentry->backendStatus;
 
-	/* Switch into long-lived context to construct returned data structures */
-	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
-	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+		if (beentry->st_procpid <= 0)
+			continue;
 
-	tupstore = tuplestore_begin_heap(true, false, work_mem);
-	rsinfo->returnMode = SFRM_Materialize;
-	rsinfo->setResult = tupstore;
-	rsinfo->setDesc = tupdesc;
+		bm = (BackendMemory *) palloc(sizeof(BackendMemory));
+		if (!get_pid_memory(beentry->st_procpid, &bm->mem))
+		{
+			pfree(bm);
+			continue;
+		}
 
-	MemoryContextSwitchTo(oldcontext);
+		if (beentry->st_backendType == B_BG_WORKER)
+			bm->backend_type = GetBackgroundWorkerTypeByPid(beentry->st_procpid);
+		else
+			bm->backend_type = GetBackendTypeDesc(beentry->st_backendType);
 
-	diskstats = get_proc_diskstats(diskstats);
+		result = lappend(result, bm);
+	}
 
-	foreach(lc, diskstats)
+	return result;
+}
+
+#define NUM_BACKEND_MEMORY_COLS 14
+
+Datum
+pg_proc_backend_memory(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	List	   *backends;
+	ListCell   *lc;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	backends = get_backend_memory();
+
+	foreach(lc, backends)
 	{
-		DiskStat   *ds = (DiskStat *) lfirst(lc);
+		BackendMemory *bm = (BackendMemory *) lfirst(lc);
+		PidMemory  *m = &bm->mem;
+		Datum		values[NUM_BACKEND_MEMORY_COLS];
+		bool		nulls[NUM_BACKEND_MEMORY_COLS];
 		int			i;
 
 		memset(values, 0, sizeof(values));
 		memset(nulls, false, sizeof(nulls));
 
 		i = 0;
-		values[i++] = Int32GetDatum(ds->major);
-		values[i++] = Int32GetDatum(ds->minor);
-		values[i++] = CStringGetTextDatum(ds->name);
-		values[i++] = Int64GetDatum(ds->rd);
-		values[i++] = Int64GetDatum(ds->rd_merged);
-		values[i++] = Int64GetDatum(ds->rd_sec);
-		values[i++] = Int64GetDatum(ds->rd_tm);
-		values[i++] = Int64GetDatum(ds->wr);
-		values[i++] = Int64GetDatum(ds->wr_merged);
-		values[i++] = Int64GetDatum(ds->wr_sec);
-
-		values[i++] = Int64GetDatum(ds->wr_tm);
-		values[i++] = Int64GetDatum(ds->io);
-		values[i++] = Int64GetDatum(ds->tm);
-		values[i++] = Int64GetDatum(ds->wtm);
-		values[i++] = Int64GetDatum(ds->dis);
-		values[i++] = Int64GetDatum(ds->dis_merged);
-		values[i++] = Int64GetDatum(ds->dis_sec);
-		values[i++] = Int64GetDatum(ds->dis_tm);
-		values[i++] = Int64GetDatum(ds->fl);
-		values[i++] = Int64GetDatum(ds->tm_fl);
-
-		Assert(i == NUM_DISKSTATS_COLS);
-		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
-		pfree(ds);
+		values[i++] = Int32GetDatum(m->pid);
+		if (bm->backend_type)
+			values[i++] = CStringGetTextDatum(bm->backend_type);
+		else
+			nulls[i++] = true;
+		values[i++] = Int64GetDatum(m->rss);
+		values[i++] = Int64GetDatum(m->pss);
+		values[i++] = Int64GetDatum(m->pss_anon);
+		values[i++] = Int64GetDatum(m->pss_file);
+		values[i++] = Int64GetDatum(m->pss_shmem);
+		values[i++] = Int64GetDatum(m->shared_clean);
+		values[i++] = Int64GetDatum(m->shared_dirty);
+		values[i++] = Int64GetDatum(m->private_clean);
+		values[i++] = Int64GetDatum(m->private_dirty);
+		values[i++] = Int64GetDatum(m->swap);
+		values[i++] = Int64GetDatum(m->swap_pss);
+		values[i++] = Int64GetDatum(m->anon_huge_pages);
+
+		Assert(i == NUM_BACKEND_MEMORY_COLS);
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
 	}
 
 	return (Datum) 0;
 }
 
 /*
- * Display /proc/meminfo
+ * Show the memory usage of the whole cluster.
+ *
+ * Summing Pss over all the processes attached to the shared memory counts
+ * each shared page once, whereas summing RSS counts it once per process.
  */
 
-
-#define NUM_MEMORY_COLS		50
-
+#define NUM_CLUSTER_MEMORY_COLS 9
 
 Datum
-pg_proc_meminfo(PG_FUNCTION_ARGS)
+pg_proc_cluster_memory(PG_FUNCTION_ARGS)
 {
 	TupleDesc	tupdesc;
 	HeapTuple	tuple;
-	Datum		values[NUM_MEMORY_COLS];
-	bool		nulls[NUM_MEMORY_COLS];
-	MemInfo		meminfo;
+	Datum		values[NUM_CLUSTER_MEMORY_COLS];
+	bool		nulls[NUM_CLUSTER_MEMORY_COLS];
+	List	   *backends;
+	ListCell   *lc;
+	PidMemory	total;
 	int			i;
 
-	/* Build a tuple descriptor for our result type */
 	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
 		elog(ERROR, "return type must be a row type");
 
 	Assert(tupdesc->natts == lengthof(values));
 
-	get_proc_meminfo(&meminfo);
+	backends = get_backend_memory();
 
-	memset(nulls, 0, sizeof(nulls));
-	memset(values, 0, sizeof(values));
+	memset(&total, 0, sizeof(total));
+	foreach(lc, backends)
+	{
+		PidMemory  *m = &((BackendMemory *) lfirst(lc))->mem;
+
+		total.pss += m->pss;
+		total.pss_anon += m->pss_anon;
+		total.pss_file += m->pss_file;
+		total.pss_shmem += m->pss_shmem;
+		total.private_clean += m->private_clean;
+		total.private_dirty += m->private_dirty;
+		total.swap_pss += m->swap_pss;
+		total.anon_huge_pages += m->anon_huge_pages;
+	}
+
+	memset(nulls, false, sizeof(nulls));
 
 	i = 0;
-	values[i++] = Int64GetDatum(meminfo.MemTotal);
-	values[i++] = Int64GetDatum(meminfo.MemFree);
-	values[i++] = Int64GetDatum(meminfo.MemAvailable);
-	values[i++] = Int64GetDatum(meminfo.Buffers);
-	values[i++] = Int64GetDatum(meminfo.Cached);
-	values[i++] = Int64GetDatum(meminfo.SwapCached);
-	values[i++] = Int64GetDatum(meminfo.Active);
-	values[i++] = Int64GetDatum(meminfo.Inactive);
-	values[i++] = Int64GetDatum(meminfo.Active_anon);
-	values[i++] = Int64GetDatum(meminfo.Inactive_anon);
-
-	values[i++] = Int64GetDatum(meminfo.Active_file);
-	values[i++] = Int64GetDatum(meminfo.Inactive_file);
-	values[i++] = Int64GetDatum(meminfo.Unevictable);
-	values[i++] = Int64GetDatum(meminfo.Mlocked);
-	values[i++] = Int64GetDatum(meminfo.SwapTotal);
-	values[i++] = Int64GetDatum(meminfo.SwapFree);
-	values[i++] = Int64GetDatum(meminfo.Dirty);
-	values[i++] = Int64GetDatum(meminfo.Writeback);
-	values[i++] = Int64GetDatum(meminfo.AnonPages);
-	values[i++] = Int64GetDatum(meminfo.Mapped);
-
-	values[i++] = Int64GetDatum(meminfo.Shmem);
-	values[i++] = Int64GetDatum(meminfo.KReclaimable);
-	values[i++] = Int64GetDatum(meminfo.Slab);
-	values[i++] = Int64GetDatum(meminfo.SReclaimable);
-	values[i++] = Int64GetDatum(meminfo.SUnreclaim);
-	values[i++] = Int64GetDatum(meminfo.KernelStack);
-	values[i++] = Int64GetDatum(meminfo.PageTables);
-	values[i++] = Int64GetDatum(meminfo.NFS_Unstable);
-	values[i++] = Int64GetDatum(meminfo.Bounce);
-	values[i++] = Int64GetDatum(meminfo.WritebackTmp);
-
-	values[i++] = Int64GetDatum(meminfo.CommitLimit);
-	values[i++] = Int64GetDatum(meminfo.Committed_AS);
-	values[i++] = Int64GetDatum(meminfo.VmallocTotal);
-	values[i++] = Int64GetDatum(meminfo.VmallocUsed);
-	values[i++] = Int64GetDatum(meminfo.VmallocChunk);
-	values[i++] = Int64GetDatum(meminfo.Percpu);
-	values[i++] = Int64GetDatum(meminfo.HardwareCorrupted);
-	values[i++] = Int64GetDatum(meminfo.AnonHugePages);
-	values[i++] = Int64GetDatum(meminfo.ShmemHugePages);
-	values[i++] = Int64GetDatum(meminfo.ShmemPmdMapped);
-
-	values[i++] = Int64GetDatum(meminfo.FileHugePages);
-	values[i++] = Int64GetDatum(meminfo.FilePmdMapped);
-	values[i++] = Int64GetDatum(meminfo.CmaTotal);
-	values[i++] = Int64GetDatum(meminfo.CmaFree);
-	values[i++] = Int64GetDatum(meminfo.HugePages_Total);
-	values[i++] = Int64GetDatum(meminfo.HugePages_Free);
-	values[i++] = Int64GetDatum(meminfo.HugePages_Rsvd);
-	values[i++] = Int64GetDatum(meminfo.HugePages_Surp);
-	values[i++] = Int64GetDatum(meminfo.Hugepagesize);
-	values[i++] = Int64GetDatum(meminfo.Hugetlb);
+	values[i++] = Int32GetDatum(list_length(backends));
+	values[i++] = Int64GetDatum(total.pss);
+	values[i++] = Int64GetDatum(total.pss_anon);
+	values[i++] = Int64GetDatum(total.pss_file);
+	values[i++] = Int64GetDatum(total.pss_shmem);
+	values[i++] = Int64GetDatum(total.private_clean);
+	values[i++] = Int64GetDatum(total.private_dirty);
+	values[i++] = Int64GetDatum(total.swap_pss);
+	values[i++] = Int64GetDatum(total.anon_huge_pages);
+	Assert(i == NUM_CLUSTER_MEMORY_COLS);
 
 	tuple = heap_form_tuple(tupdesc, values, nulls);
 
 	return HeapTupleGetDatum(tuple);
 }
 
-
 /*
- * Display only cpu items in /proc/stat
+ * Show the TCP sockets of each PostgreSQL process with their queues,
+ * retransmissions and RTT.
+ *
+ * For a backend in ClientWrite, a send_queue that stays full with a low
+ * rtt_ms means the client is not reading; retransmissions or a high
+ * rtt_ms point at the network.  Clients connected through Unix-domain
+ * sockets are not shown.  rtt_ms and the other tcp_info columns are NULL
+ * if the kernel does not answer sock_diag requests.
  */
 
-#define NUM_STAT_COLS 9
+#define NUM_BACKEND_SOCKETS_COLS 15
 
 Datum
-pg_proc_stat(PG_FUNCTION_ARGS)
+pg_proc_backend_sockets(PG_FUNCTION_ARGS)
 {
 	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
-	TupleDesc	tupdesc;
-	Tuplestorestate *tupstore;
-	MemoryContext per_query_ctx;
-	MemoryContext oldcontext;
-	Datum		values[NUM_STAT_COLS];
-	bool		nulls[NUM_STAT_COLS];
-	List	   *stats = NIL;
+	HTAB	   *sockets;
+	List	   *tcp_sockets;
 	ListCell   *lc;
+	int			num_backends;
+	int			curr_backend;
 
-	/* check to see if caller supports us returning a tuplestore */
-	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+	InitMaterializedSRF(fcinfo, 0);
+
+	sockets = create_socket_table();
+
+	num_backends = pgstat_fetch_stat_numbackends();
+	for (curr_backend = 1; curr_backend <= num_backends; curr_backend++)
+	{
+		LocalPgBackendStatus *local_beentry;
+		PgBackendStatus *beentry;
+
+		local_beentry = pl_local_beentry_by_index(curr_backend);
+		beentry = &local_beentry->backendStatus;
+
+		if (beentry->st_procpid <= 0)
+			continue;
+
+		add_pid_sockets(sockets, beentry->st_procpid);
+	}
+
+	tcp_sockets = get_tcp_sockets(sockets);
+
+	foreach(lc, tcp_sockets)
+	{
+		TcpSocket  *sk = (TcpSocket *) lfirst(lc);
+		Datum		values[NUM_BACKEND_SOCKETS_COLS];
+		bool		nulls[NUM_BACKEND_SOCKETS_COLS];
+		int			i;
+
+		memset(values, 0, sizeof(values));
+		memset(nulls, false, sizeof(nulls));
+
+		i = 0;
+		values[i++] = Int32GetDatum(sk->pid);
+		values[i++] = Int32GetDatum(sk->fd);
+		values[i++] = DirectFunctionCall1(inet_in, CStringGetDatum(sk->local_addr));
+		values[i++] = Int32GetDatum(sk->local_port);
+		values[i++] = DirectFunctionCall1(inet_in, CStringGetDatum(sk->remote_addr));
+		values[i++] = Int32GetDatum(sk->remote_port);
+		values[i++] = CStringGetTextDatum(tcp_state_name(sk->state));
+		values[i++] = Int64GetDatum(sk->tx_queue);
+		values[i++] = Int64GetDatum(sk->rx_queue);
+		values[i++] = Int32GetDatum(sk->retransmits);
+
+		if (sk->info_valid)
+		{
+			values[i++] = Int64GetDatum(sk->total_retrans);
+			values[i++] = Int64GetDatum(sk->unacked);
+			values[i++] = Int64GetDatum(sk->snd_cwnd);
+			values[i++] = Float8GetDatum(sk->rtt_ms);
+			values[i++] = Float8GetDatum(sk->rttvar_ms);
+		}
+		else
+		{
+			nulls[i++] = true;
+			nulls[i++] = true;
+			nulls[i++] = true;
+			nulls[i++] = true;
+			nulls[i++] = true;
+		}
+
+		Assert(i == NUM_BACKEND_SOCKETS_COLS);
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	hash_destroy(sockets);
+
+	return (Datum) 0;
+}
+
+/*
+ * Display the NUMA nodes with their memory and allocation counters.
+ */
+
+#define NUM_NUMA_NODES_COLS 16
+
+Datum
+pg_proc_numa_nodes(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	List	   *nodes = NIL;
+	ListCell   *lc;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	nodes = get_numa_nodes(nodes);
+
+	foreach(lc, nodes)
+	{
+		NumaNode   *node = (NumaNode *) lfirst(lc);
+		Datum		values[NUM_NUMA_NODES_COLS];
+		bool		nulls[NUM_NUMA_NODES_COLS];
+		int			i;
+
+		memset(nulls, false, sizeof(nulls));
+
+		i = 0;
+		values[i++] = Int32GetDatum(node->node);
+		values[i++] = CStringGetTextDatum(node->cpulist);
+		values[i++] = Int64GetDatum(node->mem_total);
+		values[i++] = Int64GetDatum(node->mem_free);
+		values[i++] = Int64GetDatum(node->mem_used);
+		values[i++] = Int64GetDatum(node->file_pages);
+		values[i++] = Int64GetDatum(node->anon_pages);
+		values[i++] = Int64GetDatum(node->shmem);
+		values[i++] = Int64GetDatum(node->hugepages_total);
+		values[i++] = Int64GetDatum(node->hugepages_free);
+		values[i++] = Int64GetDatum(node->numa_hit);
+		values[i++] = Int64GetDatum(node->numa_miss);
+		values[i++] = Int64GetDatum(node->numa_foreign);
+		values[i++] = Int64GetDatum(node->interleave_hit);
+		values[i++] = Int64GetDatum(node->local_node);
+		values[i++] = Int64GetDatum(node->other_node);
+
+		Assert(i == NUM_NUMA_NODES_COLS);
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * Show on which nodes the pages of the main shared memory segment, which
+ * holds shared_buffers, are placed.
+ *
+ * The segment is the mapping that contains BufferBlocks in
+ * /proc/<pid>/numa_maps of the given process.  Only the pages that process
+ * has mapped are counted.  The postmaster has touched almost none of
+ * shared_buffers, while the checkpointer writes out every dirty buffer and
+ * so has mapped most of them; it is read if pid is 0, or the caller if
+ * there is no checkpointer.
+ */
+
+#define NUM_SHMEM_NUMA_COLS 5
+
+static int
+checkpointer_pid(void)
+{
+	int			num_backends = pgstat_fetch_stat_numbackends();
+	int			curr_backend;
+
+	for (curr_backend = 1; curr_backend <= num_backends; curr_backend++)
+	{
+		LocalPgBackendStatus *local_beentry;
+
+		local_beentry = pl_local_beentry_by_index(curr_backend);
+		if (local_beentry->backendStatus.st_backendType == B_CHECKPOINTER)
+			return local_beentry->backendStatus.st_procpid;
+	}
+
+	return 0;
+}
+
+Datum
+pg_proc_shmem_numa(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	int			pid = PG_GETARG_INT32(0);
+	NumaMapping mapping;
+	ListCell   *lc;
+	int64		total = 0;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	if (pid == 0)
+	{
+		if ((pid = checkpointer_pid()) == 0)
+			pid = MyProcPid;
+	}
+	else if (pid != PostmasterPid &&
+			 BackendPidGetProc(pid) == NULL &&
+			 AuxiliaryPidGetProc(pid) == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("PID %d is not a PostgreSQL server process", pid)));
+
+	if (!get_numa_mapping(pid, (uint64) (uintptr_t) BufferBlocks, &mapping))
+		return (Datum) 0;
+
+	foreach(lc, mapping.pages)
+		total += ((NumaPages *) lfirst(lc))->pages;
+
+	foreach(lc, mapping.pages)
+	{
+		NumaPages  *np = (NumaPages *) lfirst(lc);
+		Datum		values[NUM_SHMEM_NUMA_COLS];
+		bool		nulls[NUM_SHMEM_NUMA_COLS];
+		int			i;
+
+		memset(nulls, false, sizeof(nulls));
+
+		i = 0;
+		values[i++] = Int32GetDatum(np->node);
+		values[i++] = Int64GetDatum(np->pages);
+		values[i++] = Int64GetDatum(np->pages * mapping.pagesize * 1024);
+		values[i++] = Float8GetDatum(total > 0 ? (double) np->pages / total * 100.0 : 0);
+		values[i++] = CStringGetTextDatum(mapping.policy);
+
+		Assert(i == NUM_SHMEM_NUMA_COLS);
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * Show the cpu each PostgreSQL process last ran on, its node, and the
+ * cpus and memory nodes it is allowed to use.
+ */
+
+#define NUM_BACKEND_AFFINITY_COLS 6
+
+Datum
+pg_proc_backend_affinity(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	int			num_backends;
+	int			curr_backend;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	num_backends = pgstat_fetch_stat_numbackends();
+	for (curr_backend = 1; curr_backend <= num_backends; curr_backend++)
+	{
+		LocalPgBackendStatus *local_beentry;
+		PgBackendStatus *beentry;
+		PidAffinity pa;
+		const char *backend_type;
+		Datum		values[NUM_BACKEND_AFFINITY_COLS];
+		bool		nulls[NUM_BACKEND_AFFINITY_COLS];
+		int			node;
+		int			i;
+
+		local_beentry = pl_local_beentry_by_index(curr_backend);
+		beentry = &local_beentry->backendStatus;
+
+		if (beentry->st_procpid <= 0)
+			continue;
+
+		if (!get_pid_affinity(beentry->st_procpid, &pa))
+			continue;
+
+		if (beentry->st_backendType == B_BG_WORKER)
+			backend_type = GetBackgroundWorkerTypeByPid(beentry->st_procpid);
+		else
+			backend_type = GetBackendTypeDesc(beentry->st_backendType);
+
+		memset(values, 0, sizeof(values));
+		memset(nulls, false, sizeof(nulls));
+
+		i = 0;
+		values[i++] = Int32GetDatum(pa.pid);
+		if (backend_type)
+			values[i++] = CStringGetTextDatum(backend_type);
+		else
+			nulls[i++] = true;
+		values[i++] = Int32GetDatum(pa.processor);
+		if ((node = numa_node_of_cpu(pa.processor)) >= 0)
+			values[i++] = Int32GetDatum(node);
+		else
+			nulls[i++] = true;
+		if (pa.cpus_allowed_list)
+			values[i++] = CStringGetTextDatum(pa.cpus_allowed_list);
+		else
+			nulls[i++] = true;
+		if (pa.mems_allowed_list)
+			values[i++] = CStringGetTextDatum(pa.mems_allowed_list);
+		else
+			nulls[i++] = true;
+
+		Assert(i == NUM_BACKEND_AFFINITY_COLS);
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+
+/*
+ * Display OS type and verion.
+ */
+#define FILE_OS_TYPE		"/proc/sys/kernel/ostype"
+#define FILE_OS_VERSION		"/proc/sys/kernel/osrelease"
+
+static ProcFile os_type_file = PROCFILE_INIT(FILE_OS_TYPE);
+static ProcFile os_version_file = PROCFILE_INIT(FILE_OS_VERSION);
+
+/*
+ * Read the first word of the file.
+ */
+static char *
+read_first_word(ProcFile * pf)
+{
+	char	   *buffer;
+	char	   *word;
+	size_t		nbytes;
+
+	buffer = procfile_read(pf, &nbytes);
+
+	if ((word = pl_next_token(&buffer)) == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_EXCEPTION),
+				 errmsg("unexpected file format: \"%s\"", pf->path),
+				 errdetail("number of fields is not corresponding")));
+
+	return pstrdup(word);
+}
+
+Datum
+pg_os_version(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	HeapTuple	tuple;
+	Datum		values[2];
+	bool		nulls[2];
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	memset(nulls, 0, sizeof(nulls));
+	memset(values, 0, sizeof(values));
+
+	/*
+	 * Get os type
+	 */
+	values[0] = CStringGetTextDatum(read_first_word(&os_type_file));
+
+	/*
+	 * Get os version
+	 */
+	values[1] = CStringGetTextDatum(read_first_word(&os_version_file));
+
+	tuple = heap_form_tuple(tupdesc, values, nulls);
+
+	return HeapTupleGetDatum(tuple);
+}
+
+/*
+ * Display /proc/loadavg
+ */
+
+/*
+ * Fill values[] with the fields of LoadAvg in the column order of
+ * pg_proc_loadavg(), and return the number of filled values.
+ */
+int
+loadavg_values(LoadAvg * loadavg, Datum *values)
+{
+	int			i = 0;
+
+	values[i++] = Float4GetDatum(loadavg->loadavg1);
+	values[i++] = Float4GetDatum(loadavg->loadavg5);
+	values[i++] = Float4GetDatum(loadavg->loadavg15);
+	values[i++] = Int32GetDatum(loadavg->current_processes);
+	values[i++] = Int32GetDatum(loadavg->total_processes);
+
+	Assert(i == NUM_LOADAVG_VALUES);
+	return i;
+}
+
+Datum
+pg_proc_loadavg(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	HeapTuple	tuple;
+	Datum		values[NUM_LOADAVG_VALUES];
+	bool		nulls[NUM_LOADAVG_VALUES];
+	LoadAvg		loadavg;
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	Assert(tupdesc->natts == lengthof(values));
+
+	cached_proc_loadavg(&loadavg);
+
+	memset(nulls, 0, sizeof(nulls));
+	memset(values, 0, sizeof(values));
+
+	loadavg_values(&loadavg, values);
+
+	tuple = heap_form_tuple(tupdesc, values, nulls);
+
+	return HeapTupleGetDatum(tuple);
+}
+
+/*
+ * Display /proc/diskstats
+ */
+
+/*
+ * Fill values[] with the fields of DiskStat in the column order of
+ * pg_proc_diskstats(), and return the number of filled values.
+ */
+int
+diskstats_values(DiskStat * ds, Datum *values)
+{
+	int			i = 0;
+
+	values[i++] = Int32GetDatum(ds->major);
+	values[i++] = Int32GetDatum(ds->minor);
+	values[i++] = CStringGetTextDatum(ds->name);
+	values[i++] = Int64GetDatum(ds->rd);
+	values[i++] = Int64GetDatum(ds->rd_merged);
+	values[i++] = Int64GetDatum(ds->rd_sec);
+	values[i++] = Int64GetDatum(ds->rd_tm);
+	values[i++] = Int64GetDatum(ds->wr);
+	values[i++] = Int64GetDatum(ds->wr_merged);
+	values[i++] = Int64GetDatum(ds->wr_sec);
+
+	values[i++] = Int64GetDatum(ds->wr_tm);
+	values[i++] = Int64GetDatum(ds->io);
+	values[i++] = Int64GetDatum(ds->tm);
+	values[i++] = Int64GetDatum(ds->wtm);
+	values[i++] = Int64GetDatum(ds->dis);
+	values[i++] = Int64GetDatum(ds->dis_merged);
+	values[i++] = Int64GetDatum(ds->dis_sec);
+	values[i++] = Int64GetDatum(ds->dis_tm);
+	values[i++] = Int64GetDatum(ds->fl);
+	values[i++] = Int64GetDatum(ds->tm_fl);
+
+	Assert(i == NUM_DISKSTATS_VALUES);
+	return i;
+}
+
+#define NUM_DISKSTATS_COLS NUM_DISKSTATS_VALUES
+
+Datum
+pg_proc_diskstats(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	Datum		values[NUM_DISKSTATS_COLS];
+	bool		nulls[NUM_DISKSTATS_COLS];
+	List	   *diskstats = NIL;
+	ListCell   *lc;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
 		ereport(ERROR,
 				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
 				 errmsg("set-valued function called in context that cannot accept a set")));
@@ -535,7 +1442,7 @@ pg_proc_stat(PG_FUNCTION_ARGS)
 	/* Build a tuple descriptor for our result type */
 	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
 		elog(ERROR, "return type must be a row type");
-	Assert(tupdesc->natts == NUM_STAT_COLS);
+	Assert(tupdesc->natts == NUM_DISKSTATS_COLS);
 
 	/* Switch into long-lived context to construct returned data structures */
 	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
@@ -548,30 +1455,1109 @@ pg_proc_stat(PG_FUNCTION_ARGS)
 
 	MemoryContextSwitchTo(oldcontext);
 
-	stats = get_proc_stat(stats);
+	diskstats = cached_proc_diskstats(diskstats);
 
-	foreach(lc, stats)
+	foreach(lc, diskstats)
 	{
-		ProcStat   *ps = (ProcStat *) lfirst(lc);
+		DiskStat   *ds = (DiskStat *) lfirst(lc);
 		int			i;
 
 		memset(values, 0, sizeof(values));
 		memset(nulls, false, sizeof(nulls));
 
-		i = 0;
-		values[i++] = CStringGetTextDatum(ps->cpu);
-		values[i++] = Int64GetDatum(ps->user);
-		values[i++] = Int64GetDatum(ps->nice);
-		values[i++] = Int64GetDatum(ps->system);
-		values[i++] = Int64GetDatum(ps->idle);
-		values[i++] = Int64GetDatum(ps->iowait);
-		values[i++] = Int64GetDatum(ps->irq);
-		values[i++] = Int64GetDatum(ps->softirq);
-		values[i++] = Int64GetDatum(ps->steal);
+		i = diskstats_values(ds, values);
 
-		Assert(i == NUM_STAT_COLS);
+		Assert(i == NUM_DISKSTATS_COLS);
 		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
-		pfree(ps);
+		pfree(ds);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * Display /proc/meminfo
+ */
+
+
+/*
+ * Fill values[] with the fields of MemInfo in the column order of
+ * pg_proc_meminfo(), and return the number of filled values.
+ */
+int
+meminfo_values(MemInfo * meminfo, Datum *values)
+{
+	int			i = 0;
+
+#define MEMINFO_VALUE(key, field, unit) \
+	values[i++] = Int64GetDatum(meminfo->field);
+
+	MEMINFO_KEYS(MEMINFO_VALUE)
+
+	Assert(i == NUM_MEMINFO_VALUES);
+	return i;
+}
+
+Datum
+pg_proc_meminfo(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	HeapTuple	tuple;
+	Datum		values[NUM_MEMINFO_VALUES];
+	bool		nulls[NUM_MEMINFO_VALUES];
+	MemInfo		meminfo;
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	Assert(tupdesc->natts == lengthof(values));
+
+	cached_proc_meminfo(&meminfo);
+
+	memset(nulls, 0, sizeof(nulls));
+	memset(values, 0, sizeof(values));
+
+	meminfo_values(&meminfo, values);
+
+	tuple = heap_form_tuple(tupdesc, values, nulls);
+
+	return HeapTupleGetDatum(tuple);
+}
+
+/*
+ * Show the lines of /proc/meminfo that pg_proc_meminfo() has no column
+ * for, such as those added by newer kernels.
+ */
+
+#define NUM_MEMINFO_EXTRA_COLS 3
+
+Datum
+pg_proc_meminfo_extra(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	MemInfo		meminfo;
+	List	   *extra = NIL;
+	ListCell   *lc;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	get_proc_meminfo(&meminfo, &extra);
+
+	foreach(lc, extra)
+	{
+		MemInfoExtra *e = (MemInfoExtra *) lfirst(lc);
+		Datum		values[NUM_MEMINFO_EXTRA_COLS];
+		bool		nulls[NUM_MEMINFO_EXTRA_COLS];
+
+		memset(nulls, false, sizeof(nulls));
+
+		values[0] = CStringGetTextDatum(e->key);
+		values[1] = Int64GetDatum(e->value);
+		if (e->unit)
+			values[2] = CStringGetTextDatum(e->unit);
+		else
+			nulls[2] = true;
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+
+/*
+ * Display cpu items in /proc/stat
+ */
+
+/*
+ * Fill values[] with the fields of ProcStat in the column order of
+ * pg_proc_stat(), and return the number of filled values.
+ */
+int
+stat_values(ProcStat * ps, Datum *values)
+{
+	int			i = 0;
+
+	values[i++] = CStringGetTextDatum(ps->cpu);
+	values[i++] = Int64GetDatum(ps->user);
+	values[i++] = Int64GetDatum(ps->nice);
+	values[i++] = Int64GetDatum(ps->system);
+	values[i++] = Int64GetDatum(ps->idle);
+	values[i++] = Int64GetDatum(ps->iowait);
+	values[i++] = Int64GetDatum(ps->irq);
+	values[i++] = Int64GetDatum(ps->softirq);
+	values[i++] = Int64GetDatum(ps->steal);
+	values[i++] = Int64GetDatum(ps->guest);
+	values[i++] = Int64GetDatum(ps->guest_nice);
+
+	Assert(i == NUM_STAT_VALUES);
+	return i;
+}
+
+#define NUM_STAT_COLS NUM_STAT_VALUES
+
+Datum
+pg_proc_stat(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	Datum		values[NUM_STAT_COLS];
+	bool		nulls[NUM_STAT_COLS];
+	List	   *stats = NIL;
+	ListCell   *lc;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+	Assert(tupdesc->natts == NUM_STAT_COLS);
+
+	/* Switch into long-lived context to construct returned data structures */
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	stats = cached_proc_stat(stats);
+
+	foreach(lc, stats)
+	{
+		ProcStat   *ps = (ProcStat *) lfirst(lc);
+		int			i;
+
+		memset(values, 0, sizeof(values));
+		memset(nulls, false, sizeof(nulls));
+
+		i = stat_values(ps, values);
+
+		Assert(i == NUM_STAT_COLS);
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+		pfree(ps);
+	}
+
+	return (Datum) 0;
+}
+
+
+/*
+ * Display cpu utilization in percent
+ *
+ * pg_proc_cpu_usage(interval) samples /proc/stat twice, separated by the
+ * interval.  pg_proc_cpu_usage() compares against the sample taken by the
+ * previous call in the same session; the first call returns the average
+ * since boot.  elapsed is the time between the samples in seconds, which
+ * is measured with the monotonic clock.
+ */
+
+#define NUM_CPU_USAGE_COLS 12
+
+/* Previous sample of pg_proc_cpu_usage() */
+static List *prev_cpu_stats = NIL;
+static instr_time prev_cpu_time;
+
+static void
+put_cpu_usage(FunctionCallInfo fcinfo, List *prev, List *cur, double elapsed)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Datum		values[NUM_CPU_USAGE_COLS];
+	bool		nulls[NUM_CPU_USAGE_COLS];
+	List	   *usage;
+	ListCell   *lc;
+
+	usage = get_cpu_usage(prev, cur);
+
+	foreach(lc, usage)
+	{
+		CpuUsage   *u = (CpuUsage *) lfirst(lc);
+		int			i;
+
+		memset(values, 0, sizeof(values));
+		memset(nulls, !u->valid, sizeof(nulls));
+
+		i = 0;
+		values[i++] = CStringGetTextDatum(u->cpu);
+		values[i++] = Float8GetDatum(u->user);
+		values[i++] = Float8GetDatum(u->nice);
+		values[i++] = Float8GetDatum(u->system);
+		values[i++] = Float8GetDatum(u->idle);
+		values[i++] = Float8GetDatum(u->iowait);
+		values[i++] = Float8GetDatum(u->irq);
+		values[i++] = Float8GetDatum(u->softirq);
+		values[i++] = Float8GetDatum(u->steal);
+		values[i++] = Float8GetDatum(u->guest);
+		values[i++] = Float8GetDatum(u->guest_nice);
+		values[i++] = Float8GetDatum(elapsed);
+		Assert(i == NUM_CPU_USAGE_COLS);
+
+		nulls[0] = false;
+		nulls[NUM_CPU_USAGE_COLS - 1] = false;
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+}
+
+Datum
+pg_proc_cpu_usage(PG_FUNCTION_ARGS)
+{
+	MemoryContext oldcontext;
+	List	   *cur = NIL;
+	List	   *prev = prev_cpu_stats;
+	ListCell   *lc;
+	instr_time	now;
+	instr_time	elapsed;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	INSTR_TIME_SET_CURRENT(now);
+	cur = get_proc_stat(cur);
+
+	/* On the first call, prev_cpu_time is zero, i.e. the boot time. */
+	elapsed = now;
+	INSTR_TIME_SUBTRACT(elapsed, prev_cpu_time);
+
+	put_cpu_usage(fcinfo, prev, cur, INSTR_TIME_GET_DOUBLE(elapsed));
+
+	/*
+	 * The sample is read in the per-call context, so that nothing leaks if
+	 * reading fails, and copied only now to be kept for the next call.
+	 */
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+	prev_cpu_stats = NIL;
+	foreach(lc, cur)
+	{
+		ProcStat   *ps = palloc(sizeof(ProcStat));
+
+		memcpy(ps, lfirst(lc), sizeof(ProcStat));
+		prev_cpu_stats = lappend(prev_cpu_stats, ps);
+	}
+	MemoryContextSwitchTo(oldcontext);
+
+	prev_cpu_time = now;
+	list_free_deep(prev);
+
+	return (Datum) 0;
+}
+
+Datum
+pg_proc_cpu_usage_interval(PG_FUNCTION_ARGS)
+{
+	Interval   *span = PG_GETARG_INTERVAL_P(0);
+	List	   *prev = NIL;
+	List	   *cur = NIL;
+	instr_time	start;
+	instr_time	elapsed;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	INSTR_TIME_SET_CURRENT(start);
+	prev = get_proc_stat(prev);
+
+	wait_for_interval(span);
+
+	INSTR_TIME_SET_CURRENT(elapsed);
+	cur = get_proc_stat(cur);
+	INSTR_TIME_SUBTRACT(elapsed, start);
+
+	put_cpu_usage(fcinfo, prev, cur, INSTR_TIME_GET_DOUBLE(elapsed));
+
+	return (Datum) 0;
+}
+
+
+/*
+ * Display iostat-style metrics computed from /proc/diskstats
+ *
+ * /proc/diskstats is sampled twice, separated by the specified interval.
+ */
+
+#define NUM_IOSTAT_COLS 18
+
+Datum
+pg_proc_iostat(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Interval   *span = PG_GETARG_INTERVAL_P(0);
+	Datum		values[NUM_IOSTAT_COLS];
+	bool		nulls[NUM_IOSTAT_COLS];
+	List	   *prev = NIL;
+	List	   *cur = NIL;
+	List	   *iostats;
+	ListCell   *lc;
+	instr_time	start;
+	instr_time	elapsed;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	INSTR_TIME_SET_CURRENT(start);
+	prev = get_proc_diskstats(prev);
+
+	wait_for_interval(span);
+
+	INSTR_TIME_SET_CURRENT(elapsed);
+	cur = get_proc_diskstats(cur);
+	INSTR_TIME_SUBTRACT(elapsed, start);
+
+	iostats = get_iostat(prev, cur, INSTR_TIME_GET_DOUBLE(elapsed));
+
+	foreach(lc, iostats)
+	{
+		IoStat	   *io = (IoStat *) lfirst(lc);
+		int			i;
+
+		memset(values, 0, sizeof(values));
+		memset(nulls, false, sizeof(nulls));
+
+		i = 0;
+		values[i++] = Int32GetDatum(io->major);
+		values[i++] = Int32GetDatum(io->minor);
+		values[i++] = CStringGetTextDatum(io->name);
+		values[i++] = Float8GetDatum(io->r_s);
+		values[i++] = Float8GetDatum(io->w_s);
+		values[i++] = Float8GetDatum(io->rkb_s);
+		values[i++] = Float8GetDatum(io->wkb_s);
+		values[i++] = Float8GetDatum(io->rrqm_s);
+		values[i++] = Float8GetDatum(io->wrqm_s);
+		values[i++] = Float8GetDatum(io->r_await);
+
+		values[i++] = Float8GetDatum(io->w_await);
+		values[i++] = Float8GetDatum(io->aqu_sz);
+		values[i++] = Float8GetDatum(io->util);
+		values[i++] = Float8GetDatum(io->d_s);
+		values[i++] = Float8GetDatum(io->dkb_s);
+		values[i++] = Float8GetDatum(io->d_await);
+		values[i++] = Float8GetDatum(io->f_s);
+		values[i++] = Float8GetDatum(io->f_await);
+
+		Assert(i == NUM_IOSTAT_COLS);
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+
+/*
+ * Display /proc/vmstat
+ */
+
+#define NUM_VMSTAT_COLS 2
+
+Datum
+pg_proc_vmstat(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	List	   *vmstat = NIL;
+	ListCell   *lc;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	vmstat = get_proc_vmstat(vmstat);
+
+	foreach(lc, vmstat)
+	{
+		VmStat	   *vs = (VmStat *) lfirst(lc);
+		Datum		values[NUM_VMSTAT_COLS];
+		bool		nulls[NUM_VMSTAT_COLS];
+
+		memset(nulls, false, sizeof(nulls));
+
+		values[0] = CStringGetTextDatum(vs->name);
+		values[1] = Int64GetDatum(vs->value);
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * /proc/vmstat is sampled twice, separated by the specified interval.
+ */
+
+#define NUM_VMSTAT_RATE_COLS 4
+
+Datum
+pg_proc_vmstat_rate(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Interval   *span = PG_GETARG_INTERVAL_P(0);
+	List	   *prev = NIL;
+	List	   *cur = NIL;
+	List	   *rates;
+	ListCell   *lc;
+	instr_time	start;
+	instr_time	elapsed;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	INSTR_TIME_SET_CURRENT(start);
+	prev = get_proc_vmstat(prev);
+
+	wait_for_interval(span);
+
+	INSTR_TIME_SET_CURRENT(elapsed);
+	cur = get_proc_vmstat(cur);
+	INSTR_TIME_SUBTRACT(elapsed, start);
+
+	rates = get_vmstat_rate(prev, cur, INSTR_TIME_GET_DOUBLE(elapsed));
+
+	foreach(lc, rates)
+	{
+		VmStatRate *r = (VmStatRate *) lfirst(lc);
+		Datum		values[NUM_VMSTAT_RATE_COLS];
+		bool		nulls[NUM_VMSTAT_RATE_COLS];
+
+		memset(nulls, false, sizeof(nulls));
+
+		values[0] = CStringGetTextDatum(r->name);
+		values[1] = Int64GetDatum(r->delta);
+		values[2] = Float8GetDatum(r->rate);
+		values[3] = Float8GetDatum(INSTR_TIME_GET_DOUBLE(elapsed));
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+
+/*
+ * Display /proc/net/dev
+ */
+
+#define NUM_NETDEV_COLS (NUM_NETDEV_FIELDS + 1)
+
+Datum
+pg_proc_netdev(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	List	   *netdev = NIL;
+	ListCell   *lc;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	netdev = get_proc_netdev(netdev);
+
+	foreach(lc, netdev)
+	{
+		NetDev	   *nd = (NetDev *) lfirst(lc);
+		Datum		values[NUM_NETDEV_COLS];
+		bool		nulls[NUM_NETDEV_COLS];
+		int			i;
+
+		memset(nulls, false, sizeof(nulls));
+
+		i = 0;
+		values[i++] = CStringGetTextDatum(nd->name);
+		values[i++] = Int64GetDatum(nd->rx_bytes);
+		values[i++] = Int64GetDatum(nd->rx_packets);
+		values[i++] = Int64GetDatum(nd->rx_errs);
+		values[i++] = Int64GetDatum(nd->rx_drop);
+		values[i++] = Int64GetDatum(nd->rx_fifo);
+		values[i++] = Int64GetDatum(nd->rx_frame);
+		values[i++] = Int64GetDatum(nd->rx_compressed);
+		values[i++] = Int64GetDatum(nd->rx_multicast);
+		values[i++] = Int64GetDatum(nd->tx_bytes);
+		values[i++] = Int64GetDatum(nd->tx_packets);
+		values[i++] = Int64GetDatum(nd->tx_errs);
+		values[i++] = Int64GetDatum(nd->tx_drop);
+		values[i++] = Int64GetDatum(nd->tx_fifo);
+		values[i++] = Int64GetDatum(nd->tx_colls);
+		values[i++] = Int64GetDatum(nd->tx_carrier);
+		values[i++] = Int64GetDatum(nd->tx_compressed);
+
+		Assert(i == NUM_NETDEV_COLS);
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * /proc/net/dev is sampled twice, separated by the specified interval.
+ */
+
+#define NUM_NETDEV_RATE_COLS 10
+
+Datum
+pg_proc_netdev_rate(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Interval   *span = PG_GETARG_INTERVAL_P(0);
+	List	   *prev = NIL;
+	List	   *cur = NIL;
+	List	   *rates;
+	ListCell   *lc;
+	instr_time	start;
+	instr_time	elapsed;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	INSTR_TIME_SET_CURRENT(start);
+	prev = get_proc_netdev(prev);
+
+	wait_for_interval(span);
+
+	INSTR_TIME_SET_CURRENT(elapsed);
+	cur = get_proc_netdev(cur);
+	INSTR_TIME_SUBTRACT(elapsed, start);
+
+	rates = get_netdev_rate(prev, cur, INSTR_TIME_GET_DOUBLE(elapsed));
+
+	foreach(lc, rates)
+	{
+		NetDevRate *r = (NetDevRate *) lfirst(lc);
+		Datum		values[NUM_NETDEV_RATE_COLS];
+		bool		nulls[NUM_NETDEV_RATE_COLS];
+		int			i;
+
+		memset(nulls, false, sizeof(nulls));
+
+		i = 0;
+		values[i++] = CStringGetTextDatum(r->name);
+		values[i++] = Float8GetDatum(r->rx_kb_s);
+		values[i++] = Float8GetDatum(r->tx_kb_s);
+		values[i++] = Float8GetDatum(r->rx_packets_s);
+		values[i++] = Float8GetDatum(r->tx_packets_s);
+		values[i++] = Float8GetDatum(r->rx_errs_s);
+		values[i++] = Float8GetDatum(r->tx_errs_s);
+		values[i++] = Float8GetDatum(r->rx_drop_s);
+		values[i++] = Float8GetDatum(r->tx_drop_s);
+		values[i++] = Float8GetDatum(INSTR_TIME_GET_DOUBLE(elapsed));
+
+		Assert(i == NUM_NETDEV_RATE_COLS);
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * Display /proc/net/snmp, one row per counter
+ */
+
+#define NUM_NETSNMP_COLS 3
+
+Datum
+pg_proc_netsnmp(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	List	   *netsnmp = NIL;
+	ListCell   *lc;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	netsnmp = get_proc_netsnmp(netsnmp);
+
+	foreach(lc, netsnmp)
+	{
+		NetSnmp    *ns = (NetSnmp *) lfirst(lc);
+		Datum		values[NUM_NETSNMP_COLS];
+		bool		nulls[NUM_NETSNMP_COLS];
+
+		memset(nulls, false, sizeof(nulls));
+
+		values[0] = CStringGetTextDatum(ns->protocol);
+		values[1] = CStringGetTextDatum(ns->name);
+		values[2] = Int64GetDatum(ns->value);
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * /proc/net/snmp is sampled twice, separated by the specified interval.
+ */
+
+#define NUM_NETSNMP_RATE_COLS 21
+
+Datum
+pg_proc_netsnmp_rate(PG_FUNCTION_ARGS)
+{
+	Interval   *span = PG_GETARG_INTERVAL_P(0);
+	TupleDesc	tupdesc;
+	HeapTuple	tuple;
+	Datum		values[NUM_NETSNMP_RATE_COLS];
+	bool		nulls[NUM_NETSNMP_RATE_COLS];
+	List	   *prev = NIL;
+	List	   *cur = NIL;
+	NetSnmpRate r;
+	instr_time	start;
+	instr_time	elapsed;
+	int			i;
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	Assert(tupdesc->natts == lengthof(values));
+
+	INSTR_TIME_SET_CURRENT(start);
+	prev = get_proc_netsnmp(prev);
+
+	wait_for_interval(span);
+
+	INSTR_TIME_SET_CURRENT(elapsed);
+	cur = get_proc_netsnmp(cur);
+	INSTR_TIME_SUBTRACT(elapsed, start);
+
+	get_netsnmp_rate(prev, cur, INSTR_TIME_GET_DOUBLE(elapsed), &r);
+
+	memset(nulls, false, sizeof(nulls));
+
+	i = 0;
+	values[i++] = Float8GetDatum(r.ip_in_receives_s);
+	values[i++] = Float8GetDatum(r.ip_out_requests_s);
+	values[i++] = Float8GetDatum(r.ip_in_discards_s);
+	values[i++] = Float8GetDatum(r.ip_out_discards_s);
+	values[i++] = Float8GetDatum(r.tcp_active_opens_s);
+	values[i++] = Float8GetDatum(r.tcp_passive_opens_s);
+	values[i++] = Float8GetDatum(r.tcp_attempt_fails_s);
+	values[i++] = Float8GetDatum(r.tcp_estab_resets_s);
+	values[i++] = Int64GetDatum(r.tcp_curr_estab);
+	values[i++] = Float8GetDatum(r.tcp_in_segs_s);
+
+	values[i++] = Float8GetDatum(r.tcp_out_segs_s);
+	values[i++] = Float8GetDatum(r.tcp_retrans_segs_s);
+	values[i++] = Float8GetDatum(r.tcp_retrans_pct);
+	values[i++] = Float8GetDatum(r.tcp_in_errs_s);
+	values[i++] = Float8GetDatum(r.tcp_out_rsts_s);
+	values[i++] = Float8GetDatum(r.udp_in_datagrams_s);
+	values[i++] = Float8GetDatum(r.udp_out_datagrams_s);
+	values[i++] = Float8GetDatum(r.udp_in_errors_s);
+	values[i++] = Float8GetDatum(r.udp_rcvbuf_errors_s);
+	values[i++] = Float8GetDatum(r.udp_sndbuf_errors_s);
+
+	values[i++] = Float8GetDatum(INSTR_TIME_GET_DOUBLE(elapsed));
+	Assert(i == NUM_NETSNMP_RATE_COLS);
+
+	tuple = heap_form_tuple(tupdesc, values, nulls);
+
+	return HeapTupleGetDatum(tuple);
+}
+
+
+/*
+ * Display /proc/pressure/{cpu,memory,io}
+ */
+
+#define NUM_PRESSURE_COLS 6
+
+Datum
+pg_proc_pressure(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	List	   *pressure = NIL;
+	ListCell   *lc;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	pressure = get_proc_pressure(pressure);
+
+	foreach(lc, pressure)
+	{
+		PressureStat *ps = (PressureStat *) lfirst(lc);
+		Datum		values[NUM_PRESSURE_COLS];
+		bool		nulls[NUM_PRESSURE_COLS];
+		int			i;
+
+		memset(nulls, false, sizeof(nulls));
+
+		i = 0;
+		values[i++] = CStringGetTextDatum(ps->resource);
+		values[i++] = CStringGetTextDatum(ps->kind);
+		values[i++] = Float4GetDatum(ps->avg10);
+		values[i++] = Float4GetDatum(ps->avg60);
+		values[i++] = Float4GetDatum(ps->avg300);
+		values[i++] = Int64GetDatum(ps->total);
+
+		Assert(i == NUM_PRESSURE_COLS);
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * Block until the stall of resource exceeds threshold_us within any
+ * window_us window, or until timeout.  Return true if the stall happened.
+ */
+Datum
+pg_proc_pressure_wait(PG_FUNCTION_ARGS)
+{
+	char	   *resource = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	int64		threshold_us = PG_GETARG_INT64(1);
+	int64		window_us = PG_GETARG_INT64(2);
+	int64		timeout_ms = interval_to_wait_ms(PG_GETARG_INTERVAL_P(3));
+	char	   *kind = text_to_cstring(PG_GETARG_TEXT_PP(4));
+
+	PG_RETURN_BOOL(pressure_wait(resource, kind, threshold_us, window_us,
+								 timeout_ms));
+}
+
+
+/*
+ * Display cgroup v2 statistics of the cgroup the server runs in
+ */
+
+Datum
+pg_proc_cgroup_path(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_TEXT_P(cstring_to_text(get_cgroup_path()));
+}
+
+#define NUM_CGROUP_CPU_COLS 9
+
+Datum
+pg_proc_cgroup_cpu(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	HeapTuple	tuple;
+	Datum		values[NUM_CGROUP_CPU_COLS];
+	bool		nulls[NUM_CGROUP_CPU_COLS];
+	CgroupCpu	cpu;
+	int			i;
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	Assert(tupdesc->natts == lengthof(values));
+
+	get_cgroup_cpu(&cpu);
+
+	memset(nulls, false, sizeof(nulls));
+
+	i = 0;
+	values[i++] = Int64GetDatum(cpu.usage_usec);
+	values[i++] = Int64GetDatum(cpu.user_usec);
+	values[i++] = Int64GetDatum(cpu.system_usec);
+	values[i++] = Int64GetDatum(cpu.nr_periods);
+	values[i++] = Int64GetDatum(cpu.nr_throttled);
+	values[i++] = Int64GetDatum(cpu.throttled_usec);
+	if (cpu.quota_usec >= 0)
+	{
+		values[i++] = Int64GetDatum(cpu.quota_usec);
+		values[i++] = Int64GetDatum(cpu.period_usec);
+		values[i++] = Float8GetDatum((double) cpu.quota_usec / cpu.period_usec);
+	}
+	else
+	{
+		nulls[i++] = true;
+		if (cpu.period_usec >= 0)
+			values[i++] = Int64GetDatum(cpu.period_usec);
+		else
+			nulls[i++] = true;
+		nulls[i++] = true;
+	}
+	Assert(i == NUM_CGROUP_CPU_COLS);
+
+	tuple = heap_form_tuple(tupdesc, values, nulls);
+
+	return HeapTupleGetDatum(tuple);
+}
+
+/*
+ * cpu.stat is sampled twice, separated by the specified interval.
+ */
+
+#define NUM_CGROUP_CPU_USAGE_COLS 8
+
+Datum
+pg_proc_cgroup_cpu_usage(PG_FUNCTION_ARGS)
+{
+	Interval   *span = PG_GETARG_INTERVAL_P(0);
+	TupleDesc	tupdesc;
+	HeapTuple	tuple;
+	Datum		values[NUM_CGROUP_CPU_USAGE_COLS];
+	bool		nulls[NUM_CGROUP_CPU_USAGE_COLS];
+	CgroupCpu	prev;
+	CgroupCpu	cur;
+	CgroupCpuUsage u;
+	instr_time	start;
+	instr_time	elapsed;
+	int			i;
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	Assert(tupdesc->natts == lengthof(values));
+
+	INSTR_TIME_SET_CURRENT(start);
+	get_cgroup_cpu(&prev);
+
+	wait_for_interval(span);
+
+	INSTR_TIME_SET_CURRENT(elapsed);
+	get_cgroup_cpu(&cur);
+	INSTR_TIME_SUBTRACT(elapsed, start);
+
+	get_cgroup_cpu_usage(&prev, &cur, INSTR_TIME_GET_DOUBLE(elapsed), &u);
+
+	memset(nulls, false, sizeof(nulls));
+
+	i = 0;
+	values[i++] = Float8GetDatum(u.cpus);
+	values[i++] = Float8GetDatum(u.user_cpus);
+	values[i++] = Float8GetDatum(u.system_cpus);
+	if (u.limit_cpus >= 0)
+	{
+		values[i++] = Float8GetDatum(u.limit_cpus);
+		values[i++] = Float8GetDatum(u.limit_pct);
+	}
+	else
+	{
+		nulls[i++] = true;
+		nulls[i++] = true;
+	}
+	if (u.throttled_pct >= 0)
+		values[i++] = Float8GetDatum(u.throttled_pct);
+	else
+		nulls[i++] = true;
+	values[i++] = Float8GetDatum(u.throttled_ms_s);
+	values[i++] = Float8GetDatum(INSTR_TIME_GET_DOUBLE(elapsed));
+	Assert(i == NUM_CGROUP_CPU_USAGE_COLS);
+
+	tuple = heap_form_tuple(tupdesc, values, nulls);
+
+	return HeapTupleGetDatum(tuple);
+}
+
+static void
+cgroup_controller_error(const char *controller)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+			 errmsg("cgroup controller \"%s\" is not enabled in \"%s\"",
+					controller, get_cgroup_path()),
+			 errhint("Enable it in cgroup.subtree_control of the parent cgroup.")));
+}
+
+#define NUM_CGROUP_MEMORY_COLS 11
+
+Datum
+pg_proc_cgroup_memory(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	HeapTuple	tuple;
+	Datum		values[NUM_CGROUP_MEMORY_COLS];
+	bool		nulls[NUM_CGROUP_MEMORY_COLS];
+	CgroupMemory mem;
+	int			i;
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	Assert(tupdesc->natts == lengthof(values));
+
+	if (!get_cgroup_memory(&mem))
+		cgroup_controller_error("memory");
+
+	memset(nulls, false, sizeof(nulls));
+
+	i = 0;
+	values[i++] = Int64GetDatum(mem.current);
+	if (mem.max >= 0)
+	{
+		values[i++] = Int64GetDatum(mem.max);
+		values[i++] = Int64GetDatum(mem.available);
+	}
+	else
+	{
+		nulls[i++] = true;
+		nulls[i++] = true;
+	}
+	values[i++] = Int64GetDatum(mem.anon);
+	values[i++] = Int64GetDatum(mem.file);
+	values[i++] = Int64GetDatum(mem.inactive_file);
+	values[i++] = Int64GetDatum(mem.events_low);
+	values[i++] = Int64GetDatum(mem.events_high);
+	values[i++] = Int64GetDatum(mem.events_max);
+	values[i++] = Int64GetDatum(mem.events_oom);
+	values[i++] = Int64GetDatum(mem.events_oom_kill);
+	Assert(i == NUM_CGROUP_MEMORY_COLS);
+
+	tuple = heap_form_tuple(tupdesc, values, nulls);
+
+	return HeapTupleGetDatum(tuple);
+}
+
+#define NUM_CGROUP_MEMORY_STAT_COLS 2
+
+Datum
+pg_proc_cgroup_memory_stat(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	List	   *stat = NIL;
+	ListCell   *lc;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	stat = get_cgroup_memory_stat(stat);
+
+	foreach(lc, stat)
+	{
+		CgroupStatItem *item = (CgroupStatItem *) lfirst(lc);
+		Datum		values[NUM_CGROUP_MEMORY_STAT_COLS];
+		bool		nulls[NUM_CGROUP_MEMORY_STAT_COLS];
+
+		memset(nulls, false, sizeof(nulls));
+		values[0] = CStringGetTextDatum(item->key);
+		values[1] = Int64GetDatum(item->value);
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+#define NUM_CGROUP_IO_STAT_COLS 8
+
+Datum
+pg_proc_cgroup_io_stat(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	List	   *iostat = NIL;
+	ListCell   *lc;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	iostat = get_cgroup_io_stat(iostat);
+
+	foreach(lc, iostat)
+	{
+		CgroupIoStat *io = (CgroupIoStat *) lfirst(lc);
+		Datum		values[NUM_CGROUP_IO_STAT_COLS];
+		bool		nulls[NUM_CGROUP_IO_STAT_COLS];
+		int			i;
+
+		memset(nulls, false, sizeof(nulls));
+
+		i = 0;
+		values[i++] = Int32GetDatum(io->major);
+		values[i++] = Int32GetDatum(io->minor);
+		values[i++] = Int64GetDatum(io->rbytes);
+		values[i++] = Int64GetDatum(io->wbytes);
+		values[i++] = Int64GetDatum(io->rios);
+		values[i++] = Int64GetDatum(io->wios);
+		values[i++] = Int64GetDatum(io->dbytes);
+		values[i++] = Int64GetDatum(io->dios);
+		Assert(i == NUM_CGROUP_IO_STAT_COLS);
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * io.stat is sampled twice, separated by the specified interval.
+ */
+
+#define NUM_CGROUP_IO_RATE_COLS 9
+
+Datum
+pg_proc_cgroup_iostat(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Interval   *span = PG_GETARG_INTERVAL_P(0);
+	List	   *prev = NIL;
+	List	   *cur = NIL;
+	List	   *rates;
+	ListCell   *lc;
+	instr_time	start;
+	instr_time	elapsed;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	INSTR_TIME_SET_CURRENT(start);
+	prev = get_cgroup_io_stat(prev);
+
+	wait_for_interval(span);
+
+	INSTR_TIME_SET_CURRENT(elapsed);
+	cur = get_cgroup_io_stat(cur);
+	INSTR_TIME_SUBTRACT(elapsed, start);
+
+	rates = get_cgroup_io_rate(prev, cur, INSTR_TIME_GET_DOUBLE(elapsed));
+
+	foreach(lc, rates)
+	{
+		CgroupIoRate *r = (CgroupIoRate *) lfirst(lc);
+		Datum		values[NUM_CGROUP_IO_RATE_COLS];
+		bool		nulls[NUM_CGROUP_IO_RATE_COLS];
+		int			i;
+
+		memset(nulls, false, sizeof(nulls));
+
+		i = 0;
+		values[i++] = Int32GetDatum(r->major);
+		values[i++] = Int32GetDatum(r->minor);
+		values[i++] = Float8GetDatum(r->r_s);
+		values[i++] = Float8GetDatum(r->w_s);
+		values[i++] = Float8GetDatum(r->rkb_s);
+		values[i++] = Float8GetDatum(r->wkb_s);
+		values[i++] = Float8GetDatum(r->d_s);
+		values[i++] = Float8GetDatum(r->dkb_s);
+		values[i++] = Float8GetDatum(INSTR_TIME_GET_DOUBLE(elapsed));
+		Assert(i == NUM_CGROUP_IO_RATE_COLS);
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+Datum
+pg_proc_cgroup_pressure(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	List	   *pressure = NIL;
+	ListCell   *lc;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	pressure = get_cgroup_pressure(pressure);
+
+	foreach(lc, pressure)
+	{
+		PressureStat *ps = (PressureStat *) lfirst(lc);
+		Datum		values[NUM_PRESSURE_COLS];
+		bool		nulls[NUM_PRESSURE_COLS];
+		int			i;
+
+		memset(nulls, false, sizeof(nulls));
+
+		i = 0;
+		values[i++] = CStringGetTextDatum(ps->resource);
+		values[i++] = CStringGetTextDatum(ps->kind);
+		values[i++] = Float4GetDatum(ps->avg10);
+		values[i++] = Float4GetDatum(ps->avg60);
+		values[i++] = Float4GetDatum(ps->avg300);
+		values[i++] = Int64GetDatum(ps->total);
+
+		Assert(i == NUM_PRESSURE_COLS);
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
 	}
 
 	return (Datum) 0;
@@ -0,0 +1,94 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_linux_proc.h
+ *		Common declarations of pg_linux_proc
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#ifndef __PG_LINUX_PROC_H__
+#define __PG_LINUX_PROC_H__
+
+#include "datatype/timestamp.h"
+#include "nodes/pg_list.h"
+
+#include "loadavg.h"
+#include "diskstats.h"
+#include "meminfo.h"
+#include "stat.h"
+
+/*
+ * Number of output columns of each collector.  The *_values() functions
+ * below fill exactly this many entries, so that the live functions and
+ * the history functions return the same layout.
+ */
+#define NUM_LOADAVG_VALUES		5
+#define NUM_DISKSTATS_VALUES	20
+#define NUM_MEMINFO_VALUES		50
+#define NUM_STAT_VALUES			11
+
+/*
+ * Entry of the local snapshot of the backend status array by its 1-based
+ * index; the function was renamed in PG17.
+ */
+#if PG_VERSION_NUM >= 170000
+#define pl_local_beentry_by_index(idx)	pgstat_get_local_beentry_by_index(idx)
+#else
+#define pl_local_beentry_by_index(idx)	pgstat_fetch_stat_local_beentry(idx)
+#endif
+
+/* GUC variables */
+extern int	proc_max_devices;
+
+extern int	proc_max_cpus(void);
+
+/* Upper limit of the sampling window of the rate functions */
+#define MAX_WAIT_INTERVAL_MS	(3600 * 1000)
+
+extern int64 interval_to_wait_ms(Interval *span);
+extern void wait_for_interval(Interval *span);
+
+/*
+ * Return the delta of a cumulative counter, treating a decrease as zero.
+ *
+ * The counters can go backwards when a cpu is hot-plugged or a device is
+ * re-attached, and iowait is documented to decrease in certain conditions.
+ */
+static inline int64
+counter_delta(int64 prev, int64 cur)
+{
+	return (cur > prev) ? cur - prev : 0;
+}
+
+/*
+ * Return the entry of the previous sample prev that matches cur, the idx-th
+ * entry of the current sample, or NULL.  Both samples are usually in the
+ * same order, so the idx-th entry of prev is tried first.
+ */
+static inline void *
+find_prev_entry(List *prev, int idx, const void *cur,
+				bool (*match) (const void *a, const void *b))
+{
+	ListCell   *lc;
+
+	if (idx < list_length(prev) && match(list_nth(prev, idx), cur))
+		return list_nth(prev, idx);
+
+	foreach(lc, prev)
+	{
+		if (match(lfirst(lc), cur))
+			return lfirst(lc);
+	}
+	return NULL;
+}
+
+extern int	loadavg_values(LoadAvg * loadavg, Datum *values);
+extern int	diskstats_values(DiskStat * ds, Datum *values);
+extern int	meminfo_values(MemInfo * meminfo, Datum *values);
+extern int	stat_values(ProcStat * ps, Datum *values);
+
+#endif
@@ -3,6 +3,12 @@
  * pid.c
  *		Get pid list from /proc on Linux
  *
+ * The files under /proc/<pid> are opened with openat() relative to a
+ * descriptor of /proc that is kept open for the life of the backend, and
+ * read with read() into a buffer that is reused across calls.  A process
+ * can exit at any time during a scan, so a process whose files have
+ * disappeared is skipped rather than reported as an error.
+ *
  * Copyright (c) 2008-2025, PostgreSQL Global Development Group
  * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
  *
@@ -13,70 +19,898 @@
 #include "nodes/pg_list.h"
 
 #include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "miscadmin.h"
+#include "storage/fd.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+
+#include "parse.h"
 #include "pid.h"
 
+/* Descriptor of /proc, opened on first use */
+static int	proc_dirfd = -1;
+
+/* Read buffer reused by read_pid_file() */
+static char *pid_buf = NULL;
+static size_t pid_buf_size = 0;
+
+#define PID_BUF_INIT_SIZE	4096
+
 /*
- * Read cmdline from /proc/pid
+ * Return the cached descriptor of /proc.
  */
-static void
-get_cmdline(int64 pid, char *cmdline)
+static int
+get_proc_dirfd(void)
+{
+	if (proc_dirfd < 0)
+	{
+		proc_dirfd = open(DIR_PID, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (proc_dirfd < 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not open dir \"%s\": %m", DIR_PID)));
+	}
+	return proc_dirfd;
+}
+
+/*
+ * Read the whole /proc/<pid>/<name> into the reused buffer.
+ *
+ * Return the buffer, which is valid until the next call, and set *len to
+ * the number of bytes read; the data is always null-terminated.  NULL is
+ * returned if the process has exited or the file is not readable by us.
+ */
+char *
+read_pid_file(int pid, const char *name, ssize_t *len)
 {
-	FILE	   *fp;
-	char		line[32];
+	char		path[64];
+	int			fd;
+	ssize_t		total = 0;
+	int			save_errno;
+
+	if (pid_buf == NULL)
+	{
+		pid_buf = MemoryContextAlloc(TopMemoryContext, PID_BUF_INIT_SIZE);
+		pid_buf_size = PID_BUF_INIT_SIZE;
+	}
 
-	sprintf(line, "/proc/%ld/cmdline", pid);
+	snprintf(path, sizeof(path), "%d/%s", pid, name);
 
-	if ((fp = fopen(line, "r")) == NULL)
+	if ((fd = openat(get_proc_dirfd(), path, O_RDONLY | O_CLOEXEC)) < 0)
+	{
+		if (errno == ENOENT || errno == ESRCH || errno == EACCES)
+			return NULL;
 		ereport(ERROR,
 				(errcode_for_file_access(),
-				 errmsg("could not open file \"%s\": ", line)));
+				 errmsg("could not open file \"%s/%s\": %m", DIR_PID, path)));
+	}
+
+	for (;;)
+	{
+		ssize_t		nbytes;
+
+		if ((size_t) total == pid_buf_size - 1)
+		{
+			pid_buf = repalloc(pid_buf, pid_buf_size * 2);
+			pid_buf_size *= 2;
+		}
+
+		nbytes = read(fd, pid_buf + total, pid_buf_size - 1 - total);
+		if (nbytes < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			save_errno = errno;
+			close(fd);
+			errno = save_errno;
+			if (errno == ESRCH || errno == ENOENT || errno == EACCES)
+				return NULL;
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not read file \"%s/%s\": %m", DIR_PID, path)));
+		}
+		if (nbytes == 0)
+			break;
+		total += nbytes;
+	}
+
+	close(fd);
 
-	/*
-	 * We handle NULL because it doesn't indicate an error when the command
-	 * line cannot be read.
-	 */
-	if (fgets(cmdline, sizeof(char) * MAX_CMDLINE, fp) == NULL)
-		elog(DEBUG1, "could not read file \"%s\".", line);
+	pid_buf[total] = '\0';
+	*len = total;
 
-	fclose(fp);
+	return pid_buf;
 }
 
+/*
+ * Make a ProcPid of the process, or return NULL if it has exited.
+ *
+ * As ps does for a process without arguments, the first element of
+ * cmdline is returned.
+ */
+static ProcPid *
+make_proc_pid(int pid)
+{
+	ProcPid    *ps;
+	char	   *cmdline;
+	ssize_t		len;
 
+	if ((cmdline = read_pid_file(pid, "cmdline", &len)) == NULL)
+		return NULL;
 
-List *
-get_proc_pid(List *stat)
+	ps = (ProcPid *) palloc(sizeof(ProcPid));
+	ps->pid = pid;
+	ps->cmdline = pnstrdup(cmdline, Min(strlen(cmdline), MAX_CMDLINE - 1));
+
+	return ps;
+}
+
+/*
+ * Parse a pid directory name; return 0 if it is not a pid.
+ */
+static int
+dirname_to_pid(const char *name)
+{
+	int			pid = 0;
+
+	if (*name == '\0')
+		return 0;
+
+	for (; *name != '\0'; name++)
+	{
+		if (*name < '0' || *name > '9')
+			return 0;
+		pid = pid * 10 + (*name - '0');
+	}
+	return pid;
+}
+
+/*
+ * Return the parent pid of the process, or -1 if it has exited.
+ */
+static int
+get_ppid(int pid)
+{
+	char	   *buf;
+	char	   *p;
+	ssize_t		len;
+	int32		ppid;
+
+	if ((buf = read_pid_file(pid, "stat", &len)) == NULL)
+		return -1;
+
+	/* "pid (comm) state ppid ..."; comm can contain ')' */
+	if ((p = strrchr(buf, ')')) == NULL)
+		return -1;
+	p++;
+
+	if (pl_next_token(&p) == NULL || !pl_parse_int32(&p, &ppid))
+		return -1;
+
+	return ppid;
+}
+
+/*
+ * Append the descendants of the postmaster to pids, using
+ * /proc/<pid>/task/<pid>/children.  Return false if the kernel does not
+ * provide it (CONFIG_PROC_CHILDREN is not set).
+ *
+ * PostgreSQL processes are single-threaded, so the main thread's children
+ * are all the children of the process.
+ */
+static bool
+walk_postmaster_children(List **pids)
+{
+	List	   *queue = list_make1_int(PostmasterPid);
+	ListCell   *lc;
+	char		name[64];
+	int			i;
+
+	/* The queue grows as we walk it. */
+	for (i = 0; i < list_length(queue); i++)
+	{
+		int			pid = list_nth_int(queue, i);
+		char	   *buf;
+		char	   *p;
+		ssize_t		len;
+
+		snprintf(name, sizeof(name), "task/%d/children", pid);
+
+		if ((buf = read_pid_file(pid, name, &len)) == NULL)
+		{
+			if (pid == PostmasterPid)
+				return false;
+			continue;
+		}
+
+		for (p = buf; *p != '\0';)
+		{
+			char	   *end;
+			long		child = strtol(p, &end, 10);
+
+			if (end == p)
+				break;
+			queue = lappend_int(queue, (int) child);
+			p = end;
+		}
+	}
+
+	foreach(lc, queue)
+	{
+		ProcPid    *ps = make_proc_pid(lfirst_int(lc));
+
+		if (ps != NULL)
+			*pids = lappend(*pids, ps);
+	}
+
+	return true;
+}
+
+typedef struct PidEntry
+{
+	int			pid;			/* hash key */
+	int			ppid;
+}			PidEntry;
+
+/*
+ * Append the descendants of the postmaster to pids, by scanning all of
+ * /proc and following the parent pids.
+ */
+static void
+scan_postmaster_descendants(List **pids)
 {
+	HTAB	   *htab;
+	HASHCTL		ctl;
+	HASH_SEQ_STATUS status;
+	PidEntry   *entry;
 	DIR		   *dir;
+	struct dirent *dp;
+
+	ctl.keysize = sizeof(int);
+	ctl.entrysize = sizeof(PidEntry);
+	ctl.hcxt = CurrentMemoryContext;
+	htab = hash_create("pg_linux_proc pids", 1024, &ctl,
+					   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	dir = AllocateDir(DIR_PID);
+	while ((dp = ReadDir(dir, DIR_PID)) != NULL)
+	{
+		int			pid = dirname_to_pid(dp->d_name);
+		int			ppid;
+
+		if (pid == 0 || (ppid = get_ppid(pid)) < 0)
+			continue;
+
+		entry = (PidEntry *) hash_search(htab, &pid, HASH_ENTER, NULL);
+		entry->ppid = ppid;
+	}
+	FreeDir(dir);
 
+	hash_seq_init(&status, htab);
+	while ((entry = (PidEntry *) hash_seq_search(&status)) != NULL)
+	{
+		int			pid = entry->pid;
+		int			depth;
+		ProcPid    *ps;
+
+		/* Follow the parents up to the postmaster or init. */
+		for (depth = 0; pid > 1 && pid != PostmasterPid && depth < 64; depth++)
+		{
+			PidEntry   *parent = (PidEntry *) hash_search(htab, &pid, HASH_FIND, NULL);
+
+			if (parent == NULL)
+				break;
+			pid = parent->ppid;
+		}
+
+		if (pid != PostmasterPid)
+			continue;
+
+		if ((ps = make_proc_pid(entry->pid)) != NULL)
+			*pids = lappend(*pids, ps);
+	}
+
+	hash_destroy(htab);
+}
+
+/*
+ * Get the pids and their cmdlines.
+ *
+ * If postgres_only is true, only the postmaster and its descendants are
+ * returned.
+ */
+List *
+get_proc_pid(List *pids, bool postgres_only)
+{
+	DIR		   *dir;
 	struct dirent *dp;
 
-	if ((dir = opendir(DIR_PID)) == NULL)
-		ereport(ERROR,
-				(errcode_for_file_access(),
-				 errmsg("could not open dir \"%s\": ", DIR_PID)));
+	if (postgres_only)
+	{
+		if (!walk_postmaster_children(&pids))
+			scan_postmaster_descendants(&pids);
+		return pids;
+	}
 
-	while ((dp = readdir(dir)) != NULL)
+	dir = AllocateDir(DIR_PID);
+	while ((dp = ReadDir(dir, DIR_PID)) != NULL)
 	{
+		int			pid = dirname_to_pid(dp->d_name);
 		ProcPid    *ps;
 
-		if (dp->d_name[0] >= '0' && dp->d_name[0] <= '9')
+		if (pid == 0)
+			continue;
+
+		if ((ps = make_proc_pid(pid)) != NULL)
+			pids = lappend(pids, ps);
+	}
+	FreeDir(dir);
+
+	return pids;
+}
+
+/*
+ * If tok, the first token of a line, is key, parse the number at *pp into
+ * *value.
+ */
+static bool
+match_key(const char *tok, const char *key, char **pp, int64 *value)
+{
+	if (strcmp(tok, key) != 0)
+		return false;
+
+	(void) pl_parse_int64(pp, value);
+	return true;
+}
+
+/*
+ * Parse /proc/<pid>/stat.
+ *
+ * The command name in the second field can contain spaces and
+ * parentheses, so the fields are counted from the last ')'.
+ */
+static bool
+parse_pid_stat(char *buf, PidStat * ps)
+{
+	char	   *p = strrchr(buf, ')');
+	char	   *tok;
+	int			field;
+
+	if (p == NULL)
+		return false;
+	p++;
+
+	/* field 3 (state) follows ") "; the fields after it are all numbers */
+	if ((tok = pl_next_token(&p)) == NULL)
+		return false;
+	ps->state = tok[0];
+
+	for (field = 4; field <= 39; field++)
+	{
+		int64		value;
+
+		if (!pl_parse_int64(&p, &value))
+			return false;
+
+		switch (field)
+		{
+			case 4:
+				ps->ppid = (int) value;
+				break;
+			case 10:
+				ps->minflt = value;
+				break;
+			case 12:
+				ps->majflt = value;
+				break;
+			case 14:
+				ps->utime = value;
+				break;
+			case 15:
+				ps->stime = value;
+				break;
+			case 22:
+				ps->starttime = value;
+				break;
+			case 24:
+				ps->rss = value;
+				break;
+			case 39:
+				ps->processor = (int) value;
+				break;
+			default:
+				break;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Parse /proc/<pid>/io into ps.  The file is readable only by the owner of
+ * the process; io_valid is left false if it is not readable.
+ */
+static void
+read_pid_io(int pid, PidStat * ps)
+{
+	char	   *buf;
+	char	   *line;
+	ssize_t		len;
+
+	if ((buf = read_pid_file(pid, "io", &len)) == NULL)
+		return;
+
+	ps->io_valid = true;
+	while ((line = pl_next_line(&buf)) != NULL)
+	{
+		char	   *key = pl_next_token(&line);
+
+		if (key == NULL)
+			continue;
+
+		if (match_key(key, "rchar:", &line, &ps->rchar) ||
+			match_key(key, "wchar:", &line, &ps->wchar) ||
+			match_key(key, "read_bytes:", &line, &ps->read_bytes) ||
+			match_key(key, "write_bytes:", &line, &ps->write_bytes) ||
+			match_key(key, "cancelled_write_bytes:", &line,
+					  &ps->cancelled_write_bytes))
+			continue;
+	}
+}
+
+/*
+ * Get statistics of the process from /proc/<pid>/stat, status and io.
+ *
+ * Return false if the process has exited meanwhile.
+ */
+bool
+get_pid_stat(int pid, PidStat * ps)
+{
+	char	   *buf;
+	char	   *line;
+	ssize_t		len;
+
+	memset(ps, 0, sizeof(PidStat));
+	ps->pid = pid;
+
+	/* /proc/<pid>/stat */
+	if ((buf = read_pid_file(pid, "stat", &len)) == NULL)
+		return false;
+
+	if (!parse_pid_stat(buf, ps))
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_EXCEPTION),
+				 errmsg("unexpected file format: \"/proc/%d/stat\"", pid),
+				 errdetail("number of fields is not corresponding")));
+
+	/* /proc/<pid>/status */
+	if ((buf = read_pid_file(pid, "status", &len)) == NULL)
+		return false;
+
+	while ((line = pl_next_line(&buf)) != NULL)
+	{
+		char	   *key = pl_next_token(&line);
+
+		if (key == NULL)
+			continue;
+
+		if (match_key(key, "VmRSS:", &line, &ps->vm_rss) ||
+			match_key(key, "RssAnon:", &line, &ps->rss_anon) ||
+			match_key(key, "RssFile:", &line, &ps->rss_file) ||
+			match_key(key, "RssShmem:", &line, &ps->rss_shmem) ||
+			match_key(key, "voluntary_ctxt_switches:", &line,
+					  &ps->voluntary_ctxt_switches) ||
+			match_key(key, "nonvoluntary_ctxt_switches:", &line,
+					  &ps->nonvoluntary_ctxt_switches))
+			continue;
+	}
+
+	read_pid_io(pid, ps);
+
+	return true;
+}
+
+typedef struct SmapsKey
+{
+	const char *key;
+	size_t		offset;			/* of the field in PidMemory */
+}			SmapsKey;
+
+static const SmapsKey smaps_keys[] = {
+	{"Rss:", offsetof(PidMemory, rss)},
+	{"Pss:", offsetof(PidMemory, pss)},
+	{"Pss_Anon:", offsetof(PidMemory, pss_anon)},
+	{"Pss_File:", offsetof(PidMemory, pss_file)},
+	{"Pss_Shmem:", offsetof(PidMemory, pss_shmem)},
+	{"Shared_Clean:", offsetof(PidMemory, shared_clean)},
+	{"Shared_Dirty:", offsetof(PidMemory, shared_dirty)},
+	{"Private_Clean:", offsetof(PidMemory, private_clean)},
+	{"Private_Dirty:", offsetof(PidMemory, private_dirty)},
+	{"Swap:", offsetof(PidMemory, swap)},
+	{"SwapPss:", offsetof(PidMemory, swap_pss)},
+	{"AnonHugePages:", offsetof(PidMemory, anon_huge_pages)},
+};
+
+/*
+ * Get memory usage of the process from /proc/<pid>/smaps_rollup.
+ *
+ * The file is parsed in place in the buffer of read_pid_file(), so no
+ * memory is allocated per process.  Pss_Anon, Pss_File and Pss_Shmem are
+ * left zero on kernels older than 5.9.  Return false if the process has
+ * exited meanwhile.
+ */
+bool
+get_pid_memory(int pid, PidMemory * pm)
+{
+	char	   *buf;
+	char	   *line;
+	ssize_t		len;
+
+	memset(pm, 0, sizeof(PidMemory));
+	pm->pid = pid;
+
+	if ((buf = read_pid_file(pid, "smaps_rollup", &len)) == NULL)
+		return false;
+
+	/* The first line is the range of the mappings; skip it. */
+	if (pl_next_line(&buf) == NULL)
+		return false;
+
+	/* "Pss:                1234 kB" */
+	while ((line = pl_next_line(&buf)) != NULL)
+	{
+		char	   *key = pl_next_token(&line);
+		int			i;
+
+		if (key == NULL)
+			continue;
+
+		for (i = 0; i < lengthof(smaps_keys); i++)
 		{
+			if (strcmp(smaps_keys[i].key, key) == 0)
+			{
+				if (!pl_parse_int64(&line,
+									(int64 *) ((char *) pm + smaps_keys[i].offset)))
+					ereport(ERROR,
+							(errcode(ERRCODE_DATA_EXCEPTION),
+							 errmsg("unexpected file format: \"/proc/%d/smaps_rollup\"", pid),
+							 errdetail("number of fields is not corresponding")));
+				break;
+			}
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Return a copy of the value of "key:\t<value>" in line, or NULL if line
+ * does not start with key.
+ */
+static char *
+match_key_string(const char *line, const char *key)
+{
+	size_t		len = strlen(key);
+
+	if (strncmp(line, key, len) != 0)
+		return NULL;
+
+	return pstrdup(pl_skip_blanks((char *) line + len));
+}
+
+/*
+ * Get the cpu last executed on from /proc/<pid>/stat, and the allowed
+ * cpus and memory nodes from /proc/<pid>/status.
+ *
+ * Return false if the process has exited meanwhile.
+ */
+bool
+get_pid_affinity(int pid, PidAffinity * pa)
+{
+	PidStat		ps;
+	char	   *buf;
+	char	   *line;
+	ssize_t		len;
+
+	memset(pa, 0, sizeof(PidAffinity));
+	pa->pid = pid;
+
+	if ((buf = read_pid_file(pid, "stat", &len)) == NULL)
+		return false;
+
+	memset(&ps, 0, sizeof(PidStat));
+	if (!parse_pid_stat(buf, &ps))
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_EXCEPTION),
+				 errmsg("unexpected file format: \"/proc/%d/stat\"", pid),
+				 errdetail("number of fields is not corresponding")));
+	pa->processor = ps.processor;
+
+	if ((buf = read_pid_file(pid, "status", &len)) == NULL)
+		return false;
+
+	/* "Cpus_allowed_list:\t0-15" */
+	while ((line = pl_next_line(&buf)) != NULL)
+	{
+		char	   *value;
+
+		if ((value = match_key_string(line, "Cpus_allowed_list:")) != NULL)
+			pa->cpus_allowed_list = value;
+		else if ((value = match_key_string(line, "Mems_allowed_list:")) != NULL)
+			pa->mems_allowed_list = value;
+	}
+
+	return true;
+}
+
+/*
+ * Get the scheduler state of the process.  This is called for each active
+ * backend at every ASH sample, so only the few files needed are read.
+ *
+ * Return false if the process has exited meanwhile.
+ */
+bool
+get_pid_sched(int pid, PidSched * ps)
+{
+	PidStat		st;
+	char	   *buf;
+	ssize_t		len;
+
+	memset(ps, 0, sizeof(PidSched));
+	ps->pid = pid;
 
-			ps = (ProcPid *) palloc0(sizeof(ProcPid));
+	if ((buf = read_pid_file(pid, "stat", &len)) == NULL)
+		return false;
 
-			if (sscanf(dp->d_name, "%ld", &(ps->pid)) != 1)
-				ereport(ERROR,
-						(errcode(ERRCODE_DATA_EXCEPTION),
-						 errmsg("unexpected file format: \"%s\"", DIR_PID),
-						 errdetail("number of fields is not corresponding")));
+	memset(&st, 0, sizeof(PidStat));
+	if (!parse_pid_stat(buf, &st))
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_EXCEPTION),
+				 errmsg("unexpected file format: \"/proc/%d/stat\"", pid),
+				 errdetail("number of fields is not corresponding")));
+	ps->state = st.state;
+	ps->processor = st.processor;
+
+	/* "cpu_time run_delay timeslices" in ns */
+	if ((buf = read_pid_file(pid, "schedstat", &len)) != NULL)
+	{
+		if (!pl_parse_int64(&buf, &ps->cpu_time) ||
+			!pl_parse_int64(&buf, &ps->run_delay))
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_EXCEPTION),
+					 errmsg("unexpected file format: \"/proc/%d/schedstat\"", pid),
+					 errdetail("number of fields is not corresponding")));
+	}
+
+	/* "do_epoll_wait", or "0" if it is running */
+	if ((buf = read_pid_file(pid, "wchan", &len)) != NULL &&
+		strcmp(buf, "0") != 0)
+		strlcpy(ps->wchan, buf, sizeof(ps->wchan));
+
+	return true;
+}
+
+/*
+ * A process of the first pass of pg_proc_top(), and of the second pass
+ * before it is turned into a PidTop.
+ */
+typedef struct PidTopEntry
+{
+	int			pid;			/* hash key */
+	int64		starttime;		/* tells a reused pid apart */
+	int			ppid;
+	char		state;
+	char		comm[PID_COMM_LEN];
+	int64		ticks;			/* utime + stime */
+	int64		rss;			/* in pages */
+	bool		io_valid;
+	int64		read_bytes;
+	int64		write_bytes;
+}			PidTopEntry;
+
+/*
+ * Read /proc/<pid>/stat and io into e.  Return false if the process has
+ * exited meanwhile.
+ */
+static bool
+read_pid_top(int pid, PidTopEntry * e)
+{
+	PidStat		ps;
+	char	   *buf;
+	char	   *lparen;
+	char	   *rparen;
+	ssize_t		len;
+
+	if ((buf = read_pid_file(pid, "stat", &len)) == NULL)
+		return false;
+
+	/* "pid (comm) state ..."; parse_pid_stat() overwrites what follows ')' */
+	if ((lparen = strchr(buf, '(')) == NULL ||
+		(rparen = strrchr(buf, ')')) == NULL || rparen < lparen)
+		return false;
+	strlcpy(e->comm, lparen + 1, Min(rparen - lparen, PID_COMM_LEN));
+
+	memset(&ps, 0, sizeof(PidStat));
+	if (!parse_pid_stat(buf, &ps))
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_EXCEPTION),
+				 errmsg("unexpected file format: \"/proc/%d/stat\"", pid),
+				 errdetail("number of fields is not corresponding")));
+
+	read_pid_io(pid, &ps);
+
+	e->starttime = ps.starttime;
+	e->ppid = ps.ppid;
+	e->state = ps.state;
+	e->ticks = ps.utime + ps.stime;
+	e->rss = ps.rss;
+	e->io_valid = ps.io_valid;
+	e->read_bytes = ps.read_bytes;
+	e->write_bytes = ps.write_bytes;
+
+	return true;
+}
+
+/*
+ * Take the first pass of pg_proc_top(): the stat and io counters of every
+ * process, in a hash table keyed by pid.  It is looked up once per process
+ * in the second pass, which a list could not do without a scan.
+ */
+HTAB *
+get_pid_top_snapshot(void)
+{
+	HTAB	   *htab;
+	HASHCTL		ctl;
+	DIR		   *dir;
+	struct dirent *dp;
+
+	ctl.keysize = sizeof(int);
+	ctl.entrysize = sizeof(PidTopEntry);
+	ctl.hcxt = CurrentMemoryContext;
+	htab = hash_create("pg_linux_proc top", 1024, &ctl,
+					   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	dir = AllocateDir(DIR_PID);
+	while ((dp = ReadDir(dir, DIR_PID)) != NULL)
+	{
+		int			pid = dirname_to_pid(dp->d_name);
+		PidTopEntry *e;
+
+		if (pid == 0)
+			continue;
+
+		e = (PidTopEntry *) hash_search(htab, &pid, HASH_ENTER, NULL);
+		if (!read_pid_top(pid, e))
+			hash_search(htab, &pid, HASH_REMOVE, NULL);
+	}
+	FreeDir(dir);
+
+	return htab;
+}
+
+static double
+pid_top_key(const PidTop * t, PidTopOrder order)
+{
+	switch (order)
+	{
+		case PID_TOP_CPU:
+			return t->cpu;
+		case PID_TOP_IO:
+			return t->read_bytes + t->write_bytes;
+		case PID_TOP_RSS:
+			return (double) t->rss_delta;
+	}
+	return 0;
+}
+
+/* Descending by the key of the order, then ascending by pid */
+static int
+pid_top_cmp(const void *a, const void *b, void *arg)
+{
+	const PidTop *ta = (const PidTop *) a;
+	const PidTop *tb = (const PidTop *) b;
+	PidTopOrder order = *(PidTopOrder *) arg;
+	double		ka = pid_top_key(ta, order);
+	double		kb = pid_top_key(tb, order);
+
+	if (ka != kb)
+		return (ka > kb) ? -1 : 1;
+	return (ta->pid < tb->pid) ? -1 : (ta->pid > tb->pid);
+}
+
+/*
+ * Take the second pass of pg_proc_top() elapsed seconds after prev, and
+ * return the top n processes by order.
+ *
+ * A process started between the passes is counted from zero, including one
+ * that reuses the pid of a process that has exited meanwhile, which is told
+ * apart by its start time.  cmdline is read only for the processes returned.
+ */
+List *
+get_pid_top(HTAB *prev, double elapsed, PidTopOrder order, int n)
+{
+	double		ticks_per_sec = (double) sysconf(_SC_CLK_TCK);
+	int64		page_kb = sysconf(_SC_PAGESIZE) / 1024;
+	PidTop	   *tops;
+	int			ntops = 0;
+	int			maxtops = 1024;
+	List	   *result = NIL;
+	DIR		   *dir;
+	struct dirent *dp;
+	int			i;
 
-			get_cmdline(ps->pid, ps->cmdline);
-			if (ps->cmdline != NULL)
-				stat = lappend(stat, ps);
+	if (elapsed <= 0)
+		elapsed = 1e-9;
+
+	tops = (PidTop *) palloc(sizeof(PidTop) * maxtops);
+
+	dir = AllocateDir(DIR_PID);
+	while ((dp = ReadDir(dir, DIR_PID)) != NULL)
+	{
+		int			pid = dirname_to_pid(dp->d_name);
+		PidTopEntry cur;
+		PidTopEntry *p;
+		PidTopEntry zero;
+		PidTop	   *t;
+
+		if (pid == 0)
+			continue;
+
+		memset(&cur, 0, sizeof(PidTopEntry));
+		if (!read_pid_top(pid, &cur))
+			continue;
+
+		p = (PidTopEntry *) hash_search(prev, &pid, HASH_FIND, NULL);
+		if (p == NULL || p->starttime != cur.starttime)
+		{
+			memset(&zero, 0, sizeof(PidTopEntry));
+			zero.io_valid = true;
+			p = &zero;
+		}
+
+		if (ntops == maxtops)
+		{
+			maxtops *= 2;
+			tops = (PidTop *) repalloc(tops, sizeof(PidTop) * maxtops);
 		}
+
+		t = &tops[ntops++];
+		memset(t, 0, sizeof(PidTop));
+		t->pid = pid;
+		t->ppid = cur.ppid;
+		t->postgres = (pid == PostmasterPid || cur.ppid == PostmasterPid);
+		t->state = cur.state;
+		memcpy(t->comm, cur.comm, PID_COMM_LEN);
+		t->cpu = (double) (cur.ticks - p->ticks) / ticks_per_sec / elapsed * 100.0;
+		t->io_valid = cur.io_valid && p->io_valid;
+		if (t->io_valid)
+		{
+			t->read_bytes = (double) (cur.read_bytes - p->read_bytes) / elapsed;
+			t->write_bytes = (double) (cur.write_bytes - p->write_bytes) / elapsed;
+		}
+		t->rss = cur.rss * page_kb;
+		t->rss_delta = (cur.rss - p->rss) * page_kb;
 	}
+	FreeDir(dir);
+
+	qsort_arg(tops, ntops, sizeof(PidTop), pid_top_cmp, &order);
 
-	closedir(dir);
+	for (i = 0; i < ntops && i < n; i++)
+	{
+		PidTop	   *t = &tops[i];
+		char	   *cmdline;
+		ssize_t		len;
+
+		if ((cmdline = read_pid_file(t->pid, "cmdline", &len)) != NULL)
+			t->cmdline = pnstrdup(cmdline, Min(strlen(cmdline), MAX_CMDLINE - 1));
+		else
+			t->cmdline = pstrdup("");
+
+		result = lappend(result, t);
+	}
 
-	return stat;
+	return result;
 }
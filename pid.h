@@ -13,16 +13,137 @@
 #ifndef __PROC_PID_H__
 #define __PROC_PID_H__
 
+#include "utils/hsearch.h"
+
 #define DIR_PID			"/proc"
 #define MAX_CMDLINE 512
+#define PID_COMM_LEN	16		/* TASK_COMM_LEN of the kernel */
 
 typedef struct ProcPid
 {
-	int64		pid;
-	char		cmdline[MAX_CMDLINE];
+	int			pid;
+	char	   *cmdline;		/* at most MAX_CMDLINE - 1 bytes */
 }			ProcPid;
 
+/*
+ * Per-process statistics from /proc/<pid>/stat, status and io.
+ */
+typedef struct PidStat
+{
+	int			pid;
+
+	/* /proc/<pid>/stat */
+	char		state;			/* R, S, D, Z, T, ... */
+	int			ppid;
+	int			processor;		/* cpu number last executed on */
+	int64		minflt;
+	int64		majflt;
+	int64		utime;			/* in clock ticks */
+	int64		stime;			/* in clock ticks */
+	int64		starttime;		/* in clock ticks after boot */
+	int64		rss;			/* in pages */
+
+	/* /proc/<pid>/status, in kB */
+	int64		vm_rss;
+	int64		rss_anon;
+	int64		rss_file;
+	int64		rss_shmem;
+	int64		voluntary_ctxt_switches;
+	int64		nonvoluntary_ctxt_switches;
+
+	/* /proc/<pid>/io; io_valid is false if it is not readable */
+	bool		io_valid;
+	int64		rchar;
+	int64		wchar;
+	int64		read_bytes;
+	int64		write_bytes;
+	int64		cancelled_write_bytes;
+}			PidStat;
+
+/*
+ * Memory usage of a process from /proc/<pid>/smaps_rollup, in kB.
+ *
+ * Pss charges each shared page to the processes mapping it in equal
+ * shares, so the Pss of all the processes attached to the shared memory
+ * adds up to the shared memory counted once.
+ */
+typedef struct PidMemory
+{
+	int			pid;
+	int64		rss;
+	int64		pss;
+	int64		pss_anon;
+	int64		pss_file;
+	int64		pss_shmem;
+	int64		shared_clean;
+	int64		shared_dirty;
+	int64		private_clean;
+	int64		private_dirty;
+	int64		swap;
+	int64		swap_pss;
+	int64		anon_huge_pages;
+}			PidMemory;
+
+/*
+ * CPU and memory node affinity of a process from /proc/<pid>/status.
+ */
+typedef struct PidAffinity
+{
+	int			pid;
+	int			processor;		/* cpu number last executed on */
+	char	   *cpus_allowed_list;	/* e.g. "0-15,32-47" */
+	char	   *mems_allowed_list;	/* e.g. "0-1" */
+}			PidAffinity;
+
+/*
+ * Scheduler state of a process from /proc/<pid>/stat, schedstat and wchan.
+ * cpu_time and run_delay are zero if the kernel has no schedstat.
+ */
+typedef struct PidSched
+{
+	int			pid;
+	char		state;			/* R, S, D, ... */
+	int			processor;		/* cpu number last executed on */
+	int64		cpu_time;		/* ns spent on a cpu */
+	int64		run_delay;		/* ns spent waiting on a runqueue */
+	char		wchan[64];		/* kernel function it sleeps in; "" if none */
+}			PidSched;
+
+typedef enum PidTopOrder
+{
+	PID_TOP_CPU,
+	PID_TOP_IO,
+	PID_TOP_RSS
+}			PidTopOrder;
+
+/*
+ * Usage of a process over the interval of pg_proc_top().  postgres is true
+ * for the postmaster and its children.
+ */
+typedef struct PidTop
+{
+	int			pid;
+	int			ppid;
+	bool		postgres;
+	char		state;
+	char		comm[PID_COMM_LEN];
+	char	   *cmdline;
+	double		cpu;			/* % of a cpu */
+	bool		io_valid;
+	double		read_bytes;		/* bytes/s */
+	double		write_bytes;	/* bytes/s */
+	int64		rss;			/* kB */
+	int64		rss_delta;		/* kB */
+}			PidTop;
+
 
-extern List *get_proc_pid(struct List *pid);
+extern List *get_proc_pid(struct List *pid, bool postgres_only);
+extern char *read_pid_file(int pid, const char *name, ssize_t *len);
+extern bool get_pid_stat(int pid, PidStat * ps);
+extern bool get_pid_memory(int pid, PidMemory * pm);
+extern bool get_pid_affinity(int pid, PidAffinity * pa);
+extern bool get_pid_sched(int pid, PidSched * ps);
+extern HTAB *get_pid_top_snapshot(void);
+extern List *get_pid_top(HTAB *prev, double elapsed, PidTopOrder order, int n);
 
 #endif
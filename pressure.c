@@ -0,0 +1,249 @@
+/*-------------------------------------------------------------------------
+ *
+ * pressure.c
+ *		Show /proc/pressure info (Pressure Stall Information) on Linux
+ *
+ * Besides reading the averages, a session can register a PSI trigger
+ * ("some 150000 1000000": 150ms of stall within any 1s window) by writing
+ * it to /proc/pressure/<resource>, and the kernel then signals POLLPRI on
+ * that descriptor when the threshold is crossed.  See
+ * Documentation/accounting/psi.rst of the kernel.
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "miscadmin.h"
+#include "portability/instr_time.h"
+#include "storage/fd.h"
+#include "storage/ipc.h"
+#include "storage/pmsignal.h"
+#include "utils/wait_event.h"
+
+#include "parse.h"
+#include "pressure.h"
+#include "procfile.h"
+
+static const char *pressure_resources[] = {"cpu", "memory", "io"};
+
+static ProcFile pressure_files[] = {
+	PROCFILE_INIT(DIR_PRESSURE "/cpu"),
+	PROCFILE_INIT(DIR_PRESSURE "/memory"),
+	PROCFILE_INIT(DIR_PRESSURE "/io"),
+};
+
+/* Longest sleep between checks for interrupts while waiting for a trigger */
+#define PRESSURE_POLL_SLICE_MS	100
+
+/*
+ * Parse "avg10=0.00" into value.
+ */
+static bool
+parse_pressure_float(char **pp, const char *key, float4 *value)
+{
+	char	   *tok = pl_next_token(pp);
+	size_t		len = strlen(key);
+
+	if (tok == NULL || strncmp(tok, key, len) != 0 || tok[len] != '=')
+		return false;
+
+	tok += len + 1;
+	return pl_parse_float4(&tok, value);
+}
+
+static bool
+parse_pressure_line(char *line, PressureStat * ps)
+{
+	char	   *kind = pl_next_token(&line);
+	char	   *tok;
+
+	if (kind == NULL || strlen(kind) >= sizeof(ps->kind))
+		return false;
+	strcpy(ps->kind, kind);
+
+	if (!parse_pressure_float(&line, "avg10", &ps->avg10) ||
+		!parse_pressure_float(&line, "avg60", &ps->avg60) ||
+		!parse_pressure_float(&line, "avg300", &ps->avg300))
+		return false;
+
+	tok = pl_next_token(&line);
+	if (tok == NULL || strncmp(tok, "total=", 6) != 0)
+		return false;
+	tok += 6;
+
+	return pl_parse_int64(&tok, &ps->total);
+}
+
+/*
+ * Append a PressureStat per line of buf, the contents of the pressure file
+ * path of resource.  This is shared with the cgroup *.pressure files,
+ * which have the same format.
+ */
+List *
+parse_pressure(char *buf, const char *resource, const char *path,
+			   List *pressure)
+{
+	char	   *line;
+
+	while ((line = pl_next_line(&buf)) != NULL)
+	{
+		PressureStat *ps = (PressureStat *) palloc0(sizeof(PressureStat));
+
+		ps->resource = resource;
+		if (!parse_pressure_line(line, ps))
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_EXCEPTION),
+					 errmsg("unexpected file format: \"%s\"", path),
+					 errdetail("number of fields is not corresponding")));
+
+		pressure = lappend(pressure, ps);
+	}
+
+	return pressure;
+}
+
+/*
+ * Append a PressureStat per line of /proc/pressure/{cpu,memory,io}.
+ *
+ * The "full" line of cpu exists only on 5.13 and later kernels.
+ */
+List *
+get_proc_pressure(List *pressure)
+{
+	int			r;
+
+	for (r = 0; r < lengthof(pressure_files); r++)
+	{
+		char	   *buf;
+		size_t		len;
+
+		buf = procfile_read(&pressure_files[r], &len);
+		pressure = parse_pressure(buf, pressure_resources[r],
+								  pressure_files[r].path, pressure);
+	}
+
+	return pressure;
+}
+
+/*
+ * Register a PSI trigger on resource and wait until it fires.
+ *
+ * Return true if the stall of kind ("some" or "full") exceeded
+ * threshold_us within a window_us window, or false if timeout_ms passed
+ * first.  The trigger lives as long as its descriptor, which is closed
+ * at the end of the transaction if we error out.
+ */
+bool
+pressure_wait(const char *resource, const char *kind,
+			  int64 threshold_us, int64 window_us, int64 timeout_ms)
+{
+	char		path[MAXPGPATH];
+	char		trigger[64];
+	struct pollfd pfd;
+	instr_time	start;
+	bool		fired = false;
+	int			r;
+
+	for (r = 0; r < lengthof(pressure_resources); r++)
+		if (strcmp(resource, pressure_resources[r]) == 0)
+			break;
+	if (r == lengthof(pressure_resources))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("invalid pressure resource: \"%s\"", resource),
+				 errhint("Valid resources are \"cpu\", \"memory\" and \"io\".")));
+
+	if (strcmp(kind, "some") != 0 && strcmp(kind, "full") != 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("invalid pressure kind: \"%s\"", kind),
+				 errhint("Valid kinds are \"some\" and \"full\".")));
+
+	if (window_us < PRESSURE_WINDOW_MIN_US || window_us > PRESSURE_WINDOW_MAX_US)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("window must be between %d and %d microseconds",
+						PRESSURE_WINDOW_MIN_US, PRESSURE_WINDOW_MAX_US)));
+
+	if (threshold_us <= 0 || threshold_us > window_us)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("threshold must be between 1 microsecond and the window")));
+
+	snprintf(path, sizeof(path), "%s/%s", DIR_PRESSURE, resource);
+	snprintf(trigger, sizeof(trigger), "%s " INT64_FORMAT " " INT64_FORMAT,
+			 kind, threshold_us, window_us);
+
+	if ((pfd.fd = OpenTransientFile(path, O_RDWR | O_NONBLOCK)) < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m", path)));
+
+	/* The kernel expects the terminating null byte too. */
+	if (write(pfd.fd, trigger, strlen(trigger) + 1) < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not register pressure trigger \"%s\" on \"%s\": %m",
+						trigger, path),
+				 errhint("Unprivileged triggers need a window that is a multiple of 2 seconds.")));
+
+	pfd.events = POLLPRI;
+
+	INSTR_TIME_SET_CURRENT(start);
+
+	for (;;)
+	{
+		instr_time	now;
+		int64		remaining_ms;
+		int			rc;
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (!PostmasterIsAlive())
+			proc_exit(1);
+
+		INSTR_TIME_SET_CURRENT(now);
+		INSTR_TIME_SUBTRACT(now, start);
+		remaining_ms = timeout_ms - (int64) INSTR_TIME_GET_MILLISEC(now);
+		if (remaining_ms <= 0)
+			break;
+
+		pgstat_report_wait_start(PG_WAIT_EXTENSION);
+		rc = poll(&pfd, 1, (int) Min(remaining_ms, PRESSURE_POLL_SLICE_MS));
+		pgstat_report_wait_end();
+
+		if (rc < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not poll file \"%s\": %m", path)));
+		}
+		if (rc == 0)
+			continue;
+
+		if (pfd.revents & POLLERR)
+			ereport(ERROR,
+					(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+					 errmsg("pressure trigger on \"%s\" was removed", path)));
+
+		if (pfd.revents & POLLPRI)
+		{
+			fired = true;
+			break;
+		}
+	}
+
+	CloseTransientFile(pfd.fd);
+
+	return fired;
+}
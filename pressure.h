@@ -0,0 +1,49 @@
+/*-------------------------------------------------------------------------
+ *
+ * pressure.h
+ *		Show /proc/pressure info (Pressure Stall Information) on Linux
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#ifndef __PRESSURE_H__
+#define __PRESSURE_H__
+
+#include "nodes/pg_list.h"
+
+#define DIR_PRESSURE			"/proc/pressure"
+
+/*
+ * Trigger window limits of the kernel (kernel/sched/psi.c), in us.
+ * Unprivileged processes may only use windows that are multiples of 2s.
+ */
+#define PRESSURE_WINDOW_MIN_US	500000
+#define PRESSURE_WINDOW_MAX_US	10000000
+
+/*
+ * One line of /proc/pressure/<resource>:
+ * "some avg10=0.00 avg60=0.00 avg300=0.00 total=0"
+ */
+typedef struct PressureStat
+{
+	const char *resource;		/* "cpu", "memory" or "io" */
+	char		kind[5];		/* "some" or "full" */
+	float4		avg10;			/* percentage of time stalled */
+	float4		avg60;
+	float4		avg300;
+	int64		total;			/* total stall time in us */
+}			PressureStat;
+
+
+extern List *parse_pressure(char *buf, const char *resource,
+							 const char *path, List *pressure);
+extern List *get_proc_pressure(List *pressure);
+extern bool pressure_wait(const char *resource, const char *kind,
+						  int64 threshold_us, int64 window_us,
+						  int64 timeout_ms);
+
+#endif
@@ -0,0 +1,185 @@
+/*-------------------------------------------------------------------------
+ *
+ * procfile.c
+ *		Cached descriptors of fixed /proc files
+ *
+ * Files such as /proc/stat and /proc/meminfo are read again and again by
+ * monitoring sessions.  Instead of open() and close() on each call, the
+ * descriptor is kept open and the file is re-read with pread() from
+ * offset zero, which makes the kernel regenerate its contents.  The read
+ * buffer is kept too, so a call costs the pread() calls only.
+ *
+ * The descriptors are reserved with AcquireExternalFD(), so that they are
+ * accounted in max_files_per_process.  If no descriptor can be reserved,
+ * the file is opened and closed on each call as before.
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "storage/fd.h"
+#include "utils/memutils.h"
+
+#include "procfile.h"
+
+#define PROCFILE_INIT_BUFSIZE	4096
+
+/*
+ * Open pf->path.  Return true if the descriptor can be kept open.
+ *
+ * If missing_ok is true and the file does not exist, pf->fd is left -1.
+ */
+static bool
+procfile_open(ProcFile * pf, bool missing_ok)
+{
+	bool		keep = AcquireExternalFD();
+
+	if ((pf->fd = open(pf->path, O_RDONLY | O_CLOEXEC)) < 0)
+	{
+		if (keep)
+			ReleaseExternalFD();
+		if (missing_ok && errno == ENOENT)
+			return false;
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m", pf->path)));
+	}
+
+	return keep;
+}
+
+void
+procfile_close(ProcFile * pf)
+{
+	if (pf->fd >= 0)
+	{
+		close(pf->fd);
+		ReleaseExternalFD();
+		pf->fd = -1;
+	}
+}
+
+/*
+ * Read the whole file from offset zero into pf->buf.
+ *
+ * Return -1 with errno set on failure.
+ */
+static ssize_t
+procfile_pread(ProcFile * pf, int fd)
+{
+	size_t		total = 0;
+
+	for (;;)
+	{
+		ssize_t		nbytes;
+
+		if (total == pf->bufsize - 1)
+		{
+			pf->buf = repalloc(pf->buf, pf->bufsize * 2);
+			pf->bufsize *= 2;
+		}
+
+		nbytes = pread(fd, pf->buf + total, pf->bufsize - 1 - total, total);
+		if (nbytes < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (nbytes == 0)
+			break;
+		total += nbytes;
+	}
+
+	pf->buf[total] = '\0';
+	return (ssize_t) total;
+}
+
+/*
+ * Read the whole file, and return the null-terminated contents.
+ *
+ * The returned buffer belongs to pf and is overwritten by the next call;
+ * callers may modify it in place while parsing.
+ */
+char *
+procfile_read(ProcFile * pf, size_t *len)
+{
+	return procfile_read_extended(pf, len, false);
+}
+
+/*
+ * Same as procfile_read(), but if missing_ok is true, return NULL if the
+ * file does not exist, such as a cgroup file of a disabled controller.
+ */
+char *
+procfile_read_extended(ProcFile * pf, size_t *len, bool missing_ok)
+{
+	ssize_t		nbytes;
+	int			retry;
+
+	if (pf->buf == NULL)
+	{
+		pf->buf = MemoryContextAlloc(TopMemoryContext, PROCFILE_INIT_BUFSIZE);
+		pf->bufsize = PROCFILE_INIT_BUFSIZE;
+	}
+
+	for (retry = 0;; retry++)
+	{
+		if (pf->fd < 0)
+		{
+			if (!procfile_open(pf, missing_ok))
+			{
+				/* No descriptor to spare; read once and close. */
+				int			fd = pf->fd;
+				int			save_errno;
+
+				if (fd < 0)
+					return NULL;	/* missing */
+
+				pf->fd = -1;
+				nbytes = procfile_pread(pf, fd);
+				save_errno = errno;
+				close(fd);
+				errno = save_errno;
+				break;
+			}
+		}
+
+		nbytes = procfile_pread(pf, pf->fd);
+		if (nbytes >= 0)
+			break;
+
+		/*
+		 * The file has gone away under the descriptor, e.g. a cgroup was
+		 * removed or the filesystem was remounted.  Reopen it once.
+		 */
+		if (retry == 0 &&
+			(errno == ENOENT || errno == ESTALE || errno == ENODEV))
+		{
+			procfile_close(pf);
+			continue;
+		}
+		break;
+	}
+
+	if (nbytes < 0)
+	{
+		int			save_errno = errno;
+
+		procfile_close(pf);
+		errno = save_errno;
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read file \"%s\": %m", pf->path)));
+	}
+
+	*len = (size_t) nbytes;
+	return pf->buf;
+}
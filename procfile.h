@@ -0,0 +1,37 @@
+/*-------------------------------------------------------------------------
+ *
+ * procfile.h
+ *		Cached descriptors of fixed /proc files
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#ifndef __PROCFILE_H__
+#define __PROCFILE_H__
+
+/*
+ * A /proc file whose descriptor is kept open for the life of the backend.
+ *
+ * Each collector has a static ProcFile, and procfile_read() re-reads it
+ * from offset zero with pread() into the buffer of the ProcFile.
+ */
+typedef struct ProcFile
+{
+	const char *path;
+	int			fd;				/* -1 if not opened */
+	char	   *buf;			/* allocated in TopMemoryContext */
+	size_t		bufsize;
+}			ProcFile;
+
+#define PROCFILE_INIT(path)	{(path), -1, NULL, 0}
+
+extern char *procfile_read(ProcFile * pf, size_t *len);
+extern char *procfile_read_extended(ProcFile * pf, size_t *len,
+									bool missing_ok);
+extern void procfile_close(ProcFile * pf);
+
+#endif
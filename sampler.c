@@ -0,0 +1,438 @@
+/*-------------------------------------------------------------------------
+ *
+ * sampler.c
+ *		Background sampler and shared-memory history of pg_linux_proc
+ *
+ * A background worker reads /proc/loadavg, /proc/meminfo, /proc/stat and
+ * /proc/diskstats every pg_linux_proc.sample_interval and stores the
+ * results into a fixed-size ring buffer in shared memory.  The history
+ * functions, such as pg_proc_stat_history(), read the ring buffer, so
+ * clients don't need to poll the live functions to keep a history.  The
+ * samples are also appended to the on-disk store of store.c.
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "nodes/pg_list.h"
+#include "pgstat.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/interrupt.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "tcop/tcopprot.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+
+#include "pg_linux_proc.h"
+#include "sampler.h"
+#include "store.h"
+
+#define SAMPLER_TRANCHE_NAME	"pg_linux_proc sampler"
+
+/*
+ * Shared state of the history ring buffer.
+ *
+ * next is the number of samples written since server start; the newest
+ * sample is in slot (next - 1) % size.  Slots are written by the sampler
+ * under the exclusive lock and read by backends under the shared lock.
+ */
+typedef struct SamplerShared
+{
+	LWLock	   *lock;
+	int			size;			/* number of slots */
+	int			max_cpus;		/* capacity of ProcStat array per slot */
+	int			max_devices;	/* capacity of DiskStat array per slot */
+	Size		slot_size;
+	uint64		next;
+	char		slots[FLEXIBLE_ARRAY_MEMBER];
+}			SamplerShared;
+
+/* GUC variables */
+int			sampler_interval = 10000;	/* ms */
+int			sampler_history_size = 360;
+
+static SamplerShared * sampler = NULL;
+
+#define SamplerSlot(s, n) \
+	((HistorySample *) ((s)->slots + (s)->slot_size * ((n) % (s)->size)))
+
+static Size
+sampler_slot_size(int max_cpus, int max_devices)
+{
+	return MAXALIGN(MAXALIGN(sizeof(HistorySample))
+					+ MAXALIGN(sizeof(ProcStat) * max_cpus)
+					+ sizeof(DiskStat) * max_devices);
+}
+
+void
+sampler_define_gucs(void)
+{
+	DefineCustomIntVariable("pg_linux_proc.sample_interval",
+							"Sets the interval between samples of the background sampler.",
+							NULL,
+							&sampler_interval,
+							10000,
+							100,
+							INT_MAX,
+							PGC_SIGHUP,
+							GUC_UNIT_MS,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("pg_linux_proc.history_size",
+							"Sets the number of samples kept in the history ring buffer.",
+							"Zero disables the background sampler.",
+							&sampler_history_size,
+							360,
+							0,
+							INT_MAX / 2,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+}
+
+void
+sampler_register_worker(void)
+{
+	BackgroundWorker worker;
+
+	if (sampler_history_size <= 0)
+		return;
+
+	memset(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	worker.bgw_start_time = BgWorkerStart_PostmasterStart;
+	worker.bgw_restart_time = 10;
+	sprintf(worker.bgw_library_name, "pg_linux_proc");
+	sprintf(worker.bgw_function_name, "pg_linux_proc_sampler_main");
+	snprintf(worker.bgw_name, BGW_MAXLEN, "pg_linux_proc sampler");
+	snprintf(worker.bgw_type, BGW_MAXLEN, "pg_linux_proc sampler");
+	worker.bgw_main_arg = (Datum) 0;
+	worker.bgw_notify_pid = 0;
+
+	RegisterBackgroundWorker(&worker);
+}
+
+Size
+sampler_shmem_size(void)
+{
+	Size		size;
+
+	if (sampler_history_size <= 0)
+		return 0;
+
+	size = offsetof(SamplerShared, slots);
+	size = add_size(size, mul_size(sampler_slot_size(proc_max_cpus(),
+													 proc_max_devices),
+								   sampler_history_size));
+	return size;
+}
+
+void
+sampler_shmem_request(void)
+{
+	if (sampler_history_size <= 0)
+		return;
+
+	RequestAddinShmemSpace(sampler_shmem_size());
+	RequestNamedLWLockTranche(SAMPLER_TRANCHE_NAME, 1);
+}
+
+void
+sampler_shmem_startup(void)
+{
+	bool		found;
+
+	if (sampler_history_size <= 0)
+		return;
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	sampler = ShmemInitStruct("pg_linux_proc sampler",
+							  sampler_shmem_size(),
+							  &found);
+	if (!found)
+	{
+		sampler->lock = &(GetNamedLWLockTranche(SAMPLER_TRANCHE_NAME))->lock;
+		sampler->size = sampler_history_size;
+		sampler->max_cpus = proc_max_cpus();
+		sampler->max_devices = proc_max_devices;
+		sampler->slot_size = sampler_slot_size(sampler->max_cpus,
+											   sampler->max_devices);
+		sampler->next = 0;
+	}
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+/*
+ * Read all sources and store them into the next slot of the ring buffer.
+ *
+ * The files are read and parsed before taking the lock, so readers are
+ * blocked only while the slot is copied.
+ */
+static void
+sampler_take_sample(void)
+{
+	LoadAvg		loadavg;
+	MemInfo		meminfo;
+	List	   *stats = NIL;
+	List	   *disks = NIL;
+	ListCell   *lc;
+	HistorySample *slot;
+	ProcStat   *slot_stats;
+	DiskStat   *slot_disks;
+	TimestampTz ts;
+	int			n;
+
+	ts = GetCurrentTimestamp();
+	get_proc_loadavg(&loadavg);
+	get_proc_meminfo(&meminfo, NULL);
+	stats = get_proc_stat(stats);
+	disks = get_proc_diskstats(disks);
+
+	LWLockAcquire(sampler->lock, LW_EXCLUSIVE);
+
+	slot = SamplerSlot(sampler, sampler->next);
+	slot_stats = HistorySampleStats(slot);
+	slot_disks = HistorySampleDisks(slot, sampler->max_cpus);
+
+	slot->ts = ts;
+	slot->loadavg = loadavg;
+	slot->meminfo = meminfo;
+
+	n = 0;
+	foreach(lc, stats)
+	{
+		if (n >= sampler->max_cpus)
+			break;
+		slot_stats[n++] = *(ProcStat *) lfirst(lc);
+	}
+	slot->nstat = n;
+
+	n = 0;
+	foreach(lc, disks)
+	{
+		if (n >= sampler->max_devices)
+			break;
+		slot_disks[n++] = *(DiskStat *) lfirst(lc);
+	}
+	slot->ndisk = n;
+
+	sampler->next++;
+
+	LWLockRelease(sampler->lock);
+
+	store_append(ts, &loadavg, &meminfo, stats, disks);
+}
+
+void
+pg_linux_proc_sampler_main(Datum main_arg)
+{
+	MemoryContext sample_context;
+
+	pqsignal(SIGHUP, SignalHandlerForConfigReload);
+	pqsignal(SIGTERM, die);
+	BackgroundWorkerUnblockSignals();
+
+	sample_context = AllocSetContextCreate(TopMemoryContext,
+										   "pg_linux_proc sampler",
+										   ALLOCSET_DEFAULT_SIZES);
+
+	for (;;)
+	{
+		MemoryContext oldcontext;
+		TimestampTz start;
+		long		elapsed;
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (ConfigReloadPending)
+		{
+			ConfigReloadPending = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		start = GetCurrentTimestamp();
+
+		oldcontext = MemoryContextSwitchTo(sample_context);
+		sampler_take_sample();
+		MemoryContextSwitchTo(oldcontext);
+		MemoryContextReset(sample_context);
+
+		/* Sleep until the next sampling time, not for a whole interval. */
+		elapsed = (long) ((GetCurrentTimestamp() - start) / 1000);
+
+		(void) WaitLatch(MyLatch,
+						 WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+						 Max(sampler_interval - elapsed, 0),
+						 PG_WAIT_EXTENSION);
+		ResetLatch(MyLatch);
+	}
+}
+
+/*
+ * Return copies of the samples taken after since, oldest first.
+ *
+ * *max_cpus is set to the ProcStat capacity of the slots, which is needed
+ * to locate the DiskStat array of each sample.
+ */
+List *
+sampler_get_history(TimestampTz since, int *max_cpus)
+{
+	List	   *samples = NIL;
+	uint64		first;
+	uint64		n;
+
+	if (sampler == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("pg_linux_proc history is not available"),
+				 errhint("pg_linux_proc must be loaded via shared_preload_libraries, and pg_linux_proc.history_size must be greater than zero.")));
+
+	*max_cpus = sampler->max_cpus;
+
+	LWLockAcquire(sampler->lock, LW_SHARED);
+
+	first = (sampler->next > (uint64) sampler->size) ?
+		sampler->next - sampler->size : 0;
+
+	for (n = first; n < sampler->next; n++)
+	{
+		HistorySample *slot = SamplerSlot(sampler, n);
+		HistorySample *copy;
+
+		if (slot->ts <= since)
+			continue;
+
+		copy = (HistorySample *) palloc(sampler->slot_size);
+		memcpy(copy, slot, sampler->slot_size);
+		samples = lappend(samples, copy);
+	}
+
+	LWLockRelease(sampler->lock);
+
+	return samples;
+}
+
+/*
+ * History functions
+ *
+ * Each function returns the same columns as its live counterpart,
+ * preceded by the sampling time.
+ */
+
+PG_FUNCTION_INFO_V1(pg_proc_loadavg_history);
+PG_FUNCTION_INFO_V1(pg_proc_diskstats_history);
+PG_FUNCTION_INFO_V1(pg_proc_meminfo_history);
+PG_FUNCTION_INFO_V1(pg_proc_stat_history);
+
+typedef enum HistorySource
+{
+	HISTORY_LOADAVG,
+	HISTORY_DISKSTATS,
+	HISTORY_MEMINFO,
+	HISTORY_STAT
+}			HistorySource;
+
+static void
+history_srf(FunctionCallInfo fcinfo, HistorySource source)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TimestampTz since = PG_GETARG_TIMESTAMPTZ(0);
+	Datum		values[1 + NUM_MEMINFO_VALUES];
+	bool		nulls[1 + NUM_MEMINFO_VALUES];
+	List	   *samples;
+	ListCell   *lc;
+	int			max_cpus;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	samples = sampler_get_history(since, &max_cpus);
+
+	memset(nulls, false, sizeof(nulls));
+
+	foreach(lc, samples)
+	{
+		HistorySample *s = (HistorySample *) lfirst(lc);
+		int			i;
+
+		values[0] = TimestampTzGetDatum(s->ts);
+
+		switch (source)
+		{
+			case HISTORY_LOADAVG:
+				loadavg_values(&s->loadavg, values + 1);
+				tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc,
+									 values, nulls);
+				break;
+
+			case HISTORY_MEMINFO:
+				meminfo_values(&s->meminfo, values + 1);
+				tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc,
+									 values, nulls);
+				break;
+
+			case HISTORY_STAT:
+				for (i = 0; i < s->nstat; i++)
+				{
+					stat_values(&HistorySampleStats(s)[i], values + 1);
+					tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc,
+										 values, nulls);
+				}
+				break;
+
+			case HISTORY_DISKSTATS:
+				for (i = 0; i < s->ndisk; i++)
+				{
+					diskstats_values(&HistorySampleDisks(s, max_cpus)[i],
+									 values + 1);
+					tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc,
+										 values, nulls);
+				}
+				break;
+		}
+	}
+}
+
+Datum
+pg_proc_loadavg_history(PG_FUNCTION_ARGS)
+{
+	history_srf(fcinfo, HISTORY_LOADAVG);
+	return (Datum) 0;
+}
+
+Datum
+pg_proc_diskstats_history(PG_FUNCTION_ARGS)
+{
+	history_srf(fcinfo, HISTORY_DISKSTATS);
+	return (Datum) 0;
+}
+
+Datum
+pg_proc_meminfo_history(PG_FUNCTION_ARGS)
+{
+	history_srf(fcinfo, HISTORY_MEMINFO);
+	return (Datum) 0;
+}
+
+Datum
+pg_proc_stat_history(PG_FUNCTION_ARGS)
+{
+	history_srf(fcinfo, HISTORY_STAT);
+	return (Datum) 0;
+}
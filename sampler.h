@@ -0,0 +1,59 @@
+/*-------------------------------------------------------------------------
+ *
+ * sampler.h
+ *		Background sampler and shared-memory history of pg_linux_proc
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#ifndef __SAMPLER_H__
+#define __SAMPLER_H__
+
+#include "datatype/timestamp.h"
+
+#include "loadavg.h"
+#include "diskstats.h"
+#include "meminfo.h"
+#include "stat.h"
+
+/*
+ * One slot of the history ring buffer.
+ *
+ * The ProcStat and DiskStat arrays follow the fixed part; their capacity
+ * is fixed at server start (see SamplerShared), so every slot has the
+ * same size.
+ */
+typedef struct HistorySample
+{
+	TimestampTz ts;				/* sampling time */
+	LoadAvg		loadavg;
+	MemInfo		meminfo;
+	int			nstat;			/* number of valid ProcStat entries */
+	int			ndisk;			/* number of valid DiskStat entries */
+}			HistorySample;
+
+#define HistorySampleStats(s) \
+	((ProcStat *) ((char *) (s) + MAXALIGN(sizeof(HistorySample))))
+#define HistorySampleDisks(s, max_cpus) \
+	((DiskStat *) ((char *) HistorySampleStats(s) + \
+				   MAXALIGN(sizeof(ProcStat) * (max_cpus))))
+
+/* GUC variables */
+extern int	sampler_interval;
+extern int	sampler_history_size;
+
+extern void sampler_define_gucs(void);
+extern void sampler_register_worker(void);
+extern Size sampler_shmem_size(void);
+extern void sampler_shmem_request(void);
+extern void sampler_shmem_startup(void);
+
+extern List *sampler_get_history(TimestampTz since, int *max_cpus);
+
+extern PGDLLEXPORT void pg_linux_proc_sampler_main(Datum main_arg);
+
+#endif
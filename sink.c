@@ -0,0 +1,488 @@
+/*-------------------------------------------------------------------------
+ *
+ * sink.c
+ *		Table sink of the sampled history of pg_linux_proc
+ *
+ * When pg_linux_proc.sink_database is set, a background worker connected
+ * to that database copies the samples of the history ring buffer into
+ * pg_linux_proc.sink_table every pg_linux_proc.sink_flush_interval, one
+ * row per sample, item and metric as in pg_proc_history().  The table can
+ * then be joined with other data, or published for logical replication.
+ *
+ * The rows are written as COPY does: with table_multi_insert() in batches
+ * of pg_linux_proc.sink_batch_size rows, through a bulk insert state, in a
+ * single transaction per flush.  Indexes are maintained and NOT NULL and
+ * CHECK constraints are checked, but triggers are not fired.
+ *
+ * The sampling time of the last sample written is kept in shared memory,
+ * so a restart of the worker neither loses nor duplicates the samples
+ * still in the ring buffer.  The worker flushes at least twice per turn of
+ * the ring buffer, whatever the interval, so that no sample is overwritten
+ * before it is written.
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/heapam.h"
+#include "access/table.h"
+#include "access/tableam.h"
+#include "access/xact.h"
+#include "catalog/namespace.h"
+#include "catalog/pg_type.h"
+#include "executor/executor.h"
+#include "miscadmin.h"
+#include "parser/parse_relation.h"
+#include "pgstat.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/interrupt.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/shmem.h"
+#include "tcop/tcopprot.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+#include "utils/snapmgr.h"
+#include "utils/timestamp.h"
+#include "utils/varlena.h"
+
+#include "sampler.h"
+#include "sink.h"
+#include "store.h"
+
+/* The columns of the sink table, as pg_proc_history() with the source */
+#define NUM_SINK_COLS	5
+
+static const Oid sink_col_types[NUM_SINK_COLS] = {
+	TIMESTAMPTZOID, TEXTOID, TEXTOID, TEXTOID, FLOAT8OID
+};
+
+/*
+ * Shared state of the sink.  last_ts is only read and written by the
+ * worker; it is in shared memory to survive a restart of the worker.
+ */
+typedef struct SinkShared
+{
+	TimestampTz last_ts;		/* of the last sample written */
+}			SinkShared;
+
+/* GUC variables */
+char	   *sink_database = NULL;
+char	   *sink_table = NULL;
+int			sink_flush_interval = 60000;	/* ms */
+int			sink_batch_size = 1000;
+
+static SinkShared * sink = NULL;
+
+/* State of a flush */
+typedef struct SinkState
+{
+	Relation	rel;
+	EState	   *estate;
+	ResultRelInfo *rri;
+	BulkInsertState bistate;
+	CommandId	cid;
+	AttrNumber	attnums[NUM_SINK_COLS];
+	TupleTableSlot **slots;
+	int			nslots;			/* filled */
+	MemoryContext batch_context;	/* of the values of the filled slots */
+	TimestampTz ts;				/* of the sample being written */
+	int64		rows;
+}			SinkState;
+
+static bool
+sink_enabled(void)
+{
+	return sink_database != NULL && sink_database[0] != '\0' &&
+		sampler_history_size > 0;
+}
+
+void
+sink_define_gucs(void)
+{
+	DefineCustomStringVariable("pg_linux_proc.sink_database",
+							   "Sets the database of the table the sampled history is written into.",
+							   "Empty disables the sink.",
+							   &sink_database,
+							   "",
+							   PGC_POSTMASTER,
+							   0,
+							   NULL,
+							   NULL,
+							   NULL);
+
+	DefineCustomStringVariable("pg_linux_proc.sink_table",
+							   "Sets the table the sampled history is written into.",
+							   NULL,
+							   &sink_table,
+							   "pg_linux_proc_samples",
+							   PGC_SIGHUP,
+							   0,
+							   NULL,
+							   NULL,
+							   NULL);
+
+	DefineCustomIntVariable("pg_linux_proc.sink_flush_interval",
+							"Sets the interval between writes of the sampled history into the table.",
+							NULL,
+							&sink_flush_interval,
+							60000,
+							100,
+							INT_MAX,
+							PGC_SIGHUP,
+							GUC_UNIT_MS,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("pg_linux_proc.sink_batch_size",
+							"Sets the number of rows inserted at once into the table.",
+							NULL,
+							&sink_batch_size,
+							1000,
+							1,
+							65536,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+}
+
+void
+sink_register_worker(void)
+{
+	BackgroundWorker worker;
+
+	if (!sink_enabled())
+		return;
+
+	memset(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS | BGWORKER_BACKEND_DATABASE_CONNECTION;
+	worker.bgw_start_time = BgWorkerStart_RecoveryFinished;
+	worker.bgw_restart_time = 10;
+	sprintf(worker.bgw_library_name, "pg_linux_proc");
+	sprintf(worker.bgw_function_name, "pg_linux_proc_sink_main");
+	snprintf(worker.bgw_name, BGW_MAXLEN, "pg_linux_proc sink");
+	snprintf(worker.bgw_type, BGW_MAXLEN, "pg_linux_proc sink");
+	worker.bgw_main_arg = (Datum) 0;
+	worker.bgw_notify_pid = 0;
+
+	RegisterBackgroundWorker(&worker);
+}
+
+Size
+sink_shmem_size(void)
+{
+	if (!sink_enabled())
+		return 0;
+
+	return sizeof(SinkShared);
+}
+
+void
+sink_shmem_request(void)
+{
+	if (!sink_enabled())
+		return;
+
+	RequestAddinShmemSpace(sink_shmem_size());
+}
+
+void
+sink_shmem_startup(void)
+{
+	bool		found;
+
+	if (!sink_enabled())
+		return;
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	sink = ShmemInitStruct("pg_linux_proc sink",
+						   sink_shmem_size(),
+						   &found);
+	if (!found)
+		sink->last_ts = DT_NOBEGIN;
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+/*
+ * Open the sink table and check that its columns are those of
+ * pg_proc_history() preceded by the source.
+ */
+static Relation
+sink_open_table(AttrNumber *attnums)
+{
+	RangeVar   *rv;
+	Relation	rel;
+	TupleDesc	tupdesc;
+	int			ncols = 0;
+	int			i;
+
+	rv = makeRangeVarFromNameList(stringToQualifiedNameList(sink_table, NULL));
+	rel = table_openrv(rv, RowExclusiveLock);
+
+	if (rel->rd_rel->relkind != RELKIND_RELATION)
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("\"%s\" is not a table", RelationGetRelationName(rel))));
+
+	tupdesc = RelationGetDescr(rel);
+	for (i = 0; i < tupdesc->natts; i++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+
+		if (attr->attisdropped)
+			continue;
+		if (ncols == NUM_SINK_COLS || attr->atttypid != sink_col_types[ncols])
+			break;
+		attnums[ncols++] = attr->attnum;
+	}
+	if (i < tupdesc->natts || ncols != NUM_SINK_COLS)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATATYPE_MISMATCH),
+				 errmsg("table \"%s\" does not have the columns of the pg_linux_proc sink",
+						RelationGetRelationName(rel)),
+				 errhint("The columns must be (ts timestamptz, source text, item text, metric text, value float8).")));
+
+	return rel;
+}
+
+/*
+ * Set up an executor state to maintain the indexes and check the
+ * constraints, as the apply worker of logical replication does.
+ */
+static void
+sink_init_executor(SinkState * st)
+{
+	RangeTblEntry *rte;
+	List	   *perminfos = NIL;
+
+	st->estate = CreateExecutorState();
+
+	rte = makeNode(RangeTblEntry);
+	rte->rtekind = RTE_RELATION;
+	rte->relid = RelationGetRelid(st->rel);
+	rte->relkind = st->rel->rd_rel->relkind;
+	rte->rellockmode = RowExclusiveLock;
+	addRTEPermissionInfo(&perminfos, rte);
+	ExecInitRangeTable(st->estate, list_make1(rte), perminfos);
+
+	st->rri = makeNode(ResultRelInfo);
+	InitResultRelInfo(st->rri, st->rel, 1, NULL, 0);
+	st->estate->es_output_cid = st->cid;
+
+	ExecOpenIndices(st->rri, false);
+}
+
+/* Insert the filled slots */
+static void
+sink_flush_batch(SinkState * st)
+{
+	int			i;
+
+	if (st->nslots == 0)
+		return;
+
+	if (st->rel->rd_att->constr)
+	{
+		for (i = 0; i < st->nslots; i++)
+			ExecConstraints(st->rri, st->slots[i], st->estate);
+	}
+
+	table_multi_insert(st->rel, st->slots, st->nslots, st->cid, 0, st->bistate);
+
+	if (st->rri->ri_NumIndices > 0)
+	{
+		for (i = 0; i < st->nslots; i++)
+		{
+			List	   *recheck;
+
+			recheck = ExecInsertIndexTuples(st->rri, st->slots[i], st->estate,
+											false, false, NULL, NIL, false);
+			list_free(recheck);
+			ResetPerTupleExprContext(st->estate);
+		}
+	}
+
+	for (i = 0; i < st->nslots; i++)
+		ExecClearTuple(st->slots[i]);
+
+	st->rows += st->nslots;
+	st->nslots = 0;
+	MemoryContextReset(st->batch_context);
+}
+
+static void
+sink_add_row(void *arg, const char *source, const char *item,
+			 const char *metric, double value)
+{
+	SinkState  *st = (SinkState *) arg;
+	TupleTableSlot *slot = st->slots[st->nslots];
+	MemoryContext oldcontext;
+
+	ExecClearTuple(slot);
+	memset(slot->tts_isnull, true, sizeof(bool) * slot->tts_tupleDescriptor->natts);
+
+	oldcontext = MemoryContextSwitchTo(st->batch_context);
+
+	slot->tts_values[st->attnums[0] - 1] = TimestampTzGetDatum(st->ts);
+	slot->tts_isnull[st->attnums[0] - 1] = false;
+	slot->tts_values[st->attnums[1] - 1] = CStringGetTextDatum(source);
+	slot->tts_isnull[st->attnums[1] - 1] = false;
+	if (item)
+	{
+		slot->tts_values[st->attnums[2] - 1] = CStringGetTextDatum(item);
+		slot->tts_isnull[st->attnums[2] - 1] = false;
+	}
+	slot->tts_values[st->attnums[3] - 1] = CStringGetTextDatum(metric);
+	slot->tts_isnull[st->attnums[3] - 1] = false;
+	slot->tts_values[st->attnums[4] - 1] = Float8GetDatum(value);
+	slot->tts_isnull[st->attnums[4] - 1] = false;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	ExecStoreVirtualTuple(slot);
+
+	if (++st->nslots == sink_batch_size)
+		sink_flush_batch(st);
+}
+
+/*
+ * Write the samples taken since the last flush into the table.
+ */
+static void
+sink_flush(MemoryContext batch_context)
+{
+	SinkState	st;
+	List	   *samples;
+	ListCell   *lc;
+	int			max_cpus;
+	TimestampTz last_ts = sink->last_ts;
+	int			i;
+
+	samples = sampler_get_history(last_ts, &max_cpus);
+	if (samples == NIL)
+		return;
+
+	SetCurrentStatementStartTimestamp();
+	StartTransactionCommand();
+	PushActiveSnapshot(GetTransactionSnapshot());
+	pgstat_report_activity(STATE_RUNNING, "writing samples");
+
+	memset(&st, 0, sizeof(st));
+	st.rel = sink_open_table(st.attnums);
+	st.cid = GetCurrentCommandId(true);
+	st.bistate = GetBulkInsertState();
+	st.batch_context = batch_context;
+	sink_init_executor(&st);
+
+	st.slots = palloc(sizeof(TupleTableSlot *) * sink_batch_size);
+	for (i = 0; i < sink_batch_size; i++)
+		st.slots[i] = table_slot_create(st.rel, NULL);
+
+	foreach(lc, samples)
+	{
+		HistorySample *s = (HistorySample *) lfirst(lc);
+
+		st.ts = s->ts;
+		store_sample_metrics(&s->loadavg, &s->meminfo,
+							 HistorySampleStats(s), s->nstat,
+							 HistorySampleDisks(s, max_cpus), s->ndisk,
+							 sink_add_row, &st);
+		last_ts = s->ts;
+	}
+	sink_flush_batch(&st);
+
+	for (i = 0; i < sink_batch_size; i++)
+		ExecDropSingleTupleTableSlot(st.slots[i]);
+	FreeBulkInsertState(st.bistate);
+	table_finish_bulk_insert(st.rel, 0);
+	ExecCloseIndices(st.rri);
+	FreeExecutorState(st.estate);
+	table_close(st.rel, NoLock);
+
+	PopActiveSnapshot();
+	CommitTransactionCommand();
+	pgstat_report_stat(false);
+	pgstat_report_activity(STATE_IDLE, NULL);
+
+	/* The samples are written only once committed. */
+	sink->last_ts = last_ts;
+
+	elog(DEBUG1, "pg_linux_proc sink wrote %d samples, " INT64_FORMAT " rows",
+		 list_length(samples), st.rows);
+}
+
+void
+pg_linux_proc_sink_main(Datum main_arg)
+{
+	MemoryContext flush_context;
+	MemoryContext batch_context;
+
+	pqsignal(SIGHUP, SignalHandlerForConfigReload);
+	pqsignal(SIGTERM, die);
+	BackgroundWorkerUnblockSignals();
+
+	BackgroundWorkerInitializeConnection(sink_database, NULL, 0);
+
+	flush_context = AllocSetContextCreate(TopMemoryContext,
+										  "pg_linux_proc sink",
+										  ALLOCSET_DEFAULT_SIZES);
+	batch_context = AllocSetContextCreate(TopMemoryContext,
+										  "pg_linux_proc sink batch",
+										  ALLOCSET_DEFAULT_SIZES);
+
+	for (;;)
+	{
+		long		timeout;
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (ConfigReloadPending)
+		{
+			ConfigReloadPending = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		/*
+		 * An error, such as a missing table, is reported and the samples are
+		 * written again at the next flush.
+		 */
+		PG_TRY();
+		{
+			MemoryContextSwitchTo(flush_context);
+			sink_flush(batch_context);
+		}
+		PG_CATCH();
+		{
+			EmitErrorReport();
+			FlushErrorState();
+			AbortCurrentTransaction();
+			pgstat_report_activity(STATE_IDLE, NULL);
+		}
+		PG_END_TRY();
+
+		MemoryContextSwitchTo(TopMemoryContext);
+		MemoryContextReset(flush_context);
+		MemoryContextReset(batch_context);
+
+		/* Flush at least twice per turn of the ring buffer. */
+		timeout = Min((long) sink_flush_interval,
+					  (long) sampler_history_size * sampler_interval / 2);
+
+		(void) WaitLatch(MyLatch,
+						 WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+						 timeout,
+						 PG_WAIT_EXTENSION);
+		ResetLatch(MyLatch);
+	}
+}
@@ -0,0 +1,30 @@
+/*-------------------------------------------------------------------------
+ *
+ * sink.h
+ *		Table sink of the sampled history of pg_linux_proc
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#ifndef __SINK_H__
+#define __SINK_H__
+
+/* GUC variables */
+extern char *sink_database;
+extern char *sink_table;
+extern int	sink_flush_interval;
+extern int	sink_batch_size;
+
+extern void sink_define_gucs(void);
+extern void sink_register_worker(void);
+extern Size sink_shmem_size(void);
+extern void sink_shmem_request(void);
+extern void sink_shmem_startup(void);
+
+extern PGDLLEXPORT void pg_linux_proc_sink_main(Datum main_arg);
+
+#endif
@@ -0,0 +1,205 @@
+/*-------------------------------------------------------------------------
+ *
+ * sketch.c
+ *		Mergeable quantile sketches of pg_linux_proc
+ *
+ * A DDSketch (Masson et al., "DDSketch: A Fast and Fully-Mergeable Quantile
+ * Sketch with Relative-Error Guarantees", VLDB 2019) counts the values in
+ * bins of exponentially growing width, so that any quantile it returns is
+ * within SKETCH_ALPHA of the true value relative to it.  Two sketches
+ * merge by adding their bins, which gives the same sketch as if all the
+ * values had been added to one, so the sketches of the rollup buckets of
+ * the on-disk store can be merged over any time range.
+ *
+ * The bins are a dense array over the keys in use.  When it would exceed
+ * SKETCH_MAX_BINS, the lowest bins are collapsed into one, which keeps the
+ * upper quantiles, the ones of interest here, accurate.
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <math.h>
+
+#include "utils/float.h"
+
+#include "sketch.h"
+
+#define SKETCH_GAMMA		((1 + SKETCH_ALPHA) / (1 - SKETCH_ALPHA))
+
+void
+sketch_init(DDSketch * sk, MemoryContext cxt)
+{
+	memset(sk, 0, sizeof(DDSketch));
+	sk->cxt = cxt;
+}
+
+/* Empty the sketch, keeping its bins allocated */
+void
+sketch_reset(DDSketch * sk)
+{
+	sk->count = 0;
+	sk->zero_count = 0;
+	sk->nbins = 0;
+}
+
+void
+sketch_free(DDSketch * sk)
+{
+	if (sk->bins)
+		pfree(sk->bins);
+	sk->bins = NULL;
+	sk->maxbins = 0;
+	sketch_reset(sk);
+}
+
+/*
+ * Make the bins cover key, collapsing the lowest ones if needed.
+ */
+static void
+sketch_cover(DDSketch * sk, int32 key)
+{
+	int32		lo;
+	int32		hi;
+	int32		nbins;
+	int32		kept;
+
+	if (sk->nbins == 0)
+	{
+		if (sk->maxbins == 0)
+		{
+			sk->maxbins = 16;
+			sk->bins = MemoryContextAlloc(sk->cxt, sizeof(int64) * sk->maxbins);
+		}
+		sk->min_key = key;
+		sk->nbins = 1;
+		sk->bins[0] = 0;
+		return;
+	}
+
+	lo = Min(sk->min_key, key);
+	hi = Max(sk->min_key + sk->nbins - 1, key);
+	if (hi - lo + 1 > SKETCH_MAX_BINS)
+		lo = hi - SKETCH_MAX_BINS + 1;
+	nbins = hi - lo + 1;
+
+	if (lo == sk->min_key && nbins == sk->nbins)
+		return;
+
+	if (nbins > sk->maxbins)
+	{
+		while (sk->maxbins < nbins)
+			sk->maxbins *= 2;
+		sk->bins = repalloc(sk->bins, sizeof(int64) * sk->maxbins);
+	}
+
+	if (lo <= sk->min_key)
+	{
+		/* Shift the bins up to make room for the lower keys. */
+		int32		shift = sk->min_key - lo;
+
+		memmove(&sk->bins[shift], sk->bins, sizeof(int64) * sk->nbins);
+		memset(sk->bins, 0, sizeof(int64) * shift);
+		kept = shift + sk->nbins;
+	}
+	else
+	{
+		/* Collapse the bins up to lo into the lowest one. */
+		int32		shift = lo - sk->min_key;
+		int64		collapsed = 0;
+		int32		j;
+
+		for (j = 0; j <= shift && j < sk->nbins; j++)
+			collapsed += sk->bins[j];
+		kept = Max(sk->nbins - shift, 1);
+		if (kept > 1)
+			memmove(&sk->bins[1], &sk->bins[shift + 1], sizeof(int64) * (kept - 1));
+		sk->bins[0] = collapsed;
+	}
+	if (kept < nbins)
+		memset(&sk->bins[kept], 0, sizeof(int64) * (nbins - kept));
+
+	sk->min_key = lo;
+	sk->nbins = nbins;
+}
+
+/*
+ * Add n values of the bin key.
+ */
+void
+sketch_add_key(DDSketch * sk, int32 key, int64 n)
+{
+	sketch_cover(sk, key);
+	sk->bins[Max(key, sk->min_key) - sk->min_key] += n;
+	sk->count += n;
+}
+
+void
+sketch_add(DDSketch * sk, double value)
+{
+	if (value <= SKETCH_MIN_VALUE)
+	{
+		sk->zero_count++;
+		sk->count++;
+		return;
+	}
+
+	sketch_add_key(sk, (int32) ceil(log(value) / log(SKETCH_GAMMA)), 1);
+}
+
+void
+sketch_merge(DDSketch * dst, const DDSketch * src)
+{
+	int32		j;
+
+	if (src->nbins > 0)
+	{
+		/* Cover the whole range first, so the bins are moved once. */
+		sketch_cover(dst, src->min_key + src->nbins - 1);
+		sketch_cover(dst, src->min_key);
+	}
+
+	for (j = 0; j < src->nbins; j++)
+	{
+		if (src->bins[j] != 0)
+			sketch_add_key(dst, src->min_key + j, src->bins[j]);
+	}
+
+	dst->zero_count += src->zero_count;
+	dst->count += src->zero_count;
+}
+
+/*
+ * Return the q-quantile, 0 <= q <= 1, of the values of the sketch, or NaN
+ * if it is empty.
+ */
+double
+sketch_quantile(const DDSketch * sk, double q)
+{
+	double		rank;
+	int64		cum;
+	int32		j;
+
+	if (sk->count == 0)
+		return get_float8_nan();
+
+	rank = q * (sk->count - 1);
+	cum = sk->zero_count;
+	if (cum > rank)
+		return 0;
+
+	for (j = 0; j < sk->nbins; j++)
+	{
+		cum += sk->bins[j];
+		if (cum > rank)
+			break;
+	}
+	j = Min(j, sk->nbins - 1);
+
+	/* the middle of the bin, in relative terms */
+	return 2 * pow(SKETCH_GAMMA, sk->min_key + j) / (SKETCH_GAMMA + 1);
+}
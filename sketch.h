@@ -0,0 +1,53 @@
+/*-------------------------------------------------------------------------
+ *
+ * sketch.h
+ *		Mergeable quantile sketches of pg_linux_proc
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#ifndef __SKETCH_H__
+#define __SKETCH_H__
+
+/* Relative accuracy of the quantiles */
+#define SKETCH_ALPHA		0.01
+
+/*
+ * Maximum number of bins of a sketch.  With SKETCH_ALPHA, they cover four
+ * decades below the largest value at full accuracy; smaller values are
+ * counted in the lowest bin.
+ */
+#define SKETCH_MAX_BINS		512
+
+/* Values up to this, including the negative ones, count as zero */
+#define SKETCH_MIN_VALUE	1e-9
+
+/*
+ * A DDSketch: bins[j] counts the values v with
+ * gamma^(key-1) < v <= gamma^key, key = min_key + j, where
+ * gamma = (1 + SKETCH_ALPHA) / (1 - SKETCH_ALPHA).
+ */
+typedef struct DDSketch
+{
+	MemoryContext cxt;			/* of bins */
+	int64		count;			/* total, including zero_count */
+	int64		zero_count;
+	int32		min_key;
+	int32		nbins;
+	int32		maxbins;		/* allocated */
+	int64	   *bins;
+}			DDSketch;
+
+extern void sketch_init(DDSketch * sk, MemoryContext cxt);
+extern void sketch_reset(DDSketch * sk);
+extern void sketch_free(DDSketch * sk);
+extern void sketch_add(DDSketch * sk, double value);
+extern void sketch_add_key(DDSketch * sk, int32 key, int64 n);
+extern void sketch_merge(DDSketch * dst, const DDSketch * src);
+extern double sketch_quantile(const DDSketch * sk, double q);
+
+#endif
@@ -0,0 +1,405 @@
+/*-------------------------------------------------------------------------
+ *
+ * snapcache.c
+ *		Shared snapshot cache of parsed /proc files
+ *
+ * When many monitoring sessions call pg_proc_meminfo() and friends at the
+ * same moment, each of them would read and parse the same files.  This
+ * module keeps the last parsed result of each source in shared memory
+ * with its time, and a caller whose pg_linux_proc.cache_ttl has not
+ * expired copies it without touching the file.
+ *
+ * Each source is protected by a sequence lock: the writer makes the
+ * sequence odd while it writes and even again afterwards, and readers
+ * retry (or give up) if the sequence was odd or changed while they
+ * copied.  So readers never block each other or the writer.  Only the
+ * backend that wins the refreshing flag writes; the others read the file
+ * by themselves instead of waiting for it.  The flag is cleared even if
+ * the writer errors out or exits in the middle of the refresh.
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "nodes/pg_list.h"
+#include "port/atomics.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/guc.h"
+#include "utils/timestamp.h"
+
+#include "pg_linux_proc.h"
+#include "snapcache.h"
+
+typedef enum SnapSource
+{
+	SNAP_LOADAVG,
+	SNAP_MEMINFO,
+	SNAP_STAT,
+	SNAP_DISKSTATS
+}			SnapSource;
+
+#define NUM_SNAP_SOURCES	(SNAP_DISKSTATS + 1)
+
+/* Number of times a reader retries when the writer interferes */
+#define SNAP_MAX_RETRY		3
+
+typedef struct SnapEntry
+{
+	pg_atomic_uint32 seq;		/* odd while the data is being written */
+	pg_atomic_flag refreshing;	/* set while a backend refreshes it */
+	TimestampTz ts;				/* time the file was read; 0 if never */
+	int			count;			/* number of valid elements */
+	int			capacity;		/* max number of elements */
+	Size		elemsize;
+	Size		offset;			/* of the data from the start of the cache */
+}			SnapEntry;
+
+typedef struct SnapCacheShared
+{
+	SnapEntry	entries[NUM_SNAP_SOURCES];
+}			SnapCacheShared;
+
+/* GUC variables */
+int			snapcache_ttl = 0;	/* ms */
+
+static SnapCacheShared * snapcache = NULL;
+
+#define SnapData(e)	((char *) snapcache + (e)->offset)
+
+void
+snapcache_define_gucs(void)
+{
+	DefineCustomIntVariable("pg_linux_proc.cache_ttl",
+							"Sets how long a parsed /proc file is shared among sessions.",
+							"Zero disables the snapshot cache.",
+							&snapcache_ttl,
+							0,
+							0,
+							INT_MAX,
+							PGC_USERSET,
+							GUC_UNIT_MS,
+							NULL,
+							NULL,
+							NULL);
+}
+
+Size
+snapcache_shmem_size(void)
+{
+	Size		size;
+
+	size = MAXALIGN(sizeof(SnapCacheShared));
+	size = add_size(size, MAXALIGN(sizeof(LoadAvg)));
+	size = add_size(size, MAXALIGN(sizeof(MemInfo)));
+	size = add_size(size, MAXALIGN(mul_size(sizeof(ProcStat), proc_max_cpus())));
+	size = add_size(size, mul_size(sizeof(DiskStat), proc_max_devices));
+
+	return size;
+}
+
+void
+snapcache_shmem_request(void)
+{
+	RequestAddinShmemSpace(snapcache_shmem_size());
+}
+
+static Size
+snapcache_init_entry(SnapSource src, int capacity, Size elemsize, Size offset)
+{
+	SnapEntry  *e = &snapcache->entries[src];
+
+	pg_atomic_init_u32(&e->seq, 0);
+	pg_atomic_init_flag(&e->refreshing);
+	e->ts = 0;
+	e->count = 0;
+	e->capacity = capacity;
+	e->elemsize = elemsize;
+	e->offset = offset;
+
+	return offset + MAXALIGN(elemsize * capacity);
+}
+
+void
+snapcache_shmem_startup(void)
+{
+	bool		found;
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	snapcache = ShmemInitStruct("pg_linux_proc snapshot cache",
+								snapcache_shmem_size(),
+								&found);
+	if (!found)
+	{
+		Size		offset = MAXALIGN(sizeof(SnapCacheShared));
+
+		offset = snapcache_init_entry(SNAP_LOADAVG, 1, sizeof(LoadAvg), offset);
+		offset = snapcache_init_entry(SNAP_MEMINFO, 1, sizeof(MemInfo), offset);
+		offset = snapcache_init_entry(SNAP_STAT, proc_max_cpus(),
+									  sizeof(ProcStat), offset);
+		offset = snapcache_init_entry(SNAP_DISKSTATS, proc_max_devices,
+									  sizeof(DiskStat), offset);
+	}
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+static inline bool
+snapcache_enabled(void)
+{
+	return snapcache != NULL && snapcache_ttl > 0;
+}
+
+/*
+ * Copy the cached data of src into data, which must have room for the
+ * capacity of src, if it is younger than the TTL.  Return the number of
+ * elements copied, or -1 if the cache cannot be used.
+ */
+static int
+snap_get(SnapSource src, void *data)
+{
+	SnapEntry  *e = &snapcache->entries[src];
+	int			retry;
+
+	for (retry = 0; retry < SNAP_MAX_RETRY; retry++)
+	{
+		uint32		before;
+		TimestampTz ts;
+		int			count;
+
+		before = pg_atomic_read_u32(&e->seq);
+		if (before & 1)
+			return -1;			/* being written; don't wait for it */
+
+		pg_read_barrier();
+
+		ts = e->ts;
+		count = Min(Max(e->count, 0), e->capacity);
+		memcpy(data, SnapData(e), e->elemsize * count);
+
+		pg_read_barrier();
+
+		if (pg_atomic_read_u32(&e->seq) != before)
+			continue;			/* torn; try again */
+
+		if (ts == 0 ||
+			TimestampDifferenceExceeds(ts, GetCurrentTimestamp(), snapcache_ttl))
+			return -1;
+
+		return count;
+	}
+
+	return -1;
+}
+
+/*
+ * Begin to write src.  Return false if another backend is refreshing it.
+ */
+static inline bool
+snap_begin_refresh(SnapSource src)
+{
+	return pg_atomic_test_set_flag(&snapcache->entries[src].refreshing);
+}
+
+static inline void
+snap_end_refresh(SnapSource src)
+{
+	pg_atomic_clear_flag(&snapcache->entries[src].refreshing);
+}
+
+/*
+ * Clear the refreshing flag when the refresh fails, including a FATAL
+ * error or proc_exit() in the middle of it; otherwise the source would
+ * never be refreshed again.
+ */
+static void
+snap_refresh_cleanup(int code, Datum arg)
+{
+	snap_end_refresh((SnapSource) DatumGetInt32(arg));
+}
+
+/*
+ * Publish the elements of data, or of the list if data is NULL.
+ * Only the backend holding the refreshing flag may call this.
+ */
+static void
+snap_put(SnapSource src, TimestampTz ts, const void *data, List *list)
+{
+	SnapEntry  *e = &snapcache->entries[src];
+	int			count = (data != NULL) ? 1 : list_length(list);
+
+	/* Too many cpus or devices to cache; leave the old one to expire. */
+	if (count > e->capacity)
+		return;
+
+	/* fetch_add is a full barrier */
+	pg_atomic_fetch_add_u32(&e->seq, 1);
+
+	if (data != NULL)
+		memcpy(SnapData(e), data, e->elemsize);
+	else
+	{
+		ListCell   *lc;
+		char	   *dst = SnapData(e);
+
+		foreach(lc, list)
+		{
+			memcpy(dst, lfirst(lc), e->elemsize);
+			dst += e->elemsize;
+		}
+	}
+	e->ts = ts;
+	e->count = count;
+
+	pg_write_barrier();
+	pg_atomic_fetch_add_u32(&e->seq, 1);
+}
+
+/*
+ * Make a list of palloc'd copies of the cached elements.
+ */
+static List *
+snap_get_list(SnapSource src, List *list, bool *hit)
+{
+	SnapEntry  *e = &snapcache->entries[src];
+	char	   *data = palloc(e->elemsize * e->capacity);
+	int			count;
+	int			i;
+
+	*hit = false;
+	if ((count = snap_get(src, data)) < 0)
+	{
+		pfree(data);
+		return list;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		void	   *elem = palloc(e->elemsize);
+
+		memcpy(elem, data + e->elemsize * i, e->elemsize);
+		list = lappend(list, elem);
+	}
+	pfree(data);
+
+	*hit = true;
+	return list;
+}
+
+bool
+cached_proc_loadavg(LoadAvg * loadavg)
+{
+	if (!snapcache_enabled())
+		return get_proc_loadavg(loadavg);
+
+	if (snap_get(SNAP_LOADAVG, loadavg) == 1)
+		return true;
+
+	if (!snap_begin_refresh(SNAP_LOADAVG))
+		return get_proc_loadavg(loadavg);
+
+	PG_ENSURE_ERROR_CLEANUP(snap_refresh_cleanup, Int32GetDatum(SNAP_LOADAVG));
+	{
+		TimestampTz ts = GetCurrentTimestamp();
+
+		get_proc_loadavg(loadavg);
+		snap_put(SNAP_LOADAVG, ts, loadavg, NIL);
+	}
+	PG_END_ENSURE_ERROR_CLEANUP(snap_refresh_cleanup, Int32GetDatum(SNAP_LOADAVG));
+	snap_end_refresh(SNAP_LOADAVG);
+
+	return true;
+}
+
+bool
+cached_proc_meminfo(MemInfo * meminfo)
+{
+	if (!snapcache_enabled())
+		return get_proc_meminfo(meminfo, NULL);
+
+	if (snap_get(SNAP_MEMINFO, meminfo) == 1)
+		return true;
+
+	if (!snap_begin_refresh(SNAP_MEMINFO))
+		return get_proc_meminfo(meminfo, NULL);
+
+	PG_ENSURE_ERROR_CLEANUP(snap_refresh_cleanup, Int32GetDatum(SNAP_MEMINFO));
+	{
+		TimestampTz ts = GetCurrentTimestamp();
+
+		get_proc_meminfo(meminfo, NULL);
+		snap_put(SNAP_MEMINFO, ts, meminfo, NIL);
+	}
+	PG_END_ENSURE_ERROR_CLEANUP(snap_refresh_cleanup, Int32GetDatum(SNAP_MEMINFO));
+	snap_end_refresh(SNAP_MEMINFO);
+
+	return true;
+}
+
+List *
+cached_proc_stat(List *stat)
+{
+	List	   *volatile result = NIL;
+	bool		hit;
+
+	Assert(stat == NIL);
+
+	if (!snapcache_enabled())
+		return get_proc_stat(stat);
+
+	result = snap_get_list(SNAP_STAT, stat, &hit);
+	if (hit)
+		return result;
+
+	if (!snap_begin_refresh(SNAP_STAT))
+		return get_proc_stat(stat);
+
+	PG_ENSURE_ERROR_CLEANUP(snap_refresh_cleanup, Int32GetDatum(SNAP_STAT));
+	{
+		TimestampTz ts = GetCurrentTimestamp();
+
+		result = get_proc_stat(stat);
+		snap_put(SNAP_STAT, ts, NULL, result);
+	}
+	PG_END_ENSURE_ERROR_CLEANUP(snap_refresh_cleanup, Int32GetDatum(SNAP_STAT));
+	snap_end_refresh(SNAP_STAT);
+
+	return result;
+}
+
+List *
+cached_proc_diskstats(List *diskstats)
+{
+	List	   *volatile result = NIL;
+	bool		hit;
+
+	Assert(diskstats == NIL);
+
+	if (!snapcache_enabled())
+		return get_proc_diskstats(diskstats);
+
+	result = snap_get_list(SNAP_DISKSTATS, diskstats, &hit);
+	if (hit)
+		return result;
+
+	if (!snap_begin_refresh(SNAP_DISKSTATS))
+		return get_proc_diskstats(diskstats);
+
+	PG_ENSURE_ERROR_CLEANUP(snap_refresh_cleanup, Int32GetDatum(SNAP_DISKSTATS));
+	{
+		TimestampTz ts = GetCurrentTimestamp();
+
+		result = get_proc_diskstats(diskstats);
+		snap_put(SNAP_DISKSTATS, ts, NULL, result);
+	}
+	PG_END_ENSURE_ERROR_CLEANUP(snap_refresh_cleanup, Int32GetDatum(SNAP_DISKSTATS));
+	snap_end_refresh(SNAP_DISKSTATS);
+
+	return result;
+}
@@ -0,0 +1,38 @@
+/*-------------------------------------------------------------------------
+ *
+ * snapcache.h
+ *		Shared snapshot cache of parsed /proc files
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#ifndef __SNAPCACHE_H__
+#define __SNAPCACHE_H__
+
+#include "nodes/pg_list.h"
+
+#include "loadavg.h"
+#include "meminfo.h"
+
+/* GUC variables */
+extern int	snapcache_ttl;
+
+extern void snapcache_define_gucs(void);
+extern Size snapcache_shmem_size(void);
+extern void snapcache_shmem_request(void);
+extern void snapcache_shmem_startup(void);
+
+/*
+ * Same as get_proc_*(), but return the snapshot cached in shared memory
+ * if it is younger than pg_linux_proc.cache_ttl.
+ */
+extern bool cached_proc_loadavg(LoadAvg * loadavg);
+extern bool cached_proc_meminfo(MemInfo * meminfo);
+extern List *cached_proc_stat(List *stat);
+extern List *cached_proc_diskstats(List *diskstats);
+
+#endif
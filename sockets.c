@@ -0,0 +1,446 @@
+/*-------------------------------------------------------------------------
+ *
+ * sockets.c
+ *		Get TCP sockets of processes from /proc/net/tcp{,6} on Linux
+ *
+ * The sockets of a process are the "socket:[inode]" links in
+ * /proc/<pid>/fd.  They are collected into a hash table keyed by inode
+ * first, so /proc/net/tcp and tcp6 are parsed once however many processes
+ * are looked at.
+ *
+ * /proc/net/tcp{,6} has one line per socket of the network namespace,
+ * which makes it megabytes on a busy host, so it is read into a buffer of
+ * the call rather than through a cached ProcFile, whose buffer would stay
+ * that large for the life of the backend.
+ *
+ * /proc/net/tcp has the queues and the retransmission timer, but not the
+ * RTT.  That comes from struct tcp_info, which is requested with a
+ * sock_diag netlink dump (what "ss -ti" does).  If the netlink socket
+ * cannot be used, e.g. it is blocked by seccomp, the tcp_info fields are
+ * left invalid.
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/inet_diag.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/sock_diag.h>
+#include <unistd.h>
+
+#include "lib/stringinfo.h"
+#include "storage/fd.h"
+
+#include "parse.h"
+#include "pid.h"
+#include "sockets.h"
+
+static const char *const tcp_states[] = {
+	"UNKNOWN",
+	"ESTABLISHED",
+	"SYN_SENT",
+	"SYN_RECV",
+	"FIN_WAIT1",
+	"FIN_WAIT2",
+	"TIME_WAIT",
+	"CLOSE",
+	"CLOSE_WAIT",
+	"LAST_ACK",
+	"LISTEN",
+	"CLOSING",
+	"NEW_SYN_RECV",
+};
+
+#define SOCKET_LINK_PREFIX	"socket:["
+
+const char *
+tcp_state_name(int state)
+{
+	if (state <= 0 || state >= lengthof(tcp_states))
+		return tcp_states[0];
+	return tcp_states[state];
+}
+
+HTAB *
+create_socket_table(void)
+{
+	HASHCTL		ctl;
+
+	ctl.keysize = sizeof(uint64);
+	ctl.entrysize = sizeof(TcpSocket);
+	ctl.hcxt = CurrentMemoryContext;
+
+	return hash_create("pg_linux_proc sockets", 256, &ctl,
+					   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+}
+
+/*
+ * Add the sockets open in pid to the table, and return the number added.
+ * A process that has exited is ignored.
+ */
+int
+add_pid_sockets(HTAB *sockets, int pid)
+{
+	char		dirpath[MAXPGPATH];
+	char		path[MAXPGPATH];
+	char		link[64];
+	DIR		   *dir;
+	struct dirent *dp;
+	int			nadded = 0;
+
+	snprintf(dirpath, sizeof(dirpath), DIR_PID "/%d/fd", pid);
+
+	if ((dir = AllocateDir(dirpath)) == NULL)
+		return 0;
+
+	while ((dp = ReadDirExtended(dir, dirpath, DEBUG1)) != NULL)
+	{
+		ssize_t		len;
+		uint64		inode;
+		char	   *end;
+		TcpSocket  *sk;
+		bool		found;
+
+		if (dp->d_name[0] < '0' || dp->d_name[0] > '9')
+			continue;
+
+		snprintf(path, sizeof(path), "%s/%s", dirpath, dp->d_name);
+		len = readlink(path, link, sizeof(link) - 1);
+		if (len <= 0)
+			continue;
+		link[len] = '\0';
+
+		if (strncmp(link, SOCKET_LINK_PREFIX, strlen(SOCKET_LINK_PREFIX)) != 0)
+			continue;
+
+		inode = strtou64(link + strlen(SOCKET_LINK_PREFIX), &end, 10);
+		if (*end != ']')
+			continue;
+
+		sk = (TcpSocket *) hash_search(sockets, &inode, HASH_ENTER, &found);
+		if (found)
+			continue;
+
+		memset(sk, 0, sizeof(TcpSocket));
+		sk->inode = inode;
+		sk->pid = pid;
+		sk->fd = atoi(dp->d_name);
+		nadded++;
+	}
+	FreeDir(dir);
+
+	return nadded;
+}
+
+/*
+ * Convert "0100007F:1538" to "127.0.0.1" and 5432.
+ *
+ * The kernel prints the address as 32-bit words in host byte order, so
+ * each word is put back into memory as it is.
+ */
+static bool
+parse_tcp_address(int family, char *tok, char *addr, int *port)
+{
+	char	   *colon = strchr(tok, ':');
+	uint32		words[4];
+	int			nwords = (family == AF_INET) ? 1 : 4;
+	int			i;
+
+	if (colon == NULL || colon - tok != nwords * 8)
+		return false;
+
+	*port = (int) strtol(colon + 1, NULL, 16);
+
+	for (i = 0; i < nwords; i++)
+	{
+		char		word[9];
+
+		memcpy(word, tok + i * 8, 8);
+		word[8] = '\0';
+		words[i] = (uint32) strtoul(word, NULL, 16);
+	}
+
+	return inet_ntop(family, words, addr, INET6_ADDRSTRLEN) != NULL;
+}
+
+/*
+  sl  local_address rem_address   st tx_queue rx_queue tr tm->when retrnsmt   uid  timeout inode
+   0: 0100007F:1538 00000000:0000 0A 00000000:00000000 00:00000000 00000000    26        0 21581 1 ...
+ */
+
+/*
+ * Read the whole file into a palloc'd buffer.  Return NULL if it does not
+ * exist.
+ */
+static char *
+read_nettcp(const char *path)
+{
+	StringInfoData buf;
+	int			fd;
+
+	if ((fd = OpenTransientFile(path, O_RDONLY)) < 0)
+	{
+		if (errno == ENOENT)
+			return NULL;
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m", path)));
+	}
+
+	initStringInfo(&buf);
+
+	for (;;)
+	{
+		ssize_t		n;
+
+		/* Files under /proc report size 0, so read until EOF. */
+		if (buf.maxlen - buf.len - 1 < BLCKSZ)
+			enlargeStringInfo(&buf, BLCKSZ);
+
+		n = read(fd, buf.data + buf.len, buf.maxlen - buf.len - 1);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not read file \"%s\": %m", path)));
+		}
+		if (n == 0)
+			break;
+		buf.len += n;
+	}
+	buf.data[buf.len] = '\0';
+
+	CloseTransientFile(fd);
+
+	return buf.data;
+}
+
+static void
+parse_nettcp(HTAB *sockets, const char *path, int family)
+{
+	char	   *buf;
+	char	   *p;
+	char	   *line;
+	bool		header = true;
+
+	if ((buf = read_nettcp(path)) == NULL)
+		return;					/* no IPv6 */
+
+	p = buf;
+	while ((line = pl_next_line(&p)) != NULL)
+	{
+		char	   *tok[10];
+		TcpSocket  *sk;
+		uint64		inode;
+		char	   *colon;
+		int			i;
+
+		if (header)
+		{
+			header = false;
+			continue;
+		}
+
+		for (i = 0; i < lengthof(tok); i++)
+			if ((tok[i] = pl_next_token(&line)) == NULL)
+				ereport(ERROR,
+						(errcode(ERRCODE_DATA_EXCEPTION),
+						 errmsg("unexpected file format: \"%s\"", path),
+						 errdetail("number of fields is not corresponding")));
+
+		inode = strtou64(tok[9], NULL, 10);
+		sk = (TcpSocket *) hash_search(sockets, &inode, HASH_FIND, NULL);
+		if (sk == NULL)
+			continue;
+
+		if (!parse_tcp_address(family, tok[1], sk->local_addr, &sk->local_port) ||
+			!parse_tcp_address(family, tok[2], sk->remote_addr, &sk->remote_port) ||
+			(colon = strchr(tok[4], ':')) == NULL)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_EXCEPTION),
+					 errmsg("unexpected file format: \"%s\"", path),
+					 errdetail("invalid address or queue field")));
+
+		sk->state = (int) strtol(tok[3], NULL, 16);
+		sk->tx_queue = (int64) strtou64(tok[4], NULL, 16);
+		sk->rx_queue = (int64) strtou64(colon + 1, NULL, 16);
+		sk->retransmits = (int) strtol(tok[6], NULL, 16);
+		sk->found = true;
+	}
+
+	pfree(buf);
+}
+
+/*
+ * Copy the tcp_info attribute of a sock_diag message to its socket.
+ */
+static void
+diag_fill_socket(HTAB *sockets, struct nlmsghdr *h)
+{
+	struct inet_diag_msg *msg = (struct inet_diag_msg *) NLMSG_DATA(h);
+	struct rtattr *attr;
+	TcpSocket  *sk;
+	uint64		inode;
+	int			len;
+
+	if (h->nlmsg_len < NLMSG_LENGTH(sizeof(*msg)))
+		return;
+
+	inode = msg->idiag_inode;
+	sk = (TcpSocket *) hash_search(sockets, &inode, HASH_FIND, NULL);
+	if (sk == NULL || !sk->found)
+		return;
+
+	len = h->nlmsg_len - NLMSG_LENGTH(sizeof(*msg));
+	for (attr = (struct rtattr *) (msg + 1); RTA_OK(attr, len);
+		 attr = RTA_NEXT(attr, len))
+	{
+		struct tcp_info ti;
+
+		if (attr->rta_type != INET_DIAG_INFO)
+			continue;
+
+		/* An older kernel sends a shorter struct */
+		memset(&ti, 0, sizeof(ti));
+		memcpy(&ti, RTA_DATA(attr), Min(RTA_PAYLOAD(attr), sizeof(ti)));
+
+		sk->total_retrans = ti.tcpi_total_retrans;
+		sk->unacked = ti.tcpi_unacked;
+		sk->snd_cwnd = ti.tcpi_snd_cwnd;
+		sk->rtt_ms = ti.tcpi_rtt / 1000.0;
+		sk->rttvar_ms = ti.tcpi_rttvar / 1000.0;
+		sk->info_valid = true;
+	}
+}
+
+/*
+ * Dump the TCP sockets of family with their tcp_info.  Return false if
+ * sock_diag is not available.
+ *
+ * Nothing in the loop can throw, so the netlink socket is always closed.
+ */
+static bool
+diag_tcp_sockets(HTAB *sockets, int family)
+{
+	struct
+	{
+		struct nlmsghdr nlh;
+		struct inet_diag_req_v2 req;
+	}			request;
+	struct sockaddr_nl nladdr;
+	long		buf[8192 / sizeof(long)];
+	bool		done = false;
+	bool		ok = true;
+	int			sock;
+
+	if ((sock = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG)) < 0)
+		return false;
+
+	memset(&nladdr, 0, sizeof(nladdr));
+	nladdr.nl_family = AF_NETLINK;
+
+	memset(&request, 0, sizeof(request));
+	request.nlh.nlmsg_len = sizeof(request);
+	request.nlh.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+	request.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	request.req.sdiag_family = family;
+	request.req.sdiag_protocol = IPPROTO_TCP;
+	request.req.idiag_states = ~0U;
+	request.req.idiag_ext = 1 << (INET_DIAG_INFO - 1);
+
+	if (sendto(sock, &request, sizeof(request), 0,
+			   (struct sockaddr *) &nladdr, sizeof(nladdr)) < 0)
+	{
+		close(sock);
+		return false;
+	}
+
+	while (!done)
+	{
+		struct nlmsghdr *h;
+		int			len;
+
+		len = recv(sock, buf, sizeof(buf), 0);
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len <= 0)
+		{
+			ok = false;
+			break;
+		}
+
+		for (h = (struct nlmsghdr *) buf; NLMSG_OK(h, len); h = NLMSG_NEXT(h, len))
+		{
+			if (h->nlmsg_type == NLMSG_DONE)
+			{
+				done = true;
+				break;
+			}
+			if (h->nlmsg_type == NLMSG_ERROR)
+			{
+				ok = false;
+				done = true;
+				break;
+			}
+			diag_fill_socket(sockets, h);
+		}
+	}
+
+	close(sock);
+
+	return ok;
+}
+
+static int
+tcp_socket_cmp(const ListCell *a, const ListCell *b)
+{
+	TcpSocket  *sa = (TcpSocket *) lfirst(a);
+	TcpSocket  *sb = (TcpSocket *) lfirst(b);
+
+	if (sa->pid != sb->pid)
+		return (sa->pid < sb->pid) ? -1 : 1;
+	return (sa->fd < sb->fd) ? -1 : (sa->fd > sb->fd);
+}
+
+/*
+ * Fill the sockets of the table from /proc/net/tcp{,6} and sock_diag, and
+ * return the TCP ones sorted by pid and fd.
+ */
+List *
+get_tcp_sockets(HTAB *sockets)
+{
+	HASH_SEQ_STATUS status;
+	TcpSocket  *sk;
+	List	   *result = NIL;
+
+	if (hash_get_num_entries(sockets) == 0)
+		return NIL;
+
+	parse_nettcp(sockets, FILE_NETTCP, AF_INET);
+	parse_nettcp(sockets, FILE_NETTCP6, AF_INET6);
+
+	if (diag_tcp_sockets(sockets, AF_INET))
+		diag_tcp_sockets(sockets, AF_INET6);
+
+	hash_seq_init(&status, sockets);
+	while ((sk = (TcpSocket *) hash_seq_search(&status)) != NULL)
+	{
+		if (sk->found)
+			result = lappend(result, sk);
+	}
+
+	list_sort(result, tcp_socket_cmp);
+
+	return result;
+}
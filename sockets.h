@@ -0,0 +1,64 @@
+/*-------------------------------------------------------------------------
+ *
+ * sockets.h
+ *		Get TCP sockets of processes from /proc/net/tcp{,6} on Linux
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#ifndef __SOCKETS_H__
+#define __SOCKETS_H__
+
+#include <arpa/inet.h>
+
+#include "nodes/pg_list.h"
+#include "utils/hsearch.h"
+
+#define FILE_NETTCP			"/proc/self/net/tcp"
+#define FILE_NETTCP6		"/proc/self/net/tcp6"
+
+/*
+ * A TCP socket open in a process.
+ *
+ * The entries are created from the "socket:[inode]" links of
+ * /proc/<pid>/fd, and filled from the row of /proc/net/tcp{,6} with the
+ * same inode.  If the kernel answers sock_diag requests, the tcp_info
+ * fields are filled as well and info_valid is set.
+ */
+typedef struct TcpSocket
+{
+	uint64		inode;			/* hash key */
+	int			pid;
+	int			fd;
+	bool		found;			/* false if not a TCP socket */
+
+	/* /proc/net/tcp{,6} */
+	char		local_addr[INET6_ADDRSTRLEN];
+	int			local_port;
+	char		remote_addr[INET6_ADDRSTRLEN];
+	int			remote_port;
+	int			state;			/* TCP_ESTABLISHED, ... */
+	int64		tx_queue;		/* bytes not yet acked by the peer */
+	int64		rx_queue;		/* bytes not yet read by the process */
+	int			retransmits;	/* unrecovered RTO timeouts */
+
+	/* struct tcp_info */
+	bool		info_valid;
+	int64		total_retrans;
+	int64		unacked;		/* segments */
+	int64		snd_cwnd;		/* segments */
+	double		rtt_ms;
+	double		rttvar_ms;
+}			TcpSocket;
+
+
+extern HTAB *create_socket_table(void);
+extern int	add_pid_sockets(HTAB *sockets, int pid);
+extern List *get_tcp_sockets(HTAB *sockets);
+extern const char *tcp_state_name(int state);
+
+#endif
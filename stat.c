@@ -13,49 +13,154 @@
 #include "nodes/pg_list.h"
 
 #include "stat.h"
+#include "parse.h"
+#include "pg_linux_proc.h"
+#include "procfile.h"
 
+static ProcFile stat_file = PROCFILE_INIT(FILE_STAT);
+
+/*
+ * Get the cpu lines of /proc/stat.
+ *
+ * The first element is the aggregate "cpu" line, followed by one element
+ * per online cpu.
+ */
 List *
 get_proc_stat(List *stat)
 {
-	FILE	   *fp;
-	char		line[256];
+	char	   *buf;
+	char	   *p;
+	char	   *line;
+	size_t		len;
 
-	if ((fp = fopen(FILE_STAT, "r")) == NULL)
-		ereport(ERROR,
-				(errcode_for_file_access(),
-				 errmsg("could not open file \"%s\": ", FILE_STAT)));
+	buf = procfile_read(&stat_file, &len);
 
-	while (fgets(line, sizeof(line), fp) != NULL)
+	p = buf;
+	while ((line = pl_next_line(&p)) != NULL)
 	{
 		ProcStat   *ps;
+		char	   *name;
+		int64		v[NUM_STAT_FIELDS_MAX - 1];
 
-		if (strncmp(line, "cpu", 3) == 0 && line[3] >= '0' && line[3] <= '9')
-		{
+		/*
+		 * The cpu lines come first.  The rest, including the long intr
+		 * line, is not parsed.
+		 */
+		if (strncmp(line, "cpu", 3) != 0)
+			break;
 
-			ps = palloc0(sizeof(ProcStat));
+		name = pl_next_token(&line);
 
-			if (sscanf(line, "%s %ld %ld %ld %ld %ld %ld %ld %ld",
-					   ps->cpu, &(ps->user), &(ps->nice), &(ps->system), &(ps->idle),
-					   &(ps->iowait), &(ps->irq), &(ps->softirq), &(ps->steal)) < NUM_STAT_FIELDS_MIN)
-				ereport(ERROR,
-						(errcode(ERRCODE_DATA_EXCEPTION),
-						 errmsg("unexpected file format: \"%s\"", FILE_STAT),
-						 errdetail("number of fields is not corresponding")));
+		/* guest and guest_nice are missing on old kernels. */
+		memset(v, 0, sizeof(v));
+		if (pl_parse_int64_array(&line, v, lengthof(v)) < NUM_STAT_FIELDS_MIN - 1)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_EXCEPTION),
+					 errmsg("unexpected file format: \"%s\"", FILE_STAT),
+					 errdetail("number of fields is not corresponding")));
 
-			stat = lappend(stat, ps);
-		}
+		ps = palloc(sizeof(ProcStat));
+		strlcpy(ps->cpu, name, sizeof(ps->cpu));
+		ps->user = v[0];
+		ps->nice = v[1];
+		ps->system = v[2];
+		ps->idle = v[3];
+		ps->iowait = v[4];
+		ps->irq = v[5];
+		ps->softirq = v[6];
+		ps->steal = v[7];
+		ps->guest = v[8];
+		ps->guest_nice = v[9];
+
+		stat = lappend(stat, ps);
 	}
 
+	return stat;
+}
 
-	if (ferror(fp) && errno != EINTR)
+static bool
+match_cpu(const void *a, const void *b)
+{
+	return strcmp(((const ProcStat *) a)->cpu, ((const ProcStat *) b)->cpu) == 0;
+}
+
+/*
+ * Compute the cpu utilization between two results of get_proc_stat().
+ *
+ * The cpus are matched by name, so the lists may differ when a cpu goes
+ * online or offline between the samples.  A cpu that is missing in prev
+ * is compared against zero counters, i.e. since boot.
+ */
+List *
+get_cpu_usage(List *prev, List *cur)
+{
+	List	   *usage = NIL;
+	ListCell   *lc;
+
+	foreach(lc, cur)
 	{
-		fclose(fp);
-		ereport(ERROR,
-				(errcode_for_file_access(),
-				 errmsg("could not read file \"%s\": ", FILE_STAT)));
-	}
+		ProcStat   *c = (ProcStat *) lfirst(lc);
+		ProcStat	zero;
+		ProcStat   *p;
+		CpuUsage   *u;
+		int64		user,
+					nice,
+					system,
+					idle,
+					iowait,
+					irq,
+					softirq,
+					steal,
+					guest,
+					guest_nice;
+		double		total;
 
-	fclose(fp);
+		p = (ProcStat *) find_prev_entry(prev, foreach_current_index(lc), c,
+										 match_cpu);
+		if (p == NULL)
+		{
+			memset(&zero, 0, sizeof(zero));
+			p = &zero;
+		}
 
-	return stat;
+		guest = counter_delta(p->guest, c->guest);
+		guest_nice = counter_delta(p->guest_nice, c->guest_nice);
+		user = counter_delta(p->user, c->user);
+		nice = counter_delta(p->nice, c->nice);
+		system = counter_delta(p->system, c->system);
+		idle = counter_delta(p->idle, c->idle);
+		iowait = counter_delta(p->iowait, c->iowait);
+		irq = counter_delta(p->irq, c->irq);
+		softirq = counter_delta(p->softirq, c->softirq);
+		steal = counter_delta(p->steal, c->steal);
+
+		/* guest time is already included in user and nice. */
+		user = (user > guest) ? user - guest : 0;
+		nice = (nice > guest_nice) ? nice - guest_nice : 0;
+
+		total = (double) (user + nice + system + idle + iowait + irq + softirq +
+						  steal + guest + guest_nice);
+
+		u = palloc0(sizeof(CpuUsage));
+		strlcpy(u->cpu, c->cpu, sizeof(u->cpu));
+
+		if (total > 0)
+		{
+			u->valid = true;
+			u->user = 100.0 * user / total;
+			u->nice = 100.0 * nice / total;
+			u->system = 100.0 * system / total;
+			u->idle = 100.0 * idle / total;
+			u->iowait = 100.0 * iowait / total;
+			u->irq = 100.0 * irq / total;
+			u->softirq = 100.0 * softirq / total;
+			u->steal = 100.0 * steal / total;
+			u->guest = 100.0 * guest / total;
+			u->guest_nice = 100.0 * guest_nice / total;
+		}
+
+		usage = lappend(usage, u);
+	}
+
+	return usage;
 }
@@ -16,6 +16,7 @@
 
 #define FILE_STAT			"/proc/stat"
 #define NUM_STAT_FIELDS_MIN	9
+#define NUM_STAT_FIELDS_MAX	11
 
 /*
  * https://man7.org/linux/man-pages/man5/proc.5.html
@@ -84,9 +85,34 @@ typedef struct ProcStat
 	int64		irq;
 	int64		softirq;
 	int64		steal;
+	int64		guest;
+	int64		guest_nice;
 }			ProcStat;
 
+/*
+ * CPU utilization between two ProcStat samples, in percent.
+ *
+ * As mpstat does, user and nice exclude the guest time, which the kernel
+ * also accounts in them, so that all fields sum up to 100.
+ */
+typedef struct CpuUsage
+{
+	char		cpu[8];
+	bool		valid;			/* false if no time elapsed on this cpu */
+	double		user;
+	double		nice;
+	double		system;
+	double		idle;
+	double		iowait;
+	double		irq;
+	double		softirq;
+	double		steal;
+	double		guest;
+	double		guest_nice;
+}			CpuUsage;
+
 
 extern List *get_proc_stat(struct List *stat);
+extern List *get_cpu_usage(struct List *prev, struct List *cur);
 
 #endif
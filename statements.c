@@ -0,0 +1,696 @@
+/*-------------------------------------------------------------------------
+ *
+ * statements.c
+ *		Per-query OS resource usage of pg_linux_proc
+ *
+ * The ExecutorRun and ExecutorFinish hooks take the resource usage of the
+ * backend before and after each call for a top-level query, and the
+ * ExecutorEnd hook adds the sum of the differences to an entry of a shared
+ * hash table keyed by (userid, dbid, queryid), as pg_stat_statements does
+ * with its own counters.  A portal fetched from in several steps is
+ * charged with its own steps only, not with what the backend does between
+ * them.
+ *
+ * As in pg_stat_statements, the ProcessUtility hook makes the queries run
+ * by a utility statement, such as DO, CALL, DECLARE CURSOR or EXPLAIN
+ * ANALYZE, nested, so they are not tracked as top-level queries.  The
+ * utility statements themselves are not tracked either.
+ *
+ * CPU time, page faults and context switches come from getrusage(), which
+ * has the same counters as /proc/self/stat and status in microseconds
+ * rather than clock ticks, for a single system call.  The I/O counters
+ * come from /proc/self/io, read through a cached descriptor.
+ *
+ * A parallel worker runs the same hooks with the queryid of the leader,
+ * so its usage is added to the leader's entry; only the leader counts the
+ * call.
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <sys/resource.h>
+
+#include "access/parallel.h"
+#include "catalog/pg_authid.h"
+#include "executor/executor.h"
+#include "funcapi.h"
+#include "lib/ilist.h"
+#include "miscadmin.h"
+#include "nodes/queryjumble.h"
+#include "port/atomics.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+#include "tcop/utility.h"
+#include "utils/acl.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/timestamp.h"
+
+#include "parse.h"
+#include "procfile.h"
+#include "statements.h"
+
+#define STATEMENTS_TRANCHE_NAME	"pg_linux_proc statements"
+
+typedef struct StmtKey
+{
+	Oid			userid;
+	Oid			dbid;
+	uint64		queryid;
+}			StmtKey;
+
+/* Resource usage of a process, or the difference of two of them */
+typedef struct StmtUsage
+{
+	int64		utime;			/* us */
+	int64		stime;			/* us */
+	int64		minflt;
+	int64		majflt;
+	int64		nvcsw;
+	int64		nivcsw;
+	int64		rchar;
+	int64		wchar;
+	int64		read_bytes;
+	int64		write_bytes;
+}			StmtUsage;
+
+typedef struct StmtEntry
+{
+	StmtKey		key;			/* hash key */
+	slock_t		mutex;			/* protects the counters */
+	int64		calls;
+	StmtUsage	usage;
+}			StmtEntry;
+
+typedef struct StmtShared
+{
+	LWLock	   *lock;			/* protects the hash table */
+	pg_atomic_uint64 dropped;	/* executions not stored as it was full */
+	TimestampTz reset_ts;
+}			StmtShared;
+
+/* A query being executed, from ExecutorStart to ExecutorEnd */
+typedef struct StmtRunning
+{
+	dlist_node	node;
+	QueryDesc  *queryDesc;
+	StmtUsage	usage;			/* in ExecutorRun and ExecutorFinish so far */
+	MemoryContextCallback cb;
+}			StmtRunning;
+
+/* GUC variables */
+int			statements_max = 5000;
+bool		statements_track = true;
+
+static StmtShared * stmts = NULL;
+static HTAB *stmt_hash = NULL;
+
+static ProcFile self_io_file = PROCFILE_INIT(FILE_SELF_IO);
+
+/* Current nesting depth of executor and ProcessUtility calls */
+static int	nesting_level = 0;
+
+/* Top-level queries between ExecutorStart and ExecutorEnd */
+static dlist_head running = DLIST_STATIC_INIT(running);
+
+/* Saved hook values in case of unload */
+static ExecutorStart_hook_type prev_ExecutorStart = NULL;
+static ExecutorRun_hook_type prev_ExecutorRun = NULL;
+static ExecutorFinish_hook_type prev_ExecutorFinish = NULL;
+static ExecutorEnd_hook_type prev_ExecutorEnd = NULL;
+static ProcessUtility_hook_type prev_ProcessUtility = NULL;
+
+#define stmt_enabled(level) \
+	(statements_track && stmts != NULL && (level) == 0)
+
+void
+statements_define_gucs(void)
+{
+	DefineCustomIntVariable("pg_linux_proc.statements_max",
+							"Sets the maximum number of queries tracked by pg_proc_statements.",
+							"Zero disables the tracking.",
+							&statements_max,
+							5000,
+							0,
+							INT_MAX / 2,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomBoolVariable("pg_linux_proc.track_statements",
+							 "Collects OS resource usage per query.",
+							 NULL,
+							 &statements_track,
+							 true,
+							 PGC_SUSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+}
+
+Size
+statements_shmem_size(void)
+{
+	if (statements_max <= 0)
+		return 0;
+
+	return add_size(MAXALIGN(sizeof(StmtShared)),
+					hash_estimate_size(statements_max, sizeof(StmtEntry)));
+}
+
+void
+statements_shmem_request(void)
+{
+	if (statements_max <= 0)
+		return;
+
+	RequestAddinShmemSpace(statements_shmem_size());
+	RequestNamedLWLockTranche(STATEMENTS_TRANCHE_NAME, 1);
+}
+
+void
+statements_shmem_startup(void)
+{
+	HASHCTL		info;
+	bool		found;
+
+	if (statements_max <= 0)
+		return;
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	stmts = ShmemInitStruct("pg_linux_proc statements",
+							sizeof(StmtShared),
+							&found);
+	if (!found)
+	{
+		stmts->lock = &(GetNamedLWLockTranche(STATEMENTS_TRANCHE_NAME))->lock;
+		pg_atomic_init_u64(&stmts->dropped, 0);
+		stmts->reset_ts = GetCurrentTimestamp();
+	}
+
+	info.keysize = sizeof(StmtKey);
+	info.entrysize = sizeof(StmtEntry);
+	stmt_hash = ShmemInitHash("pg_linux_proc statements hash",
+							  statements_max, statements_max,
+							  &info,
+							  HASH_ELEM | HASH_BLOBS | HASH_FIXED_SIZE);
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+/*
+ * Read the resource usage of this process.
+ */
+static void
+stmt_usage_read(StmtUsage * u)
+{
+	struct rusage ru;
+	char	   *buf;
+	size_t		len;
+
+	memset(u, 0, sizeof(StmtUsage));
+
+	if (getrusage(RUSAGE_SELF, &ru) == 0)
+	{
+		u->utime = (int64) ru.ru_utime.tv_sec * 1000000 + ru.ru_utime.tv_usec;
+		u->stime = (int64) ru.ru_stime.tv_sec * 1000000 + ru.ru_stime.tv_usec;
+		u->minflt = ru.ru_minflt;
+		u->majflt = ru.ru_majflt;
+		u->nvcsw = ru.ru_nvcsw;
+		u->nivcsw = ru.ru_nivcsw;
+	}
+
+	/*
+	 * "rchar: 1234\nwchar: ...\nsyscr: ...\nsyscw: ...\nread_bytes: ...\n
+	 * write_bytes: ...\ncancelled_write_bytes: ...\n"
+	 */
+	if ((buf = procfile_read_extended(&self_io_file, &len, true)) != NULL)
+	{
+		int64		v[7];
+		int			i;
+
+		for (i = 0; i < lengthof(v); i++)
+		{
+			if (pl_next_token(&buf) == NULL || !pl_parse_int64(&buf, &v[i]))
+				break;
+			pl_next_line(&buf);
+		}
+
+		if (i == lengthof(v))
+		{
+			u->rchar = v[0];
+			u->wchar = v[1];
+			u->read_bytes = v[4];
+			u->write_bytes = v[5];
+		}
+	}
+}
+
+static void
+stmt_usage_add(StmtUsage * dst, const StmtUsage * start, const StmtUsage * end)
+{
+	dst->utime += end->utime - start->utime;
+	dst->stime += end->stime - start->stime;
+	dst->minflt += end->minflt - start->minflt;
+	dst->majflt += end->majflt - start->majflt;
+	dst->nvcsw += end->nvcsw - start->nvcsw;
+	dst->nivcsw += end->nivcsw - start->nivcsw;
+	dst->rchar += end->rchar - start->rchar;
+	dst->wchar += end->wchar - start->wchar;
+	dst->read_bytes += end->read_bytes - start->read_bytes;
+	dst->write_bytes += end->write_bytes - start->write_bytes;
+}
+
+/*
+ * Add the usage of an execution to the entry of the query, creating it if
+ * needed.  If the table is full, the execution is only counted as dropped.
+ */
+static void
+stmt_store(uint64 queryid, const StmtUsage * usage, bool count_call)
+{
+	StmtKey		key;
+	StmtEntry  *entry;
+
+	memset(&key, 0, sizeof(key));
+	key.userid = GetUserId();
+	key.dbid = MyDatabaseId;
+	key.queryid = queryid;
+
+	LWLockAcquire(stmts->lock, LW_SHARED);
+
+	entry = (StmtEntry *) hash_search(stmt_hash, &key, HASH_FIND, NULL);
+	if (entry == NULL)
+	{
+		bool		found;
+
+		LWLockRelease(stmts->lock);
+		LWLockAcquire(stmts->lock, LW_EXCLUSIVE);
+
+		if (hash_get_num_entries(stmt_hash) >= statements_max)
+		{
+			/* Another backend may have created it meanwhile */
+			entry = (StmtEntry *) hash_search(stmt_hash, &key, HASH_FIND, NULL);
+			if (entry == NULL)
+			{
+				LWLockRelease(stmts->lock);
+				pg_atomic_fetch_add_u64(&stmts->dropped, 1);
+				return;
+			}
+		}
+		else
+		{
+			entry = (StmtEntry *) hash_search(stmt_hash, &key, HASH_ENTER, &found);
+			if (!found)
+			{
+				SpinLockInit(&entry->mutex);
+				entry->calls = 0;
+				memset(&entry->usage, 0, sizeof(StmtUsage));
+			}
+		}
+	}
+
+	SpinLockAcquire(&entry->mutex);
+	if (count_call)
+		entry->calls++;
+	entry->usage.utime += usage->utime;
+	entry->usage.stime += usage->stime;
+	entry->usage.minflt += usage->minflt;
+	entry->usage.majflt += usage->majflt;
+	entry->usage.nvcsw += usage->nvcsw;
+	entry->usage.nivcsw += usage->nivcsw;
+	entry->usage.rchar += usage->rchar;
+	entry->usage.wchar += usage->wchar;
+	entry->usage.read_bytes += usage->read_bytes;
+	entry->usage.write_bytes += usage->write_bytes;
+	SpinLockRelease(&entry->mutex);
+
+	LWLockRelease(stmts->lock);
+}
+
+/*
+ * Forget a query whose executor state is freed without ExecutorEnd, i.e.
+ * on error.
+ */
+static void
+stmt_running_forget(void *arg)
+{
+	StmtRunning *r = (StmtRunning *) arg;
+
+	if (r->queryDesc != NULL)
+		dlist_delete(&r->node);
+}
+
+static StmtRunning *
+stmt_running_find(QueryDesc *queryDesc)
+{
+	dlist_iter	iter;
+
+	dlist_foreach(iter, &running)
+	{
+		StmtRunning *r = dlist_container(StmtRunning, node, iter.cur);
+
+		if (r->queryDesc == queryDesc)
+			return r;
+	}
+
+	return NULL;
+}
+
+static void
+stmt_ExecutorStart(QueryDesc *queryDesc, int eflags)
+{
+	if (prev_ExecutorStart)
+		prev_ExecutorStart(queryDesc, eflags);
+	else
+		standard_ExecutorStart(queryDesc, eflags);
+
+	if (stmt_enabled(nesting_level) &&
+		queryDesc->plannedstmt->queryId != UINT64CONST(0) &&
+		(eflags & EXEC_FLAG_EXPLAIN_ONLY) == 0)
+	{
+		MemoryContext cxt = queryDesc->estate->es_query_cxt;
+		StmtRunning *r;
+
+		r = (StmtRunning *) MemoryContextAllocZero(cxt, sizeof(StmtRunning));
+		r->queryDesc = queryDesc;
+		r->cb.func = stmt_running_forget;
+		r->cb.arg = r;
+		MemoryContextRegisterResetCallback(cxt, &r->cb);
+		dlist_push_head(&running, &r->node);
+	}
+}
+
+/*
+ * Return the running query of queryDesc if it is tracked and called at the
+ * top level, and take the usage at the start of the call into start.
+ */
+static StmtRunning *
+stmt_call_start(QueryDesc *queryDesc, StmtUsage * start)
+{
+	StmtRunning *r;
+
+	if (nesting_level != 0 || dlist_is_empty(&running) ||
+		(r = stmt_running_find(queryDesc)) == NULL)
+		return NULL;
+
+	stmt_usage_read(start);
+	return r;
+}
+
+static void
+stmt_call_end(StmtRunning * r, const StmtUsage * start)
+{
+	StmtUsage	end;
+
+	stmt_usage_read(&end);
+	stmt_usage_add(&r->usage, start, &end);
+}
+
+static void
+stmt_ExecutorRun(QueryDesc *queryDesc, ScanDirection direction, uint64 count,
+				 bool execute_once)
+{
+	StmtUsage	start;
+	StmtRunning *r = stmt_call_start(queryDesc, &start);
+
+	nesting_level++;
+	PG_TRY();
+	{
+		if (prev_ExecutorRun)
+			prev_ExecutorRun(queryDesc, direction, count, execute_once);
+		else
+			standard_ExecutorRun(queryDesc, direction, count, execute_once);
+	}
+	PG_FINALLY();
+	{
+		nesting_level--;
+	}
+	PG_END_TRY();
+
+	if (r)
+		stmt_call_end(r, &start);
+}
+
+static void
+stmt_ExecutorFinish(QueryDesc *queryDesc)
+{
+	StmtUsage	start;
+	StmtRunning *r = stmt_call_start(queryDesc, &start);
+
+	nesting_level++;
+	PG_TRY();
+	{
+		if (prev_ExecutorFinish)
+			prev_ExecutorFinish(queryDesc);
+		else
+			standard_ExecutorFinish(queryDesc);
+	}
+	PG_FINALLY();
+	{
+		nesting_level--;
+	}
+	PG_END_TRY();
+
+	if (r)
+		stmt_call_end(r, &start);
+}
+
+static void
+stmt_ExecutorEnd(QueryDesc *queryDesc)
+{
+	StmtRunning *r;
+
+	if (!dlist_is_empty(&running) &&
+		(r = stmt_running_find(queryDesc)) != NULL)
+	{
+		dlist_delete(&r->node);
+		r->queryDesc = NULL;
+
+		stmt_store(queryDesc->plannedstmt->queryId, &r->usage,
+				   !IsParallelWorker());
+	}
+
+	if (prev_ExecutorEnd)
+		prev_ExecutorEnd(queryDesc);
+	else
+		standard_ExecutorEnd(queryDesc);
+}
+
+/*
+ * Run a utility statement one level down, so the queries it runs are not
+ * seen as top-level ones.  As in pg_stat_statements, EXECUTE and PREPARE
+ * are left at the top level: the prepared query is the one to track.
+ */
+static void
+stmt_ProcessUtility(PlannedStmt *pstmt, const char *queryString,
+					bool readOnlyTree,
+					ProcessUtilityContext context,
+					ParamListInfo params, QueryEnvironment *queryEnv,
+					DestReceiver *dest, QueryCompletion *qc)
+{
+	Node	   *parsetree = pstmt->utilityStmt;
+	bool		nest = !IsA(parsetree, ExecuteStmt) &&
+		!IsA(parsetree, PrepareStmt);
+
+	if (nest)
+		nesting_level++;
+	PG_TRY();
+	{
+		if (prev_ProcessUtility)
+			prev_ProcessUtility(pstmt, queryString, readOnlyTree,
+								context, params, queryEnv,
+								dest, qc);
+		else
+			standard_ProcessUtility(pstmt, queryString, readOnlyTree,
+									context, params, queryEnv,
+									dest, qc);
+	}
+	PG_FINALLY();
+	{
+		if (nest)
+			nesting_level--;
+	}
+	PG_END_TRY();
+}
+
+void
+statements_install_hooks(void)
+{
+	if (statements_max <= 0)
+		return;
+
+	/* Have queryids computed without pg_stat_statements. */
+	EnableQueryId();
+
+	prev_ExecutorStart = ExecutorStart_hook;
+	ExecutorStart_hook = stmt_ExecutorStart;
+	prev_ExecutorRun = ExecutorRun_hook;
+	ExecutorRun_hook = stmt_ExecutorRun;
+	prev_ExecutorFinish = ExecutorFinish_hook;
+	ExecutorFinish_hook = stmt_ExecutorFinish;
+	prev_ExecutorEnd = ExecutorEnd_hook;
+	ExecutorEnd_hook = stmt_ExecutorEnd;
+	prev_ProcessUtility = ProcessUtility_hook;
+	ProcessUtility_hook = stmt_ProcessUtility;
+}
+
+static void
+stmt_check_loaded(void)
+{
+	if (stmts == NULL || stmt_hash == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("pg_proc_statements is not available"),
+				 errhint("pg_linux_proc must be loaded via shared_preload_libraries, and pg_linux_proc.statements_max must be greater than zero.")));
+}
+
+/*
+ * SQL functions
+ */
+
+PG_FUNCTION_INFO_V1(pg_proc_statements);
+PG_FUNCTION_INFO_V1(pg_proc_statements_info);
+PG_FUNCTION_INFO_V1(pg_proc_statements_reset);
+
+#define NUM_STATEMENTS_COLS 14
+
+/*
+ * Show the resource usage of each query.  Times are in seconds.  As in
+ * pg_stat_statements, the queryid of other users' queries is NULL unless
+ * the caller has the privileges of pg_read_all_stats.
+ */
+Datum
+pg_proc_statements(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Oid			userid = GetUserId();
+	bool		read_all_stats;
+	HASH_SEQ_STATUS status;
+	StmtEntry  *entry;
+
+	stmt_check_loaded();
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	read_all_stats = has_privs_of_role(userid, ROLE_PG_READ_ALL_STATS);
+
+	LWLockAcquire(stmts->lock, LW_SHARED);
+
+	hash_seq_init(&status, stmt_hash);
+	while ((entry = (StmtEntry *) hash_seq_search(&status)) != NULL)
+	{
+		Datum		values[NUM_STATEMENTS_COLS];
+		bool		nulls[NUM_STATEMENTS_COLS];
+		int64		calls;
+		StmtUsage	u;
+		int			i;
+
+		SpinLockAcquire(&entry->mutex);
+		calls = entry->calls;
+		u = entry->usage;
+		SpinLockRelease(&entry->mutex);
+
+		/* Only parallel workers have run it so far */
+		if (calls == 0)
+			continue;
+
+		memset(nulls, false, sizeof(nulls));
+
+		i = 0;
+		values[i++] = ObjectIdGetDatum(entry->key.userid);
+		values[i++] = ObjectIdGetDatum(entry->key.dbid);
+		if (read_all_stats || entry->key.userid == userid)
+			values[i++] = Int64GetDatum((int64) entry->key.queryid);
+		else
+			nulls[i++] = true;
+		values[i++] = Int64GetDatum(calls);
+		values[i++] = Float8GetDatum(u.utime / 1000000.0);
+		values[i++] = Float8GetDatum(u.stime / 1000000.0);
+		values[i++] = Int64GetDatum(u.minflt);
+		values[i++] = Int64GetDatum(u.majflt);
+		values[i++] = Int64GetDatum(u.nvcsw);
+		values[i++] = Int64GetDatum(u.nivcsw);
+		values[i++] = Int64GetDatum(u.rchar);
+		values[i++] = Int64GetDatum(u.wchar);
+		values[i++] = Int64GetDatum(u.read_bytes);
+		values[i++] = Int64GetDatum(u.write_bytes);
+
+		Assert(i == NUM_STATEMENTS_COLS);
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	LWLockRelease(stmts->lock);
+
+	return (Datum) 0;
+}
+
+#define NUM_STATEMENTS_INFO_COLS 3
+
+Datum
+pg_proc_statements_info(PG_FUNCTION_ARGS)
+{
+	TupleDesc	tupdesc;
+	HeapTuple	tuple;
+	Datum		values[NUM_STATEMENTS_INFO_COLS];
+	bool		nulls[NUM_STATEMENTS_INFO_COLS];
+	int			i;
+
+	stmt_check_loaded();
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	Assert(tupdesc->natts == lengthof(values));
+
+	memset(nulls, false, sizeof(nulls));
+
+	LWLockAcquire(stmts->lock, LW_SHARED);
+
+	i = 0;
+	values[i++] = Int64GetDatum(hash_get_num_entries(stmt_hash));
+	values[i++] = Int64GetDatum((int64) pg_atomic_read_u64(&stmts->dropped));
+	values[i++] = TimestampTzGetDatum(stmts->reset_ts);
+	Assert(i == NUM_STATEMENTS_INFO_COLS);
+
+	LWLockRelease(stmts->lock);
+
+	tuple = heap_form_tuple(tupdesc, values, nulls);
+
+	return HeapTupleGetDatum(tuple);
+}
+
+/*
+ * Remove all the entries.
+ */
+Datum
+pg_proc_statements_reset(PG_FUNCTION_ARGS)
+{
+	HASH_SEQ_STATUS status;
+	StmtEntry  *entry;
+
+	stmt_check_loaded();
+
+	LWLockAcquire(stmts->lock, LW_EXCLUSIVE);
+
+	hash_seq_init(&status, stmt_hash);
+	while ((entry = (StmtEntry *) hash_seq_search(&status)) != NULL)
+		hash_search(stmt_hash, &entry->key, HASH_REMOVE, NULL);
+
+	pg_atomic_write_u64(&stmts->dropped, 0);
+	stmts->reset_ts = GetCurrentTimestamp();
+
+	LWLockRelease(stmts->lock);
+
+	PG_RETURN_VOID();
+}
@@ -0,0 +1,28 @@
+/*-------------------------------------------------------------------------
+ *
+ * statements.h
+ *		Per-query OS resource usage of pg_linux_proc
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#ifndef __STATEMENTS_H__
+#define __STATEMENTS_H__
+
+#define FILE_SELF_IO		"/proc/self/io"
+
+/* GUC variables */
+extern int	statements_max;
+extern bool statements_track;
+
+extern void statements_define_gucs(void);
+extern void statements_install_hooks(void);
+extern Size statements_shmem_size(void);
+extern void statements_shmem_request(void);
+extern void statements_shmem_startup(void);
+
+#endif
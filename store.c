@@ -0,0 +1,2102 @@
+/*-------------------------------------------------------------------------
+ *
+ * store.c
+ *		On-disk time-series store of pg_linux_proc
+ *
+ * The background sampler appends each sample of /proc/loadavg, meminfo,
+ * stat and diskstats to segment files under $PGDATA/pg_linux_proc/<source>,
+ * so the history survives a restart or a crash of the server, unlike the
+ * ring buffer in shared memory.  pg_proc_history() reads them.
+ *
+ * The raw samples are also rolled up into tiers of 1 minute and 1 hour
+ * buckets, kept in the subdirectories "1m" and "1h" with their own
+ * retention.  A row of a tier holds the min, max, avg and last of the rate
+ * of each counter, or of the value of each gauge, over the samples of the
+ * bucket, and of the awaits of each device derived from the diskstats
+ * counters as by pg_proc_iostat().  The rollups are aggregated as the
+ * samples are taken, so they are exact, and the bucket in progress is lost
+ * at a restart.
+ * pg_proc_history_rollup() reads the coarsest tier that is fine enough for
+ * the requested resolution, so a query over a month reads a few hundred
+ * rows per column instead of millions.
+ *
+ * A row of a tier also holds a DDSketch of the rates or values of each
+ * column over the bucket.  The sketches merge exactly, so
+ * pg_proc_percentiles() computes the quantiles over any range of buckets
+ * from them, without the raw samples.
+ *
+ * A segment covers pg_linux_proc.store_segment_duration of raw samples,
+ * or a day and 30 days of the tiers.  It begins with a header holding the
+ * min and max sampling times of its blocks, with which a reader skips the
+ * segments out of the time range without reading them, followed by the
+ * names of the items of the source, i.e. the cpus or the devices; loadavg
+ * and meminfo have a single unnamed item.  A new segment is started also
+ * when the set of items changes.
+ *
+ * Rows are buffered and written as a block every STORE_BLOCK_ROWS rows or
+ * block_secs of the tier.  A block is columnar: the sampling times and
+ * each (item, metric) column are encoded separately, as the difference
+ * between consecutive deltas in a variable-length bit code as in
+ * Facebook's Gorilla.  A counter growing at a steady rate, or a value that
+ * does not change, takes one bit per sample.  Each block has its own time
+ * range and CRC, and a torn block at the end of a segment is ignored.
+ *
+ * Files are written without fsync: a crash of the server loses nothing
+ * written, and a crash of the OS at most the last blocks.
+ *
+ * When a segment is started, the segments of the tier whose newest row is
+ * older than the retention of the tier are removed.
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "catalog/pg_type.h"
+#include "common/file_perm.h"
+#include "funcapi.h"
+#include "lib/stringinfo.h"
+#include "miscadmin.h"
+#include "port/pg_crc32c.h"
+#include "storage/fd.h"
+#include "storage/ipc.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+
+#include "diskstats.h"
+#include "sketch.h"
+#include "stat.h"
+#include "store.h"
+
+#define STORE_SEGMENT_MAGIC	0x53504C50	/* "PLPS" */
+#define STORE_BLOCK_MAGIC	0x42504C50	/* "PLPB" */
+#define STORE_VERSION		1
+
+#define STORE_ITEM_LEN		32
+#define STORE_BLOCK_ROWS	64
+#define STORE_SUFFIX		".seg"
+
+/* float4 values, i.e. the load averages, are stored multiplied by this */
+#define STORE_FLOAT4_SCALE	100
+
+/* The rates and values of the tiers are stored multiplied by this */
+#define STORE_RATE_SCALE	1000
+
+typedef struct StoreSegmentHeader
+{
+	uint32		magic;
+	uint16		version;
+	uint8		source;
+	uint8		tier;
+	TimestampTz min_ts;			/* of the blocks written so far */
+	TimestampTz max_ts;
+	int32		nitems;			/* followed by item names */
+	int32		nmetrics;		/* columns per item */
+}			StoreSegmentHeader;
+
+/*
+ * The payload is the column of the sampling times followed by the columns
+ * of each item and metric, item-major, and in the rollup tiers by a column
+ * of the sketches of the rows for each item and metric.  Each column is
+ * preceded by its length in bytes as a varint.
+ */
+typedef struct StoreBlockHeader
+{
+	uint32		magic;
+	uint32		size;			/* of the payload */
+	TimestampTz min_ts;
+	TimestampTz max_ts;
+	uint32		nrows;
+	pg_crc32c	crc;			/* of the payload */
+}			StoreBlockHeader;
+
+static const StoreMetric loadavg_metrics[] = {
+	{"loadavg1", offsetof(LoadAvg, loadavg1), STORE_FLOAT4, false, STORE_UNIT_NONE,
+	"1m load average."},
+	{"loadavg5", offsetof(LoadAvg, loadavg5), STORE_FLOAT4, false, STORE_UNIT_NONE,
+	"5m load average."},
+	{"loadavg15", offsetof(LoadAvg, loadavg15), STORE_FLOAT4, false, STORE_UNIT_NONE,
+	"15m load average."},
+	{"current_processes", offsetof(LoadAvg, current_processes), STORE_INT32, false, STORE_UNIT_NONE,
+	"Runnable kernel scheduling entities."},
+	{"total_processes", offsetof(LoadAvg, total_processes), STORE_INT32, false, STORE_UNIT_NONE,
+	"Kernel scheduling entities."},
+};
+
+#define MEMINFO_METRIC(key, field, unit) \
+	{#field, offsetof(MemInfo, field), STORE_INT64, false, STORE_UNIT_##unit, \
+	key " of /proc/meminfo."},
+
+static const StoreMetric meminfo_metrics[] = {
+	MEMINFO_KEYS(MEMINFO_METRIC)
+};
+
+static const StoreMetric stat_metrics[] = {
+	{"usr", offsetof(ProcStat, user), STORE_INT64, true, STORE_UNIT_TICKS,
+	"Time spent in user mode."},
+	{"nice", offsetof(ProcStat, nice), STORE_INT64, true, STORE_UNIT_TICKS,
+	"Time spent in user mode with low priority."},
+	{"system", offsetof(ProcStat, system), STORE_INT64, true, STORE_UNIT_TICKS,
+	"Time spent in system mode."},
+	{"idle", offsetof(ProcStat, idle), STORE_INT64, true, STORE_UNIT_TICKS,
+	"Time spent idle."},
+	{"iowait", offsetof(ProcStat, iowait), STORE_INT64, true, STORE_UNIT_TICKS,
+	"Time spent idle waiting for I/O."},
+	{"irq", offsetof(ProcStat, irq), STORE_INT64, true, STORE_UNIT_TICKS,
+	"Time spent servicing interrupts."},
+	{"softirq", offsetof(ProcStat, softirq), STORE_INT64, true, STORE_UNIT_TICKS,
+	"Time spent servicing softirqs."},
+	{"steal", offsetof(ProcStat, steal), STORE_INT64, true, STORE_UNIT_TICKS,
+	"Time stolen by the hypervisor."},
+	{"guest", offsetof(ProcStat, guest), STORE_INT64, true, STORE_UNIT_TICKS,
+	"Time spent running guests."},
+	{"guest_nice", offsetof(ProcStat, guest_nice), STORE_INT64, true, STORE_UNIT_TICKS,
+	"Time spent running guests with low priority."},
+};
+
+static const StoreMetric diskstats_metrics[] = {
+	{"rd", offsetof(DiskStat, rd), STORE_INT64, true, STORE_UNIT_NONE,
+	"Reads completed successfully."},
+	{"rd_merged", offsetof(DiskStat, rd_merged), STORE_INT64, true, STORE_UNIT_NONE,
+	"Reads merged."},
+	{"rd_sec", offsetof(DiskStat, rd_sec), STORE_INT64, true, STORE_UNIT_SECTORS,
+	"Data read."},
+	{"rd_tm", offsetof(DiskStat, rd_tm), STORE_INT64, true, STORE_UNIT_MS,
+	"Time spent reading."},
+	{"wr", offsetof(DiskStat, wr), STORE_INT64, true, STORE_UNIT_NONE,
+	"Writes completed successfully."},
+	{"wr_merged", offsetof(DiskStat, wr_merged), STORE_INT64, true, STORE_UNIT_NONE,
+	"Writes merged."},
+	{"wr_sec", offsetof(DiskStat, wr_sec), STORE_INT64, true, STORE_UNIT_SECTORS,
+	"Data written."},
+	{"wr_tm", offsetof(DiskStat, wr_tm), STORE_INT64, true, STORE_UNIT_MS,
+	"Time spent writing."},
+	{"io", offsetof(DiskStat, io), STORE_INT64, false, STORE_UNIT_NONE,
+	"I/Os currently in progress."},
+	{"tm", offsetof(DiskStat, tm), STORE_INT64, true, STORE_UNIT_MS,
+	"Time spent doing I/Os."},
+	{"wtm", offsetof(DiskStat, wtm), STORE_INT64, true, STORE_UNIT_MS,
+	"Weighted time spent doing I/Os."},
+	{"dis", offsetof(DiskStat, dis), STORE_INT64, true, STORE_UNIT_NONE,
+	"Discards completed successfully."},
+	{"dis_merged", offsetof(DiskStat, dis_merged), STORE_INT64, true, STORE_UNIT_NONE,
+	"Discards merged."},
+	{"dis_sec", offsetof(DiskStat, dis_sec), STORE_INT64, true, STORE_UNIT_SECTORS,
+	"Data discarded."},
+	{"dis_tm", offsetof(DiskStat, dis_tm), STORE_INT64, true, STORE_UNIT_MS,
+	"Time spent discarding."},
+	{"fl", offsetof(DiskStat, fl), STORE_INT64, true, STORE_UNIT_NONE,
+	"Flush requests completed successfully."},
+	{"tm_fl", offsetof(DiskStat, tm_fl), STORE_INT64, true, STORE_UNIT_MS,
+	"Time spent flushing."},
+};
+
+static const StoreRatio diskstats_ratios[] = {
+	{"r_await", 3, 0},			/* rd_tm / rd */
+	{"w_await", 7, 4},			/* wr_tm / wr */
+	{"d_await", 14, 11},		/* dis_tm / dis */
+	{"f_await", 16, 15},		/* tm_fl / fl */
+};
+
+const StoreSourceDef store_sources[NUM_STORE_SOURCES] = {
+	{"loadavg", loadavg_metrics, lengthof(loadavg_metrics), NULL, 0, false},
+	{"meminfo", meminfo_metrics, lengthof(meminfo_metrics), NULL, 0, false},
+	{"stat", stat_metrics, lengthof(stat_metrics), NULL, 0, true},
+	{"diskstats", diskstats_metrics, lengthof(diskstats_metrics),
+		diskstats_ratios, lengthof(diskstats_ratios), true},
+};
+
+/* GUC variables */
+int			store_retention = 24 * 60;	/* min */
+int			store_retention_1m = 30 * 24 * 60;	/* min */
+int			store_retention_1h = 365 * 24 * 60; /* min */
+int			store_segment_duration = 60;	/* min */
+
+/*
+ * Tier 0 holds the raw samples, and the others the rollups.  A row of a
+ * rollup tier has NUM_ROLLUP_STATS columns per metric and ratio.
+ */
+typedef struct StoreTier
+{
+	const char *name;			/* subdirectory; NULL for the raw samples */
+	int64		bucket;			/* us; 0 for the raw samples */
+	int64		segment;		/* us; 0 for store_segment_duration */
+	int			block_secs;		/* max time buffered before a block is
+								 * written */
+	int		   *retention;		/* GUC, in minutes */
+}			StoreTier;
+
+#define NUM_STORE_TIERS		3
+
+static const StoreTier store_tiers[NUM_STORE_TIERS] = {
+	{NULL, 0, 0, 60, &store_retention},
+	{"1m", USECS_PER_MINUTE, USECS_PER_DAY, 15 * 60, &store_retention_1m},
+	{"1h", USECS_PER_HOUR, 30 * USECS_PER_DAY, 0, &store_retention_1h},
+};
+
+#define NUM_ROLLUP_STATS	4	/* min, max, avg, last */
+
+/* The metrics and then the ratios of an item of the rollup tiers */
+#define RollupMetrics(source) \
+	(store_sources[source].nmetrics + store_sources[source].nratios)
+
+#define TierMetrics(source, tier) \
+	((tier) > 0 ? RollupMetrics(source) * NUM_ROLLUP_STATS : \
+	 store_sources[source].nmetrics)
+
+/*
+ * The open segment and the buffered block of a source and tier, in the
+ * sampler.  values is column-major, STORE_BLOCK_ROWS values per column.
+ */
+typedef struct StoreWriter
+{
+	int			fd;				/* -1 if no segment is open */
+	char		path[MAXPGPATH];
+	off_t		offset;			/* end of the segment */
+	StoreSegmentHeader header;
+	TimestampTz seg_end;		/* start of the next segment */
+	TimestampTz retry_ts;		/* no new segment before, after a failure */
+	char	  (*items)[STORE_ITEM_LEN];
+	int			nrows;
+	TimestampTz ts[STORE_BLOCK_ROWS];
+	int64	   *values;
+	int			nsketches;		/* item and metric pairs; 0 for the raw
+								 * samples */
+	StringInfoData *sketches;
+}			StoreWriter;
+
+/* The previous raw sample of a source, to compute the rates */
+typedef struct StorePrev
+{
+	TimestampTz ts;				/* DT_NOBEGIN if none */
+	int			nitems;
+	char	  (*items)[STORE_ITEM_LEN];
+	int64	   *values;
+}			StorePrev;
+
+/* The bucket in progress of a source and rollup tier */
+typedef struct StoreRollup
+{
+	TimestampTz bucket;			/* start; DT_NOBEGIN if none */
+	int			nitems;
+	char	  (*items)[STORE_ITEM_LEN];
+	double	   *min;
+	double	   *max;
+	double	   *sum;
+	double	   *last;
+	int		   *count;
+	int			nsketches;		/* of the allocated arrays */
+	DDSketch   *sketches;
+}			StoreRollup;
+
+static StoreWriter store_writers[NUM_STORE_SOURCES][NUM_STORE_TIERS];
+static StorePrev store_prev[NUM_STORE_SOURCES];
+static StoreRollup store_rollups[NUM_STORE_SOURCES][NUM_STORE_TIERS];
+static bool store_initialized = false;
+
+static void store_close(int code, Datum arg);
+
+void
+store_define_gucs(void)
+{
+	DefineCustomIntVariable("pg_linux_proc.store_retention",
+							"Sets how long the raw samples are kept on disk.",
+							"Zero disables the on-disk store.",
+							&store_retention,
+							24 * 60,
+							0,
+							INT_MAX / 2,
+							PGC_SIGHUP,
+							GUC_UNIT_MIN,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("pg_linux_proc.store_retention_1m",
+							"Sets how long the 1 minute rollups are kept on disk.",
+							NULL,
+							&store_retention_1m,
+							30 * 24 * 60,
+							0,
+							INT_MAX / 2,
+							PGC_SIGHUP,
+							GUC_UNIT_MIN,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("pg_linux_proc.store_retention_1h",
+							"Sets how long the 1 hour rollups are kept on disk.",
+							NULL,
+							&store_retention_1h,
+							365 * 24 * 60,
+							0,
+							INT_MAX / 2,
+							PGC_SIGHUP,
+							GUC_UNIT_MIN,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("pg_linux_proc.store_segment_duration",
+							"Sets the time covered by a segment file of the raw samples.",
+							NULL,
+							&store_segment_duration,
+							60,
+							1,
+							7 * 24 * 60,
+							PGC_SIGHUP,
+							GUC_UNIT_MIN,
+							NULL,
+							NULL,
+							NULL);
+}
+
+/*
+ * Bit streams
+ */
+
+typedef struct BitWriter
+{
+	StringInfo	buf;
+	uint32		cur;
+	int			nbits;			/* in cur */
+}			BitWriter;
+
+typedef struct BitReader
+{
+	const uint8 *p;
+	const uint8 *end;
+	uint32		cur;
+	int			nbits;			/* left in cur */
+	bool		overrun;
+}			BitReader;
+
+/* Append the n low bits of v, most significant first */
+static void
+bw_put(BitWriter * bw, uint64 v, int n)
+{
+	while (n > 0)
+	{
+		int			take = Min(n, 8 - bw->nbits);
+
+		bw->cur = (bw->cur << take) | ((v >> (n - take)) & ((1U << take) - 1));
+		bw->nbits += take;
+		n -= take;
+
+		if (bw->nbits == 8)
+		{
+			appendStringInfoChar(bw->buf, (char) bw->cur);
+			bw->cur = 0;
+			bw->nbits = 0;
+		}
+	}
+}
+
+static void
+bw_flush(BitWriter * bw)
+{
+	if (bw->nbits > 0)
+		bw_put(bw, 0, 8 - bw->nbits);
+}
+
+static uint64
+br_get(BitReader * br, int n)
+{
+	uint64		v = 0;
+
+	while (n > 0)
+	{
+		int			take;
+
+		if (br->nbits == 0)
+		{
+			if (br->p >= br->end)
+			{
+				br->overrun = true;
+				return 0;
+			}
+			br->cur = *br->p++;
+			br->nbits = 8;
+		}
+
+		take = Min(n, br->nbits);
+		v = (v << take) | ((br->cur >> (br->nbits - take)) & ((1U << take) - 1));
+		br->nbits -= take;
+		n -= take;
+	}
+
+	return v;
+}
+
+static inline uint64
+zigzag_encode(int64 v)
+{
+	return ((uint64) v << 1) ^ (uint64) (v >> 63);
+}
+
+static inline int64
+zigzag_decode(uint64 v)
+{
+	return (int64) (v >> 1) ^ -(int64) (v & 1);
+}
+
+static void
+append_varint(StringInfo buf, uint64 v)
+{
+	while (v >= 0x80)
+	{
+		appendStringInfoChar(buf, (char) ((v & 0x7F) | 0x80));
+		v >>= 7;
+	}
+	appendStringInfoChar(buf, (char) v);
+}
+
+/* Return false if the varint runs past end */
+static bool
+read_varint(const uint8 **p, const uint8 *end, uint64 *v)
+{
+	int			shift = 0;
+
+	*v = 0;
+	while (*p < end && shift < 64)
+	{
+		uint8		b = *(*p)++;
+
+		*v |= (uint64) (b & 0x7F) << shift;
+		if ((b & 0x80) == 0)
+			return true;
+		shift += 7;
+	}
+	return false;
+}
+
+/*
+ * Encode n values: the first as a zigzag-encoded varint, then the
+ * zigzag-encoded difference of each delta from the previous one, prefixed
+ * by its size: '0' for zero, '10' for 7 bits, '110' for 9 bits, '1110' for
+ * 12 bits and '1111' for 64 bits.
+ */
+static void
+encode_column(StringInfo buf, const int64 *values, int n)
+{
+	BitWriter	bw = {buf, 0, 0};
+	int64		prev_delta = 0;
+	int			i;
+
+	append_varint(buf, zigzag_encode(values[0]));
+
+	for (i = 1; i < n; i++)
+	{
+		int64		delta = (int64) ((uint64) values[i] - (uint64) values[i - 1]);
+		uint64		z = zigzag_encode((int64) ((uint64) delta - (uint64) prev_delta));
+
+		if (z == 0)
+			bw_put(&bw, 0x0, 1);
+		else if (z < (UINT64CONST(1) << 7))
+		{
+			bw_put(&bw, 0x2, 2);
+			bw_put(&bw, z, 7);
+		}
+		else if (z < (UINT64CONST(1) << 9))
+		{
+			bw_put(&bw, 0x6, 3);
+			bw_put(&bw, z, 9);
+		}
+		else if (z < (UINT64CONST(1) << 12))
+		{
+			bw_put(&bw, 0xE, 4);
+			bw_put(&bw, z, 12);
+		}
+		else
+		{
+			bw_put(&bw, 0xF, 4);
+			bw_put(&bw, z, 64);
+		}
+		prev_delta = delta;
+	}
+
+	bw_flush(&bw);
+}
+
+/*
+ * Decode n values encoded by encode_column().  Return false if the data
+ * ends early.
+ */
+static bool
+decode_column(const uint8 *data, size_t len, int64 *values, int n)
+{
+	BitReader	br = {data, data + len, 0, 0, false};
+	int64		prev_delta = 0;
+	uint64		first;
+	int			i;
+
+	if (!read_varint(&br.p, br.end, &first))
+		return false;
+	values[0] = zigzag_decode(first);
+
+	for (i = 1; i < n; i++)
+	{
+		uint64		z;
+		int64		delta;
+
+		if (br_get(&br, 1) == 0)
+			z = 0;
+		else if (br_get(&br, 1) == 0)
+			z = br_get(&br, 7);
+		else if (br_get(&br, 1) == 0)
+			z = br_get(&br, 9);
+		else if (br_get(&br, 1) == 0)
+			z = br_get(&br, 12);
+		else
+			z = br_get(&br, 64);
+
+		delta = (int64) ((uint64) prev_delta + (uint64) zigzag_decode(z));
+		values[i] = (int64) ((uint64) values[i - 1] + (uint64) delta);
+		prev_delta = delta;
+	}
+
+	return !br.overrun;
+}
+
+static void
+append_column(StringInfo payload, StringInfo col, const int64 *values, int n)
+{
+	resetStringInfo(col);
+	encode_column(col, values, n);
+	append_varint(payload, (uint64) col->len);
+	appendBinaryStringInfo(payload, col->data, col->len);
+}
+
+/*
+ * A sketch is encoded as its zero count, its number of non-empty bins and,
+ * for each of them, its key and its count.  The key of the first is
+ * zigzag-encoded, and the others are encoded as the gap from the previous
+ * key.  The rates of a bucket fill a few bins scattered over the range of
+ * the sketch, so the empty bins between them are not written.
+ */
+static void
+append_sketch(StringInfo buf, const DDSketch * sk)
+{
+	int32		nonempty = 0;
+	int32		prev = -1;
+	int32		j;
+
+	for (j = 0; j < sk->nbins; j++)
+		if (sk->bins[j] != 0)
+			nonempty++;
+
+	append_varint(buf, (uint64) sk->zero_count);
+	append_varint(buf, (uint64) nonempty);
+
+	for (j = 0; j < sk->nbins; j++)
+	{
+		if (sk->bins[j] == 0)
+			continue;
+
+		if (prev < 0)
+			append_varint(buf, zigzag_encode(sk->min_key + j));
+		else
+			append_varint(buf, (uint64) (j - prev));
+		append_varint(buf, (uint64) sk->bins[j]);
+		prev = j;
+	}
+}
+
+/*
+ * Decode a sketch into sk, or skip it if sk is NULL.  Return false if the
+ * data is invalid.
+ */
+static bool
+read_sketch(const uint8 **p, const uint8 *end, DDSketch * sk)
+{
+	uint64		zero_count;
+	uint64		nbins;
+	uint64		v;
+	uint64		n;
+	int64		key = 0;
+	int64		first_key = 0;
+	uint64		j;
+
+	if (!read_varint(p, end, &zero_count) || !read_varint(p, end, &nbins) ||
+		nbins > SKETCH_MAX_BINS)
+		return false;
+
+	if (sk)
+	{
+		sketch_reset(sk);
+		sk->zero_count = sk->count = (int64) zero_count;
+	}
+
+	for (j = 0; j < nbins; j++)
+	{
+		if (!read_varint(p, end, &v) || !read_varint(p, end, &n))
+			return false;
+
+		if (j == 0)
+			key = first_key = zigzag_decode(v);
+		else if (v == 0 || v > SKETCH_MAX_BINS)
+			return false;
+		else
+			key += (int64) v;
+
+		/* The bins of a sketch span at most SKETCH_MAX_BINS keys. */
+		if (key - first_key >= SKETCH_MAX_BINS || key > PG_INT32_MAX ||
+			key < PG_INT32_MIN)
+			return false;
+		if (sk && n > 0)
+			sketch_add_key(sk, (int32) key, (int64) n);
+	}
+	return true;
+}
+
+static int64
+metric_value(const char *record, const StoreMetric * metric)
+{
+	const char *field = record + metric->offset;
+
+	switch (metric->type)
+	{
+		case STORE_INT32:
+			return *(const int32 *) field;
+		case STORE_INT64:
+			return *(const int64 *) field;
+		case STORE_FLOAT4:
+			return (int64) rint(*(const float4 *) field * STORE_FLOAT4_SCALE);
+	}
+	return 0;
+}
+
+/* Return the value of pg_proc_history() of a metric of record */
+double
+store_metric_value(const char *record, const StoreMetric * metric)
+{
+	int64		v = metric_value(record, metric);
+
+	if (metric->type == STORE_FLOAT4)
+		return (double) v / STORE_FLOAT4_SCALE;
+	return (double) v;
+}
+
+/*
+ * Writer
+ */
+
+static void
+store_tier_dir(char *path, StoreSource source, int tier)
+{
+	if (store_tiers[tier].name == NULL)
+		snprintf(path, MAXPGPATH, "%s/%s", DIR_STORE, store_sources[source].name);
+	else
+		snprintf(path, MAXPGPATH, "%s/%s/%s", DIR_STORE,
+				 store_sources[source].name, store_tiers[tier].name);
+}
+
+static bool
+same_items(int nitems1, char (*items1)[STORE_ITEM_LEN],
+		   int nitems2, char (*items2)[STORE_ITEM_LEN])
+{
+	return nitems1 == nitems2 &&
+		(nitems1 == 0 || memcmp(items1, items2, STORE_ITEM_LEN * nitems1) == 0);
+}
+
+/* Copy items into TopMemoryContext, replacing *dst */
+static void
+copy_items(char (**dst)[STORE_ITEM_LEN], char (*items)[STORE_ITEM_LEN],
+		   int nitems)
+{
+	if (*dst)
+		pfree(*dst);
+	*dst = MemoryContextAlloc(TopMemoryContext, Max(STORE_ITEM_LEN * nitems, 1));
+	memcpy(*dst, items, STORE_ITEM_LEN * nitems);
+}
+
+/* Close the segment of w, after a failed write or at the end of it */
+static void
+store_close_segment(StoreWriter * w)
+{
+	if (w->fd >= 0)
+		close(w->fd);
+	w->fd = -1;
+	w->nrows = 0;
+}
+
+/*
+ * Write the buffered block and update the time range in the header of the
+ * segment.  On a write error, such as ENOSPC, the segment is closed and
+ * the next row starts a new one; the sampler keeps running.
+ */
+static void
+store_flush_block(StoreWriter * w)
+{
+	int			ncols = w->header.nitems * w->header.nmetrics;
+	StoreBlockHeader bh;
+	StringInfoData payload;
+	StringInfoData col;
+	int			c;
+
+	if (w->fd < 0 || w->nrows == 0)
+		return;
+
+	initStringInfo(&payload);
+	initStringInfo(&col);
+
+	append_column(&payload, &col, w->ts, w->nrows);
+	for (c = 0; c < ncols; c++)
+		append_column(&payload, &col, &w->values[c * STORE_BLOCK_ROWS], w->nrows);
+	for (c = 0; c < w->nsketches; c++)
+	{
+		append_varint(&payload, (uint64) w->sketches[c].len);
+		appendBinaryStringInfo(&payload, w->sketches[c].data, w->sketches[c].len);
+	}
+
+	memset(&bh, 0, sizeof(bh));
+	bh.magic = STORE_BLOCK_MAGIC;
+	bh.size = payload.len;
+	bh.min_ts = w->ts[0];
+	bh.max_ts = w->ts[w->nrows - 1];
+	bh.nrows = w->nrows;
+	INIT_CRC32C(bh.crc);
+	COMP_CRC32C(bh.crc, payload.data, payload.len);
+	FIN_CRC32C(bh.crc);
+
+	if (w->header.min_ts > bh.min_ts)
+		w->header.min_ts = bh.min_ts;
+	w->header.max_ts = bh.max_ts;
+
+	errno = 0;
+	if (pg_pwrite(w->fd, &bh, sizeof(bh), w->offset) != sizeof(bh) ||
+		pg_pwrite(w->fd, payload.data, payload.len,
+				  w->offset + sizeof(bh)) != payload.len ||
+		pg_pwrite(w->fd, &w->header, sizeof(w->header), 0) != sizeof(w->header))
+	{
+		/* if write didn't set errno, assume problem is no disk space */
+		if (errno == 0)
+			errno = ENOSPC;
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not write file \"%s\": %m", w->path)));
+		store_close_segment(w);
+	}
+	else
+		w->offset += sizeof(bh) + payload.len;
+
+	w->nrows = 0;
+	for (c = 0; c < w->nsketches; c++)
+		resetStringInfo(&w->sketches[c]);
+	pfree(payload.data);
+	pfree(col.data);
+}
+
+/*
+ * Remove the segments of the source and tier whose newest row is older
+ * than the retention of the tier, except the open one.
+ */
+static void
+store_remove_old(StoreSource source, int tier, TimestampTz now)
+{
+	StoreWriter *w = &store_writers[source][tier];
+	TimestampTz cutoff = now - (int64) *store_tiers[tier].retention * USECS_PER_MINUTE;
+	char		dirpath[MAXPGPATH];
+	char		path[MAXPGPATH];
+	DIR		   *dir;
+	struct dirent *de;
+
+	store_tier_dir(dirpath, source, tier);
+
+	dir = AllocateDir(dirpath);
+	while ((de = ReadDir(dir, dirpath)) != NULL)
+	{
+		StoreSegmentHeader hdr;
+		TimestampTz newest;
+		int			fd;
+		ssize_t		n;
+
+		if (strstr(de->d_name, STORE_SUFFIX) == NULL)
+			continue;
+
+		snprintf(path, sizeof(path), "%s/%s", dirpath, de->d_name);
+		if (w->fd >= 0 && strcmp(path, w->path) == 0)
+			continue;
+
+		if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+			continue;
+		n = pg_pread(fd, &hdr, sizeof(hdr), 0);
+		close(fd);
+
+		/* A segment without blocks is as old as its name. */
+		if (n == sizeof(hdr) && hdr.magic == STORE_SEGMENT_MAGIC &&
+			hdr.max_ts != DT_NOBEGIN)
+			newest = hdr.max_ts;
+		else
+			newest = strtoi64(de->d_name, NULL, 10);
+
+		if (newest < cutoff && unlink(path) < 0 && errno != ENOENT)
+			ereport(LOG,
+					(errcode_for_file_access(),
+					 errmsg("could not remove file \"%s\": %m", path)));
+	}
+	FreeDir(dir);
+}
+
+/*
+ * Start a segment of the source and tier at ts for the items.  If the file
+ * cannot be created or written, e.g. on ENOSPC or EACCES, the rows are
+ * dropped until the next segment boundary instead of retrying and logging
+ * at every sample.
+ */
+static void
+store_open_segment(StoreSource source, int tier, TimestampTz ts,
+				   int nitems, char (*items)[STORE_ITEM_LEN])
+{
+	StoreWriter *w = &store_writers[source][tier];
+	int			nmetrics = TierMetrics(source, tier);
+	char		dirpath[MAXPGPATH];
+	int64		duration = store_tiers[tier].segment;
+	size_t		items_size = STORE_ITEM_LEN * nitems;
+	int			c;
+
+	if (duration == 0)
+		duration = (int64) store_segment_duration * USECS_PER_MINUTE;
+
+	store_tier_dir(dirpath, source, tier);
+	snprintf(w->path, sizeof(w->path), "%s/" INT64_FORMAT STORE_SUFFIX,
+			 dirpath, (int64) ts);
+
+	copy_items(&w->items, items, nitems);
+	if (w->values)
+		pfree(w->values);
+	w->values = MemoryContextAlloc(TopMemoryContext,
+								   sizeof(int64) * STORE_BLOCK_ROWS *
+								   Max(nitems * nmetrics, 1));
+	w->nrows = 0;
+
+	for (c = 0; c < w->nsketches; c++)
+		pfree(w->sketches[c].data);
+	if (w->sketches)
+		pfree(w->sketches);
+	w->sketches = NULL;
+	w->nsketches = (tier > 0) ? nitems * RollupMetrics(source) : 0;
+	if (w->nsketches > 0)
+	{
+		MemoryContext oldcxt = MemoryContextSwitchTo(TopMemoryContext);
+
+		w->sketches = palloc(sizeof(StringInfoData) * w->nsketches);
+		for (c = 0; c < w->nsketches; c++)
+			initStringInfo(&w->sketches[c]);
+		MemoryContextSwitchTo(oldcxt);
+	}
+	w->seg_end = (ts / duration + 1) * duration;
+
+	memset(&w->header, 0, sizeof(w->header));
+	w->header.magic = STORE_SEGMENT_MAGIC;
+	w->header.version = STORE_VERSION;
+	w->header.source = (uint8) source;
+	w->header.tier = (uint8) tier;
+	w->header.min_ts = DT_NOEND;
+	w->header.max_ts = DT_NOBEGIN;
+	w->header.nitems = nitems;
+	w->header.nmetrics = nmetrics;
+
+	w->fd = open(w->path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+				 pg_file_create_mode);
+	if (w->fd < 0)
+	{
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not create file \"%s\": %m", w->path)));
+		w->retry_ts = w->seg_end;
+		return;
+	}
+
+	errno = 0;
+	if (pg_pwrite(w->fd, &w->header, sizeof(w->header), 0) != sizeof(w->header) ||
+		pg_pwrite(w->fd, items, items_size, sizeof(w->header)) != items_size)
+	{
+		if (errno == 0)
+			errno = ENOSPC;
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not write file \"%s\": %m", w->path)));
+		store_close_segment(w);
+		w->retry_ts = w->seg_end;
+		return;
+	}
+	w->offset = sizeof(w->header) + items_size;
+
+	store_remove_old(source, tier, ts);
+}
+
+/*
+ * Append a row of the source and tier.  row has TierMetrics() values per
+ * item, and sketches, of the rollup tiers, a sketch per item and metric.
+ */
+static void
+store_append_row(StoreSource source, int tier, TimestampTz ts, int nitems,
+				 char (*items)[STORE_ITEM_LEN], const int64 *row,
+				 const DDSketch * sketches)
+{
+	StoreWriter *w = &store_writers[source][tier];
+	int			ncols = nitems * TierMetrics(source, tier);
+	int			c;
+
+	if (w->fd >= 0 &&
+		(ts >= w->seg_end ||
+		 !same_items(nitems, items, w->header.nitems, w->items)))
+	{
+		store_flush_block(w);
+		store_close_segment(w);
+	}
+
+	if (w->fd < 0)
+	{
+		if (ts < w->retry_ts)
+			return;
+		store_open_segment(source, tier, ts, nitems, items);
+		if (w->fd < 0)
+			return;
+	}
+
+	w->ts[w->nrows] = ts;
+	for (c = 0; c < ncols; c++)
+		w->values[c * STORE_BLOCK_ROWS + w->nrows] = row[c];
+	for (c = 0; c < w->nsketches; c++)
+		append_sketch(&w->sketches[c], &sketches[c]);
+	w->nrows++;
+
+	if (w->nrows == STORE_BLOCK_ROWS ||
+		ts - w->ts[0] >= (int64) store_tiers[tier].block_secs * USECS_PER_SEC)
+		store_flush_block(w);
+}
+
+/*
+ * Rollups
+ */
+
+/* Write the bucket in progress of the source and tier, and empty it */
+static void
+rollup_emit(StoreSource source, int tier)
+{
+	StoreRollup *r = &store_rollups[source][tier];
+	int			ncols = r->nitems * RollupMetrics(source);
+	int64	   *row;
+	int			c;
+
+	if (r->bucket == DT_NOBEGIN)
+		return;
+
+	row = palloc(sizeof(int64) * NUM_ROLLUP_STATS * Max(ncols, 1));
+	for (c = 0; c < ncols; c++)
+	{
+		int64	   *stats = &row[c * NUM_ROLLUP_STATS];
+
+		/* A column without a rate, e.g. after a counter reset, reads 0. */
+		if (r->count[c] == 0)
+		{
+			memset(stats, 0, sizeof(int64) * NUM_ROLLUP_STATS);
+			continue;
+		}
+		stats[0] = (int64) rint(r->min[c] * STORE_RATE_SCALE);
+		stats[1] = (int64) rint(r->max[c] * STORE_RATE_SCALE);
+		stats[2] = (int64) rint(r->sum[c] / r->count[c] * STORE_RATE_SCALE);
+		stats[3] = (int64) rint(r->last[c] * STORE_RATE_SCALE);
+	}
+
+	store_append_row(source, tier, r->bucket, r->nitems, r->items, row,
+					 r->sketches);
+	pfree(row);
+
+	r->bucket = DT_NOBEGIN;
+}
+
+/*
+ * Add the rates of a sample to the bucket of the tier containing ts.
+ * valid[c] is false for the columns without a rate.
+ */
+static void
+rollup_add(StoreSource source, int tier, TimestampTz ts, int nitems,
+		   char (*items)[STORE_ITEM_LEN], const double *rates, const bool *valid)
+{
+	StoreRollup *r = &store_rollups[source][tier];
+	int			ncols = nitems * RollupMetrics(source);
+	TimestampTz bucket = ts - ts % store_tiers[tier].bucket;
+	int			c;
+
+	if (r->bucket != DT_NOBEGIN &&
+		(r->bucket != bucket ||
+		 !same_items(nitems, items, r->nitems, r->items)))
+		rollup_emit(source, tier);
+
+	if (r->bucket == DT_NOBEGIN)
+	{
+		if (r->items == NULL ||
+			!same_items(nitems, items, r->nitems, r->items))
+		{
+			copy_items(&r->items, items, nitems);
+			r->nitems = nitems;
+			if (r->min)
+			{
+				pfree(r->min);
+				pfree(r->max);
+				pfree(r->sum);
+				pfree(r->last);
+				pfree(r->count);
+				for (c = 0; c < r->nsketches; c++)
+					sketch_free(&r->sketches[c]);
+				pfree(r->sketches);
+			}
+			r->min = MemoryContextAlloc(TopMemoryContext, sizeof(double) * Max(ncols, 1));
+			r->max = MemoryContextAlloc(TopMemoryContext, sizeof(double) * Max(ncols, 1));
+			r->sum = MemoryContextAlloc(TopMemoryContext, sizeof(double) * Max(ncols, 1));
+			r->last = MemoryContextAlloc(TopMemoryContext, sizeof(double) * Max(ncols, 1));
+			r->count = MemoryContextAlloc(TopMemoryContext, sizeof(int) * Max(ncols, 1));
+			r->sketches = MemoryContextAlloc(TopMemoryContext, sizeof(DDSketch) * Max(ncols, 1));
+			r->nsketches = ncols;
+			for (c = 0; c < ncols; c++)
+				sketch_init(&r->sketches[c], TopMemoryContext);
+		}
+		r->bucket = bucket;
+		memset(r->count, 0, sizeof(int) * Max(ncols, 1));
+		for (c = 0; c < ncols; c++)
+			sketch_reset(&r->sketches[c]);
+	}
+
+	for (c = 0; c < ncols; c++)
+	{
+		if (!valid[c])
+			continue;
+
+		if (r->count[c] == 0)
+		{
+			r->min[c] = r->max[c] = r->sum[c] = rates[c];
+		}
+		else
+		{
+			r->min[c] = Min(r->min[c], rates[c]);
+			r->max[c] = Max(r->max[c], rates[c]);
+			r->sum[c] += rates[c];
+		}
+		r->last[c] = rates[c];
+		r->count[c]++;
+		sketch_add(&r->sketches[c], rates[c]);
+	}
+}
+
+/*
+ * Compute the rollup metric m of an item, the rate per second of a counter,
+ * the value of a gauge or a ratio, from its raw values cur and those of the
+ * previous sample prev, elapsed seconds before.  Return false if it has
+ * none, after a counter reset or for a ratio without events.
+ */
+static bool
+rollup_value(const StoreSourceDef * def, int m, const int64 *cur,
+			 const int64 *prev, double elapsed, double *value)
+{
+	const StoreMetric *metric;
+
+	if (m >= def->nmetrics)
+	{
+		const StoreRatio *ratio = &def->ratios[m - def->nmetrics];
+		int64		num = cur[ratio->numerator] - prev[ratio->numerator];
+		int64		den = cur[ratio->denominator] - prev[ratio->denominator];
+
+		if (num < 0 || den <= 0)
+			return false;
+		*value = (double) num / den;
+		return true;
+	}
+
+	metric = &def->metrics[m];
+	if (metric->counter)
+	{
+		if (cur[m] < prev[m])
+			return false;
+		*value = (double) (cur[m] - prev[m]) / elapsed;
+	}
+	else if (metric->type == STORE_FLOAT4)
+		*value = (double) cur[m] / STORE_FLOAT4_SCALE;
+	else
+		*value = (double) cur[m];
+	return true;
+}
+
+/*
+ * Compute the rollup metrics of a row of raw values, RollupMetrics() per
+ * item.  Return false if there is no previous sample of the same items.
+ */
+static bool
+store_rates(StoreSource source, TimestampTz ts, int nitems,
+			char (*items)[STORE_ITEM_LEN], const int64 *row,
+			double *rates, bool *valid)
+{
+	const StoreSourceDef *def = &store_sources[source];
+	StorePrev  *prev = &store_prev[source];
+	int			nrollup = RollupMetrics(source);
+	double		elapsed;
+	int			i;
+
+	if (prev->ts == DT_NOBEGIN || ts <= prev->ts ||
+		!same_items(nitems, items, prev->nitems, prev->items))
+		return false;
+
+	elapsed = (double) (ts - prev->ts) / USECS_PER_SEC;
+
+	for (i = 0; i < nitems; i++)
+	{
+		int			m;
+
+		for (m = 0; m < nrollup; m++)
+		{
+			int			c = i * nrollup + m;
+
+			valid[c] = rollup_value(def, m, &row[i * def->nmetrics],
+									&prev->values[i * def->nmetrics],
+									elapsed, &rates[c]);
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Append a sample of source to the raw tier, and add its rates to the
+ * rollup tiers.  records are the nitems structs of the source, named by
+ * items.
+ */
+static void
+store_append_source(StoreSource source, TimestampTz ts, int nitems,
+					char (*items)[STORE_ITEM_LEN], const char **records)
+{
+	const StoreSourceDef *def = &store_sources[source];
+	StorePrev  *prev = &store_prev[source];
+	int			ncols = nitems * def->nmetrics;
+	int64	   *row;
+	double	   *rates;
+	bool	   *valid;
+	int			i;
+	int			m;
+	int			tier;
+
+	row = palloc(sizeof(int64) * Max(ncols, 1));
+	for (i = 0; i < nitems; i++)
+		for (m = 0; m < def->nmetrics; m++)
+			row[i * def->nmetrics + m] = metric_value(records[i], &def->metrics[m]);
+
+	store_append_row(source, 0, ts, nitems, items, row, NULL);
+
+	rates = palloc(sizeof(double) * Max(nitems * RollupMetrics(source), 1));
+	valid = palloc(sizeof(bool) * Max(nitems * RollupMetrics(source), 1));
+	if (store_rates(source, ts, nitems, items, row, rates, valid))
+	{
+		for (tier = 1; tier < NUM_STORE_TIERS; tier++)
+		{
+			if (*store_tiers[tier].retention > 0)
+				rollup_add(source, tier, ts, nitems, items, rates, valid);
+		}
+	}
+
+	if (!same_items(nitems, items, prev->nitems, prev->items) ||
+		prev->values == NULL)
+	{
+		copy_items(&prev->items, items, nitems);
+		prev->nitems = nitems;
+		if (prev->values)
+			pfree(prev->values);
+		prev->values = MemoryContextAlloc(TopMemoryContext,
+										  sizeof(int64) * Max(ncols, 1));
+	}
+	memcpy(prev->values, row, sizeof(int64) * ncols);
+	prev->ts = ts;
+}
+
+static void
+store_init(void)
+{
+	char		path[MAXPGPATH];
+	int			s;
+	int			t;
+
+	if (MakePGDirectory(DIR_STORE) < 0 && errno != EEXIST)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not create directory \"%s\": %m", DIR_STORE)));
+
+	for (s = 0; s < NUM_STORE_SOURCES; s++)
+	{
+		for (t = 0; t < NUM_STORE_TIERS; t++)
+		{
+			store_tier_dir(path, s, t);
+			if (MakePGDirectory(path) < 0 && errno != EEXIST)
+				ereport(ERROR,
+						(errcode_for_file_access(),
+						 errmsg("could not create directory \"%s\": %m", path)));
+
+			store_writers[s][t].fd = -1;
+			store_writers[s][t].retry_ts = DT_NOBEGIN;
+			store_rollups[s][t].bucket = DT_NOBEGIN;
+		}
+		store_prev[s].ts = DT_NOBEGIN;
+	}
+
+	/* Write the buffered blocks when the sampler exits. */
+	on_proc_exit(store_close, (Datum) 0);
+
+	store_initialized = true;
+}
+
+/*
+ * Flush and close all the segments.  The buckets in progress are not
+ * written, as they would be written again, incomplete, after a restart.
+ */
+static void
+store_close(int code, Datum arg)
+{
+	int			s;
+	int			t;
+
+	for (s = 0; s < NUM_STORE_SOURCES; s++)
+	{
+		for (t = 0; t < NUM_STORE_TIERS; t++)
+		{
+			store_flush_block(&store_writers[s][t]);
+			store_close_segment(&store_writers[s][t]);
+		}
+	}
+}
+
+/*
+ * Store a sample of the sampler.  This is called by the sampler process
+ * only.
+ */
+void
+store_append(TimestampTz ts, const LoadAvg * loadavg, const MemInfo * meminfo,
+			 List *stats, List *disks)
+{
+	char		single[1][STORE_ITEM_LEN] = {""};
+	const char *record;
+	char	  (*items)[STORE_ITEM_LEN];
+	const char **records;
+	ListCell   *lc;
+	int			n;
+
+	if (store_retention <= 0)
+	{
+		if (store_initialized)
+			store_close(0, (Datum) 0);
+		return;
+	}
+
+	if (!store_initialized)
+		store_init();
+
+	record = (const char *) loadavg;
+	store_append_source(STORE_LOADAVG, ts, 1, single, &record);
+
+	record = (const char *) meminfo;
+	store_append_source(STORE_MEMINFO, ts, 1, single, &record);
+
+	items = palloc0(STORE_ITEM_LEN * Max(list_length(stats), 1));
+	records = palloc(sizeof(char *) * Max(list_length(stats), 1));
+	n = 0;
+	foreach(lc, stats)
+	{
+		ProcStat   *st = (ProcStat *) lfirst(lc);
+
+		strlcpy(items[n], st->cpu, STORE_ITEM_LEN);
+		records[n++] = (const char *) st;
+	}
+	store_append_source(STORE_STAT, ts, n, items, records);
+
+	items = palloc0(STORE_ITEM_LEN * Max(list_length(disks), 1));
+	records = palloc(sizeof(char *) * Max(list_length(disks), 1));
+	n = 0;
+	foreach(lc, disks)
+	{
+		DiskStat   *ds = (DiskStat *) lfirst(lc);
+
+		strlcpy(items[n], ds->name, STORE_ITEM_LEN);
+		records[n++] = (const char *) ds;
+	}
+	store_append_source(STORE_DISKSTATS, ts, n, items, records);
+}
+
+/*
+ * Call cb for each metric of a sample, with the source, item and metric
+ * names and the values of pg_proc_history().  item is NULL for loadavg and
+ * meminfo.
+ */
+void
+store_sample_metrics(const LoadAvg * loadavg, const MemInfo * meminfo,
+					 const ProcStat * stats, int nstats,
+					 const DiskStat * disks, int ndisks,
+					 StoreMetricCallback cb, void *arg)
+{
+	int			s;
+
+	for (s = 0; s < NUM_STORE_SOURCES; s++)
+	{
+		const StoreSourceDef *def = &store_sources[s];
+		int			nitems;
+		int			i;
+
+		switch (s)
+		{
+			case STORE_STAT:
+				nitems = nstats;
+				break;
+			case STORE_DISKSTATS:
+				nitems = ndisks;
+				break;
+			default:
+				nitems = 1;
+				break;
+		}
+
+		for (i = 0; i < nitems; i++)
+		{
+			const char *record;
+			const char *item;
+			int			m;
+
+			switch (s)
+			{
+				case STORE_LOADAVG:
+					record = (const char *) loadavg;
+					item = NULL;
+					break;
+				case STORE_MEMINFO:
+					record = (const char *) meminfo;
+					item = NULL;
+					break;
+				case STORE_STAT:
+					record = (const char *) &stats[i];
+					item = stats[i].cpu;
+					break;
+				default:
+					record = (const char *) &disks[i];
+					item = disks[i].name;
+					break;
+			}
+
+			for (m = 0; m < def->nmetrics; m++)
+			{
+				const StoreMetric *metric = &def->metrics[m];
+
+				cb(arg, def->name, item, metric->name,
+				   store_metric_value(record, metric));
+			}
+		}
+	}
+}
+
+/*
+ * Reader
+ */
+
+/*
+ * Called for each row in the time range.  The value of column c is
+ * values[c * STORE_BLOCK_ROWS].  If a metric is given to store_scan(), the
+ * sketch of it of item i is sketches[i * STORE_BLOCK_ROWS]; otherwise
+ * sketches is NULL.
+ */
+typedef void (*StoreRowCallback) (void *arg, TimestampTz ts, int nitems,
+								  char (*items)[STORE_ITEM_LEN],
+								  const int64 *values,
+								  const DDSketch * sketches);
+
+typedef struct StoreSegment
+{
+	int64		start;			/* from the file name */
+	char		path[MAXPGPATH];
+}			StoreSegment;
+
+static int
+segment_cmp(const void *a, const void *b)
+{
+	int64		sa = ((const StoreSegment *) a)->start;
+	int64		sb = ((const StoreSegment *) b)->start;
+
+	return (sa < sb) ? -1 : (sa > sb);
+}
+
+/*
+ * Read the segment into a palloc'd buffer, unless its header shows that it
+ * has no row in (since, until].  Return NULL if it is skipped, or it has
+ * been removed or is being created meanwhile.
+ */
+static char *
+read_segment_file(const char *path, TimestampTz since, TimestampTz until,
+				  size_t *len)
+{
+	StoreSegmentHeader hdr;
+	int			fd;
+	struct stat st;
+	char	   *buf;
+	size_t		total = 0;
+
+	if ((fd = OpenTransientFile(path, O_RDONLY | PG_BINARY)) < 0)
+	{
+		if (errno == ENOENT)
+			return NULL;
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m", path)));
+	}
+
+	/* Prune the segment by the time range in its header. */
+	if (pg_pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+		(hdr.magic == STORE_SEGMENT_MAGIC &&
+		 (hdr.max_ts == DT_NOBEGIN || hdr.max_ts <= since || hdr.min_ts > until)))
+	{
+		CloseTransientFile(fd);
+		return NULL;
+	}
+
+	if (fstat(fd, &st) < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not stat file \"%s\": %m", path)));
+
+	buf = palloc(Max(st.st_size, 1));
+	while (total < (size_t) st.st_size)
+	{
+		ssize_t		n = pg_pread(fd, buf + total, st.st_size - total, total);
+
+		if (n < 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not read file \"%s\": %m", path)));
+		if (n == 0)
+			break;
+		total += n;
+	}
+	CloseTransientFile(fd);
+
+	*len = total;
+	return buf;
+}
+
+/*
+ * Call cb for each row of a segment in (since, until].  The sketches of
+ * metric are decoded, if it is not -1.
+ */
+static void
+store_scan_segment(StoreSource source, int tier, const char *path,
+				   TimestampTz since, TimestampTz until, int metric,
+				   StoreRowCallback cb, void *arg)
+{
+	StoreSegmentHeader hdr;
+	char	   *buf;
+	size_t		len;
+	size_t		off;
+	char	  (*items)[STORE_ITEM_LEN];
+	int			ncols;
+	int			nsketches;
+	TimestampTz *ts;
+	int64	   *values;
+	DDSketch   *sketches = NULL;
+
+	if ((buf = read_segment_file(path, since, until, &len)) == NULL)
+		return;
+	memcpy(&hdr, buf, sizeof(hdr));
+
+	if (hdr.magic != STORE_SEGMENT_MAGIC || hdr.version != STORE_VERSION ||
+		hdr.source != source || hdr.tier != tier ||
+		hdr.nmetrics != TierMetrics(source, tier) || hdr.nitems < 0 ||
+		len < sizeof(hdr) + (size_t) STORE_ITEM_LEN * hdr.nitems)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_EXCEPTION),
+				 errmsg("unexpected file format: \"%s\"", path),
+				 errdetail("invalid segment header")));
+
+	items = (char (*)[STORE_ITEM_LEN]) (buf + sizeof(hdr));
+	ncols = hdr.nitems * hdr.nmetrics;
+	ts = palloc(sizeof(TimestampTz) * STORE_BLOCK_ROWS);
+	values = palloc(sizeof(int64) * STORE_BLOCK_ROWS * Max(ncols, 1));
+
+	nsketches = (tier > 0) ? hdr.nitems * RollupMetrics(source) : 0;
+	if (metric >= 0 && nsketches > 0)
+	{
+		int			k;
+
+		sketches = palloc(sizeof(DDSketch) * STORE_BLOCK_ROWS * hdr.nitems);
+		for (k = 0; k < STORE_BLOCK_ROWS * hdr.nitems; k++)
+			sketch_init(&sketches[k], CurrentMemoryContext);
+	}
+
+	off = sizeof(hdr) + (size_t) STORE_ITEM_LEN * hdr.nitems;
+	while (off + sizeof(StoreBlockHeader) <= len)
+	{
+		StoreBlockHeader bh;
+		const uint8 *p;
+		const uint8 *end;
+		pg_crc32c	crc;
+		uint64		collen;
+		bool		valid = true;
+		int			c;
+		int			r;
+
+		memcpy(&bh, buf + off, sizeof(bh));
+
+		/* Stop at a torn or partially written block. */
+		if (bh.magic != STORE_BLOCK_MAGIC ||
+			bh.nrows == 0 || bh.nrows > STORE_BLOCK_ROWS ||
+			bh.size > len - off - sizeof(bh))
+			break;
+
+		p = (const uint8 *) buf + off + sizeof(bh);
+		end = p + bh.size;
+		off += sizeof(bh) + bh.size;
+
+		if (bh.max_ts <= since || bh.min_ts > until)
+			continue;
+
+		INIT_CRC32C(crc);
+		COMP_CRC32C(crc, p, bh.size);
+		FIN_CRC32C(crc);
+		if (!EQ_CRC32C(crc, bh.crc))
+			break;
+
+		for (c = -1; c < ncols && valid; c++)
+		{
+			int64	   *col = (c < 0) ? (int64 *) ts : &values[c * STORE_BLOCK_ROWS];
+
+			valid = read_varint(&p, end, &collen) &&
+				collen <= (uint64) (end - p) &&
+				decode_column(p, collen, col, bh.nrows);
+			p += collen;
+		}
+		for (c = 0; c < nsketches && valid; c++)
+		{
+			const uint8 *colend;
+
+			valid = read_varint(&p, end, &collen) &&
+				collen <= (uint64) (end - p);
+			if (!valid)
+				break;
+			colend = p + collen;
+
+			if (sketches && c % RollupMetrics(source) == metric)
+			{
+				int			i = c / RollupMetrics(source);
+
+				for (r = 0; r < (int) bh.nrows && valid; r++)
+					valid = read_sketch(&p, colend, &sketches[i * STORE_BLOCK_ROWS + r]);
+			}
+			p = colend;
+		}
+		if (!valid)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_EXCEPTION),
+					 errmsg("unexpected file format: \"%s\"", path),
+					 errdetail("invalid block at offset %zu", off - bh.size - sizeof(bh))));
+
+		for (r = 0; r < (int) bh.nrows; r++)
+		{
+			if (ts[r] > since && ts[r] <= until)
+				cb(arg, ts[r], hdr.nitems, items, &values[r],
+				   sketches ? &sketches[r] : NULL);
+		}
+	}
+
+	if (sketches)
+	{
+		int			k;
+
+		for (k = 0; k < STORE_BLOCK_ROWS * hdr.nitems; k++)
+			sketch_free(&sketches[k]);
+		pfree(sketches);
+	}
+	pfree(ts);
+	pfree(values);
+	pfree(buf);
+}
+
+/*
+ * Call cb for each row of the source and tier in (since, until], oldest
+ * first, with the sketches of metric unless it is -1.
+ */
+static void
+store_scan(StoreSource source, int tier, TimestampTz since, TimestampTz until,
+		   int metric, StoreRowCallback cb, void *arg)
+{
+	char		dirpath[MAXPGPATH];
+	StoreSegment *segments;
+	int			nsegments = 0;
+	int			maxsegments = 64;
+	DIR		   *dir;
+	struct dirent *de;
+	int			i;
+
+	store_tier_dir(dirpath, source, tier);
+	if ((dir = AllocateDir(dirpath)) == NULL)
+	{
+		if (errno == ENOENT)
+			return;
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open directory \"%s\": %m", dirpath)));
+	}
+
+	segments = palloc(sizeof(StoreSegment) * maxsegments);
+	while ((de = ReadDir(dir, dirpath)) != NULL)
+	{
+		char	   *end;
+		int64		start = strtoi64(de->d_name, &end, 10);
+
+		if (end == de->d_name || strcmp(end, STORE_SUFFIX) != 0)
+			continue;
+
+		if (nsegments == maxsegments)
+		{
+			maxsegments *= 2;
+			segments = repalloc(segments, sizeof(StoreSegment) * maxsegments);
+		}
+		segments[nsegments].start = start;
+		snprintf(segments[nsegments].path, MAXPGPATH, "%s/%s", dirpath, de->d_name);
+		nsegments++;
+	}
+	FreeDir(dir);
+
+	qsort(segments, nsegments, sizeof(StoreSegment), segment_cmp);
+
+	for (i = 0; i < nsegments; i++)
+	{
+		/* A segment starting after until has no row to return. */
+		if (segments[i].start > until)
+			break;
+
+		CHECK_FOR_INTERRUPTS();
+		store_scan_segment(source, tier, segments[i].path, since, until,
+						   metric, cb, arg);
+	}
+
+	pfree(segments);
+}
+
+static StoreSource
+parse_source(const char *name)
+{
+	int			s;
+
+	for (s = 0; s < NUM_STORE_SOURCES; s++)
+		if (strcmp(name, store_sources[s].name) == 0)
+			return (StoreSource) s;
+
+	ereport(ERROR,
+			(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+			 errmsg("invalid history source: \"%s\"", name),
+			 errhint("Valid sources are \"loadavg\", \"meminfo\", \"stat\" and \"diskstats\".")));
+	return NUM_STORE_SOURCES;	/* keep compiler quiet */
+}
+
+typedef struct StoreEmitState
+{
+	ReturnSetInfo *rsinfo;
+	StoreSource source;
+
+	/* for the rates of the raw samples in pg_proc_history_rollup() */
+	TimestampTz prev_ts;		/* DT_NOBEGIN if none */
+	int			prev_nitems;
+	char	  (*prev_items)[STORE_ITEM_LEN];
+	int64	   *prev_values;
+}			StoreEmitState;
+
+/*
+ * Show the raw samples of a source stored on disk, one row per item and
+ * metric.
+ */
+
+#define NUM_HISTORY_COLS 4
+
+static void
+emit_raw(void *arg, TimestampTz ts, int nitems, char (*items)[STORE_ITEM_LEN],
+		 const int64 *values, const DDSketch * sketches)
+{
+	StoreEmitState *st = (StoreEmitState *) arg;
+	const StoreSourceDef *def = &store_sources[st->source];
+	int			i;
+	int			m;
+
+	for (i = 0; i < nitems; i++)
+	{
+		for (m = 0; m < def->nmetrics; m++)
+		{
+			const StoreMetric *metric = &def->metrics[m];
+			int64		v = values[(i * def->nmetrics + m) * STORE_BLOCK_ROWS];
+			Datum		values_out[NUM_HISTORY_COLS];
+			bool		nulls[NUM_HISTORY_COLS];
+
+			memset(nulls, false, sizeof(nulls));
+
+			values_out[0] = TimestampTzGetDatum(ts);
+			if (def->has_items)
+				values_out[1] = CStringGetTextDatum(items[i]);
+			else
+				nulls[1] = true;
+			values_out[2] = CStringGetTextDatum(metric->name);
+			if (metric->type == STORE_FLOAT4)
+				values_out[3] = Float8GetDatum((double) v / STORE_FLOAT4_SCALE);
+			else
+				values_out[3] = Float8GetDatum((double) v);
+
+			tuplestore_putvalues(st->rsinfo->setResult, st->rsinfo->setDesc,
+								 values_out, nulls);
+		}
+	}
+}
+
+PG_FUNCTION_INFO_V1(pg_proc_history);
+
+Datum
+pg_proc_history(PG_FUNCTION_ARGS)
+{
+	StoreEmitState st;
+
+	memset(&st, 0, sizeof(st));
+	st.source = parse_source(text_to_cstring(PG_GETARG_TEXT_PP(0)));
+
+	InitMaterializedSRF(fcinfo, 0);
+	st.rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+
+	store_scan(st.source, 0, PG_GETARG_TIMESTAMPTZ(1), PG_GETARG_TIMESTAMPTZ(2),
+			   -1, emit_raw, &st);
+
+	return (Datum) 0;
+}
+
+/*
+ * Show the rollups of a source at the requested resolution: min, max, avg
+ * and last of the rate per second of each counter, of the value of each
+ * gauge, and of each ratio, per bucket.
+ *
+ * The coarsest tier whose buckets are not longer than the resolution is
+ * read.  Below a minute, the rates are computed from the raw samples, and
+ * all four are the rate since the previous sample.
+ */
+
+#define NUM_HISTORY_ROLLUP_COLS 7
+
+static const char *
+rollup_metric_name(const StoreSourceDef * def, int m)
+{
+	if (m >= def->nmetrics)
+		return def->ratios[m - def->nmetrics].name;
+	return def->metrics[m].name;
+}
+
+static void
+emit_rollup_row(StoreEmitState * st, TimestampTz ts, const char *item,
+				const char *metric, const double *stats)
+{
+	Datum		values[NUM_HISTORY_ROLLUP_COLS];
+	bool		nulls[NUM_HISTORY_ROLLUP_COLS];
+	int			i;
+	int			k;
+
+	memset(nulls, false, sizeof(nulls));
+
+	i = 0;
+	values[i++] = TimestampTzGetDatum(ts);
+	if (item)
+		values[i++] = CStringGetTextDatum(item);
+	else
+		nulls[i++] = true;
+	values[i++] = CStringGetTextDatum(metric);
+	for (k = 0; k < NUM_ROLLUP_STATS; k++)
+		values[i++] = Float8GetDatum(stats[k]);
+	Assert(i == NUM_HISTORY_ROLLUP_COLS);
+
+	tuplestore_putvalues(st->rsinfo->setResult, st->rsinfo->setDesc,
+						 values, nulls);
+}
+
+static void
+emit_rollup(void *arg, TimestampTz ts, int nitems, char (*items)[STORE_ITEM_LEN],
+			const int64 *values, const DDSketch * sketches)
+{
+	StoreEmitState *st = (StoreEmitState *) arg;
+	const StoreSourceDef *def = &store_sources[st->source];
+	int			nrollup = RollupMetrics(st->source);
+	int			i;
+	int			m;
+
+	for (i = 0; i < nitems; i++)
+	{
+		for (m = 0; m < nrollup; m++)
+		{
+			int			c = (i * nrollup + m) * NUM_ROLLUP_STATS;
+			double		stats[NUM_ROLLUP_STATS];
+			int			k;
+
+			for (k = 0; k < NUM_ROLLUP_STATS; k++)
+				stats[k] = (double) values[(c + k) * STORE_BLOCK_ROWS] / STORE_RATE_SCALE;
+
+			emit_rollup_row(st, ts, def->has_items ? items[i] : NULL,
+							rollup_metric_name(def, m), stats);
+		}
+	}
+}
+
+static void
+emit_raw_rates(void *arg, TimestampTz ts, int nitems, char (*items)[STORE_ITEM_LEN],
+			   const int64 *values, const DDSketch * sketches)
+{
+	StoreEmitState *st = (StoreEmitState *) arg;
+	const StoreSourceDef *def = &store_sources[st->source];
+	int			nrollup = RollupMetrics(st->source);
+	int			ncols = nitems * def->nmetrics;
+	int64	   *row;
+	bool		have_prev;
+	int			c;
+	int			i;
+
+	row = palloc(sizeof(int64) * Max(ncols, 1));
+	for (c = 0; c < ncols; c++)
+		row[c] = values[c * STORE_BLOCK_ROWS];
+
+	have_prev = st->prev_ts != DT_NOBEGIN && ts > st->prev_ts &&
+		same_items(nitems, items, st->prev_nitems, st->prev_items);
+
+	for (i = 0; i < nitems && have_prev; i++)
+	{
+		double		elapsed = (double) (ts - st->prev_ts) / USECS_PER_SEC;
+		int			m;
+
+		for (m = 0; m < nrollup; m++)
+		{
+			double		rate;
+			double		stats[NUM_ROLLUP_STATS];
+			int			k;
+
+			if (!rollup_value(def, m, &row[i * def->nmetrics],
+							  &st->prev_values[i * def->nmetrics],
+							  elapsed, &rate))
+				continue;
+
+			for (k = 0; k < NUM_ROLLUP_STATS; k++)
+				stats[k] = rate;
+
+			emit_rollup_row(st, ts, def->has_items ? items[i] : NULL,
+							rollup_metric_name(def, m), stats);
+		}
+	}
+
+	if (!have_prev)
+	{
+		if (st->prev_items)
+			pfree(st->prev_items);
+		if (st->prev_values)
+			pfree(st->prev_values);
+		st->prev_items = palloc(Max(STORE_ITEM_LEN * nitems, 1));
+		memcpy(st->prev_items, items, STORE_ITEM_LEN * nitems);
+		st->prev_nitems = nitems;
+		st->prev_values = palloc(sizeof(int64) * Max(ncols, 1));
+	}
+	memcpy(st->prev_values, row, sizeof(int64) * ncols);
+	st->prev_ts = ts;
+	pfree(row);
+}
+
+PG_FUNCTION_INFO_V1(pg_proc_history_rollup);
+
+Datum
+pg_proc_history_rollup(PG_FUNCTION_ARGS)
+{
+	Interval   *resolution = PG_GETARG_INTERVAL_P(1);
+	TimestampTz since = PG_GETARG_TIMESTAMPTZ(2);
+	TimestampTz until = PG_GETARG_TIMESTAMPTZ(3);
+	StoreEmitState st;
+	int64		resolution_us;
+	int			tier;
+
+	memset(&st, 0, sizeof(st));
+	st.source = parse_source(text_to_cstring(PG_GETARG_TEXT_PP(0)));
+	st.prev_ts = DT_NOBEGIN;
+
+	resolution_us = resolution->time +
+		((int64) resolution->month * DAYS_PER_MONTH + resolution->day) * USECS_PER_DAY;
+
+	for (tier = NUM_STORE_TIERS - 1; tier > 0; tier--)
+		if (store_tiers[tier].bucket <= resolution_us)
+			break;
+
+	InitMaterializedSRF(fcinfo, 0);
+	st.rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+
+	if (tier == 0)
+		store_scan(st.source, 0, since, until, -1, emit_raw_rates, &st);
+	else
+		store_scan(st.source, tier, since, until, -1, emit_rollup, &st);
+
+	return (Datum) 0;
+}
+
+/*
+ * Show the quantiles of the rate per second of a counter, or of the value
+ * of a gauge, over the buckets of a rollup tier overlapping (since, until],
+ * by merging their sketches.
+ *
+ * The 1 minute tier is read if it still covers since, and the 1 hour tier
+ * otherwise.  The bucket in progress is not on disk yet, so the last
+ * minute, or hour, is not included.
+ */
+
+#define NUM_PERCENTILES_COLS 4
+
+typedef struct StoreItemSketch
+{
+	char		item[STORE_ITEM_LEN];
+	DDSketch	sketch;
+}			StoreItemSketch;
+
+typedef struct StoreMergeState
+{
+	int			nitems;
+	int			maxitems;
+	StoreItemSketch *items;
+}			StoreMergeState;
+
+static void
+merge_sketches(void *arg, TimestampTz ts, int nitems, char (*items)[STORE_ITEM_LEN],
+			   const int64 *values, const DDSketch * sketches)
+{
+	StoreMergeState *st = (StoreMergeState *) arg;
+	int			i;
+	int			j;
+
+	for (i = 0; i < nitems; i++)
+	{
+		/* The items rarely change, so they are looked up linearly. */
+		for (j = 0; j < st->nitems; j++)
+			if (strcmp(st->items[j].item, items[i]) == 0)
+				break;
+
+		if (j == st->nitems)
+		{
+			if (st->nitems == st->maxitems)
+			{
+				st->maxitems *= 2;
+				st->items = repalloc(st->items, sizeof(StoreItemSketch) * st->maxitems);
+			}
+			strlcpy(st->items[j].item, items[i], STORE_ITEM_LEN);
+			sketch_init(&st->items[j].sketch, CurrentMemoryContext);
+			st->nitems++;
+		}
+
+		sketch_merge(&st->items[j].sketch, &sketches[i * STORE_BLOCK_ROWS]);
+	}
+}
+
+PG_FUNCTION_INFO_V1(pg_proc_percentiles);
+
+Datum
+pg_proc_percentiles(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	char	   *name = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	TimestampTz since = PG_GETARG_TIMESTAMPTZ(1);
+	TimestampTz until = PG_GETARG_TIMESTAMPTZ(2);
+	ArrayType  *quantiles = PG_GETARG_ARRAYTYPE_P(3);
+	char	   *dot = strchr(name, '.');
+	Datum	   *elems;
+	int			nquantiles;
+	StoreSource source;
+	StoreMergeState st;
+	int			metric;
+	int			tier;
+	int			i;
+	int			k;
+
+	if (dot == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("invalid metric: \"%s\"", name),
+				 errhint("Metrics are named \"source.metric\", e.g. \"stat.iowait\" or \"diskstats.w_await\".")));
+	*dot = '\0';
+	source = parse_source(name);
+
+	for (metric = 0; metric < RollupMetrics(source); metric++)
+		if (strcmp(dot + 1, rollup_metric_name(&store_sources[source], metric)) == 0)
+			break;
+	if (metric == RollupMetrics(source))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("invalid metric of \"%s\": \"%s\"", name, dot + 1),
+				 errhint("The metrics are those of pg_proc_history_rollup(\"%s\").", name)));
+
+	if (array_contains_nulls(quantiles))
+		ereport(ERROR,
+				(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+				 errmsg("quantiles must not contain nulls")));
+	deconstruct_array_builtin(quantiles, FLOAT8OID, &elems, NULL, &nquantiles);
+	for (k = 0; k < nquantiles; k++)
+	{
+		double		q = DatumGetFloat8(elems[k]);
+
+		if (!(q >= 0 && q <= 1))
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("quantile %g is out of range", q),
+					 errhint("Quantiles must be between 0 and 1.")));
+	}
+
+	/* Prefer the finer tier while it still holds since. */
+	tier = 1;
+	if (store_retention_1m <= 0 ||
+		(store_retention_1h > 0 &&
+		 since < GetCurrentTimestamp() - (int64) store_retention_1m * USECS_PER_MINUTE))
+		tier = 2;
+
+	/* A bucket starting before since overlaps the range if it ends after it. */
+	if (!TIMESTAMP_IS_NOBEGIN(since))
+		since -= store_tiers[tier].bucket;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	st.nitems = 0;
+	st.maxitems = 8;
+	st.items = palloc(sizeof(StoreItemSketch) * st.maxitems);
+	store_scan(source, tier, since, until, metric, merge_sketches, &st);
+
+	for (i = 0; i < st.nitems; i++)
+	{
+		const DDSketch *sk = &st.items[i].sketch;
+
+		for (k = 0; k < nquantiles; k++)
+		{
+			Datum		values[NUM_PERCENTILES_COLS];
+			bool		nulls[NUM_PERCENTILES_COLS];
+			int			j = 0;
+
+			memset(nulls, false, sizeof(nulls));
+
+			if (store_sources[source].has_items)
+				values[j++] = CStringGetTextDatum(st.items[i].item);
+			else
+				nulls[j++] = true;
+			values[j++] = elems[k];
+			if (sk->count > 0)
+				values[j++] = Float8GetDatum(sketch_quantile(sk, DatumGetFloat8(elems[k])));
+			else
+				nulls[j++] = true;
+			values[j++] = Int64GetDatum(sk->count);
+			Assert(j == NUM_PERCENTILES_COLS);
+
+			tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+		}
+	}
+
+	return (Datum) 0;
+}
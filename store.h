@@ -0,0 +1,115 @@
+/*-------------------------------------------------------------------------
+ *
+ * store.h
+ *		On-disk time-series store of pg_linux_proc
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#ifndef __STORE_H__
+#define __STORE_H__
+
+#include "datatype/timestamp.h"
+#include "nodes/pg_list.h"
+
+#include "diskstats.h"
+#include "loadavg.h"
+#include "meminfo.h"
+#include "stat.h"
+
+/* Relative to the data directory */
+#define DIR_STORE			"pg_linux_proc"
+
+typedef enum StoreType
+{
+	STORE_INT32,
+	STORE_INT64,
+	STORE_FLOAT4
+}			StoreType;
+
+/* The unit of the value of a metric in its /proc file */
+typedef enum StoreUnit
+{
+	STORE_UNIT_NONE,
+	STORE_UNIT_TICKS,			/* USER_HZ */
+	STORE_UNIT_KB,
+	STORE_UNIT_SECTORS,			/* 512 bytes */
+	STORE_UNIT_MS
+}			StoreUnit;
+
+/*
+ * A metric of a source, a field of the struct its collector fills.  This
+ * is the one table of the names of the metrics, those of pg_proc_history(),
+ * the sink and the OpenMetrics endpoint.  A counter is rolled up as its
+ * rate per second, a gauge as its value.
+ */
+typedef struct StoreMetric
+{
+	const char *name;
+	size_t		offset;			/* of the field in the record */
+	StoreType	type;
+	bool		counter;
+	StoreUnit	unit;
+	const char *help;
+}			StoreMetric;
+
+/*
+ * A ratio is rolled up as the delta of a counter over the delta of another
+ * between two samples, such as the await of a device, the time spent on
+ * the I/Os completed over their number.  It is computed as get_iostat()
+ * does, and exists in the rollup tiers only.  The counters are given by
+ * their index in the metrics of the source.
+ */
+typedef struct StoreRatio
+{
+	const char *name;
+	int			numerator;
+	int			denominator;
+}			StoreRatio;
+
+typedef enum StoreSource
+{
+	STORE_LOADAVG,
+	STORE_MEMINFO,
+	STORE_STAT,
+	STORE_DISKSTATS,
+	NUM_STORE_SOURCES
+}			StoreSource;
+
+typedef struct StoreSourceDef
+{
+	const char *name;
+	const StoreMetric *metrics;
+	int			nmetrics;
+	const StoreRatio *ratios;	/* of the rollup tiers */
+	int			nratios;
+	bool		has_items;		/* false for a single unnamed item */
+}			StoreSourceDef;
+
+extern const StoreSourceDef store_sources[NUM_STORE_SOURCES];
+
+/* Called for each metric of a sample by store_sample_metrics() */
+typedef void (*StoreMetricCallback) (void *arg, const char *source,
+									 const char *item, const char *metric,
+									 double value);
+
+/* GUC variables */
+extern int	store_retention;
+extern int	store_retention_1m;
+extern int	store_retention_1h;
+extern int	store_segment_duration;
+
+extern void store_define_gucs(void);
+extern void store_append(TimestampTz ts, const LoadAvg * loadavg,
+						 const MemInfo * meminfo, List *stats, List *disks);
+extern double store_metric_value(const char *record, const StoreMetric * metric);
+extern void store_sample_metrics(const LoadAvg * loadavg, const MemInfo * meminfo,
+								 const ProcStat * stats, int nstats,
+								 const DiskStat * disks, int ndisks,
+								 StoreMetricCallback cb, void *arg);
+
+#endif
@@ -0,0 +1,116 @@
+/*-------------------------------------------------------------------------
+ *
+ * vmstat.c
+ *		Show /proc/vmstat info on Linux
+ *
+ * /proc/vmstat has about 200 "name value" lines.  The nr_* lines are
+ * mostly levels, e.g. nr_dirty, and the others are event counters since
+ * boot, e.g. pgmajfault, allocstall_normal and compact_fail.
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "parse.h"
+#include "procfile.h"
+#include "vmstat.h"
+
+static ProcFile vmstat_file = PROCFILE_INIT(FILE_VMSTAT);
+
+/*
+ * Append a VmStat per line of /proc/vmstat.
+ */
+List *
+get_proc_vmstat(List *vmstat)
+{
+	char	   *buf;
+	char	   *p;
+	char	   *line;
+	size_t		len;
+
+	buf = procfile_read(&vmstat_file, &len);
+
+	p = buf;
+	while ((line = pl_next_line(&p)) != NULL)
+	{
+		char	   *name = pl_next_token(&line);
+		VmStat	   *vs;
+
+		if (name == NULL)
+			continue;
+
+		vs = (VmStat *) palloc(sizeof(VmStat));
+		strlcpy(vs->name, name, sizeof(vs->name));
+		if (!pl_parse_int64(&line, &vs->value))
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_EXCEPTION),
+					 errmsg("unexpected file format: \"%s\"", FILE_VMSTAT),
+					 errdetail("number of fields is not corresponding")));
+
+		vmstat = lappend(vmstat, vs);
+	}
+
+	return vmstat;
+}
+
+/*
+ * Compute the change of each line between two results of get_proc_vmstat()
+ * taken elapsed seconds apart.
+ *
+ * The delta is signed, since a level such as nr_dirty can go down.  Both
+ * samples come from the same kernel, so the lines are matched by position
+ * and only looked up by name if the lists differ.
+ */
+List *
+get_vmstat_rate(List *prev, List *cur, double elapsed)
+{
+	List	   *rates = NIL;
+	ListCell   *lc;
+	int			n = 0;
+
+	if (elapsed <= 0)
+		return NIL;
+
+	foreach(lc, cur)
+	{
+		VmStat	   *c = (VmStat *) lfirst(lc);
+		VmStat	   *p = NULL;
+		VmStatRate *r;
+
+		if (n < list_length(prev) &&
+			strcmp(((VmStat *) list_nth(prev, n))->name, c->name) == 0)
+			p = (VmStat *) list_nth(prev, n);
+		else
+		{
+			ListCell   *lc2;
+
+			foreach(lc2, prev)
+			{
+				VmStat	   *v = (VmStat *) lfirst(lc2);
+
+				if (strcmp(v->name, c->name) == 0)
+				{
+					p = v;
+					break;
+				}
+			}
+		}
+		n++;
+
+		if (p == NULL)
+			continue;
+
+		r = (VmStatRate *) palloc(sizeof(VmStatRate));
+		strlcpy(r->name, c->name, sizeof(r->name));
+		r->delta = c->value - p->value;
+		r->rate = r->delta / elapsed;
+
+		rates = lappend(rates, r);
+	}
+
+	return rates;
+}
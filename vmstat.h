@@ -0,0 +1,40 @@
+/*-------------------------------------------------------------------------
+ *
+ * vmstat.h
+ *		Show /proc/vmstat info on Linux
+ *
+ * Copyright (c) 2008-2025, PostgreSQL Global Development Group
+ * Copyright (c) 2024-2025, Hironobu Suzuki @ interdb.jp
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#ifndef __VMSTAT_H__
+#define __VMSTAT_H__
+
+#include "nodes/pg_list.h"
+
+#define FILE_VMSTAT			"/proc/vmstat"
+#define VMSTAT_NAME_LEN		64
+
+/* A line of /proc/vmstat, e.g. "pgmajfault 1234" */
+typedef struct VmStat
+{
+	char		name[VMSTAT_NAME_LEN];
+	int64		value;
+}			VmStat;
+
+/* Change of a VmStat between two samples */
+typedef struct VmStatRate
+{
+	char		name[VMSTAT_NAME_LEN];
+	int64		delta;
+	double		rate;			/* per second */
+}			VmStatRate;
+
+
+extern List *get_proc_vmstat(List *vmstat);
+extern List *get_vmstat_rate(List *prev, List *cur, double elapsed);
+
+#endif